@@ -0,0 +1,138 @@
+#include "AllocationTracker.h"
+
+#if ALLOCATION_TRACKER
+
+#include <cstdlib>
+#include <new>
+
+// thread local storage for plain counters, thread_local isn't available in VS2012
+#if defined( _MSC_VER )
+    #define ALLOCATION_TLS __declspec( thread )
+#else
+    #define ALLOCATION_TLS __thread
+#endif
+
+
+namespace {
+
+    ALLOCATION_TLS uint64_t sAllocations    = 0;
+    ALLOCATION_TLS uint64_t sBytes          = 0;
+
+    // like the standard operator new, calls the new handler until the allocation succeeds or there is no handler left.
+    // std::get_new_handler() is missing from VS2012, the handler is read back by setting it
+    void* allocate( size_t size )
+    {
+        sAllocations++;
+        sBytes += size;
+
+        for(;;)
+        {
+            void *ptr = std::malloc( size > 0 ? size : 1 );
+            if ( ptr )
+                return ptr;
+
+            std::new_handler handler = std::set_new_handler( 0 );
+            std::set_new_handler( handler );
+
+            if ( !handler )
+                throw std::bad_alloc();
+
+            handler();
+        }
+    }
+
+    void* allocateNoThrow( size_t size ) throw()
+    {
+        try {
+            return allocate( size );
+        }
+        catch( const std::bad_alloc& ) {
+            return 0;
+        }
+    }
+
+}
+
+
+AllocationTracker::Counts AllocationTracker::getThreadCounts()
+{
+    Counts counts;
+    counts.mAllocations = sAllocations;
+    counts.mBytes       = sBytes;
+
+    return counts;
+}
+
+
+void* operator new( size_t size )
+{
+    return allocate( size );
+}
+
+
+void* operator new[]( size_t size )
+{
+    return allocate( size );
+}
+
+
+void* operator new( size_t size, const std::nothrow_t& ) throw()
+{
+    return allocateNoThrow( size );
+}
+
+
+void* operator new[]( size_t size, const std::nothrow_t& ) throw()
+{
+    return allocateNoThrow( size );
+}
+
+
+void operator delete( void *ptr ) throw()
+{
+    std::free( ptr );
+}
+
+
+void operator delete[]( void *ptr ) throw()
+{
+    std::free( ptr );
+}
+
+
+void operator delete( void *ptr, const std::nothrow_t& ) throw()
+{
+    std::free( ptr );
+}
+
+
+void operator delete[]( void *ptr, const std::nothrow_t& ) throw()
+{
+    std::free( ptr );
+}
+
+
+// since C++14 the compiler calls the sized versions when it knows the size, they free like the others
+#if defined( __cpp_sized_deallocation )
+
+void operator delete( void *ptr, size_t ) throw()
+{
+    std::free( ptr );
+}
+
+
+void operator delete[]( void *ptr, size_t ) throw()
+{
+    std::free( ptr );
+}
+
+#endif
+
+#else
+
+AllocationTracker::Counts AllocationTracker::getThreadCounts()
+{
+    return Counts();
+}
+
+#endif
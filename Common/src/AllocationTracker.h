@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+
+// the replacement of operator new and delete is opt-in, add ALLOCATION_TRACKER=1 to the preprocessor definitions
+// of a profiling build, otherwise the counts stay at zero and the allocator is the standard one
+#ifndef ALLOCATION_TRACKER
+    #define ALLOCATION_TRACKER 0
+#endif
+
+
+//! Counts the heap allocations of each thread by replacing the global operator new and delete, in builds with ALLOCATION_TRACKER=1.
+//! The counters are thread local and never locked.
+//! The counts are cumulative, a stage of the frame is measured by the difference of two snapshots taken on the same thread.
+class AllocationTracker {
+
+public:
+
+    //! False unless the build defines ALLOCATION_TRACKER=1, getThreadCounts() always returns zero then.
+    static bool     isEnabled()                     { return ALLOCATION_TRACKER != 0; }
+
+    struct Counts {
+        Counts() : mAllocations( 0 ), mBytes( 0 ) {}
+
+        Counts& operator+=( const Counts &rhs )
+        {
+            mAllocations    += rhs.mAllocations;
+            mBytes          += rhs.mBytes;
+            return *this;
+        }
+
+        Counts operator-( const Counts &rhs ) const
+        {
+            Counts counts;
+            counts.mAllocations = mAllocations - rhs.mAllocations;
+            counts.mBytes       = mBytes - rhs.mBytes;
+            return counts;
+        }
+
+        uint64_t    mAllocations;
+        uint64_t    mBytes;
+    };
+
+    //! Allocations made by the calling thread since it started.
+    static Counts   getThreadCounts();
+};
@@ -0,0 +1,166 @@
+#include "AsyncMeshLoader.h"
+
+#include "cinder/app/App.h"
+#include "ObjParser.h"
+#include "cinder/Timer.h"
+
+using namespace ci;
+using namespace ci::app;
+using namespace std;
+
+
+AsyncMeshLoader::AsyncMeshLoader( const Format &format )
+: mFormat( format ), mRequestId( 0 ), mResultId( 0 ), mResultLoadTime( 0.0 ), mFailedId( 0 ), mRunning( true ),
+  mLatestId( 0 ), mDoneId( 0 ), mUploadingId( 0 )
+{
+    if ( !mFormat.mLoadFn )
+        mFormat.mLoadFn = &AsyncMeshLoader::loadObj;
+
+    mThread = shared_ptr<thread>( new thread( bind( &AsyncMeshLoader::workerLoop, this ) ) );
+}
+
+
+AsyncMeshLoader::~AsyncMeshLoader()
+{
+    {
+        lock_guard<mutex> lock( mMutex );
+        mRunning = false;
+    }
+    mCond.notify_one();
+
+    // a load in progress is waited for, the parsers can't be interrupted
+    mThread->join();
+}
+
+
+MeshDataRef AsyncMeshLoader::loadObj( const fs::path &path )
+{
+    TriMesh mesh;
+    ObjParser::create( path )->load( &mesh );
+
+    return MeshData::create( mesh );
+}
+
+
+void AsyncMeshLoader::load( const fs::path &path )
+{
+    {
+        lock_guard<mutex> lock( mMutex );
+        mRequestPath    = path;
+        mRequestId      = ++mLatestId;
+    }
+    mCond.notify_one();
+
+    mRequestTimer.start();
+}
+
+
+bool AsyncMeshLoader::update()
+{
+    // pick up a freshly loaded mesh, results of superseded requests are dropped
+    {
+        lock_guard<mutex> lock( mMutex );
+
+        // a failed request leaves the current mesh on screen, there's nothing left to wait for
+        if ( mFailedId == mLatestId )
+            mDoneId = mLatestId;
+
+        if ( !mResult.empty() )
+        {
+            if ( mResultId == mLatestId )
+            {
+                mUploading                      = MeshLod::create( mResult );
+                mUploadingPath                  = mResultPath;
+                mUploadingId                    = mResultId;
+                mUploadingTimings               = Timings();
+                mUploadingTimings.mLoad         = mResultLoadTime;
+            }
+
+            mResult.clear();
+        }
+    }
+
+    if ( !mUploading )
+        return false;
+
+    Timer timer( true );
+    bool done = mUploading->uploadChunk( mFormat.mUploadBytesPerFrame );
+
+    mUploadingTimings.mUpload += timer.getSeconds();
+    mUploadingTimings.mUploadFrames++;
+
+    if ( !done )
+        return false;
+
+    // swap, the old mesh has been on screen until now
+    mMesh       = mUploading;
+    mMeshPath   = mUploadingPath;
+    mDoneId     = mUploadingId;
+    mTimings    = mUploadingTimings;
+    mTimings.mTotal = mRequestTimer.getSeconds();
+    mUploading.reset();
+
+    const GpuMeshRef &mesh = mMesh->getMesh( 0 );
+
+    console() << "AsyncMeshLoader: " << mMeshPath.filename().string() << ", " << mesh->getNumVertices() << " vertices, " << mesh->getNumIndices() / 3 << " triangles"
+              << ", " << mMesh->getNumLevels() << " levels"
+              << ", load " << mTimings.mLoad * 1000.0 << " ms, upload " << mTimings.mUpload * 1000.0 << " ms over " << mTimings.mUploadFrames << " frames"
+              << ", total " << mTimings.mTotal * 1000.0 << " ms" << endl;
+
+    return true;
+}
+
+
+void AsyncMeshLoader::workerLoop()
+{
+    uint64_t processedId = 0;
+
+    while( true )
+    {
+        fs::path    path;
+        uint64_t    id;
+
+        {
+            unique_lock<mutex> lock( mMutex );
+            mCond.wait( lock, [&]() { return !mRunning || mRequestId != processedId; } );
+
+            if ( !mRunning )
+                return;
+
+            path        = mRequestPath;
+            id          = mRequestId;
+            processedId = id;
+        }
+
+        MeshLod::Levels levels;
+        Timer           timer( true );
+
+        try {
+            MeshDataRef data = mFormat.mLoadFn( path );
+            if ( data )
+                levels = MeshLod::buildLevels( data, mFormat.mLodRatios );
+        }
+        catch( const std::exception &exc ) {
+            console() << "AsyncMeshLoader: cannot load " << path.string() << ": " << exc.what() << endl;
+        }
+        catch( ... ) {
+            console() << "AsyncMeshLoader: cannot load " << path.string() << endl;
+        }
+
+        {
+            lock_guard<mutex> lock( mMutex );
+
+            if ( !levels.empty() )
+            {
+                mResult.swap( levels );
+                mResultPath     = path;
+                mResultId       = id;
+                mResultLoadTime = timer.getSeconds();
+            }
+            else
+            {
+                mFailedId       = id;
+            }
+        }
+    }
+}
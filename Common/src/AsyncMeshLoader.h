@@ -0,0 +1,105 @@
+#pragma once
+
+#include "cinder/Filesystem.h"
+#include "cinder/Timer.h"
+
+#include "MeshLod.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+
+typedef std::shared_ptr<class AsyncMeshLoader>  AsyncMeshLoaderRef;
+
+//! Loads meshes without stalling the render loop: the file is parsed and prepared for upload on a worker thread,
+//! then update() uploads it to the GPU a chunk per frame. getMesh() keeps returning the previous mesh until the new one is complete.
+//! Only the latest request counts, a mesh requested while another one is loading replaces it.
+//! With LOD ratios the simplified levels are built on the worker too and uploaded after the full mesh.
+class AsyncMeshLoader {
+
+public:
+
+    //! Runs on the worker thread, returns the mesh ready for upload or throws.
+    typedef std::function<MeshDataRef( const ci::fs::path& )>  LoadFn;
+
+    struct Timings {
+        Timings() : mLoad( 0.0 ), mUpload( 0.0 ), mTotal( 0.0 ), mUploadFrames( 0 ) {}
+
+        double      mLoad;              // parsing, preparation and simplification on the worker, seconds
+        double      mUpload;            // time spent uploading on the main thread, seconds
+        double      mTotal;             // from load() to the mesh being ready, seconds
+        uint32_t    mUploadFrames;      // frames the upload was spread over
+    };
+
+    struct Format {
+        Format() : mUploadBytesPerFrame( 4 * 1024 * 1024 ) {}
+
+        //! GPU upload budget of each update().
+        Format& uploadBytesPerFrame( size_t bytes )     { mUploadBytesPerFrame = bytes; return *this; }
+        //! Replaces the default loader, ObjParser into a TriMesh.
+        Format& loadFn( const LoadFn &fn )              { mLoadFn = fn; return *this; }
+        //! Fractions of the triangles of each simplified level, see MeshLod::buildLevels(). None by default.
+        Format& lodRatios( const std::vector<float> &ratios )  { mLodRatios = ratios; return *this; }
+
+        size_t              mUploadBytesPerFrame;
+        LoadFn              mLoadFn;
+        std::vector<float>  mLodRatios;
+    };
+
+    static AsyncMeshLoaderRef create( const Format &format = Format() ) { return AsyncMeshLoaderRef( new AsyncMeshLoader( format ) ); }
+
+    ~AsyncMeshLoader();
+
+    //! Loads an OBJ through ObjParser, the default LoadFn.
+    static MeshDataRef  loadObj( const ci::fs::path &path );
+
+    //! Queues \a path, returns immediately.
+    void                load( const ci::fs::path &path );
+
+    //! Uploads the next chunk of a loaded mesh, call once per frame from the GL thread.
+    //! Returns true on the frame a new mesh becomes current.
+    bool                update();
+
+    //! The latest complete mesh and its levels, null until the first one is ready.
+    const MeshLodRef&   getMesh() const         { return mMesh; }
+    const ci::fs::path& getMeshPath() const     { return mMeshPath; }
+    //! From load() until its mesh is current or has failed to load, including the time the request waits for the worker.
+    bool                isLoading() const       { return mDoneId != mLatestId; }
+    const Timings&      getTimings() const      { return mTimings; }
+
+private:
+
+    AsyncMeshLoader( const Format &format );
+
+    void                workerLoop();
+
+    Format                          mFormat;
+
+    // worker side, guarded by mMutex
+    std::mutex                      mMutex;
+    std::condition_variable         mCond;
+    ci::fs::path                    mRequestPath;
+    uint64_t                        mRequestId;
+    MeshLod::Levels                 mResult;
+    ci::fs::path                    mResultPath;
+    uint64_t                        mResultId;
+    double                          mResultLoadTime;
+    uint64_t                        mFailedId;          // the last request that produced no mesh
+    bool                            mRunning;
+
+    // main thread
+    uint64_t                        mLatestId;
+    uint64_t                        mDoneId;            // the last request that became current or failed
+    ci::Timer                       mRequestTimer;
+    MeshLodRef                      mUploading;
+    ci::fs::path                    mUploadingPath;
+    uint64_t                        mUploadingId;
+    Timings                         mUploadingTimings;
+    MeshLodRef                      mMesh;
+    ci::fs::path                    mMeshPath;
+    Timings                         mTimings;
+
+    std::shared_ptr<std::thread>    mThread;
+};
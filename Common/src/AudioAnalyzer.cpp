@@ -0,0 +1,639 @@
+#include "AudioAnalyzer.h"
+
+#include "cinder/app/App.h"
+#include "cinder/gl/gl.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+using namespace ci;
+using namespace ci::app;
+using namespace std;
+
+
+namespace {
+
+    // computed by the SpectrumKernel, in float from the window to the results
+    bool isKernelFeature( xtract_features_ feature )
+    {
+        return feature == XTRACT_SPECTRUM || feature == XTRACT_BARK_COEFFICIENTS;
+    }
+
+}
+
+
+AudioAnalyzer::Format& AudioAnalyzer::Format::args( const vector<string> &args )
+{
+    for( size_t k=0; k < args.size(); k++ )
+    {
+        if ( args[k] == "--audio-file" && k + 1 < args.size() )
+            mInputFile = args[++k];
+
+        else if ( args[k] == "--audio-synthetic" )
+            mSynthetic = true;
+
+        else if ( args[k] == "--audio-offline" )
+            mFileMode = OFFLINE;
+
+        else if ( args[k] == "--audio-raw" && k + 2 < args.size() )
+        {
+            mRawSampleRate  = (size_t)atoi( args[++k].c_str() );
+            mRawNumChannels = (size_t)atoi( args[++k].c_str() );
+        }
+
+        else if ( args[k] == "--audio-no-loop" )
+            mLoop = false;
+    }
+
+    return *this;
+}
+
+
+AudioAnalyzer::AudioAnalyzer( const Format &format )
+: mFormat( format ), mRingBuffer( format.mRingSize ), mAnalysedCount( 0 ), mDroppedHops( 0 ), mSampleRate( 44100.0f ),
+  mPublishedId( 0 ), mConsumedId( 0 ), mResetAccumulator( true ), mRunThread( false ),
+  mFileReadPos( 0 ), mOfflineFrames( 0 ), mCapturedCount( 0 ), mPcmStage( 0 ), mXtractStage( 0 ), mAnalysisTrace( nullptr ), mLatencyProbe( nullptr )
+{
+    mXtract     = ciXtract::create();
+    mPcmData    = mRingBuffer.getLatestWindow( mFormat.mWindowSize );
+
+    initAudio();
+
+    mSpectrum.init( mFormat.mWindowSize, mSampleRate );
+
+    if ( mFormat.mSession )
+        mFormat.mSession->setSampleRate( (uint32_t)mSampleRate );
+
+    if ( mFormat.mThreaded && mTapNode )
+    {
+        mRunThread  = true;
+        mThread     = shared_ptr<thread>( new thread( bind( &AudioAnalyzer::threadedAnalysis, this ) ) );
+    }
+}
+
+
+AudioAnalyzer::~AudioAnalyzer()
+{
+    if ( mThread )
+    {
+        mRunThread = false;
+        mThread->join();
+    }
+
+    if ( mTapNode )
+    {
+        mInputNode->disable();
+        mTapNode->disconnectAll();
+    }
+}
+
+
+void AudioAnalyzer::initAudio()
+{
+    if ( isReplaying() )
+    {
+        mSampleRate = (float)mFormat.mSession->getSampleRate();
+        console() << "AudioAnalyzer: replaying a session, " << mSampleRate << " Hz" << endl;
+        return;
+    }
+
+    if ( !mFormat.mInputFile.empty() || mFormat.mSynthetic )
+    {
+        initFile();
+        return;
+    }
+
+    auto ctx = audio::Context::master();
+
+    vector<audio::DeviceRef> devices = audio::Device::getInputDevices();
+    console() << "List audio devices:" << endl;
+    for( size_t k=0; k < devices.size(); k++ )
+        console() << devices[k]->getName() << endl;
+
+    // find and initialise a device by name
+    audio::DeviceRef dev = audio::Device::findDeviceByName( mFormat.mDeviceName );
+
+    if ( !dev )
+    {
+        console() << "AudioAnalyzer: cannot find \"" << mFormat.mDeviceName << "\", using the default input" << endl;
+        dev = audio::Device::getDefaultInput();
+    }
+
+    if ( !dev )
+    {
+        console() << "AudioAnalyzer: no input device available" << endl;
+        return;
+    }
+
+    mInputNode  = ctx->createInputDeviceNode( dev );
+    mSampleRate = (float)ctx->getSampleRate();
+
+    // the tap node writes the PCM data into the ring from the audio callback
+    mTapNode = ctx->makeNode( new PcmTapNode( &mRingBuffer ) );
+
+    // pipe the input device into the tap
+    mInputNode >> mTapNode;
+
+    // InputDeviceNode (and all InputNode subclasses) need to be enabled()'s to process audio. So does the Context:
+    mInputNode->enable();
+    ctx->enable();
+}
+
+
+void AudioAnalyzer::initFile()
+{
+    if ( mFormat.mSynthetic && mFormat.mInputFile.empty() )
+    {
+        mFile = PcmFile::createSynthetic( mFormat.mRawSampleRate );
+    }
+    else
+    {
+        try {
+            mFile = PcmFile::create( mFormat.mInputFile, mFormat.mRawSampleRate, mFormat.mRawNumChannels );
+        }
+        catch( const MappedFileExc &exc ) {
+            console() << "AudioAnalyzer: cannot open \"" << mFormat.mInputFile << "\": " << exc.what() << endl;
+            return;
+        }
+    }
+
+    console() << "AudioAnalyzer: " << ( mFormat.mInputFile.empty() ? "synthetic signal" : mFormat.mInputFile ) << ", " << mFile->getSampleRate() << " Hz, " << mFile->getNumChannels() << " channels, " << mFile->getNumFrames() << " frames" << endl;
+
+    mSampleRate = (float)mFile->getSampleRate();
+
+    // offline mode doesn't touch the audio context at all, update() feeds the ring
+    if ( mFormat.mFileMode == OFFLINE )
+        return;
+
+    auto ctx = audio::Context::master();
+
+    if ( ctx->getSampleRate() != mFile->getSampleRate() )
+        console() << "AudioAnalyzer: the file is " << mFile->getSampleRate() << " Hz but the context runs at " << ctx->getSampleRate() << " Hz, the file isn't resampled" << endl;
+
+    mSampleRate = (float)ctx->getSampleRate();
+
+    mFileNode   = ctx->makeNode( new PcmFileInputNode( mFile, mFormat.mLoop ) );
+    mInputNode  = mFileNode;
+    mTapNode    = ctx->makeNode( new PcmTapNode( &mRingBuffer ) );
+
+    mInputNode >> mTapNode;
+
+    mInputNode->enable();
+    ctx->enable();
+}
+
+
+void AudioAnalyzer::feedFile()
+{
+    // the file advances by exactly one frame of audio per update, however long the frame took
+    mOfflineFrames++;
+
+    uint64_t target     = (uint64_t)( mOfflineFrames * (double)mSampleRate / mFormat.mOfflineFrameRate );
+    uint64_t remaining  = target - mFileReadPos;
+
+    // write in chunks the analysis can keep up with, offline mode never drops a hop
+    size_t chunkSize = mRingBuffer.getCapacity() > mFormat.mWindowSize ? mRingBuffer.getCapacity() - mFormat.mWindowSize : mRingBuffer.getCapacity();
+
+    while( remaining > 0 )
+    {
+        size_t n = (size_t)min<uint64_t>( remaining, chunkSize );
+
+        // growing the buffer and writing the session allocate, they stay out of the allocation free stage
+        mFileBuffer.resize( n );
+
+        {
+            FrameProfiler::Scope scope( mProfiler.get(), mPcmStage );
+
+            if ( mFormat.mLoop )
+            {
+                mFile->readLooped( 0, mFileReadPos, mFileBuffer.data(), n );
+            }
+            else
+            {
+                size_t read = mFile->read( 0, mFileReadPos, mFileBuffer.data(), n );
+                fill( mFileBuffer.begin() + read, mFileBuffer.end(), 0.0f );
+            }
+
+            if ( mLatency )
+                mLatency->processInput( mFileBuffer.data(), n, mRingBuffer.getWriteCount() );
+
+            mRingBuffer.write( mFileBuffer.data(), n );
+            mFileReadPos   += n;
+            remaining      -= n;
+        }
+
+        capture( mRingBuffer.getWriteCount() );
+
+        FrameProfiler::Scope scope( mProfiler.get(), mXtractStage );
+        processAvailable( mRingBuffer.getWriteCount() );
+    }
+}
+
+
+void AudioAnalyzer::feedReplay()
+{
+    const SessionLogRef &session = mFormat.mSession;
+
+    // the blocks go through the ring and the analysis exactly as they were captured
+    for( size_t k=0; k < session->getNumPcm(); k++ )
+    {
+        const float *samples    = session->getPcm( k );
+        size_t      count       = session->getPcmSize( k );
+
+        // the log is read only, the impulses go into a copy, grown out of the allocation free stage
+        if ( mLatency )
+            mFileBuffer.resize( count );
+
+        {
+            FrameProfiler::Scope scope( mProfiler.get(), mPcmStage );
+
+            if ( mLatency )
+            {
+                copy( samples, samples + count, mFileBuffer.begin() );
+                mLatency->processInput( mFileBuffer.data(), count, mRingBuffer.getWriteCount() );
+                samples = mFileBuffer.data();
+            }
+
+            mRingBuffer.write( samples, count );
+        }
+
+        FrameProfiler::Scope scope( mProfiler.get(), mXtractStage );
+        processAvailable( mRingBuffer.getWriteCount() );
+    }
+}
+
+
+void AudioAnalyzer::capture( uint64_t writeCount )
+{
+    if ( !mFormat.mSession || !mFormat.mSession->isCapturing() )
+        return;
+
+    // a frame that stalls longer than the ring loses the oldest samples, the analysis couldn't see them either
+    uint64_t oldest = writeCount > mRingBuffer.getCapacity() ? writeCount - mRingBuffer.getCapacity() : 0;
+    size_t   count  = (size_t)( writeCount - max( mCapturedCount, oldest ) );
+
+    mFormat.mSession->addPcm( mRingBuffer.getWindow( writeCount, count ), count );
+    mCapturedCount = writeCount;
+}
+
+
+bool AudioAnalyzer::isFinished() const
+{
+    if ( isReplaying() )
+        return mFormat.mSession->isFinished();
+
+    if ( isOffline() )
+        return !mFormat.mLoop && mFileReadPos >= mFile->getNumFrames();
+
+    return mFileNode && mFileNode->isFinished();
+}
+
+
+void AudioAnalyzer::enableFeature( xtract_features_ feature )
+{
+    lock_guard<mutex> lock( mXtractMutex );
+
+    if ( feature == XTRACT_SPECTRUM )
+        mKernelResults[feature].assign( mSpectrum.getSpectrumSize(), 0.0f );
+    else if ( feature == XTRACT_BARK_COEFFICIENTS )
+        mKernelResults[feature].assign( mSpectrum.getNumBands(), 0.0f );
+    else
+        mXtract->enableFeature( feature );
+
+    if ( find( mFeatures.begin(), mFeatures.end(), feature ) == mFeatures.end() )
+    {
+        mFeatures.push_back( feature );
+        mFeatureParams[feature] = shared_ptr<FeatureParams>( new FeatureParams() );
+    }
+}
+
+
+void AudioAnalyzer::setFeatureParams( xtract_features_ feature, float gain, float offset, float damping )
+{
+    // the map only changes in enableFeature(), which is called from the same thread
+    auto it = mFeatureParams.find( feature );
+    if ( it == mFeatureParams.end() )
+        return;
+
+    it->second->mGain       = gain;
+    it->second->mOffset     = offset;
+    it->second->mDamping    = damping;
+    it->second->mIsSet      = true;
+}
+
+
+FeatureView AudioAnalyzer::getResults( xtract_features_ feature, Aggregate aggregate ) const
+{
+    const Frame                 &frame  = mFrames.getFront();
+    const std::vector<float>    &data   = aggregate == MAX ? frame.mMax : ( aggregate == MEAN ? frame.mMean : frame.mData );
+
+    for( size_t k=0; k < frame.mSlots.size(); k++ )
+        if ( frame.mSlots[k].mFeature == feature )
+            return FeatureView( &data[ frame.mSlots[k].mOffset ], frame.mSlots[k].mSize );
+
+    return FeatureView();
+}
+
+
+void AudioAnalyzer::update()
+{
+    if ( !isRunning() )
+        return;
+
+    if ( isReplaying() )
+    {
+        feedReplay();
+    }
+    else if ( isOffline() )
+    {
+        feedFile();
+    }
+    else if ( !mThread )
+    {
+        // what is captured is exactly what this frame analyses, even if the audio callback writes more meanwhile
+        uint64_t writeCount = mRingBuffer.getWriteCount();
+        capture( writeCount );
+
+        FrameProfiler::Scope scope( mProfiler.get(), mXtractStage );
+        processAvailable( writeCount );
+    }
+    else
+    {
+        capture( mRingBuffer.getWriteCount() );
+    }
+
+    // swap in the latest results
+    FrameProfiler::Scope    scope( mProfiler.get(), mPcmStage );
+    Tracer::Scope           trace( mTracer ? mTracer->getMainBuffer() : nullptr, "Results swap" );
+
+    if ( mFrames.update() )
+    {
+        const Frame &frame = mFrames.getFront();
+        mPcmData    = mRingBuffer.getWindow( frame.mSampleCount, mFormat.mWindowSize );
+        mConsumedId = frame.mFrameId;
+
+        if ( mLatency )
+            mLatency->markPickedUp( frame.mSampleCount );
+    }
+}
+
+
+void AudioAnalyzer::setProfiler( const FrameProfilerRef &profiler )
+{
+    mProfiler = profiler;
+
+    if ( mProfiler )
+    {
+        mPcmStage       = mProfiler->addStage( "PCM fetch", true );
+        mXtractStage    = mProfiler->addStage( "Xtract update" );
+    }
+}
+
+
+void AudioAnalyzer::setTracer( const TracerRef &tracer )
+{
+    // the threads keep writing to the buffers, the tracer is kept alive and never replaced
+    if ( mTracer || !tracer )
+        return;
+
+    mTracer = tracer;
+
+    mAnalysisTrace = mThread ? mTracer->createBuffer( "Analysis" ) : mTracer->getMainBuffer();
+
+    if ( mTapNode )
+        mTapNode->setTraceBuffer( mTracer->createBuffer( "Audio callback" ) );
+}
+
+
+void AudioAnalyzer::setLatencyProbe( const LatencyProbeRef &probe )
+{
+    // like the tracer, the threads keep the pointer
+    if ( mLatency || !probe )
+        return;
+
+    mLatency = probe;
+    mLatencyProbe.store( mLatency.get(), memory_order_release );
+
+    if ( mTapNode )
+        mTapNode->setLatencyProbe( mLatency.get() );
+}
+
+
+bool AudioAnalyzer::processAvailable( uint64_t writeCount )
+{
+    size_t      windowSize  = mFormat.mWindowSize;
+    size_t      hopSize     = mFormat.mHopSize;
+
+    if ( writeCount < windowSize || writeCount == mAnalysedCount )
+        return false;
+
+    // decided once per batch, every hop of it goes into the aggregates until the consumer picks them up
+    if ( mConsumedId >= mPublishedId )
+        mResetAccumulator = true;
+
+    if ( hopSize == 0 )
+    {
+        // analyse only the latest window
+        analyse( writeCount );
+        mAnalysedCount = writeCount;
+    }
+    else
+    {
+        // the first window ends at windowSize, then one every hop
+        if ( mAnalysedCount < windowSize )
+            mAnalysedCount = windowSize - hopSize;
+
+        // skip the hops that have already been overwritten in the ring
+        uint64_t latestValid = writeCount - mRingBuffer.getCapacity() + windowSize;
+
+        if ( writeCount > mRingBuffer.getCapacity() && mAnalysedCount + hopSize < latestValid )
+        {
+            uint64_t skipped = ( latestValid - mAnalysedCount ) / hopSize;
+            mAnalysedCount  += skipped * hopSize;
+            mDroppedHops    += skipped;
+        }
+
+        if ( mAnalysedCount + hopSize > writeCount )
+            return false;
+
+        while( mAnalysedCount + hopSize <= writeCount )
+        {
+            mAnalysedCount += hopSize;
+            analyse( mAnalysedCount );
+        }
+    }
+
+    publish();
+
+    return true;
+}
+
+
+void AudioAnalyzer::analyse( uint64_t sampleCount )
+{
+    Tracer::Scope trace( mAnalysisTrace.load( memory_order_relaxed ), "Xtract update" );
+
+    lock_guard<mutex> lock( mXtractMutex );
+
+    // damping is applied once per window, rescale it to the hop rate
+    float dampingExp = 1.0f;
+    if ( mFormat.mHopSize > 0 && mFormat.mDampingRate > 0.0f )
+        dampingExp = mFormat.mHopSize / ( mSampleRate / mFormat.mDampingRate );
+
+    // update params
+    for( auto it = mFeatureParams.begin(); it != mFeatureParams.end(); ++it )
+    {
+        if ( !it->second->mIsSet || isKernelFeature( it->first ) )
+            continue;
+
+        ciXtractFeatureRef feature = mXtract->getFeature( it->first );
+        feature->setGain( it->second->mGain );
+        feature->setOffset( it->second->mOffset );
+        feature->setDamping( pow( it->second->mDamping.load(), dampingExp ) );
+    }
+
+    const float *window = mRingBuffer.getWindow( sampleCount, mFormat.mWindowSize );
+
+    // ciXtract only runs for the features the kernel doesn't compute
+    if ( mFeatures.size() > mKernelResults.size() )
+        mXtract->update( window );
+
+    if ( !mKernelResults.empty() )
+    {
+        mSpectrum.process( window );
+
+        for( auto it = mKernelResults.begin(); it != mKernelResults.end(); ++it )
+        {
+            const FeatureParams &params = *mFeatureParams[it->first];
+            const float         *raw    = it->first == XTRACT_SPECTRUM ? mSpectrum.getSpectrum() : mSpectrum.getBands();
+
+            SpectrumKernel::shape( raw, it->second.size(), params.mGain, params.mOffset, pow( params.mDamping.load(), dampingExp ), it->second.data() );
+        }
+    }
+
+    LatencyProbe *probe = mLatencyProbe.load( memory_order_acquire );
+    if ( probe )
+        probe->markAnalysed( sampleCount );
+
+    // start over once the consumer has picked up everything accumulated so far
+    Frame   &acc    = mAccumulator;
+    size_t  offset  = 0;
+
+    if ( mResetAccumulator )
+    {
+        acc.mHopCount       = 0;
+        mResetAccumulator   = false;
+    }
+
+    // the buffers only grow, this doesn't allocate once warmed up
+    acc.mSlots.clear();
+
+    for( size_t k=0; k < mFeatures.size(); k++ )
+    {
+        size_t size = isKernelFeature( mFeatures[k] ) ? mKernelResults[ mFeatures[k] ].size() : mXtract->getFeature( mFeatures[k] )->getResultsN();
+        acc.mSlots.push_back( FeatureSlot( mFeatures[k], offset, size ) );
+        offset += size;
+    }
+
+    // a feature has been enabled, the aggregates don't line up anymore
+    if ( offset != acc.mData.size() )
+    {
+        acc.mData.resize( offset );
+        acc.mMax.resize( offset );
+        acc.mMean.resize( offset );
+        acc.mHopCount = 0;
+    }
+
+    for( size_t k=0; k < acc.mSlots.size(); k++ )
+    {
+        const FeatureSlot   &slot   = acc.mSlots[k];
+        float               *latest = &acc.mData[slot.mOffset];
+        float               *max    = &acc.mMax[slot.mOffset];
+        float               *sum    = &acc.mMean[slot.mOffset];
+
+        if ( isKernelFeature( slot.mFeature ) )
+        {
+            memcpy( latest, mKernelResults[slot.mFeature].data(), slot.mSize * sizeof(float) );
+        }
+        else
+        {
+            const double *data = mXtract->getFeature( slot.mFeature )->getResults().get();
+            for( size_t i=0; i < slot.mSize; i++ )
+                latest[i] = (float)data[i];
+        }
+
+        for( size_t i=0; i < slot.mSize; i++ )
+        {
+            if ( acc.mHopCount == 0 )
+            {
+                max[i] = latest[i];
+                sum[i] = latest[i];
+            }
+            else
+            {
+                max[i]  = std::max( max[i], latest[i] );
+                sum[i] += latest[i];
+            }
+        }
+    }
+
+    acc.mSampleCount = sampleCount;
+    acc.mHopCount++;
+}
+
+
+void AudioAnalyzer::publish()
+{
+    const Frame &acc    = mAccumulator;
+    Frame       &frame  = mFrames.getBack();
+
+    frame.mSlots        = acc.mSlots;
+    frame.mData         = acc.mData;
+    frame.mMax          = acc.mMax;
+    frame.mMean.resize( acc.mMean.size() );
+
+    float scale = 1.0f / acc.mHopCount;
+    for( size_t k=0; k < acc.mMean.size(); k++ )
+        frame.mMean[k] = acc.mMean[k] * scale;
+
+    frame.mSampleCount  = acc.mSampleCount;
+    frame.mHopCount     = acc.mHopCount;
+    frame.mFrameId      = ++mPublishedId;
+
+    mFrames.publish();
+}
+
+
+void AudioAnalyzer::threadedAnalysis()
+{
+    while( mRunThread )
+    {
+        if ( !processAvailable( mRingBuffer.getWriteCount() ) )
+            this_thread::sleep_for( chrono::milliseconds( 1 ) );
+    }
+}
+
+
+void AudioAnalyzer::drawData( xtract_features_ feature, const Rectf &rect, Aggregate aggregate, const ColorA &col ) const
+{
+    FeatureView data = getResults( feature, aggregate );
+
+    gl::color( ColorA( 0.0f, 0.0f, 0.0f, 0.5f ) );
+    gl::drawSolidRect( rect );
+
+    if ( data.empty() )
+        return;
+
+    float   w = rect.getWidth() / data.size();
+    float   h;
+
+    gl::color( col );
+
+    for( size_t k=0; k < data.size(); k++ )
+    {
+        h = constrain( data[k], 0.0f, 1.0f ) * rect.getHeight();
+        gl::drawSolidRect( Rectf( rect.x1 + k * w, rect.y2 - h, rect.x1 + ( k + 1 ) * w - 1.0f, rect.y2 ) );
+    }
+}
@@ -0,0 +1,246 @@
+#pragma once
+
+#include "cinder/audio/Context.h"
+#include "cinder/Rect.h"
+#include "cinder/Color.h"
+
+#include <thread>
+#include <mutex>
+#include <map>
+
+#include "ciXtract.h"
+
+#include "PcmRingBuffer.h"
+#include "PcmTapNode.h"
+#include "PcmFileInputNode.h"
+#include "TripleBuffer.h"
+#include "FrameProfiler.h"
+#include "Tracer.h"
+#include "SessionLog.h"
+#include "LatencyProbe.h"
+#include "SpectrumKernel.h"
+
+
+//! Non-owning view of the results of one feature.
+struct FeatureView {
+
+    FeatureView() : mData( nullptr ), mSize( 0 ) {}
+    FeatureView( const float *data, size_t size ) : mData( data ), mSize( size ) {}
+
+    const float*    data() const                    { return mData; }
+    size_t          size() const                    { return mSize; }
+    bool            empty() const                   { return mSize == 0; }
+    float           operator[]( size_t n ) const    { return mData[n]; }
+
+    const float     *mData;
+    size_t          mSize;
+};
+
+
+typedef std::shared_ptr<class AudioAnalyzer>    AudioAnalyzerRef;
+
+//! Audio input and ciXtract analysis shared by the sound apps.
+//! The audio callback fills a lock-free ring. The analysis runs either in update() or, in threaded mode,
+//! on a worker thread that publishes a snapshot of the results; update() then only swaps the snapshot in.
+//! With a hop size set, every hop of the stream is analysed instead of only the latest window.
+//! The input is either an audio device, a WAV/raw file or a synthetic signal, played in real time through the audio graph
+//! or, in offline mode, pushed straight into the ring one frame of audio per update() with no audio hardware involved.
+//! A SessionLog can capture the samples fed to the analysis each frame, or replay them in place of any input.
+//! XTRACT_SPECTRUM and XTRACT_BARK_COEFFICIENTS are computed in single precision by a SpectrumKernel, the other features by ciXtract.
+class AudioAnalyzer {
+
+public:
+
+    //! Which results getResults() returns when several windows were analysed since the last update().
+    enum Aggregate { LATEST, MAX, MEAN };
+
+    //! REALTIME plays the file through the audio context, OFFLINE feeds it as fast as the app updates.
+    enum FileMode { REALTIME, OFFLINE };
+
+    struct Format {
+        Format() : mDeviceName( "Soundflower (2ch)" ), mWindowSize( CIXTRACT_PCM_SIZE ), mRingSize( CIXTRACT_PCM_SIZE * 32 ), mThreaded( false ), mHopSize( 0 ), mDampingRate( 60.0f ),
+            mFileMode( REALTIME ), mRawSampleRate( 44100 ), mRawNumChannels( 1 ), mLoop( true ), mOfflineFrameRate( 60.0f ), mSynthetic( false ) {}
+
+        //! Input device, falls back to the default input if the device can't be found.
+        Format& deviceName( const std::string &name )   { mDeviceName = name; return *this; }
+        //! Samples in the ring, it must be large enough to cover a few frames of audio.
+        Format& ringSize( size_t size )                 { mRingSize = size; return *this; }
+        //! Runs the analysis on a worker thread.
+        Format& threaded( bool threaded = true )        { mThreaded = threaded; return *this; }
+        //! Analyses a window every \a size samples, 0 only analyses the latest window.
+        Format& hopSize( size_t size )                  { mHopSize = size; return *this; }
+        //! Rate in Hz the damping values are meant for, in streaming mode damping is rescaled to the hop rate.
+        Format& dampingRate( float rate )               { mDampingRate = rate; return *this; }
+        //! Reads the input from a WAV or raw float file instead of the device.
+        Format& inputFile( const std::string &path, FileMode mode = REALTIME )  { mInputFile = path; mFileMode = mode; return *this; }
+        //! Reads the input from a synthetic signal that is the same on every machine, see PcmFile::createSynthetic().
+        Format& synthetic( FileMode mode = REALTIME )   { mSynthetic = true; mFileMode = mode; return *this; }
+        //! Feeds the input file offline, or the synthetic signal if there is no file. Benchmarks need no audio hardware.
+        Format& offline()                               { mFileMode = OFFLINE; mSynthetic = mInputFile.empty(); return *this; }
+        //! Sample rate and interleaved channels of raw input files.
+        Format& rawFormat( size_t sampleRate, size_t numChannels )              { mRawSampleRate = sampleRate; mRawNumChannels = numChannels; return *this; }
+        //! Restarts the file once it's over, otherwise silence follows.
+        Format& loop( bool loop = true )                { mLoop = loop; return *this; }
+        //! In offline mode every update() advances the file by 1 / \a fps seconds, however long the frame took.
+        Format& offlineFrameRate( float fps )           { mOfflineFrameRate = fps; return *this; }
+        //! Captures the samples fed to the analysis into \a session, or reads them from it when it replays, no input is opened then.
+        Format& session( const SessionLogRef &session ) { mSession = session; return *this; }
+        //! Picks up "--audio-file <path>", "--audio-synthetic", "--audio-offline", "--audio-raw <sampleRate> <channels>" and "--audio-no-loop" from the command line.
+        Format& args( const std::vector<std::string> &args );
+
+        std::string     mDeviceName;
+        size_t          mWindowSize;
+        size_t          mRingSize;
+        bool            mThreaded;
+        size_t          mHopSize;
+        float           mDampingRate;
+        std::string     mInputFile;
+        FileMode        mFileMode;
+        size_t          mRawSampleRate;
+        size_t          mRawNumChannels;
+        bool            mLoop;
+        float           mOfflineFrameRate;
+        bool            mSynthetic;
+        SessionLogRef   mSession;
+    };
+
+    static AudioAnalyzerRef create( const Format &format = Format() ) { return AudioAnalyzerRef( new AudioAnalyzer( format ) ); }
+
+    ~AudioAnalyzer();
+
+    void                enableFeature( xtract_features_ feature );
+
+    //! Thread safe, the values are applied to the feature right before its next update.
+    void                setFeatureParams( xtract_features_ feature, float gain, float offset, float damping );
+
+    //! Results swapped in by update(), empty until the feature has been analysed once. The view stays valid until the next
+    //! update() and is contiguous floats, it can go straight to a texture, a vbo or the particle kernels.
+    //! MAX and MEAN aggregate all the windows analysed since the previous update().
+    FeatureView         getResults( xtract_features_ feature, Aggregate aggregate = LATEST ) const;
+
+    //! Number of windows aggregated in the current results.
+    uint32_t            getHopCount() const                             { return mFrames.getFront().mHopCount; }
+    //! Number of hops skipped because the analysis fell behind the ring.
+    uint64_t            getDroppedHops() const                          { return mDroppedHops; }
+
+    //! Direct access to ciXtract, not safe to use while the worker thread is running. The spectrum and the Bark bands aren't computed there.
+    ciXtractRef         getXtract() const                               { return mXtract; }
+
+    //! Analyses the latest window, or picks up the latest results in threaded mode. In offline mode it first feeds the next frame of the file.
+    void                update();
+
+    //! Adds the "PCM fetch" and "Xtract update" stages to \a profiler and times them in update(), "PCM fetch" is allocation free.
+    //! In threaded mode the analysis runs on the worker and only picking up the results is timed.
+    void                setProfiler( const FrameProfilerRef &profiler );
+
+    //! Records the audio callback, each analysed window and the swap of the results in \a tracer.
+    //! The analysis is recorded on its own thread in threaded mode, on the main buffer otherwise. Only the first tracer is used.
+    void                setTracer( const TracerRef &tracer );
+
+    //! Sends the impulses of \a probe through the input and marks when the analysis and update() reach them. Only the first probe is used.
+    void                setLatencyProbe( const LatencyProbeRef &probe );
+
+    //! Zero-copy view of the window the current results come from.
+    const float*        getPcmData() const                              { return mPcmData; }
+    size_t              getPcmSize() const                              { return mFormat.mWindowSize; }
+
+    bool                isRunning() const                               { return mTapNode || isOffline(); }
+    bool                isThreaded() const                              { return (bool)mThread; }
+    //! True if a file is fed straight into the analysis, the worker thread isn't used in this mode.
+    bool                isOffline() const                               { return ( mFile && mFormat.mFileMode == OFFLINE ) || isReplaying(); }
+    //! True if the samples are read from a replayed SessionLog, one frame of them per update().
+    bool                isReplaying() const                             { return mFormat.mSession && mFormat.mSession->isReplaying(); }
+    //! True once a file that doesn't loop or a replayed session has been played entirely.
+    bool                isFinished() const;
+    float               getSampleRate() const                           { return mSampleRate; }
+
+    void                drawPcm( const ci::Rectf &rect ) const          { ciXtract::drawPcm( rect, getPcmData(), getPcmSize() ); }
+    void                drawData( xtract_features_ feature, const ci::Rectf &rect, Aggregate aggregate = LATEST, const ci::ColorA &col = ci::ColorA::white() ) const;
+
+protected:
+
+    AudioAnalyzer( const Format &format );
+
+    struct FeatureSlot {
+        FeatureSlot( xtract_features_ feature, size_t offset, size_t size ) : mFeature( feature ), mOffset( offset ), mSize( size ) {}
+
+        xtract_features_    mFeature;
+        size_t              mOffset;
+        size_t              mSize;
+    };
+
+    //! Results of all the enabled features: the latest window, and max and mean of the windows analysed since the previous frame was picked up.
+    struct Frame {
+        Frame() : mSampleCount( 0 ), mFrameId( 0 ), mHopCount( 0 ) {}
+
+        std::vector<FeatureSlot>    mSlots;
+        std::vector<float>          mData;
+        std::vector<float>          mMax;
+        std::vector<float>          mMean;
+        uint64_t                    mSampleCount;
+        uint64_t                    mFrameId;
+        uint32_t                    mHopCount;
+    };
+
+    struct FeatureParams {
+        FeatureParams() : mGain( 1.0f ), mOffset( 0.0f ), mDamping( 0.0f ), mIsSet( false ) {}
+
+        std::atomic<float>  mGain;
+        std::atomic<float>  mOffset;
+        std::atomic<float>  mDamping;
+        std::atomic<bool>   mIsSet;
+    };
+
+    void initAudio();
+    void initFile();
+    void feedFile();
+    void feedReplay();
+    void capture( uint64_t writeCount );
+    bool processAvailable( uint64_t writeCount );
+    void analyse( uint64_t sampleCount );
+    void publish();
+    void threadedAnalysis();
+
+    Format                          mFormat;
+    ciXtractRef                     mXtract;
+    SpectrumKernel                  mSpectrum;
+    std::vector<xtract_features_>   mFeatures;
+    std::map<xtract_features_, std::vector<float> >  mKernelResults;   // shaped results of the features the kernel computes
+    std::map<xtract_features_, std::shared_ptr<FeatureParams> >  mFeatureParams;
+    std::mutex                      mXtractMutex;
+
+    PcmRingBuffer                   mRingBuffer;
+    const float                     *mPcmData;
+    uint64_t                        mAnalysedCount;
+    std::atomic<uint64_t>           mDroppedHops;
+    float                           mSampleRate;
+
+    Frame                           mAccumulator;       // hops analysed since the consumer last picked up a frame, mMean holds the sum
+    uint64_t                        mPublishedId;
+    std::atomic<uint64_t>           mConsumedId;
+    bool                            mResetAccumulator;  // set by processAvailable() when the previous batch has been picked up
+    TripleBuffer<Frame>             mFrames;
+
+    std::shared_ptr<std::thread>    mThread;
+    std::atomic<bool>               mRunThread;
+
+    ci::audio::InputNodeRef         mInputNode;
+    PcmTapNodeRef                   mTapNode;
+
+    PcmFileRef                      mFile;
+    PcmFileInputNodeRef             mFileNode;
+    uint64_t                        mFileReadPos;       // offline mode only
+    uint64_t                        mOfflineFrames;
+    std::vector<float>              mFileBuffer;
+    uint64_t                        mCapturedCount;     // samples of the ring already written to the session
+
+    FrameProfilerRef                mProfiler;
+    size_t                          mPcmStage;
+    size_t                          mXtractStage;
+
+    TracerRef                       mTracer;
+    std::atomic<Tracer::Buffer*>    mAnalysisTrace;     // read by the worker thread
+
+    LatencyProbeRef                 mLatency;
+    std::atomic<LatencyProbe*>      mLatencyProbe;      // read by the worker thread
+};
@@ -0,0 +1,198 @@
+#include "BatchRenderer.h"
+
+#include "cinder/app/App.h"
+
+#include <cstring>
+#include <cstddef>
+
+using namespace ci;
+using namespace ci::app;
+using namespace std;
+
+
+namespace {
+
+const char *kCircleVert =
+    "#version 120\n"
+    "attribute float radius;\n"
+    "varying vec4 vColor;\n"
+    "varying float vRadius;\n"
+    "void main() {\n"
+    "    vColor       = gl_Color;\n"
+    "    vRadius      = radius;\n"
+    "    gl_PointSize = radius * 2.0 + 2.0;\n"
+    "    gl_Position  = gl_ModelViewProjectionMatrix * gl_Vertex;\n"
+    "}\n";
+
+// one pixel wide ring, the sprite is one pixel larger than the circle on each side
+const char *kCircleFrag =
+    "#version 120\n"
+    "varying vec4 vColor;\n"
+    "varying float vRadius;\n"
+    "void main() {\n"
+    "    vec2  p     = ( gl_PointCoord - 0.5 ) * ( vRadius * 2.0 + 2.0 );\n"
+    "    float alpha = clamp( 1.0 - abs( length( p ) - vRadius ), 0.0, 1.0 );\n"
+    "    if ( alpha <= 0.0 )\n"
+    "        discard;\n"
+    "    gl_FragColor = vec4( vColor.rgb, vColor.a * alpha );\n"
+    "}\n";
+
+}
+
+
+BatchRenderer::BatchRenderer()
+: mLineCapacity( 0 ), mCircleCapacity( 0 ), mRadiusAttrib( -1 ), mNumDrawCalls( 0 ), mNumPrimitives( 0 )
+{
+    mLineVbo    = gl::Vbo( GL_ARRAY_BUFFER );
+    mCircleVbo  = gl::Vbo( GL_ARRAY_BUFFER );
+
+    try {
+        mCircleShader = gl::GlslProg::create( kCircleVert, kCircleFrag );
+        mRadiusAttrib = mCircleShader->getAttribLocation( "radius" );
+    }
+    catch( const gl::GlslProgCompileExc &exc ) {
+        console() << "BatchRenderer: cannot compile the circle shader, circles are drawn one by one: " << exc.what() << endl;
+        mCircleShader.reset();
+    }
+}
+
+
+uint32_t BatchRenderer::packColor( const ColorA &col )
+{
+    // GL_UNSIGNED_BYTE colours are read in memory order, r first
+    uint8_t rgba[4] = { (uint8_t)( constrain( col.r, 0.0f, 1.0f ) * 255.0f + 0.5f ),
+                        (uint8_t)( constrain( col.g, 0.0f, 1.0f ) * 255.0f + 0.5f ),
+                        (uint8_t)( constrain( col.b, 0.0f, 1.0f ) * 255.0f + 0.5f ),
+                        (uint8_t)( constrain( col.a, 0.0f, 1.0f ) * 255.0f + 0.5f ) };
+    uint32_t packed;
+    memcpy( &packed, rgba, sizeof(packed) );
+    return packed;
+}
+
+
+void BatchRenderer::addLine( const Vec2f &a, const Vec2f &b, const ColorA &colA, const ColorA &colB )
+{
+    LineVertex v;
+
+    v.mX = a.x;     v.mY = a.y;     v.mColor = packColor( colA );
+    mLines.push_back( v );
+
+    v.mX = b.x;     v.mY = b.y;     v.mColor = packColor( colB );
+    mLines.push_back( v );
+}
+
+
+size_t BatchRenderer::allocateLines( size_t count )
+{
+    size_t index = mLines.size() / 2;
+    mLines.resize( mLines.size() + count * 2 );
+    return index;
+}
+
+
+void BatchRenderer::setLine( size_t index, const Vec2f &a, const Vec2f &b, const ColorA &col )
+{
+    LineVertex *v = &mLines[index * 2];
+
+    v[0].mX = a.x;  v[0].mY = a.y;  v[0].mColor = packColor( col );
+    v[1].mX = b.x;  v[1].mY = b.y;  v[1].mColor = v[0].mColor;
+}
+
+
+void BatchRenderer::addStrokedCircle( const Vec2f &center, float radius, const ColorA &col )
+{
+    CircleVertex v;
+    v.mX        = center.x;
+    v.mY        = center.y;
+    v.mRadius   = radius;
+    v.mColor    = packColor( col );
+
+    mCircles.push_back( v );
+}
+
+
+void BatchRenderer::upload( gl::Vbo &vbo, size_t *capacity, const void *data, size_t size )
+{
+    // grow geometrically, the buffers settle after a few frames
+    if ( size > *capacity )
+        *capacity = max( size, *capacity * 2 );
+
+    vbo.bind();
+
+    // orphaning lets the driver hand out a fresh buffer instead of waiting for the previous frame to be drawn
+    vbo.bufferData( *capacity, NULL, GL_STREAM_DRAW );
+    vbo.bufferSubData( 0, size, data );
+}
+
+
+void BatchRenderer::draw()
+{
+    mNumDrawCalls   = 0;
+    mNumPrimitives  = mLines.size() / 2 + mCircles.size();
+
+    glEnableClientState( GL_VERTEX_ARRAY );
+    glEnableClientState( GL_COLOR_ARRAY );
+
+    if ( !mLines.empty() )
+    {
+        upload( mLineVbo, &mLineCapacity, mLines.data(), mLines.size() * sizeof(LineVertex) );
+
+        glVertexPointer( 2, GL_FLOAT, sizeof(LineVertex), (const GLvoid*)offsetof( LineVertex, mX ) );
+        glColorPointer( 4, GL_UNSIGNED_BYTE, sizeof(LineVertex), (const GLvoid*)offsetof( LineVertex, mColor ) );
+        glDrawArrays( GL_LINES, 0, (GLsizei)mLines.size() );
+
+        mLineVbo.unbind();
+        mNumDrawCalls++;
+    }
+
+    if ( !mCircles.empty() && mCircleShader )
+    {
+        upload( mCircleVbo, &mCircleCapacity, mCircles.data(), mCircles.size() * sizeof(CircleVertex) );
+
+        mCircleShader->bind();
+
+        glEnable( GL_VERTEX_PROGRAM_POINT_SIZE );
+        glEnable( GL_POINT_SPRITE );
+
+        glVertexPointer( 2, GL_FLOAT, sizeof(CircleVertex), (const GLvoid*)offsetof( CircleVertex, mX ) );
+        glColorPointer( 4, GL_UNSIGNED_BYTE, sizeof(CircleVertex), (const GLvoid*)offsetof( CircleVertex, mColor ) );
+
+        if ( mRadiusAttrib >= 0 )
+        {
+            glEnableVertexAttribArray( mRadiusAttrib );
+            glVertexAttribPointer( mRadiusAttrib, 1, GL_FLOAT, GL_FALSE, sizeof(CircleVertex), (const GLvoid*)offsetof( CircleVertex, mRadius ) );
+        }
+
+        glDrawArrays( GL_POINTS, 0, (GLsizei)mCircles.size() );
+
+        if ( mRadiusAttrib >= 0 )
+            glDisableVertexAttribArray( mRadiusAttrib );
+
+        glDisable( GL_POINT_SPRITE );
+        glDisable( GL_VERTEX_PROGRAM_POINT_SIZE );
+
+        mCircleShader->unbind();
+        mCircleVbo.unbind();
+        mNumDrawCalls++;
+    }
+
+    glDisableClientState( GL_COLOR_ARRAY );
+    glDisableClientState( GL_VERTEX_ARRAY );
+
+    // no shader, fall back to immediate mode
+    if ( !mCircles.empty() && !mCircleShader )
+    {
+        for( size_t k=0; k < mCircles.size(); k++ )
+        {
+            const uint8_t *rgba = (const uint8_t*)&mCircles[k].mColor;
+            gl::color( ColorA( rgba[0] / 255.0f, rgba[1] / 255.0f, rgba[2] / 255.0f, rgba[3] / 255.0f ) );
+            gl::drawStrokedCircle( Vec2f( mCircles[k].mX, mCircles[k].mY ), mCircles[k].mRadius );
+        }
+
+        mNumDrawCalls += mCircles.size();
+    }
+
+    // the vectors keep their capacity
+    mLines.clear();
+    mCircles.clear();
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "cinder/gl/gl.h"
+#include "cinder/gl/Vbo.h"
+#include "cinder/gl/GlslProg.h"
+#include "cinder/Color.h"
+
+#include <vector>
+
+
+typedef std::shared_ptr<class BatchRenderer>    BatchRendererRef;
+
+//! Collects 2d lines and stroked circles and draws each kind with a single call out of a persistent dynamic VBO,
+//! instead of one immediate mode gl::drawLine or gl::drawStrokedCircle per primitive.
+//! Lines have a colour per vertex. Circles are point sprites shaded into a ring, their radius is in pixels,
+//! so the modelview must not scale.
+class BatchRenderer {
+
+public:
+
+    static BatchRendererRef create() { return BatchRendererRef( new BatchRenderer() ); }
+
+    void    addLine( const ci::Vec2f &a, const ci::Vec2f &b, const ci::ColorA &col )                              { addLine( a, b, col, col ); }
+    void    addLine( const ci::Vec2f &a, const ci::Vec2f &b, const ci::ColorA &colA, const ci::ColorA &colB );
+    void    addStrokedCircle( const ci::Vec2f &center, float radius, const ci::ColorA &col );
+
+    //! Makes room for \a count lines and returns the index of the first one. setLine() can then fill them from several threads.
+    size_t  allocateLines( size_t count );
+    void    setLine( size_t index, const ci::Vec2f &a, const ci::Vec2f &b, const ci::ColorA &col );
+
+    //! Uploads and draws everything added since the previous draw(), then starts a new batch.
+    void    draw();
+
+    //! Draw calls issued by the last draw().
+    size_t  getNumDrawCalls() const     { return mNumDrawCalls; }
+    //! Lines and circles drawn by the last draw().
+    size_t  getNumPrimitives() const    { return mNumPrimitives; }
+    //! Draw calls immediate mode would have needed on top of the ones issued by the last draw().
+    int     getDrawCallsSaved() const   { return (int)mNumPrimitives - (int)mNumDrawCalls; }
+
+private:
+
+    BatchRenderer();
+
+    struct LineVertex {
+        float       mX, mY;
+        uint32_t    mColor;
+    };
+
+    struct CircleVertex {
+        float       mX, mY;
+        float       mRadius;
+        uint32_t    mColor;
+    };
+
+    static uint32_t packColor( const ci::ColorA &col );
+
+    //! Orphans the buffer, growing it if needed, then uploads \a size bytes.
+    void    upload( ci::gl::Vbo &vbo, size_t *capacity, const void *data, size_t size );
+
+    std::vector<LineVertex>     mLines;
+    std::vector<CircleVertex>   mCircles;
+
+    ci::gl::Vbo                 mLineVbo;
+    ci::gl::Vbo                 mCircleVbo;
+    size_t                      mLineCapacity;
+    size_t                      mCircleCapacity;
+
+    ci::gl::GlslProgRef         mCircleShader;
+    GLint                       mRadiusAttrib;
+
+    size_t                      mNumDrawCalls;
+    size_t                      mNumPrimitives;
+};
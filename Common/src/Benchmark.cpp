@@ -0,0 +1,179 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace ci;
+using namespace std;
+
+
+Benchmark::Format& Benchmark::Format::args( const vector<string> &args )
+{
+    for( size_t k=0; k < args.size(); k++ )
+    {
+        if ( args[k] == "--benchmark" && k + 1 < args.size() )
+            mFrames = (size_t)atoi( args[++k].c_str() );
+
+        else if ( args[k] == "--benchmark-warmup" && k + 1 < args.size() )
+            mWarmupFrames = (size_t)atoi( args[++k].c_str() );
+
+        else if ( args[k] == "--benchmark-null" )
+            mNullRenderer = true;
+
+        else if ( args[k] == "--benchmark-report" && k + 1 < args.size() )
+            mReportPath = args[++k];
+
+        else if ( args[k] == "--param" && k + 2 < args.size() )
+        {
+            const string &name = args[++k];
+            mParams[name] = args[++k];
+        }
+    }
+
+    return *this;
+}
+
+
+Benchmark::Benchmark( const string &name, const Format &format )
+: mName( name ), mFormat( format ), mItems( 0.0 ), mFrame( 0 ), mAllocations( 0 ), mViolationsAtStart( 0 ), mOverBudgetAtStart( 0 ), mFinished( false )
+{
+    mFormat.mWarmupFrames = max<size_t>( mFormat.mWarmupFrames, 1 );
+
+    if ( mFormat.mReportPath.empty() )
+        mFormat.mReportPath = getDocumentsDirectory() / ( mName + "-benchmark.txt" );
+}
+
+
+void Benchmark::setParam( const string &name, const string &value )
+{
+    for( size_t k=0; k < mParams.size(); k++ )
+    {
+        if ( mParams[k].first == name )
+        {
+            mParams[k].second = value;
+            return;
+        }
+    }
+
+    mParams.push_back( make_pair( name, value ) );
+}
+
+
+bool Benchmark::addFrame( const FrameProfiler &profiler )
+{
+    if ( !isEnabled() || mFinished )
+        return mFinished;
+
+    size_t frame = mFrame++;
+
+    // the wall time covers the measured frames from their first update, it starts when the last warm-up frame ends
+    if ( frame < mFormat.mWarmupFrames )
+    {
+        if ( frame + 1 == mFormat.mWarmupFrames )
+            mTimer.start();
+
+        return false;
+    }
+
+    // the first measured frame allocates the samples, the stages are known by then
+    if ( frame == mFormat.mWarmupFrames )
+    {
+        mSamples.resize( profiler.getNumStages() );
+        for( size_t k=0; k < mSamples.size(); k++ )
+            mSamples[k].reserve( mFormat.mFrames );
+
+        mViolationsAtStart  = profiler.getAllocationViolations();
+        mOverBudgetAtStart  = profiler.getOverBudgetFrames();
+    }
+
+    for( size_t k=0; k < mSamples.size(); k++ )
+        mSamples[k].push_back( profiler.getLastTime( k ) );
+
+    mAllocations += profiler.getLastAllocations( 0 ).mAllocations;
+
+    if ( mSamples[0].size() < mFormat.mFrames )
+        return false;
+
+    mTimer.stop();
+    writeReport( profiler );
+    mFinished = true;
+
+    return true;
+}
+
+
+void Benchmark::writeReport( const FrameProfiler &profiler )
+{
+    double  seconds = mTimer.getSeconds();
+    size_t  frames  = mSamples[0].size();
+    char    line[256];
+
+    ostringstream report;
+
+    report << mName << " benchmark" << endl;
+    report << endl;
+
+    snprintf( line, sizeof(line), "%-24s %u, after %u warm-up frames\n", "frames", (unsigned)frames, (unsigned)mFormat.mWarmupFrames );
+    report << line;
+    snprintf( line, sizeof(line), "%-24s %s\n", "renderer", mFormat.mNullRenderer ? "null" : "OpenGL" );
+    report << line;
+    snprintf( line, sizeof(line), "%-24s %.3f s\n", "wall time", seconds );
+    report << line;
+    snprintf( line, sizeof(line), "%-24s %.1f\n", "frames / s", seconds > 0.0 ? frames / seconds : 0.0 );
+    report << line;
+
+    if ( !mItemName.empty() )
+    {
+        snprintf( line, sizeof(line), "%-24s %.0f\n", ( mItemName + " / s" ).c_str(), seconds > 0.0 ? mItems / seconds : 0.0 );
+        report << line;
+    }
+
+    if ( AllocationTracker::isEnabled() )
+        snprintf( line, sizeof(line), "%-24s %.1f\n", "allocations / frame", (double)mAllocations / frames );
+    else
+        snprintf( line, sizeof(line), "%-24s %s\n", "allocations / frame", "not tracked" );
+    report << line;
+    snprintf( line, sizeof(line), "%-24s %u\n", "frames over budget", (unsigned)( profiler.getOverBudgetFrames() - mOverBudgetAtStart ) );
+    report << line;
+    snprintf( line, sizeof(line), "%-24s %u\n", "allocation violations", (unsigned)( profiler.getAllocationViolations() - mViolationsAtStart ) );
+    report << line;
+
+    report << endl << "parameters" << endl;
+
+    for( size_t k=0; k < mParams.size(); k++ )
+    {
+        snprintf( line, sizeof(line), "  %-22s %s\n", mParams[k].first.c_str(), mParams[k].second.c_str() );
+        report << line;
+    }
+
+    snprintf( line, sizeof(line), "\n%-24s %8s %8s %8s %8s %8s %8s   ms\n", "stage", "min", "p50", "p90", "p99", "max", "avg" );
+    report << line;
+
+    vector<float> sorted;
+
+    for( size_t k=0; k < mSamples.size(); k++ )
+    {
+        sorted = mSamples[k];
+        sort( sorted.begin(), sorted.end() );
+
+        double sum = 0.0;
+        for( size_t i=0; i < sorted.size(); i++ )
+            sum += sorted[i];
+
+        // nearest rank
+        size_t n = sorted.size();
+        snprintf( line, sizeof(line), "%-24s %8.3f %8.3f %8.3f %8.3f %8.3f %8.3f\n", profiler.getStageName( k ).c_str(),
+                  sorted[0], sorted[ ( n * 50 + 99 ) / 100 - 1 ], sorted[ ( n * 90 + 99 ) / 100 - 1 ], sorted[ ( n * 99 + 99 ) / 100 - 1 ], sorted[n - 1], sum / n );
+        report << line;
+    }
+
+    mReport = report.str();
+
+    cout << mReport;
+
+    ofstream file( mFormat.mReportPath.string().c_str(), ios::trunc );
+    file << mReport;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "cinder/Timer.h"
+#include "cinder/Filesystem.h"
+#include "cinder/Utilities.h"
+
+#include "FrameProfiler.h"
+
+#include <map>
+#include <vector>
+#include <string>
+#include <sstream>
+
+
+typedef std::shared_ptr<class Benchmark>    BenchmarkRef;
+
+//! Runs an app for a fixed number of frames and reports the frame time percentiles of every profiler stage,
+//! the throughput and the parameters used. Meant to be started from the command line with the audio fed offline,
+//! so that two runs on the same machine see the same input and the same work.
+//! The app records each frame with addFrame() once its profiler frame has ended, and quits when it returns true.
+class Benchmark {
+
+public:
+
+    struct Format {
+        Format() : mFrames( 0 ), mWarmupFrames( 60 ), mNullRenderer( false ) {}
+
+        //! Frames measured, 0 disables the benchmark.
+        Format& frames( size_t frames )                     { mFrames = frames; return *this; }
+        //! Frames run before the measure and the allocation checks start, at least 1: the wall time runs from the end of the last one.
+        Format& warmupFrames( size_t frames )               { mWarmupFrames = frames; return *this; }
+        //! Skips the drawing, only the CPU side of the frame is measured.
+        Format& nullRenderer( bool null = true )            { mNullRenderer = null; return *this; }
+        //! Report file, by default <Documents>/<name>-benchmark.txt.
+        Format& report( const ci::fs::path &path )          { mReportPath = path; return *this; }
+        //! Sets the parameter \a name, overriding the value passed to param().
+        Format& set( const std::string &name, const std::string &value )    { mParams[name] = value; return *this; }
+        //! Picks up "--benchmark <frames>", "--benchmark-warmup <frames>", "--benchmark-null", "--benchmark-report <path>"
+        //! and "--param <name> <value>" from the command line.
+        Format& args( const std::vector<std::string> &args );
+
+        size_t                              mFrames;
+        size_t                              mWarmupFrames;
+        bool                                mNullRenderer;
+        ci::fs::path                        mReportPath;
+        std::map<std::string, std::string>  mParams;
+    };
+
+    static BenchmarkRef create( const std::string &name, const Format &format = Format() )   { return BenchmarkRef( new Benchmark( name, format ) ); }
+
+    bool                isEnabled() const                   { return mFormat.mFrames > 0; }
+    bool                isNullRenderer() const              { return isEnabled() && mFormat.mNullRenderer; }
+    bool                isFinished() const                  { return mFinished; }
+
+    //! Profiler format for the app, in a benchmark run it fails on allocations in allocation free stages from the first measured frame.
+    FrameProfiler::Format   getProfilerFormat() const
+    {
+        FrameProfiler::Format format;
+        if ( isEnabled() )
+            format.failOnAllocation().warmupFrames( mFormat.mWarmupFrames );
+
+        return format;
+    }
+
+    //! Applies the command line value of \a name to \a value if there is one, then lists the value in the report.
+    //! Numbers and bools, as 0 or 1. Call it in setup() before the value is used.
+    template<typename T>
+    void                param( const std::string &name, T *value )
+    {
+        std::map<std::string, std::string>::const_iterator it = mFormat.mParams.find( name );
+        if ( it != mFormat.mParams.end() )
+        {
+            std::istringstream text( it->second );
+            text >> *value;
+        }
+
+        std::ostringstream text;
+        text << *value;
+        setParam( name, text.str() );
+    }
+
+    //! Lists a parameter in the report.
+    void                setParam( const std::string &name, const std::string &value );
+
+    //! Unit of the work reported per second, particles or vertices for instance.
+    void                setItemName( const std::string &name )      { mItemName = name; }
+    //! Work done this frame, ignored during the warm-up.
+    void                addItems( double items )                    { if ( mFrame >= mFormat.mWarmupFrames ) mItems += items; }
+
+    //! Records the frame \a profiler just ended. Returns true once all the frames are measured and the report is written.
+    bool                addFrame( const FrameProfiler &profiler );
+
+    //! The report, empty until the benchmark is finished.
+    const std::string&  getReport() const                   { return mReport; }
+
+private:
+
+    Benchmark( const std::string &name, const Format &format );
+
+    void                writeReport( const FrameProfiler &profiler );
+
+    std::string                                         mName;
+    Format                                              mFormat;
+    std::vector<std::pair<std::string, std::string> >   mParams;
+    std::string                                         mItemName;
+    double                                              mItems;
+    size_t                                              mFrame;
+    std::vector<std::vector<float> >                    mSamples;   // ms per stage and frame, reserved up front
+    uint64_t                                            mAllocations;
+    uint64_t                                            mViolationsAtStart;
+    uint64_t                                            mOverBudgetAtStart;
+    ci::Timer                                           mTimer;
+    bool                                                mFinished;
+    std::string                                         mReport;
+};
@@ -0,0 +1,158 @@
+#include "DisplacementKernel.h"
+#include "SimdMath.h"
+#include "JobSystem.h"
+
+#include <cstring>
+
+using namespace std;
+
+
+DisplacementKernel::DisplacementKernel()
+: mNumVertices( 0 ), mNumBands( 0 )
+{
+}
+
+
+void DisplacementKernel::init( const float *positions, size_t count, size_t numBands, size_t stride, const uint32_t *ids )
+{
+    mBaseX.resize( count );     mBaseY.resize( count );     mBaseZ.resize( count );
+    mDirX.resize( count );      mDirY.resize( count );      mDirZ.resize( count );
+
+    for( size_t k=0; k < count; k++ )
+    {
+        float x = positions[k*stride];
+        float y = positions[k*stride+1];
+        float z = positions[k*stride+2];
+        float l = sqrt( x * x + y * y + z * z );
+
+        mBaseX[k] = x;
+        mBaseY[k] = y;
+        mBaseZ[k] = z;
+
+        // same as Vec3f::normalized(), a vertex at the origin doesn't move
+        float invL = l > 0.0f ? 1.0f / l : 0.0f;
+        mDirX[k] = x * invL;
+        mDirY[k] = y * invL;
+        mDirZ[k] = z * invL;
+    }
+
+    mNumVertices = count;
+    mIds.assign( ids, ids ? ids + count : ids );
+    setNumBands( numBands );
+}
+
+
+void DisplacementKernel::init( size_t count, size_t numBands, const uint32_t *ids )
+{
+    vector<float>().swap( mBaseX );     vector<float>().swap( mBaseY );     vector<float>().swap( mBaseZ );
+    vector<float>().swap( mDirX );      vector<float>().swap( mDirY );      vector<float>().swap( mDirZ );
+
+    mNumVertices = count;
+    mIds.assign( ids, ids ? ids + count : ids );
+    setNumBands( numBands );
+}
+
+
+void DisplacementKernel::setNumBands( size_t numBands )
+{
+    mNumBands = numBands;
+    mBin.resize( mNumVertices );
+
+    for( size_t k=0; k < mBin.size(); k++ )
+        mBin[k] = numBands > 0 ? (uint32_t)( ( mIds.empty() ? k : mIds[k] ) % numBands ) : 0;
+}
+
+
+void DisplacementKernel::displace( const float *bands, float amount, uint8_t *dest, size_t stride, JobSystem *jobs ) const
+{
+    // chunks are a multiple of 4, the SIMD blocks line up the same as in a single pass
+    if ( jobs )
+        jobs->parallelFor( getNumVertices(), 16384, [&]( size_t, size_t begin, size_t end ) { displace( bands, amount, dest, stride, begin, end ); } );
+    else
+        displace( bands, amount, dest, stride, 0, getNumVertices() );
+}
+
+
+void DisplacementKernel::displace( const float *bands, float amount, uint8_t *dest, size_t stride, size_t begin, size_t end ) const
+{
+    if ( mNumBands == 0 || mBaseX.empty() )
+        return;
+
+    size_t k = begin;
+
+#if SIMD_SSE2
+    __m128 amount4 = _mm_set1_ps( amount );
+
+    for( ; k + 4 <= end; k += 4 )
+    {
+        // SSE2 has no gather, the 4 bands are loaded one by one
+        const uint32_t  *bin    = &mBin[k];
+        __m128          offset  = _mm_mul_ps( _mm_setr_ps( bands[bin[0]], bands[bin[1]], bands[bin[2]], bands[bin[3]] ), amount4 );
+
+        __m128 x = _mm_add_ps( _mm_loadu_ps( &mBaseX[k] ), _mm_mul_ps( _mm_loadu_ps( &mDirX[k] ), offset ) );
+        __m128 y = _mm_add_ps( _mm_loadu_ps( &mBaseY[k] ), _mm_mul_ps( _mm_loadu_ps( &mDirY[k] ), offset ) );
+        __m128 z = _mm_add_ps( _mm_loadu_ps( &mBaseZ[k] ), _mm_mul_ps( _mm_loadu_ps( &mDirZ[k] ), offset ) );
+
+        float *out = (float*)( dest + k * stride );
+
+        if ( stride == 3 * sizeof(float) )
+        {
+            // tightly packed positions, transpose xxxx yyyy zzzz into xyzx yzxy zxyz
+            __m128 xyLo = _mm_unpacklo_ps( x, y );                              // x0 y0 x1 y1
+            __m128 xyHi = _mm_unpackhi_ps( x, y );                              // x2 y2 x3 y3
+            __m128 zx   = _mm_shuffle_ps( z, x, _MM_SHUFFLE( 1, 1, 0, 0 ) );    // z0 z0 x1 x1
+            __m128 yz   = _mm_shuffle_ps( y, z, _MM_SHUFFLE( 1, 1, 1, 1 ) );    // y1 y1 z1 z1
+            __m128 zx2  = _mm_shuffle_ps( z, xyHi, _MM_SHUFFLE( 2, 2, 2, 2 ) ); // z2 z2 x3 x3
+            __m128 yz3  = _mm_shuffle_ps( xyHi, z, _MM_SHUFFLE( 3, 3, 3, 3 ) ); // y3 y3 z3 z3
+
+            _mm_storeu_ps( out,     _mm_shuffle_ps( xyLo, zx, _MM_SHUFFLE( 2, 0, 1, 0 ) ) );
+            _mm_storeu_ps( out + 4, _mm_shuffle_ps( yz, xyHi, _MM_SHUFFLE( 1, 0, 2, 0 ) ) );
+            _mm_storeu_ps( out + 8, _mm_shuffle_ps( zx2, yz3, _MM_SHUFFLE( 2, 0, 2, 0 ) ) );
+        }
+        else
+        {
+            float xs[4], ys[4], zs[4];
+            _mm_storeu_ps( xs, x );
+            _mm_storeu_ps( ys, y );
+            _mm_storeu_ps( zs, z );
+
+            for( int n=0; n < 4; n++ )
+            {
+                float *p = (float*)( dest + ( k + n ) * stride );
+                p[0] = xs[n];
+                p[1] = ys[n];
+                p[2] = zs[n];
+            }
+        }
+    }
+#endif
+
+    for( ; k < end; k++ )
+    {
+        float   offset  = bands[ mBin[k] ] * amount;
+        float   *p      = (float*)( dest + k * stride );
+
+        p[0] = mBaseX[k] + mDirX[k] * offset;
+        p[1] = mBaseY[k] + mDirY[k] * offset;
+        p[2] = mBaseZ[k] + mDirZ[k] * offset;
+    }
+}
+
+
+void DisplacementKernel::calcOffsets( const float *bands, float amount, float *dest, JobSystem *jobs ) const
+{
+    if ( jobs )
+        jobs->parallelFor( getNumVertices(), 16384, [&]( size_t, size_t begin, size_t end ) { calcOffsets( bands, amount, dest, begin, end ); } );
+    else
+        calcOffsets( bands, amount, dest, 0, getNumVertices() );
+}
+
+
+void DisplacementKernel::calcOffsets( const float *bands, float amount, float *dest, size_t begin, size_t end ) const
+{
+    if ( mNumBands == 0 )
+        return;
+
+    for( size_t k = begin; k < end; k++ )
+        dest[k] = bands[ mBin[k] ] * amount;
+}
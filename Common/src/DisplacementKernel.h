@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+class JobSystem;
+
+
+//! Everything the per-frame displacement needs that doesn't change with the audio, computed once per mesh:
+//! base positions, normalised directions from the origin and the band each vertex follows, stored as arrays.
+//! The kernel writes base + dir * amount * bands[bin] straight into an interleaved (mapped) position buffer,
+//! or only amount * bands[bin] when the base and the direction are applied on the GPU, see GpuMesh::mapDisplacements().
+class DisplacementKernel {
+
+public:
+
+    DisplacementKernel();
+
+    //! \a positions holds \a count xyz triplets, \a stride floats apart. Vertex k follows band k % numBands,
+    //! or ids[k] % numBands with \a ids, so the simplified levels of a mesh keep the bands of the full mesh.
+    void    init( const float *positions, size_t count, size_t numBands, size_t stride = 3, const uint32_t *ids = nullptr );
+    //! Offsets only, no positions are kept and displace() writes nothing.
+    void    init( size_t count, size_t numBands, const uint32_t *ids = nullptr );
+    //! Only recomputes the band indices.
+    void    setNumBands( size_t numBands );
+
+    size_t  getNumVertices() const  { return mNumVertices; }
+    size_t  getNumBands() const     { return mNumBands; }
+
+    //! Writes all the displaced positions to \a dest, \a stride bytes apart. \a bands must hold getNumBands() values.
+    //! With \a jobs the vertices are split into chunks that run in parallel.
+    void    displace( const float *bands, float amount, uint8_t *dest, size_t stride, JobSystem *jobs = nullptr ) const;
+    //! Writes the positions of vertices [begin, end) only, \a dest points to the first vertex of the buffer.
+    void    displace( const float *bands, float amount, uint8_t *dest, size_t stride, size_t begin, size_t end ) const;
+
+    //! Writes the displacement of each vertex along its direction, amount * bands[bin], one float per vertex.
+    void    calcOffsets( const float *bands, float amount, float *dest, JobSystem *jobs = nullptr ) const;
+    void    calcOffsets( const float *bands, float amount, float *dest, size_t begin, size_t end ) const;
+
+private:
+
+    std::vector<float>      mBaseX, mBaseY, mBaseZ;
+    std::vector<float>      mDirX, mDirY, mDirZ;
+    std::vector<uint32_t>   mBin;
+    std::vector<uint32_t>   mIds;
+    size_t                  mNumVertices;
+    size_t                  mNumBands;
+};
@@ -0,0 +1,37 @@
+#include "FeatureHistory.h"
+
+#include <algorithm>
+
+using namespace ci;
+using namespace std;
+
+
+FeatureHistory::FeatureHistory( const Format &format )
+: mHead( 0 )
+{
+    mTexture = FeatureTexture::create( FeatureTexture::Format().size( format.mNumValues, format.mNumFrames ).pbos( format.mNumPbos )
+                                        .filter( format.mFilter ).wrap( GL_CLAMP_TO_EDGE, GL_REPEAT ) );
+
+    mRow.resize( format.mNumValues, 0.0f );
+}
+
+
+void FeatureHistory::push( const float *data, size_t count )
+{
+    mHead = ( mHead + 1 ) % getNumFrames();
+
+    // pad the row, the texels past count would keep the values of the frame from N frames ago otherwise
+    count = min( count, mRow.size() );
+    copy( data, data + count, mRow.begin() );
+    fill( mRow.begin() + count, mRow.end(), 0.0f );
+
+    mTexture->upload( mRow.data(), mRow.size(), mHead );
+}
+
+
+void FeatureHistory::setUniforms( const gl::GlslProgRef &shader, int unit ) const
+{
+    shader->uniform( "historyTex",  unit );
+    shader->uniform( "historyHead", mHead );
+    shader->uniform( "historySize", Vec2f( (float)getNumValues(), (float)getNumFrames() ) );
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "cinder/gl/GlslProg.h"
+
+#include "FeatureTexture.h"
+
+
+typedef std::shared_ptr<class FeatureHistory>   FeatureHistoryRef;
+
+//! The last N frames of a feature in a 2d ring texture, one row per frame.
+//! Each push() uploads a single row at the head, nothing is ever shifted. Shaders find a frame from the head:
+//!     float t = ( float( historyHead ) - age + 0.5 ) / historySize.y;     // age 0 is the latest frame
+//! the texture repeats along t, so the ring wraps around by itself.
+class FeatureHistory {
+
+public:
+
+    struct Format {
+        Format() : mNumValues( 32 ), mNumFrames( 64 ), mNumPbos( 0 ), mFilter( GL_NEAREST ) {}
+
+        //! Values per frame, longer frames are cut and shorter ones are padded with zeros.
+        Format& values( int numValues )         { mNumValues = numValues; return *this; }
+        Format& frames( int numFrames )         { mNumFrames = numFrames; return *this; }
+        Format& pbos( int numPbos )             { mNumPbos = numPbos; return *this; }
+        //! GL_LINEAR blends neighbouring values and frames.
+        Format& filter( GLenum filter )         { mFilter = filter; return *this; }
+
+        int     mNumValues;
+        int     mNumFrames;
+        int     mNumPbos;
+        GLenum  mFilter;
+    };
+
+    static FeatureHistoryRef create( const Format &format = Format() ) { return FeatureHistoryRef( new FeatureHistory( format ) ); }
+
+    //! Writes a new frame into the row after the head, which becomes the new head.
+    void                    push( const float *data, size_t count );
+
+    //! Row of the latest frame.
+    int                     getHead() const         { return mHead; }
+    int                     getNumValues() const    { return mTexture->getWidth(); }
+    int                     getNumFrames() const    { return mTexture->getHeight(); }
+
+    const ci::gl::Texture&  getTexture() const      { return mTexture->getTexture(); }
+
+    void                    bind( GLuint unit = 0 ) const   { mTexture->bind( unit ); }
+    void                    unbind( GLuint unit = 0 ) const { mTexture->unbind( unit ); }
+
+    //! Sets historyTex, historyHead and historySize, the texture must be bound to \a unit.
+    void                    setUniforms( const ci::gl::GlslProgRef &shader, int unit ) const;
+
+private:
+
+    FeatureHistory( const Format &format );
+
+    FeatureTextureRef       mTexture;
+    std::vector<float>      mRow;
+    int                     mHead;
+};
@@ -0,0 +1,84 @@
+#include "FeatureTexture.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace ci;
+using namespace std;
+
+
+FeatureTexture::FeatureTexture( const Format &format )
+: mFormat( format ), mPboIndex( 0 ), mUploadSize( 0 )
+{
+    gl::Texture::Format texFormat;
+    texFormat.setInternalFormat( GL_LUMINANCE32F_ARB );
+    texFormat.setMinFilter( mFormat.mFilter );
+    texFormat.setMagFilter( mFormat.mFilter );
+    texFormat.setWrap( mFormat.mWrapS, mFormat.mWrapT );
+
+    mTexture = gl::Texture( mFormat.mWidth, mFormat.mHeight, texFormat );
+
+    // start from zero rather than whatever the driver hands out
+    vector<float> zeros( mFormat.mWidth * mFormat.mHeight, 0.0f );
+    texSubImage( zeros.data(), zeros.size(), 0 );
+
+    for( int k=0; k < mFormat.mNumPbos; k++ )
+        mPbos.push_back( gl::Vbo( GL_PIXEL_UNPACK_BUFFER ) );
+}
+
+
+void FeatureTexture::upload( const float *data, size_t count, int firstRow )
+{
+    if ( firstRow < 0 || firstRow >= mFormat.mHeight )
+        return;
+
+    count       = min( count, (size_t)( mFormat.mHeight - firstRow ) * mFormat.mWidth );
+    mUploadSize = count * sizeof(float);
+
+    if ( count == 0 )
+        return;
+
+    if ( mPbos.empty() )
+    {
+        texSubImage( data, count, firstRow );
+        return;
+    }
+
+    // orphan the next buffer of the ring, mapping it never waits for a transfer still in flight
+    gl::Vbo &pbo = mPbos[mPboIndex];
+    mPboIndex = ( mPboIndex + 1 ) % mPbos.size();
+
+    pbo.bind();
+    pbo.bufferData( mUploadSize, NULL, GL_STREAM_DRAW );
+
+    uint8_t *dest = pbo.map( GL_WRITE_ONLY );
+    if ( dest )
+    {
+        memcpy( dest, data, mUploadSize );
+        pbo.unmap();
+
+        // with a PBO bound the pointer is an offset in the buffer
+        texSubImage( NULL, count, firstRow );
+    }
+
+    pbo.unbind();
+}
+
+
+void FeatureTexture::texSubImage( const float *pixels, size_t count, int firstRow )
+{
+    size_t width    = mFormat.mWidth;
+    size_t rows     = count / width;
+    size_t rest     = count % width;
+
+    mTexture.bind();
+    glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+
+    if ( rows > 0 )
+        glTexSubImage2D( mTexture.getTarget(), 0, 0, firstRow, (GLsizei)width, (GLsizei)rows, GL_LUMINANCE, GL_FLOAT, pixels );
+
+    if ( rest > 0 )
+        glTexSubImage2D( mTexture.getTarget(), 0, 0, firstRow + (GLint)rows, (GLsizei)rest, 1, GL_LUMINANCE, GL_FLOAT, (const GLvoid*)( (uintptr_t)pixels + rows * width * sizeof(float) ) );
+
+    mTexture.unbind();
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "cinder/gl/gl.h"
+#include "cinder/gl/Texture.h"
+#include "cinder/gl/Vbo.h"
+
+#include <vector>
+
+
+typedef std::shared_ptr<class FeatureTexture>   FeatureTextureRef;
+
+//! Single channel float texture allocated once, the feature values are laid out row by row and only the texels
+//! in use are uploaded with glTexSubImage2D. With a PBO ring the upload goes through a pixel buffer,
+//! so the driver copies asynchronously instead of stalling on the previous upload.
+//! The texture is GL_LUMINANCE32F, so r, g and b all hold the value and alpha is 1.
+class FeatureTexture {
+
+public:
+
+    struct Format {
+        Format() : mWidth( 32 ), mHeight( 32 ), mNumPbos( 0 ), mFilter( GL_NEAREST ), mWrapS( GL_CLAMP_TO_EDGE ), mWrapT( GL_CLAMP_TO_EDGE ) {}
+
+        Format& size( int width, int height )   { mWidth = width; mHeight = height; return *this; }
+        //! Number of pixel buffers in the ring, 0 uploads straight from client memory.
+        Format& pbos( int numPbos )             { mNumPbos = numPbos; return *this; }
+        Format& filter( GLenum filter )         { mFilter = filter; return *this; }
+        Format& wrap( GLenum s, GLenum t )      { mWrapS = s; mWrapT = t; return *this; }
+
+        int     mWidth;
+        int     mHeight;
+        int     mNumPbos;
+        GLenum  mFilter;
+        GLenum  mWrapS;
+        GLenum  mWrapT;
+    };
+
+    static FeatureTextureRef create( const Format &format = Format() ) { return FeatureTextureRef( new FeatureTexture( format ) ); }
+
+    //! Uploads \a count values starting at the first texel, anything past the texture is dropped.
+    void                    update( const float *data, size_t count )     { upload( data, count, 0 ); }
+    //! Uploads \a count values row by row, starting at the beginning of \a firstRow.
+    void                    upload( const float *data, size_t count, int firstRow );
+
+    const ci::gl::Texture&  getTexture() const      { return mTexture; }
+    int                     getWidth() const        { return mFormat.mWidth; }
+    int                     getHeight() const       { return mFormat.mHeight; }
+    //! Bytes uploaded by the last update().
+    size_t                  getUploadSize() const   { return mUploadSize; }
+
+    void                    bind( GLuint unit = 0 ) const   { mTexture.bind( unit ); }
+    void                    unbind( GLuint unit = 0 ) const { mTexture.unbind( unit ); }
+
+private:
+
+    FeatureTexture( const Format &format );
+
+    //! Uploads whole rows plus the partial last one, \a pixels is either client memory or an offset in the bound PBO.
+    void                    texSubImage( const float *pixels, size_t count, int firstRow );
+
+    Format                          mFormat;
+    ci::gl::Texture                 mTexture;
+    std::vector<ci::gl::Vbo>        mPbos;
+    size_t                          mPboIndex;
+    size_t                          mUploadSize;
+};
@@ -0,0 +1,250 @@
+#include "FrameProfiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+using namespace ci;
+using namespace std;
+
+
+FrameProfiler::Format& FrameProfiler::Format::args( const vector<string> &args )
+{
+    for( size_t k=0; k < args.size(); k++ )
+    {
+        if ( args[k] == "--profile-csv" && k + 1 < args.size() )
+            mCsvPath = args[++k];
+        else if ( args[k] == "--fail-on-alloc" )
+            mFailOnAllocation = true;
+    }
+
+    return *this;
+}
+
+
+FrameProfiler::FrameProfiler( const Format &format )
+: mFormat( format ), mClock( true ), mNumFrames( 0 ), mOverBudgetFrames( 0 ), mOverBudgetParam( 0 ),
+  mAllocationViolations( 0 ), mAllocationViolationsParam( 0 ), mFrameAllocsParam( 0 ), mFrameKbParam( 0.0f ),
+  mCsvHeaderPending( false )
+{
+    mFormat.mWindowFrames   = max<size_t>( mFormat.mWindowFrames, 1 );
+    mFormat.mRefreshFrames  = max<size_t>( mFormat.mRefreshFrames, 1 );
+
+    addStage( "Frame" );
+
+    if ( mFormat.mFailOnAllocation && !AllocationTracker::isEnabled() )
+        cerr << "FrameProfiler: allocations aren't tracked in this build, define ALLOCATION_TRACKER=1 to fail on them" << endl;
+
+    if ( !mFormat.mCsvPath.empty() )
+        startCsv( mFormat.mCsvPath );
+}
+
+
+FrameProfiler::~FrameProfiler()
+{
+    stopCsv();
+}
+
+
+size_t FrameProfiler::addStage( const string &name, bool allocationFree )
+{
+    Stage stage;
+    stage.mName             = name;
+    stage.mStart            = 0.0;
+    stage.mFrameTime        = 0.0;
+    stage.mLastMs           = 0.0f;
+    stage.mSamples.assign( mFormat.mWindowFrames, 0.0f );
+    stage.mText             = "-";
+    stage.mAllocationFree   = allocationFree;
+
+    mStages.push_back( stage );
+
+    return mStages.size() - 1;
+}
+
+
+void FrameProfiler::beginFrame()
+{
+    for( size_t k=0; k < mStages.size(); k++ )
+    {
+        mStages[k].mFrameTime   = 0.0;
+        mStages[k].mFrameAllocs = AllocationTracker::Counts();
+    }
+
+    begin( 0 );
+}
+
+
+void FrameProfiler::endFrame()
+{
+    end( 0 );
+
+    size_t  slot    = mNumFrames % mFormat.mWindowFrames;
+    size_t  slowest = 0;
+
+    for( size_t k=0; k < mStages.size(); k++ )
+    {
+        Stage &stage = mStages[k];
+        stage.mLastMs           = (float)( stage.mFrameTime * 1000.0 );
+        stage.mSamples[slot]    = stage.mLastMs;
+        stage.mLastAllocs       = stage.mFrameAllocs;
+
+        if ( k > 0 && ( slowest == 0 || stage.mLastMs > mStages[slowest].mLastMs ) )
+            slowest = k;
+    }
+
+    mNumFrames++;
+
+    if ( mStages[0].mLastMs > mFormat.mBudgetMs )
+    {
+        mOverBudgetFrames++;
+
+        char text[128];
+        snprintf( text, sizeof(text), "%s %.2f of %.2f ms", mStages[slowest].mName.c_str(), mStages[slowest].mLastMs, mStages[0].mLastMs );
+        mOverBudgetText = text;
+    }
+
+    if ( mCsv.is_open() )
+    {
+        // the apps add their stages after create(), the header waits for the first frame to have them all
+        if ( mCsvHeaderPending )
+        {
+            mCsv << "frame";
+            for( size_t k=0; k < mStages.size(); k++ )
+                mCsv << ',' << mStages[k].mName;
+            for( size_t k=0; k < mStages.size(); k++ )
+                mCsv << ',' << mStages[k].mName << " allocs";
+            mCsv << '\n';
+
+            mCsvHeaderPending = false;
+        }
+
+        mCsv << mNumFrames;
+        for( size_t k=0; k < mStages.size(); k++ )
+            mCsv << ',' << mStages[k].mLastMs;
+        for( size_t k=0; k < mStages.size(); k++ )
+            mCsv << ',' << mStages[k].mLastAllocs.mAllocations;
+        mCsv << '\n';
+    }
+
+    // the buffers grow during the first frames, after that the allocation free stages must stay so
+    if ( mNumFrames > mFormat.mWarmupFrames )
+    {
+        for( size_t k=0; k < mStages.size(); k++ )
+        {
+            const Stage &stage = mStages[k];
+
+            if ( !stage.mAllocationFree || stage.mLastAllocs.mAllocations == 0 )
+                continue;
+
+            mAllocationViolations++;
+
+            char text[128];
+            snprintf( text, sizeof(text), "%s %u allocs, %u bytes", stage.mName.c_str(), (unsigned)stage.mLastAllocs.mAllocations, (unsigned)stage.mLastAllocs.mBytes );
+            mAllocationViolationText = text;
+
+            if ( mFormat.mFailOnAllocation )
+            {
+                stopCsv();
+                cerr << "FrameProfiler: frame " << mNumFrames << ", allocation in allocation free stage " << mAllocationViolationText << endl;
+                exit( EXIT_FAILURE );
+            }
+        }
+    }
+
+    if ( mNumFrames % mFormat.mRefreshFrames == 0 )
+        updateStats();
+}
+
+
+void FrameProfiler::updateStats()
+{
+    size_t count = (size_t)min<uint64_t>( mNumFrames, mFormat.mWindowFrames );
+    if ( count == 0 )
+        return;
+
+    // nearest rank, the 99th percentile of fewer than 100 frames is the maximum
+    size_t rank = ( count * 99 + 99 ) / 100 - 1;
+
+    for( size_t k=0; k < mStages.size(); k++ )
+    {
+        Stage &stage = mStages[k];
+
+        mSorted.assign( stage.mSamples.begin(), stage.mSamples.begin() + count );
+
+        double sum = 0.0;
+        for( size_t i=0; i < count; i++ )
+            sum += mSorted[i];
+
+        nth_element( mSorted.begin(), mSorted.begin() + rank, mSorted.end() );
+
+        stage.mStats.mMin   = *min_element( mSorted.begin(), mSorted.end() );
+        stage.mStats.mAvg   = (float)( sum / count );
+        stage.mStats.mP99   = mSorted[rank];
+
+        char text[64];
+        if ( AllocationTracker::isEnabled() )
+            snprintf( text, sizeof(text), "%.2f  %.2f  %.2f  %u", stage.mStats.mMin, stage.mStats.mAvg, stage.mStats.mP99, (unsigned)stage.mLastAllocs.mAllocations );
+        else
+            snprintf( text, sizeof(text), "%.2f  %.2f  %.2f", stage.mStats.mMin, stage.mStats.mAvg, stage.mStats.mP99 );
+        stage.mText = text;
+    }
+
+    mOverBudgetParam            = (int32_t)mOverBudgetFrames;
+    mAllocationViolationsParam  = (int32_t)mAllocationViolations;
+    mFrameAllocsParam           = (int32_t)mStages[0].mLastAllocs.mAllocations;
+    mFrameKbParam               = mStages[0].mLastAllocs.mBytes / 1024.0f;
+}
+
+
+void FrameProfiler::addParams( const params::InterfaceGlRef &params, const string &group )
+{
+    string options = "group='" + group + "'";
+
+    bool allocations = AllocationTracker::isEnabled();
+
+    if ( allocations )
+    {
+        params->addParam( "Allocs / frame", &mFrameAllocsParam, options, true );
+        params->addParam( "Alloc KB / frame", &mFrameKbParam, options, true );
+    }
+
+    params->addText( allocations ? "min  avg  p99 ms  allocs" : "min  avg  p99 ms", options );
+
+    for( size_t k=0; k < mStages.size(); k++ )
+        params->addParam( mStages[k].mName, &mStages[k].mText, options, true );
+
+    params->addParam( "Frames over budget", &mOverBudgetParam, options, true );
+    params->addParam( "Last over budget", &mOverBudgetText, options, true );
+
+    if ( allocations )
+    {
+        params->addParam( "Alloc violations", &mAllocationViolationsParam, options, true );
+        params->addParam( "Last alloc violation", &mAllocationViolationText, options, true );
+    }
+}
+
+
+bool FrameProfiler::startCsv( const string &path )
+{
+    stopCsv();
+
+    mCsv.open( path.c_str(), ios::trunc );
+    if ( !mCsv.is_open() )
+        return false;
+
+    mCsv.setf( ios::fixed );
+    mCsv.precision( 3 );
+
+    mCsvHeaderPending = true;
+
+    return true;
+}
+
+
+void FrameProfiler::stopCsv()
+{
+    if ( mCsv.is_open() )
+        mCsv.close();
+}
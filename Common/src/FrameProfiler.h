@@ -0,0 +1,162 @@
+#pragma once
+
+#include "cinder/Timer.h"
+#include "cinder/params/Params.h"
+
+#include "AllocationTracker.h"
+
+#include <deque>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdint>
+
+
+typedef std::shared_ptr<class FrameProfiler>    FrameProfilerRef;
+
+//! Times the stages of each frame on the main thread and keeps rolling min, average and 99th percentile over the last frames.
+//! Stages are registered once with addStage() and timed with begin()/end() or a Scope, a stage can run several times per frame
+//! and its times add up. The statistics can be shown in a params panel and every frame streamed to a CSV file.
+//! A frame over budget records the stage that took longest, so a spike can be told apart from a slow stage.
+//! In builds with ALLOCATION_TRACKER=1 the heap allocations of each stage are counted on the main thread, stages added as
+//! allocation free are reported when they allocate.
+class FrameProfiler {
+
+public:
+
+    struct Format {
+        Format() : mWindowFrames( 300 ), mRefreshFrames( 15 ), mBudgetMs( 1000.0f / 60.0f ), mWarmupFrames( 120 ), mFailOnAllocation( false ) {}
+
+        //! Frames the statistics are computed over.
+        Format& windowFrames( size_t frames )           { mWindowFrames = frames; return *this; }
+        //! Frames between two updates of the statistics and the params panel.
+        Format& refreshFrames( size_t frames )          { mRefreshFrames = frames; return *this; }
+        //! Frame time in ms above which a frame is over budget.
+        Format& budget( float ms )                      { mBudgetMs = ms; return *this; }
+        //! Streams every frame to \a path, one column per stage.
+        Format& csv( const std::string &path )          { mCsvPath = path; return *this; }
+        //! Frames during which the buffers are allowed to grow, allocations in allocation free stages are ignored until then.
+        Format& warmupFrames( size_t frames )           { mWarmupFrames = frames; return *this; }
+        //! Exits the process with a failure as soon as an allocation free stage allocates, for benchmark runs.
+        Format& failOnAllocation( bool fail = true )    { mFailOnAllocation = fail; return *this; }
+        //! Picks up "--profile-csv <path>" and "--fail-on-alloc" from the command line.
+        Format& args( const std::vector<std::string> &args );
+
+        size_t          mWindowFrames;
+        size_t          mRefreshFrames;
+        float           mBudgetMs;
+        std::string     mCsvPath;
+        size_t          mWarmupFrames;
+        bool            mFailOnAllocation;
+    };
+
+    //! Milliseconds over the window.
+    struct Stats {
+        Stats() : mMin( 0.0f ), mAvg( 0.0f ), mP99( 0.0f ) {}
+
+        float   mMin;
+        float   mAvg;
+        float   mP99;
+    };
+
+    //! Times a stage until the end of the scope, does nothing with a null profiler.
+    class Scope {
+    public:
+        Scope( FrameProfiler *profiler, size_t stage ) : mProfiler( profiler ), mStage( stage )  { if ( mProfiler ) mProfiler->begin( mStage ); }
+        ~Scope()                                                                                { if ( mProfiler ) mProfiler->end( mStage ); }
+
+    private:
+        Scope( const Scope& );
+        Scope& operator=( const Scope& );
+
+        FrameProfiler   *mProfiler;
+        size_t          mStage;
+    };
+
+    static FrameProfilerRef create( const Format &format = Format() )   { return FrameProfilerRef( new FrameProfiler( format ) ); }
+
+    ~FrameProfiler();
+
+    //! Returns the id of a new stage, stages must be added before the first frame and before addParams().
+    //! A stage \a allocationFree is expected not to allocate once warmed up.
+    size_t              addStage( const std::string &name, bool allocationFree = false );
+
+    void                begin( size_t stage )
+    {
+        Stage &s        = mStages[stage];
+        s.mAllocStart   = AllocationTracker::getThreadCounts();
+        s.mStart        = mClock.getSeconds();
+    }
+
+    void                end( size_t stage )
+    {
+        Stage &s        = mStages[stage];
+        s.mFrameTime   += mClock.getSeconds() - s.mStart;
+        s.mFrameAllocs += AllocationTracker::getThreadCounts() - s.mAllocStart;
+    }
+
+    //! Starts timing a frame, call first thing in update().
+    void                beginFrame();
+    //! Records the stages of the frame, call last thing in draw().
+    void                endFrame();
+
+    //! Adds a read-only row per stage to \a params, min, avg and p99 in ms and the allocations of the last frame, the frames over budget
+    //! and the allocations in allocation free stages.
+    void                addParams( const ci::params::InterfaceGlRef &params, const std::string &group = "Profiler" );
+
+    //! Starts streaming to \a path, replacing the file. Returns false if it can't be opened.
+    //! The header is written by the next endFrame(), with the stages added by then.
+    bool                startCsv( const std::string &path );
+    void                stopCsv();
+    bool                isWritingCsv() const                    { return mCsv.is_open(); }
+
+    //! Stage 0 is the whole frame, from beginFrame() to endFrame().
+    size_t              getNumStages() const                    { return mStages.size(); }
+    const std::string&  getStageName( size_t stage ) const      { return mStages[stage].mName; }
+    const Stats&        getStats( size_t stage ) const          { return mStages[stage].mStats; }
+    //! Time of the stage in the last complete frame, ms.
+    float               getLastTime( size_t stage ) const       { return mStages[stage].mLastMs; }
+    uint64_t            getNumFrames() const                    { return mNumFrames; }
+    uint64_t            getOverBudgetFrames() const             { return mOverBudgetFrames; }
+    //! Allocations of the stage in the last complete frame.
+    const AllocationTracker::Counts&    getLastAllocations( size_t stage ) const    { return mStages[stage].mLastAllocs; }
+    //! Frames in which an allocation free stage allocated after the warm-up.
+    uint64_t            getAllocationViolations() const         { return mAllocationViolations; }
+    const std::string&  getLastAllocationViolation() const      { return mAllocationViolationText; }
+
+private:
+
+    FrameProfiler( const Format &format );
+
+    struct Stage {
+        std::string                 mName;
+        double                      mStart;
+        double                      mFrameTime;         // seconds in the current frame
+        float                       mLastMs;
+        std::vector<float>          mSamples;           // ms, ring of the last frames
+        Stats                       mStats;
+        std::string                 mText;              // params row
+        bool                        mAllocationFree;
+        AllocationTracker::Counts   mAllocStart;
+        AllocationTracker::Counts   mFrameAllocs;       // in the current frame
+        AllocationTracker::Counts   mLastAllocs;
+    };
+
+    void                updateStats();
+
+    Format                  mFormat;
+    ci::Timer               mClock;
+    std::deque<Stage>       mStages;            // a deque keeps the params rows in place
+    std::vector<float>      mSorted;
+    uint64_t                mNumFrames;
+    uint64_t                mOverBudgetFrames;
+    int32_t                 mOverBudgetParam;
+    std::string             mOverBudgetText;    // slowest stage of the last frame over budget
+    uint64_t                mAllocationViolations;
+    int32_t                 mAllocationViolationsParam;
+    std::string             mAllocationViolationText;
+    int32_t                 mFrameAllocsParam;
+    float                   mFrameKbParam;
+    std::ofstream           mCsv;
+    bool                    mCsvHeaderPending;
+};
@@ -0,0 +1,438 @@
+#include "GpuMesh.h"
+#include "VertexPacking.h"
+
+#include "cinder/app/App.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace ci;
+using namespace ci::app;
+using namespace std;
+
+// GL 3.0 and ARB_half_float_vertex, missing from older headers
+#ifndef GL_HALF_FLOAT
+#define GL_HALF_FLOAT 0x140B
+#endif
+
+
+namespace {
+
+// packed values come in unnormalised, the uniforms fold in the 1/32767
+const char *kCompactVert =
+    "#version 120\n"
+    "uniform vec3 positionScale;\n"
+    "uniform vec3 positionOffset;\n"
+    "attribute vec3 position;\n"
+    "attribute vec2 normal;\n"
+    "attribute vec2 texCoord;\n"
+    "attribute float displacement;\n"
+    "varying vec3 vNormal;\n"
+    "vec3 unpackOctahedral( vec2 e ) {\n"
+    "    vec3 n = vec3( e, 1.0 - abs( e.x ) - abs( e.y ) );\n"
+    "    if ( n.z < 0.0 )\n"
+    "        n.xy = ( 1.0 - abs( e.yx ) ) * vec2( e.x >= 0.0 ? 1.0 : -1.0, e.y >= 0.0 ? 1.0 : -1.0 );\n"
+    "    return normalize( n );\n"
+    "}\n"
+    "void main() {\n"
+    "    vec3  p = positionOffset + positionScale * position;\n"
+    "    float l = length( p );\n"
+    "    if ( l > 0.0 )\n"
+    "        p += p * ( displacement / l );\n"
+    "    vNormal         = gl_NormalMatrix * unpackOctahedral( normal / 32767.0 );\n"
+    "    gl_FrontColor   = gl_Color;\n"
+    "    gl_TexCoord[0]  = vec4( texCoord, 0.0, 1.0 );\n"
+    "    gl_Position     = gl_ModelViewProjectionMatrix * vec4( p, 1.0 );\n"
+    "}\n";
+
+const char *kCompactFrag =
+    "#version 120\n"
+    "uniform float lighting;\n"
+    "varying vec3 vNormal;\n"
+    "void main() {\n"
+    "    float diffuse = mix( 1.0, abs( normalize( vNormal ).z ), lighting );\n"
+    "    gl_FragColor  = vec4( gl_Color.rgb * diffuse, gl_Color.a );\n"
+    "}\n";
+
+}
+
+
+GpuMesh::GpuMesh( const MeshDataRef &data, const Format &format )
+: mData( data ), mDynamicPositions( format.mDynamicPositions ), mCompact( false ), mUploaded( 0 ),
+  mPackedStride( 0 ), mPackedNormalOffset( 0 ), mPackedTexCoordOffset( 0 ), mIndexType( GL_UNSIGNED_INT ),
+  mPositionAttrib( -1 ), mNormalAttrib( -1 ), mTexCoordAttrib( -1 ), mDisplacementAttrib( -1 )
+{
+    mVertexSource   = (const uint8_t*)mData->getVertices();
+    mIndexSource    = (const uint8_t*)mData->getIndices();
+    mVertexBytes    = mData->getNumVertices() * mData->getVertexSize() * sizeof(float);
+    mIndexBytes     = mData->getNumIndices() * sizeof(uint32_t);
+
+    if ( format.mCompact )
+        mCompact = initCompact();
+
+    mVertexVbo  = gl::Vbo( GL_ARRAY_BUFFER );
+    mIndexVbo   = gl::Vbo( GL_ELEMENT_ARRAY_BUFFER );
+
+    mVertexVbo.bind();
+    mVertexVbo.bufferData( mVertexBytes, NULL, GL_STATIC_DRAW );
+    mVertexVbo.unbind();
+
+    mIndexVbo.bind();
+    mIndexVbo.bufferData( mIndexBytes, NULL, GL_STATIC_DRAW );
+    mIndexVbo.unbind();
+
+    if ( mDynamicPositions )
+        initDynamic();
+}
+
+
+bool GpuMesh::initCompact()
+{
+    try {
+        mCompactShader = gl::GlslProg::create( kCompactVert, kCompactFrag );
+    }
+    catch( const gl::GlslProgCompileExc &exc ) {
+        console() << "GpuMesh: cannot compile the compact vertex shader, using floats: " << exc.what() << endl;
+        mCompactShader.reset();
+        return false;
+    }
+
+    // in the compatibility profile some drivers draw nothing unless generic attribute 0 is an enabled array,
+    // GlslProg links in its constructor so the binding needs a second link
+    GLuint program = mCompactShader->getHandle();
+    glBindAttribLocation( program, 0, "position" );
+    glLinkProgram( program );
+
+    GLint linked = GL_FALSE;
+    glGetProgramiv( program, GL_LINK_STATUS, &linked );
+
+    if ( linked != GL_TRUE )
+    {
+        console() << "GpuMesh: cannot link the compact vertex shader, using floats" << endl;
+        mCompactShader.reset();
+        return false;
+    }
+
+    mPositionAttrib     = mCompactShader->getAttribLocation( "position" );
+    mNormalAttrib       = mCompactShader->getAttribLocation( "normal" );
+    mTexCoordAttrib     = mCompactShader->getAttribLocation( "texCoord" );
+    mDisplacementAttrib = mCompactShader->getAttribLocation( "displacement" );
+
+    // 4 byte aligned attributes: xyz and a padding short, then 2 shorts of normal and 2 halves of texcoords
+    mPackedNormalOffset     = 4 * sizeof(int16_t);
+    mPackedTexCoordOffset   = mPackedNormalOffset + ( mData->hasNormals() ? 2 * sizeof(int16_t) : 0 );
+    mPackedStride           = mPackedTexCoordOffset + ( mData->hasTexCoords() ? 2 * sizeof(uint16_t) : 0 );
+
+    size_t numVertices  = mData->getNumVertices();
+    size_t vertexSize   = mData->getVertexSize();
+
+    // the box maps to [-32767, 32767] on each axis, a flat axis packs to 0
+    AxisAlignedBox3f    bounds  = mData->calcBoundingBox();
+    Vec3f               halfExtent( ( bounds.getMax() - bounds.getMin() ) * 0.5f );
+    Vec3f               invHalfExtent( halfExtent.x > 0.0f ? 1.0f / halfExtent.x : 0.0f,
+                                       halfExtent.y > 0.0f ? 1.0f / halfExtent.y : 0.0f,
+                                       halfExtent.z > 0.0f ? 1.0f / halfExtent.z : 0.0f );
+    mPositionOffset = bounds.getCenter();
+    mPositionScale  = halfExtent / 32767.0f;
+
+    mPackedVertices.assign( numVertices * mPackedStride, 0 );
+
+    for( size_t k=0; k < numVertices; k++ )
+    {
+        const float *src    = mData->getVertices() + k * vertexSize;
+        uint8_t     *dest   = &mPackedVertices[k * mPackedStride];
+
+        int16_t position[4] = { VertexPacking::packSnorm16( ( src[0] - mPositionOffset.x ) * invHalfExtent.x ),
+                                VertexPacking::packSnorm16( ( src[1] - mPositionOffset.y ) * invHalfExtent.y ),
+                                VertexPacking::packSnorm16( ( src[2] - mPositionOffset.z ) * invHalfExtent.z ), 0 };
+        memcpy( dest, position, sizeof(position) );
+
+        if ( mData->hasNormals() )
+        {
+            const float *n = src + mData->getNormalOffset();
+            int16_t     normal[2];
+            VertexPacking::packOctahedral( Vec3f( n[0], n[1], n[2] ), normal );
+            memcpy( dest + mPackedNormalOffset, normal, sizeof(normal) );
+        }
+
+        if ( mData->hasTexCoords() )
+        {
+            const float *t = src + mData->getTexCoordOffset();
+            uint16_t    texCoord[2] = { VertexPacking::packHalf( t[0] ), VertexPacking::packHalf( t[1] ) };
+            memcpy( dest + mPackedTexCoordOffset, texCoord, sizeof(texCoord) );
+        }
+    }
+
+    mVertexSource   = mPackedVertices.data();
+    mVertexBytes    = mPackedVertices.size();
+
+    // 16 bit indices whenever they fit
+    if ( numVertices <= 65536 )
+    {
+        mPackedIndices.resize( mData->getNumIndices() * sizeof(uint16_t) );
+        uint16_t *dest = (uint16_t*)mPackedIndices.data();
+
+        for( size_t k=0; k < mData->getNumIndices(); k++ )
+            dest[k] = (uint16_t)mData->getIndices()[k];
+
+        mIndexType      = GL_UNSIGNED_SHORT;
+        mIndexSource    = mPackedIndices.data();
+        mIndexBytes     = mPackedIndices.size();
+    }
+
+    return true;
+}
+
+
+void GpuMesh::initDynamic()
+{
+    mDynamicVbo = gl::Vbo( GL_ARRAY_BUFFER );
+    mDynamicVbo.bind();
+    mDynamicVbo.bufferData( getDynamicSize(), NULL, GL_DYNAMIC_DRAW );
+    mDynamicVbo.unbind();
+
+    // starts out at rest, for float meshes the interleaved copy of the positions is never drawn
+    if ( mCompact )
+    {
+        float *dest = mapDisplacements();
+        if ( dest )
+            fill( dest, dest + getNumVertices(), 0.0f );
+        unmapDisplacements();
+        return;
+    }
+
+    float *dest = (float*)mapPositions();
+    if ( dest )
+    {
+        for( size_t k=0; k < mData->getNumVertices(); k++ )
+        {
+            Vec3f p = mData->getPosition( k );
+            *dest++ = p.x;
+            *dest++ = p.y;
+            *dest++ = p.z;
+        }
+    }
+    unmapPositions();
+}
+
+
+size_t GpuMesh::getDynamicSize() const
+{
+    if ( !mDynamicPositions )
+        return 0;
+
+    return getNumVertices() * ( mCompact ? sizeof(float) : getPositionStride() );
+}
+
+
+uint8_t* GpuMesh::mapDynamic()
+{
+    if ( !mDynamicPositions || mData->getNumVertices() == 0 )
+        return nullptr;
+
+    mDynamicVbo.bind();
+    return mDynamicVbo.map( GL_WRITE_ONLY );
+}
+
+
+void GpuMesh::unmapDynamic()
+{
+    if ( !mDynamicPositions || mData->getNumVertices() == 0 )
+        return;
+
+    mDynamicVbo.unmap();
+    mDynamicVbo.unbind();
+}
+
+
+uint8_t* GpuMesh::mapPositions()
+{
+    return mCompact ? nullptr : mapDynamic();
+}
+
+
+void GpuMesh::unmapPositions()
+{
+    if ( !mCompact )
+        unmapDynamic();
+}
+
+
+float* GpuMesh::mapDisplacements()
+{
+    return mCompact ? (float*)mapDynamic() : nullptr;
+}
+
+
+void GpuMesh::unmapDisplacements()
+{
+    if ( mCompact )
+        unmapDynamic();
+}
+
+
+bool GpuMesh::uploadChunk( size_t maxBytes )
+{
+    // vertices first, then indices
+    if ( mUploaded < mVertexBytes && maxBytes > 0 )
+    {
+        size_t size = min( maxBytes, mVertexBytes - mUploaded );
+
+        mVertexVbo.bind();
+        mVertexVbo.bufferSubData( mUploaded, size, mVertexSource + mUploaded );
+        mVertexVbo.unbind();
+
+        mUploaded   += size;
+        maxBytes    -= size;
+    }
+
+    if ( mUploaded >= mVertexBytes && mUploaded < getSize() && maxBytes > 0 )
+    {
+        size_t offset   = mUploaded - mVertexBytes;
+        size_t size     = min( maxBytes, mIndexBytes - offset );
+
+        mIndexVbo.bind();
+        mIndexVbo.bufferSubData( offset, size, mIndexSource + offset );
+        mIndexVbo.unbind();
+
+        mUploaded += size;
+    }
+
+    // the packed copies are only needed until they are on the GPU
+    if ( isUploaded() && mCompact && !mPackedVertices.empty() )
+    {
+        vector<uint8_t>().swap( mPackedVertices );
+        vector<uint8_t>().swap( mPackedIndices );
+        mVertexSource   = nullptr;
+        mIndexSource    = nullptr;
+    }
+
+    return isUploaded();
+}
+
+
+void GpuMesh::draw() const
+{
+    if ( !isUploaded() || mData->getNumIndices() == 0 )
+        return;
+
+    if ( mCompact )
+        drawCompact();
+    else
+        drawFloat();
+}
+
+
+void GpuMesh::drawFloat() const
+{
+    GLsizei stride = (GLsizei)( mData->getVertexSize() * sizeof(float) );
+
+    if ( mDynamicPositions )
+    {
+        mDynamicVbo.bind();
+        glEnableClientState( GL_VERTEX_ARRAY );
+        glVertexPointer( 3, GL_FLOAT, (GLsizei)getPositionStride(), (const GLvoid*)0 );
+    }
+
+    mVertexVbo.bind();
+
+    if ( !mDynamicPositions )
+    {
+        glEnableClientState( GL_VERTEX_ARRAY );
+        glVertexPointer( 3, GL_FLOAT, stride, (const GLvoid*)0 );
+    }
+
+    if ( mData->hasNormals() )
+    {
+        glEnableClientState( GL_NORMAL_ARRAY );
+        glNormalPointer( GL_FLOAT, stride, (const GLvoid*)( mData->getNormalOffset() * sizeof(float) ) );
+    }
+
+    if ( mData->hasTexCoords() )
+    {
+        glEnableClientState( GL_TEXTURE_COORD_ARRAY );
+        glTexCoordPointer( 2, GL_FLOAT, stride, (const GLvoid*)( mData->getTexCoordOffset() * sizeof(float) ) );
+    }
+
+    mIndexVbo.bind();
+    glDrawElements( GL_TRIANGLES, (GLsizei)mData->getNumIndices(), GL_UNSIGNED_INT, (const GLvoid*)0 );
+    mIndexVbo.unbind();
+
+    glDisableClientState( GL_TEXTURE_COORD_ARRAY );
+    glDisableClientState( GL_NORMAL_ARRAY );
+    glDisableClientState( GL_VERTEX_ARRAY );
+
+    mVertexVbo.unbind();
+}
+
+
+void GpuMesh::drawCompact() const
+{
+    mCompactShader->bind();
+    mCompactShader->uniform( "positionScale", mPositionScale );
+    mCompactShader->uniform( "positionOffset", mPositionOffset );
+    mCompactShader->uniform( "lighting", glIsEnabled( GL_LIGHTING ) ? 1.0f : 0.0f );
+
+    GLsizei stride = (GLsizei)mPackedStride;
+
+    // attributes that are missing or not streamed read their current value
+    if ( mDisplacementAttrib >= 0 )
+    {
+        if ( mDynamicPositions )
+        {
+            mDynamicVbo.bind();
+            glEnableVertexAttribArray( mDisplacementAttrib );
+            glVertexAttribPointer( mDisplacementAttrib, 1, GL_FLOAT, GL_FALSE, sizeof(float), (const GLvoid*)0 );
+        }
+        else
+        {
+            glVertexAttrib1f( mDisplacementAttrib, 0.0f );
+        }
+    }
+
+    mVertexVbo.bind();
+
+    if ( mPositionAttrib >= 0 )
+    {
+        glEnableVertexAttribArray( mPositionAttrib );
+        glVertexAttribPointer( mPositionAttrib, 3, GL_SHORT, GL_FALSE, stride, (const GLvoid*)0 );
+    }
+
+    if ( mNormalAttrib >= 0 )
+    {
+        if ( mData->hasNormals() )
+        {
+            glEnableVertexAttribArray( mNormalAttrib );
+            glVertexAttribPointer( mNormalAttrib, 2, GL_SHORT, GL_FALSE, stride, (const GLvoid*)mPackedNormalOffset );
+        }
+        else
+        {
+            glVertexAttrib2f( mNormalAttrib, 0.0f, 0.0f );    // +z
+        }
+    }
+
+    if ( mTexCoordAttrib >= 0 )
+    {
+        if ( mData->hasTexCoords() )
+        {
+            glEnableVertexAttribArray( mTexCoordAttrib );
+            glVertexAttribPointer( mTexCoordAttrib, 2, GL_HALF_FLOAT, GL_FALSE, stride, (const GLvoid*)mPackedTexCoordOffset );
+        }
+        else
+        {
+            glVertexAttrib2f( mTexCoordAttrib, 0.0f, 0.0f );
+        }
+    }
+
+    mIndexVbo.bind();
+    glDrawElements( GL_TRIANGLES, (GLsizei)mData->getNumIndices(), mIndexType, (const GLvoid*)0 );
+    mIndexVbo.unbind();
+
+    GLint attribs[4] = { mPositionAttrib, mNormalAttrib, mTexCoordAttrib, mDisplacementAttrib };
+    for( int k=0; k < 4; k++ )
+        if ( attribs[k] >= 0 )
+            glDisableVertexAttribArray( attribs[k] );
+
+    mVertexVbo.unbind();
+    mCompactShader->unbind();
+}
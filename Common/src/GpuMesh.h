@@ -0,0 +1,113 @@
+#pragma once
+
+#include "cinder/gl/gl.h"
+#include "cinder/gl/Vbo.h"
+#include "cinder/gl/GlslProg.h"
+
+#include "MeshData.h"
+
+
+typedef std::shared_ptr<class GpuMesh>      GpuMeshRef;
+
+//! MeshData in a static interleaved vertex buffer and an index buffer.
+//! The buffers are allocated up front and can be filled a chunk at a time, spreading a large upload over several frames.
+//! With dynamic positions the positions are drawn from a separate, tightly packed buffer that can be mapped and rewritten every frame.
+//!
+//! The compact layout halves the vertex size: 16 bit positions scaled by the bounding box, octahedral normals in two 16 bit values
+//! and half float texcoords, with 16 bit indices when the mesh is small enough. It is decoded by a built-in shader that
+//! draws in gl_Color, lit by a headlight when GL_LIGHTING is enabled. Compact dynamic meshes keep the static positions and
+//! only stream one float per vertex, a displacement along the direction from the origin.
+class GpuMesh {
+
+public:
+
+    struct Format {
+        Format() : mDynamicPositions( false ), mCompact( false ) {}
+
+        //! Positions rewritten every frame, see mapPositions() and mapDisplacements().
+        Format& dynamicPositions( bool dynamic = true )     { mDynamicPositions = dynamic; return *this; }
+        //! Quantised vertices, falls back to floats if the decoding shader doesn't compile.
+        Format& compact( bool compact = true )              { mCompact = compact; return *this; }
+
+        bool    mDynamicPositions;
+        bool    mCompact;
+    };
+
+    //! Allocates the buffers, nothing is uploaded until uploadChunk() or uploadAll().
+    static GpuMeshRef   create( const MeshDataRef &data, const Format &format = Format() )  { return GpuMeshRef( new GpuMesh( data, format ) ); }
+
+    //! Uploads up to \a maxBytes of what is left, returns true once the whole mesh is on the GPU.
+    bool                uploadChunk( size_t maxBytes );
+    void                uploadAll()                         { uploadChunk( getSize() ); }
+
+    bool                isUploaded() const                  { return mUploaded == getSize(); }
+    size_t              getUploadedSize() const             { return mUploaded; }
+    //! Bytes of vertices and indices.
+    size_t              getSize() const                     { return mVertexBytes + mIndexBytes; }
+    //! Bytes rewritten by a frame of dynamic positions or displacements.
+    size_t              getDynamicSize() const;
+
+    const MeshDataRef&  getData() const                     { return mData; }
+    size_t              getNumVertices() const              { return mData->getNumVertices(); }
+    size_t              getNumIndices() const               { return mData->getNumIndices(); }
+
+    bool                isCompact() const                   { return mCompact; }
+    bool                hasDynamicPositions() const         { return mDynamicPositions; }
+
+    //! Maps the dynamic positions for writing, xyz floats getPositionStride() bytes apart. Must be followed by unmapPositions().
+    //! Null for compact meshes, which take displacements instead.
+    uint8_t*            mapPositions();
+    void                unmapPositions();
+    size_t              getPositionStride() const           { return 3 * sizeof(float); }
+
+    //! Maps the displacements of a compact dynamic mesh for writing, one float per vertex, the distance each vertex moves
+    //! along its normalised rest position. Null for float meshes. Must be followed by unmapDisplacements().
+    float*              mapDisplacements();
+    void                unmapDisplacements();
+
+    //! Draws the triangles with the fixed function arrays: gl_Vertex, gl_Normal and gl_MultiTexCoord0.
+    //! Compact meshes are drawn with the decoding shader, which replaces the bound program.
+    void                draw() const;
+
+private:
+
+    GpuMesh( const MeshDataRef &data, const Format &format );
+
+    //! Fills the quantised vertices and indices, returns false if the shader isn't available.
+    bool                initCompact();
+    void                initDynamic();
+
+    uint8_t*            mapDynamic();
+    void                unmapDynamic();
+
+    void                drawFloat() const;
+    void                drawCompact() const;
+
+    MeshDataRef         mData;
+    ci::gl::Vbo         mVertexVbo;
+    ci::gl::Vbo         mIndexVbo;
+    ci::gl::Vbo         mDynamicVbo;            // positions, or displacements when compact
+    bool                mDynamicPositions;
+    bool                mCompact;
+
+    const uint8_t       *mVertexSource;         // MeshData or the packed arrays below, until uploaded
+    const uint8_t       *mIndexSource;
+    size_t              mVertexBytes;
+    size_t              mIndexBytes;
+    size_t              mUploaded;
+
+    std::vector<uint8_t>    mPackedVertices;
+    std::vector<uint8_t>    mPackedIndices;
+    size_t              mPackedStride;
+    size_t              mPackedNormalOffset;
+    size_t              mPackedTexCoordOffset;
+    GLenum              mIndexType;
+    ci::Vec3f           mPositionScale;         // decoded position = offset + scale * packed / 32767
+    ci::Vec3f           mPositionOffset;
+
+    ci::gl::GlslProgRef mCompactShader;
+    GLint               mPositionAttrib;
+    GLint               mNormalAttrib;
+    GLint               mTexCoordAttrib;
+    GLint               mDisplacementAttrib;
+};
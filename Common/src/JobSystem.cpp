@@ -0,0 +1,171 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+using namespace std;
+
+
+size_t JobSystem::getDefaultNumWorkers()
+{
+    unsigned int cores = thread::hardware_concurrency();
+    return cores > 1 ? cores - 1 : 0;
+}
+
+
+JobSystem::JobSystem( size_t numWorkers )
+: mRunning( true ), mNumQueued( 0 )
+{
+    for( size_t k=0; k < numWorkers + 1; k++ )
+        mQueues.push_back( shared_ptr<Queue>( new Queue() ) );
+
+    for( size_t k=0; k < numWorkers; k++ )
+    {
+        mThreads.push_back( shared_ptr<thread>( new thread( bind( &JobSystem::workerLoop, this, k ) ) ) );
+        mThreadIds.push_back( mThreads.back()->get_id() );
+    }
+}
+
+
+JobSystem::~JobSystem()
+{
+    {
+        lock_guard<mutex> lock( mWakeMutex );
+        mRunning = false;
+    }
+    mWakeCond.notify_all();
+
+    for( size_t k=0; k < mThreads.size(); k++ )
+        mThreads[k]->join();
+}
+
+
+size_t JobSystem::getQueueIndex() const
+{
+    thread::id id = this_thread::get_id();
+
+    for( size_t k=0; k < mThreadIds.size(); k++ )
+        if ( mThreadIds[k] == id )
+            return k;
+
+    return mThreads.size();
+}
+
+
+void JobSystem::run( Group *group, const Job &job )
+{
+    group->mPending++;
+
+    Queue &queue = *mQueues[ getQueueIndex() ];
+    {
+        lock_guard<mutex> lock( queue.mMutex );
+        queue.mTasks.push_back( Task( job, group ) );
+    }
+
+    {
+        lock_guard<mutex> lock( mWakeMutex );
+        mNumQueued++;
+    }
+    mWakeCond.notify_one();
+}
+
+
+bool JobSystem::popOrSteal( size_t queueIndex, Task *task )
+{
+    // own jobs first, newest first while they are still in cache
+    {
+        Queue &queue = *mQueues[queueIndex];
+        lock_guard<mutex> lock( queue.mMutex );
+
+        if ( !queue.mTasks.empty() )
+        {
+            *task = queue.mTasks.back();
+            queue.mTasks.pop_back();
+            mNumQueued--;
+            return true;
+        }
+    }
+
+    // then steal the oldest job of the others
+    for( size_t k=1; k < mQueues.size(); k++ )
+    {
+        Queue &queue = *mQueues[ ( queueIndex + k ) % mQueues.size() ];
+        lock_guard<mutex> lock( queue.mMutex );
+
+        if ( !queue.mTasks.empty() )
+        {
+            *task = queue.mTasks.front();
+            queue.mTasks.pop_front();
+            mNumQueued--;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+void JobSystem::execute( Task &task )
+{
+    task.mJob();
+    task.mGroup->mPending--;
+}
+
+
+void JobSystem::wait( Group *group )
+{
+    size_t  queueIndex = getQueueIndex();
+    Task    task;
+
+    while( !group->isDone() )
+    {
+        if ( popOrSteal( queueIndex, &task ) )
+            execute( task );
+        else
+            this_thread::yield();
+    }
+}
+
+
+void JobSystem::parallelFor( size_t count, size_t grainSize, const RangeJob &job )
+{
+    size_t numChunks = getNumChunks( count, grainSize );
+
+    if ( numChunks == 0 )
+        return;
+
+    if ( numChunks == 1 )
+    {
+        job( 0, 0, count );
+        return;
+    }
+
+    Group group;
+
+    for( size_t k=0; k < numChunks; k++ )
+    {
+        size_t begin    = k * grainSize;
+        size_t end      = min( begin + grainSize, count );
+
+        run( &group, [&job, k, begin, end]() { job( k, begin, end ); } );
+    }
+
+    wait( &group );
+}
+
+
+void JobSystem::workerLoop( size_t queueIndex )
+{
+    Task task;
+
+    while( mRunning )
+    {
+        if ( popOrSteal( queueIndex, &task ) )
+        {
+            execute( task );
+            continue;
+        }
+
+        unique_lock<mutex> lock( mWakeMutex );
+        mWakeCond.wait( lock, [this]() { return mNumQueued > 0 || !mRunning; } );
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+
+typedef std::shared_ptr<class JobSystem>    JobSystemRef;
+
+//! Small work-stealing job system: every worker owns a deque, pops its own jobs from the back
+//! and steals from the front of the others when it runs dry. Threads waiting on a group run jobs too.
+//! parallelFor() splits a range into chunks that only depend on the range and the grain size, never on the
+//! number of threads, so writing per chunk outputs and merging them in chunk order gives the same result on any machine.
+class JobSystem {
+
+public:
+
+    typedef std::function<void()>                                           Job;
+    typedef std::function<void( size_t chunk, size_t begin, size_t end )>   RangeJob;
+
+    //! Jobs that can be waited on together.
+    class Group {
+    public:
+        Group() : mPending( 0 ) {}
+        bool isDone() const { return mPending == 0; }
+    private:
+        friend class JobSystem;
+        std::atomic<int> mPending;
+    };
+
+    //! \a numWorkers threads on top of the ones calling wait(), by default one less than the number of cores.
+    static JobSystemRef create( size_t numWorkers = getDefaultNumWorkers() ) { return JobSystemRef( new JobSystem( numWorkers ) ); }
+
+    static size_t getDefaultNumWorkers();
+
+    ~JobSystem();
+
+    void            run( Group *group, const Job &job );
+    //! Runs queued jobs until all the jobs in \a group are done.
+    void            wait( Group *group );
+
+    //! Calls \a job for each chunk of [0, count) and waits for all of them.
+    void            parallelFor( size_t count, size_t grainSize, const RangeJob &job );
+
+    static size_t   getNumChunks( size_t count, size_t grainSize )  { return grainSize > 0 ? ( count + grainSize - 1 ) / grainSize : 0; }
+
+    size_t          getNumWorkers() const                           { return mThreads.size(); }
+
+private:
+
+    JobSystem( size_t numWorkers );
+
+    struct Task {
+        Task() : mGroup( nullptr ) {}
+        Task( const Job &job, Group *group ) : mJob( job ), mGroup( group ) {}
+
+        Job     mJob;
+        Group   *mGroup;
+    };
+
+    struct Queue {
+        std::mutex          mMutex;
+        std::deque<Task>    mTasks;
+    };
+
+    //! Worker index of the calling thread, or the shared queue for every other thread.
+    size_t          getQueueIndex() const;
+    bool            popOrSteal( size_t queueIndex, Task *task );
+    void            execute( Task &task );
+    void            workerLoop( size_t queueIndex );
+
+    std::vector<std::shared_ptr<Queue> >        mQueues;        // one per worker, then the shared one
+    std::vector<std::shared_ptr<std::thread> >  mThreads;
+    std::vector<std::thread::id>                mThreadIds;
+
+    std::atomic<bool>           mRunning;
+    std::atomic<int>            mNumQueued;
+    std::mutex                  mWakeMutex;
+    std::condition_variable     mWakeCond;
+};
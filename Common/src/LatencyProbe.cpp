@@ -0,0 +1,296 @@
+#include "LatencyProbe.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+using namespace ci;
+using namespace std;
+
+
+namespace {
+
+    // samples of the injected burst, about 1.5 ms of white noise so every band sees it
+    const size_t    BURST_SIZE      = 64;
+    const float     BURST_LEVEL     = 0.9f;
+
+    // impulses between two updates of the params panel, about 2 seconds at the default interval
+    const size_t    REFRESH_IMPULSES    = 4;
+
+    // nearest rank on sorted values
+    float percentile( const vector<float> &sorted, size_t p )
+    {
+        return sorted[ ( sorted.size() * p + 99 ) / 100 - 1 ];
+    }
+
+    // nearest rank, reorders \a values
+    float selectPercentile( vector<float> &values, size_t p )
+    {
+        vector<float>::iterator it = values.begin() + ( values.size() * p + 99 ) / 100 - 1;
+        nth_element( values.begin(), it, values.end() );
+        return *it;
+    }
+
+}
+
+
+LatencyProbe::Format& LatencyProbe::Format::args( const vector<string> &args )
+{
+    for( size_t k=0; k < args.size(); k++ )
+    {
+        if ( args[k] == "--latency" && k + 1 < args.size() )
+        {
+            mInject     = mThreshold <= 0.0f;
+            mImpulses   = (size_t)atoi( args[++k].c_str() );
+        }
+
+        else if ( args[k] == "--latency-detect" && k + 1 < args.size() )
+            detect( (float)atof( args[++k].c_str() ) );
+
+        else if ( args[k] == "--latency-interval" && k + 1 < args.size() )
+            mInterval = (float)atof( args[++k].c_str() );
+
+        else if ( args[k] == "--latency-report" && k + 1 < args.size() )
+            mReportPath = args[++k];
+    }
+
+    return *this;
+}
+
+
+LatencyProbe::LatencyProbe( const Format &format )
+: mFormat( format ), mClock( true ), mEnabled( format.mInject || format.mThreshold > 0.0f ), mState( INPUT ), mPosition( 0 ),
+  mLastImpulse( -1.0e6 ), mBurst( 0 ), mNoise( 1 ), mLost( 0 ), mFinished( false ), mLostParam( 0 )
+{
+    if ( mFormat.mReportPath.empty() )
+        mFormat.mReportPath = getDocumentsDirectory() / "latency.txt";
+
+    for( size_t k=0; k < NUM_STAGES; k++ )
+        mTimes[k] = 0.0;
+
+    for( size_t k=0; k < NUM_STAGES - 1; k++ )
+    {
+        mLatencies[k].reserve( max<size_t>( mFormat.mImpulses, 1024 ) );
+        mStageText[k] = "-";
+    }
+
+    mSorted.reserve( mLatencies[0].capacity() );
+}
+
+
+const char* LatencyProbe::getStageName( Stage stage )
+{
+    static const char *names[NUM_STAGES] = { "Input", "Analysis", "Pickup", "Upload", "Draw", "Swap" };
+    return names[stage];
+}
+
+
+void LatencyProbe::addBurst( float *samples, size_t count )
+{
+    size_t n = min( count, mBurst );
+
+    for( size_t k=0; k < n; k++ )
+    {
+        mNoise      = mNoise * 1664525u + 1013904223u;
+        samples[k] += BURST_LEVEL * ( ( mNoise >> 8 ) / 8388608.0f - 1.0f );
+    }
+
+    mBurst -= n;
+}
+
+
+void LatencyProbe::processInput( float *samples, size_t count, uint64_t sampleCount )
+{
+    // the rest of a burst that didn't fit in the previous callback
+    if ( mBurst > 0 )
+        addBurst( samples, count );
+
+    uint64_t state = mState.load( memory_order_acquire );
+
+    if ( getStage( state ) != INPUT || !isEnabled() )
+        return;
+
+    double time = now();
+
+    if ( time - mLastImpulse < mFormat.mInterval )
+        return;
+
+    size_t at = 0;
+
+    if ( !mFormat.mInject )
+    {
+        while( at < count && fabs( samples[at] ) < mFormat.mThreshold )
+            at++;
+
+        if ( at == count )
+            return;
+    }
+
+    // the time is written before the release that hands the impulse to the next stage, see mTimes
+    mPosition.store( sampleCount + at, memory_order_relaxed );
+    mTimes[INPUT]   = time;
+    mLastImpulse    = time;
+
+    if ( mFormat.mInject )
+    {
+        mBurst = BURST_SIZE;
+        addBurst( samples + at, count - at );
+    }
+
+    mState.store( state + 1, memory_order_release );
+}
+
+
+void LatencyProbe::markAnalysed( uint64_t sampleCount )
+{
+    uint64_t state = mState.load( memory_order_acquire );
+
+    if ( getStage( state ) != ANALYSIS || sampleCount <= mPosition.load( memory_order_relaxed ) )
+        return;
+
+    // the impulse may have timed out meanwhile, the exchange fails then. The time is still written, but only this
+    // thread writes it and the next impulse reaches the main thread through this thread's own release
+    mTimes[ANALYSIS] = now();
+    mState.compare_exchange_strong( state, state + 1, memory_order_release );
+}
+
+
+void LatencyProbe::markPickedUp( uint64_t sampleCount )
+{
+    uint64_t state = mState.load( memory_order_acquire );
+
+    if ( getStage( state ) != PICKUP || sampleCount <= mPosition.load( memory_order_relaxed ) )
+        return;
+
+    mTimes[PICKUP] = now();
+    mState.compare_exchange_strong( state, state + 1, memory_order_release );
+}
+
+
+void LatencyProbe::mark( Stage stage )
+{
+    uint64_t    state   = mState.load( memory_order_acquire );
+    double      time    = now();
+
+    if ( getStage( state ) == stage )
+    {
+        mTimes[stage] = time;
+
+        if ( stage == SWAP )
+            complete( state );
+        else
+            mState.compare_exchange_strong( state, state + 1, memory_order_release );
+
+        return;
+    }
+
+    // the input time is published with the state, it can be read as soon as the impulse has left the input
+    if ( stage == SWAP && getStage( state ) != INPUT && time - mTimes[INPUT] > mFormat.mTimeout )
+    {
+        if ( mState.compare_exchange_strong( state, nextImpulse( state ), memory_order_release ) )
+        {
+            mLost++;
+            mLostParam = (int32_t)mLost;
+        }
+    }
+}
+
+
+void LatencyProbe::complete( uint64_t state )
+{
+    // the state was loaded with acquire at SWAP, every stage has written its time
+    for( size_t k=1; k < NUM_STAGES; k++ )
+        mLatencies[k - 1].push_back( (float)( ( mTimes[k] - mTimes[INPUT] ) * 1000.0 ) );
+
+    mState.store( nextImpulse( state ), memory_order_release );
+
+    bool finished = mFormat.mImpulses > 0 && getNumImpulses() == mFormat.mImpulses;
+
+    if ( getNumImpulses() % REFRESH_IMPULSES == 0 || getNumImpulses() == 1 || finished )
+        updateStats();
+
+    if ( finished )
+    {
+        writeReport();
+        mFinished = true;
+    }
+}
+
+
+void LatencyProbe::updateStats()
+{
+    char text[64];
+
+    // partial sorts of a reused buffer, the panel only shows the median and the tail
+    for( size_t k=1; k < NUM_STAGES; k++ )
+    {
+        mSorted.assign( mLatencies[k - 1].begin(), mLatencies[k - 1].end() );
+
+        float p50 = selectPercentile( mSorted, 50 );
+        float p99 = selectPercentile( mSorted, 99 );
+
+        snprintf( text, sizeof(text), "%.1f  %.1f", p50, p99 );
+        mStageText[k - 1] = text;
+    }
+}
+
+
+void LatencyProbe::addParams( const params::InterfaceGlRef &params, const string &group )
+{
+    string options = "group='" + group + "'";
+
+    params->addText( "p50  p99 ms from input", options );
+
+    for( size_t k=1; k < NUM_STAGES; k++ )
+        params->addParam( getStageName( (Stage)k ), &mStageText[k - 1], options, true );
+
+    params->addParam( "Lost impulses", &mLostParam, options, true );
+}
+
+
+string LatencyProbe::getReport() const
+{
+    ostringstream   report;
+    char            line[256];
+
+    report << "latency from the audio input, " << ( mFormat.mInject ? "injected impulses" : "detected transients" ) << endl;
+    report << endl;
+
+    snprintf( line, sizeof(line), "%-12s %u\n%-12s %u\n", "impulses", (unsigned)getNumImpulses(), "lost", (unsigned)mLost );
+    report << line;
+
+    snprintf( line, sizeof(line), "\n%-12s %8s %8s %8s %8s %8s   ms\n", "stage", "min", "p50", "p90", "p99", "max" );
+    report << line;
+
+    if ( getNumImpulses() == 0 )
+        return report.str();
+
+    vector<float> sorted;
+
+    for( size_t k=1; k < NUM_STAGES; k++ )
+    {
+        sorted = mLatencies[k - 1];
+        sort( sorted.begin(), sorted.end() );
+
+        snprintf( line, sizeof(line), "%-12s %8.2f %8.2f %8.2f %8.2f %8.2f\n", getStageName( (Stage)k ),
+                  sorted.front(), percentile( sorted, 50 ), percentile( sorted, 90 ), percentile( sorted, 99 ), sorted.back() );
+        report << line;
+    }
+
+    return report.str();
+}
+
+
+void LatencyProbe::writeReport() const
+{
+    string report = getReport();
+
+    cout << report;
+
+    ofstream file( mFormat.mReportPath.string().c_str(), ios::trunc );
+    file << report;
+}
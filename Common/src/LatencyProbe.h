@@ -0,0 +1,121 @@
+#pragma once
+
+#include "cinder/Timer.h"
+#include "cinder/Filesystem.h"
+#include "cinder/Utilities.h"
+#include "cinder/params/Params.h"
+
+#include <atomic>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+
+typedef std::shared_ptr<class LatencyProbe> LatencyProbeRef;
+
+//! Measures how long a transient takes from the audio input to the screen. An impulse is injected into the samples the
+//! audio callback writes to the ring, or a transient over a threshold is detected there, then timestamped at each stage:
+//! the window that contains it analysed, its results picked up by update(), the features uploaded, the frame drawn and swapped.
+//! The swap is timestamped when the next update() starts, after the vertical sync. The converter and driver latency before
+//! the callback and the display after the swap are out of reach, the times are from the callback that received the impulse.
+//! One impulse is in flight at a time, each stage hands it to the next through a single atomic, no thread ever waits.
+//! Only the ring sees the injected impulse, nothing is played.
+class LatencyProbe {
+
+public:
+
+    enum Stage { INPUT, ANALYSIS, PICKUP, UPLOAD, DRAW, SWAP, NUM_STAGES };
+
+    struct Format {
+        Format() : mInject( false ), mThreshold( 0.0f ), mInterval( 0.5f ), mTimeout( 2.0f ), mImpulses( 0 ) {}
+
+        //! Injects an impulse every interval.
+        Format& inject( bool inject = true )            { mInject = inject; return *this; }
+        //! Detects transients over \a threshold in the input instead of injecting, for a click played into the microphone.
+        Format& detect( float threshold )               { mThreshold = threshold; mInject = false; return *this; }
+        //! Seconds between two impulses, at least.
+        Format& interval( float seconds )               { mInterval = seconds; return *this; }
+        //! Seconds after which an impulse that didn't reach the screen is counted as lost.
+        Format& timeout( float seconds )                { mTimeout = seconds; return *this; }
+        //! Impulses measured before the report is written and isFinished() turns true, 0 measures until the app quits.
+        Format& impulses( size_t count )                { mImpulses = count; return *this; }
+        //! Report file, by default <Documents>/latency.txt.
+        Format& report( const ci::fs::path &path )      { mReportPath = path; return *this; }
+        //! Picks up "--latency <impulses>", "--latency-detect <threshold>", "--latency-interval <seconds>" and "--latency-report <path>".
+        Format& args( const std::vector<std::string> &args );
+
+        bool            mInject;
+        float           mThreshold;
+        float           mInterval;
+        float           mTimeout;
+        size_t          mImpulses;
+        ci::fs::path    mReportPath;
+    };
+
+    static LatencyProbeRef create( const Format &format = Format() )    { return LatencyProbeRef( new LatencyProbe( format ) ); }
+
+    //! Starts or stops sending impulses, or detecting them. An impulse in flight is still measured.
+    void                setEnabled( bool enabled )          { mEnabled.store( enabled, std::memory_order_relaxed ); }
+    bool                isEnabled() const                   { return mEnabled.load( std::memory_order_relaxed ); }
+
+    //! Audio side, called with the \a count samples about to be written to the ring at \a sampleCount.
+    //! Injects or detects an impulse in place when none is in flight.
+    void                processInput( float *samples, size_t count, uint64_t sampleCount );
+    //! Analysis side, the window ending at \a sampleCount (exclusive) has been analysed.
+    void                markAnalysed( uint64_t sampleCount );
+    //! Main thread, the results of the window ending at \a sampleCount are the current ones.
+    void                markPickedUp( uint64_t sampleCount );
+    //! Main thread, UPLOAD once the features are in the particles, vertices or textures, DRAW at the end of draw()
+    //! and SWAP first thing in update(). SWAP also times out the lost impulses.
+    void                mark( Stage stage );
+
+    //! Impulses that went all the way, and those that timed out.
+    size_t              getNumImpulses() const              { return mLatencies[0].size(); }
+    size_t              getNumLost() const                  { return mLost; }
+    //! Milliseconds from the input to \a stage, any stage after INPUT, one per impulse measured.
+    const std::vector<float>&   getLatencies( Stage stage ) const   { return mLatencies[ stage - 1 ]; }
+
+    //! Shows the p50 and p99 from the input to each stage, and the lost impulses.
+    void                addParams( const ci::params::InterfaceGlRef &params, const std::string &group = "Latency" );
+
+    //! True once the impulses asked for are measured and the report is written.
+    bool                isFinished() const                  { return mFinished; }
+    //! Min, percentiles and max from the input to each stage.
+    std::string         getReport() const;
+    void                writeReport() const;
+
+    static const char*  getStageName( Stage stage );
+
+private:
+
+    LatencyProbe( const Format &format );
+
+    // the stage expected next in the low byte, the impulse number above it
+    static uint32_t     getStage( uint64_t state )          { return (uint32_t)( state & 0xff ); }
+    static uint64_t     nextImpulse( uint64_t state )       { return ( ( state >> 8 ) + 1 ) << 8; }
+
+    double              now() const                         { return mClock.getSeconds(); }
+    void                addBurst( float *samples, size_t count );
+    void                complete( uint64_t state );
+    void                updateStats();
+
+    Format                      mFormat;
+    ci::Timer                   mClock;
+    std::atomic<bool>           mEnabled;
+    std::atomic<uint64_t>       mState;
+    std::atomic<uint64_t>       mPosition;                  // sample the impulse starts at
+    // mTimes[stage] is only written by the thread of that stage, after the acquire load that finds the impulse at the stage
+    // and before the release that hands it over. It is only read after an acquire load that finds the impulse past the stage.
+    double                      mTimes[NUM_STAGES];
+
+    double                      mLastImpulse;               // audio thread
+    size_t                      mBurst;
+    uint32_t                    mNoise;
+
+    std::vector<float>          mLatencies[NUM_STAGES - 1]; // main thread
+    std::vector<float>          mSorted;                    // reused by updateStats()
+    size_t                      mLost;
+    bool                        mFinished;
+    std::string                 mStageText[NUM_STAGES - 1];
+    int32_t                     mLostParam;
+};
@@ -0,0 +1,105 @@
+#include "MappedFile.h"
+
+#if defined( _WIN32 )
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+using namespace std;
+
+
+#if defined( _WIN32 )
+
+MappedFile::MappedFile( const string &path )
+: mPath( path ), mData( nullptr ), mSize( 0 ), mFileHandle( INVALID_HANDLE_VALUE ), mMappingHandle( nullptr )
+{
+    mFileHandle = ::CreateFileA( path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+    if ( mFileHandle == INVALID_HANDLE_VALUE )
+        throw MappedFileExc( "cannot open file: " + path );
+
+    LARGE_INTEGER size;
+    if ( !::GetFileSizeEx( mFileHandle, &size ) )
+    {
+        ::CloseHandle( mFileHandle );
+        throw MappedFileExc( "cannot get file size: " + path );
+    }
+
+    mSize = (size_t)size.QuadPart;
+
+    // an empty file can't be mapped
+    if ( mSize == 0 )
+        return;
+
+    mMappingHandle = ::CreateFileMappingA( mFileHandle, NULL, PAGE_READONLY, 0, 0, NULL );
+    if ( mMappingHandle )
+        mData = (const uint8_t*)::MapViewOfFile( mMappingHandle, FILE_MAP_READ, 0, 0, 0 );
+
+    if ( !mData )
+    {
+        if ( mMappingHandle )
+            ::CloseHandle( mMappingHandle );
+        ::CloseHandle( mFileHandle );
+        throw MappedFileExc( "cannot map file: " + path );
+    }
+}
+
+
+MappedFile::~MappedFile()
+{
+    if ( mData )
+        ::UnmapViewOfFile( mData );
+    if ( mMappingHandle )
+        ::CloseHandle( mMappingHandle );
+    if ( mFileHandle != INVALID_HANDLE_VALUE )
+        ::CloseHandle( mFileHandle );
+}
+
+#else
+
+MappedFile::MappedFile( const string &path )
+: mPath( path ), mData( nullptr ), mSize( 0 ), mFd( -1 )
+{
+    mFd = ::open( path.c_str(), O_RDONLY );
+    if ( mFd < 0 )
+        throw MappedFileExc( "cannot open file: " + path );
+
+    struct stat st;
+    if ( ::fstat( mFd, &st ) != 0 )
+    {
+        ::close( mFd );
+        throw MappedFileExc( "cannot get file size: " + path );
+    }
+
+    mSize = (size_t)st.st_size;
+
+    // an empty file can't be mapped
+    if ( mSize == 0 )
+        return;
+
+    void *data = ::mmap( NULL, mSize, PROT_READ, MAP_PRIVATE, mFd, 0 );
+    if ( data == MAP_FAILED )
+    {
+        ::close( mFd );
+        throw MappedFileExc( "cannot map file: " + path );
+    }
+
+    // the file is mostly read front to back
+    ::madvise( data, mSize, MADV_SEQUENTIAL );
+
+    mData = (const uint8_t*)data;
+}
+
+
+MappedFile::~MappedFile()
+{
+    if ( mData )
+        ::munmap( (void*)mData, mSize );
+    if ( mFd >= 0 )
+        ::close( mFd );
+}
+
+#endif
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <stdexcept>
+#include <cstdint>
+
+
+typedef std::shared_ptr<class MappedFile>   MappedFileRef;
+
+//! Read-only memory-mapped file.
+class MappedFile {
+
+public:
+
+    //! Throws MappedFileExc if the file can't be opened or mapped.
+    static MappedFileRef create( const std::string &path ) { return MappedFileRef( new MappedFile( path ) ); }
+
+    ~MappedFile();
+
+    const uint8_t*      getData() const     { return mData; }
+    size_t              getSize() const     { return mSize; }
+    const std::string&  getPath() const     { return mPath; }
+
+private:
+
+    MappedFile( const std::string &path );
+
+    std::string     mPath;
+    const uint8_t   *mData;
+    size_t          mSize;
+
+#if defined( _WIN32 )
+    void            *mFileHandle;
+    void            *mMappingHandle;
+#else
+    int             mFd;
+#endif
+};
+
+
+class MappedFileExc : public std::runtime_error {
+public:
+    MappedFileExc( const std::string &msg ) : std::runtime_error( msg ) {}
+};
@@ -0,0 +1,274 @@
+#include "MeshCache.h"
+
+#include "ObjParser.h"
+
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+#include <cstddef>
+
+using namespace ci;
+using namespace std;
+
+
+fs::path MeshCache::getCachePath( const fs::path &source )
+{
+    return fs::path( source.string() + ".mesh" );
+}
+
+
+uint64_t MeshCache::hashFile( const fs::path &path )
+{
+    MappedFileRef   file    = MappedFile::create( path.string() );
+    const uint8_t   *data   = file->getData();
+    uint64_t        hash    = 14695981039346656037ULL;
+
+    for( size_t k=0; k < file->getSize(); k++ )
+    {
+        hash ^= data[k];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+
+bool MeshCache::readHeader( const MappedFileRef &file, Header *header )
+{
+    if ( file->getSize() < sizeof(Header) )
+        return false;
+
+    memcpy( header, file->getData(), sizeof(Header) );
+
+    if ( memcmp( header->mMagic, "RWMC", 4 ) != 0 || header->mVersion != VERSION
+        || header->mVertexSize != MeshData::getVertexSize( header->mAttribs ) )
+        return false;
+
+    // the arrays must fit in the file, checked in a way that can't overflow
+    uint64_t available  = file->getSize() - sizeof(Header);
+    uint64_t maxCount   = available / sizeof(float);
+
+    if ( header->mNumVertices > maxCount / header->mVertexSize || header->mNumIndices > maxCount )
+        return false;
+
+    return header->mNumVertices * header->mVertexSize * sizeof(float) + header->mNumIndices * sizeof(uint32_t) <= available;
+}
+
+
+bool MeshCache::matchesSource( const Header &header, const fs::path &source, int64_t *newTime )
+{
+    *newTime = header.mSourceTime;
+
+    if ( !fs::exists( source ) )
+        return true;
+
+    if ( (uint64_t)fs::file_size( source ) != header.mSourceSize )
+        return false;
+
+    // the timestamp is the cheap check, the hash only runs when it changed
+    int64_t time = (int64_t)fs::last_write_time( source );
+    if ( time == header.mSourceTime )
+        return true;
+
+    if ( hashFile( source ) != header.mSourceHash )
+        return false;
+
+    *newTime = time;
+
+    return true;
+}
+
+
+void MeshCache::writeSourceTime( const fs::path &cache, int64_t time )
+{
+    // the file must not be mapped, Windows doesn't share a mapped file for writing. A cache that can't be updated
+    // is still valid, the hash runs again next time
+    fstream file( cache.string().c_str(), ios::binary | ios::in | ios::out );
+    file.seekp( offsetof( Header, mSourceTime ) );
+    file.write( (const char*)&time, sizeof(int64_t) );
+}
+
+
+MeshDataRef MeshCache::createView( const MappedFileRef &file, const Header &header )
+{
+    // the header is a multiple of 4 bytes, so are the arrays that follow it
+    const float     *vertices   = (const float*)( file->getData() + sizeof(Header) );
+    const uint32_t  *indices    = (const uint32_t*)( vertices + header.mNumVertices * header.mVertexSize );
+
+    return MeshData::create( header.mAttribs, vertices, (size_t)header.mNumVertices, indices, (size_t)header.mNumIndices, file );
+}
+
+
+bool MeshCache::isValid( const fs::path &source, const fs::path &cache, bool optimize )
+{
+    try {
+        if ( !fs::exists( cache ) )
+            return false;
+
+        Header  header;
+        int64_t sourceTime;
+
+        if ( !readHeader( MappedFile::create( cache.string() ), &header ) || !matchesOptimize( header, optimize ) || !matchesSource( header, source, &sourceTime ) )
+            return false;
+
+        // only the timestamp changed, the next checks skip the hash
+        if ( sourceTime != header.mSourceTime )
+            writeSourceTime( cache, sourceTime );
+
+        return true;
+    }
+    catch( const std::exception & ) {
+        return false;
+    }
+}
+
+
+MeshDataRef MeshCache::load( const fs::path &cache )
+{
+    MappedFileRef   file;
+    Header          header;
+
+    try {
+        file = MappedFile::create( cache.string() );
+    }
+    catch( const MappedFileExc &exc ) {
+        throw MeshCacheExc( exc.what() );
+    }
+
+    if ( !readHeader( file, &header ) )
+        throw MeshCacheExc( "invalid mesh cache: " + cache.string() );
+
+    return createView( file, header );
+}
+
+
+void MeshCache::write( const MeshData &data, const fs::path &source, const fs::path &cache, const MeshOptimizer::Stats *optimizeStats )
+{
+    Header header;
+    memset( &header, 0, sizeof(Header) );
+    memcpy( header.mMagic, "RWMC", 4 );
+
+    header.mVersion     = VERSION;
+    header.mAttribs     = data.getAttribs();
+    header.mVertexSize  = (uint32_t)data.getVertexSize();
+    header.mNumVertices = data.getNumVertices();
+    header.mNumIndices  = data.getNumIndices();
+    header.mSourceSize  = fs::file_size( source );
+    header.mSourceTime  = (int64_t)fs::last_write_time( source );
+    header.mSourceHash  = hashFile( source );
+
+    if ( optimizeStats )
+    {
+        header.mFlags           = OPTIMIZED;
+        header.mSourceVertices  = optimizeStats->mVerticesBefore;
+        header.mAcmrBefore      = optimizeStats->mAcmrBefore;
+        header.mAcmrAfter       = optimizeStats->mAcmrAfter;
+    }
+
+    fs::path tmp( cache.string() + ".tmp" );
+
+    {
+        ofstream out( tmp.string().c_str(), ios::binary | ios::trunc );
+        out.write( (const char*)&header, sizeof(Header) );
+        out.write( (const char*)data.getVertices(), data.getNumVertices() * data.getVertexSize() * sizeof(float) );
+        out.write( (const char*)data.getIndices(), data.getNumIndices() * sizeof(uint32_t) );
+
+        if ( !out )
+        {
+            out.close();
+            remove( tmp.string().c_str() );
+            throw MeshCacheExc( "cannot write mesh cache: " + cache.string() );
+        }
+    }
+
+    fs::rename( tmp, cache );
+}
+
+
+MeshDataRef MeshCache::parseObj( const fs::path &source, JobSystem *jobs )
+{
+    TriMesh mesh;
+    ObjParser::create( source, true, jobs )->load( &mesh );
+
+    return MeshData::create( mesh );
+}
+
+
+MeshDataRef MeshCache::build( const fs::path &source, const fs::path &cache, JobSystem *jobs, bool optimize, MeshOptimizer::Stats *stats )
+{
+    MeshDataRef             data = parseObj( source, jobs );
+    MeshOptimizer::Stats    optimizeStats;
+
+    if ( optimize )
+        data = MeshOptimizer::optimize( *data, &optimizeStats );
+
+    write( *data, source, cache, optimize ? &optimizeStats : nullptr );
+
+    if ( stats )
+        *stats = optimizeStats;
+
+    return data;
+}
+
+
+MeshDataRef MeshCache::loadObj( const fs::path &source, bool writeCache, JobSystem *jobs, bool optimize, MeshOptimizer::Stats *stats )
+{
+    fs::path cache = getCachePath( source );
+
+    // a cache that can't be read is treated as stale
+    try {
+        if ( fs::exists( cache ) )
+        {
+            MappedFileRef   file = MappedFile::create( cache.string() );
+            Header          header;
+            int64_t         sourceTime;
+
+            if ( readHeader( file, &header ) && matchesOptimize( header, optimize ) && matchesSource( header, source, &sourceTime ) )
+            {
+                // only the timestamp changed, the header gets the new one so the next launches skip the hash.
+                // The cache is mapped again once written
+                if ( sourceTime != header.mSourceTime )
+                {
+                    file.reset();
+                    writeSourceTime( cache, sourceTime );
+
+                    file = MappedFile::create( cache.string() );
+                    if ( !readHeader( file, &header ) )
+                        throw MeshCacheExc( "invalid mesh cache: " + cache.string() );
+                }
+
+                if ( stats )
+                {
+                    stats->mVerticesBefore  = optimize ? header.mSourceVertices : (uint32_t)header.mNumVertices;
+                    stats->mVerticesAfter   = (uint32_t)header.mNumVertices;
+                    stats->mAcmrBefore      = header.mAcmrBefore;
+                    stats->mAcmrAfter       = header.mAcmrAfter;
+                }
+
+                return createView( file, header );
+            }
+        }
+    }
+    catch( const std::exception & ) {
+    }
+
+    MeshDataRef             data = parseObj( source, jobs );
+    MeshOptimizer::Stats    optimizeStats;
+
+    if ( optimize )
+        data = MeshOptimizer::optimize( *data, &optimizeStats );
+
+    if ( stats )
+        *stats = optimizeStats;
+
+    if ( writeCache )
+    {
+        try {
+            write( *data, source, cache, optimize ? &optimizeStats : nullptr );
+        }
+        catch( const std::exception & ) {
+        }
+    }
+
+    return data;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "cinder/Filesystem.h"
+
+#include "MeshData.h"
+#include "MappedFile.h"
+#include "MeshOptimizer.h"
+
+#include <stdexcept>
+
+
+class JobSystem;
+
+
+//! Binary mesh cache: a 72 byte header followed by the interleaved vertices and the indices of a MeshData, ready for upload.
+//! Loading maps the file and returns a view into it, nothing is parsed or copied.
+//! The header keeps the size, timestamp and FNV-1a hash of the source file. A cache is stale when the size differs,
+//! or when the timestamp differs and the hash doesn't match, so a checkout that only touches the timestamps keeps it valid.
+//! Optimised meshes are cached with their MeshOptimizer stats, a cache is only valid for the optimisation it was built with.
+class MeshCache {
+
+public:
+
+    //! The cache of \a source lives next to it: "head-low.obj" is cached in "head-low.obj.mesh".
+    static ci::fs::path     getCachePath( const ci::fs::path &source );
+
+    //! True if \a cache exists, is well formed and matches \a source and \a optimize. A cache without its source is always valid.
+    static bool             isValid( const ci::fs::path &source, const ci::fs::path &cache, bool optimize = false );
+
+    //! Maps \a cache, throws MeshCacheExc if it's not a valid cache file. The staleness isn't checked.
+    static MeshDataRef      load( const ci::fs::path &cache );
+
+    //! Writes \a data as the cache of \a source, through a temporary file so a cache is never seen half written. Throws on failure.
+    //! \a optimizeStats marks \a data as the output of MeshOptimizer.
+    static void             write( const MeshData &data, const ci::fs::path &source, const ci::fs::path &cache, const MeshOptimizer::Stats *optimizeStats = nullptr );
+
+    //! Parses \a source with ObjParser, on \a jobs if given, optionally runs MeshOptimizer and writes the cache. Throws on failure.
+    static MeshDataRef      build( const ci::fs::path &source, const ci::fs::path &cache, JobSystem *jobs = nullptr, bool optimize = false, MeshOptimizer::Stats *stats = nullptr );
+
+    //! Loads the cache of \a source if it's valid, otherwise parses the OBJ and, with \a writeCache, tries to write the cache.
+    //! Only throws if the OBJ can't be loaded, a cache that can't be written is simply not used.
+    //! With \a optimize the mesh goes through MeshOptimizer, \a stats gets its results, from the cache header if loaded from the cache.
+    static MeshDataRef      loadObj( const ci::fs::path &source, bool writeCache = true, JobSystem *jobs = nullptr, bool optimize = false, MeshOptimizer::Stats *stats = nullptr );
+
+    //! 64 bit FNV-1a of the whole file.
+    static uint64_t         hashFile( const ci::fs::path &path );
+
+    static const uint32_t   VERSION = 2;
+
+private:
+
+    struct Header {
+        char        mMagic[4];          // "RWMC"
+        uint32_t    mVersion;
+        uint32_t    mAttribs;
+        uint32_t    mVertexSize;        // floats per vertex
+        uint64_t    mNumVertices;
+        uint64_t    mNumIndices;
+        uint64_t    mSourceSize;
+        int64_t     mSourceTime;
+        uint64_t    mSourceHash;
+        uint32_t    mFlags;             // OPTIMIZED
+        uint32_t    mSourceVertices;    // before optimising
+        float       mAcmrBefore;
+        float       mAcmrAfter;
+    };
+
+    enum HeaderFlags { OPTIMIZED = 1 };
+
+    static bool             readHeader( const MappedFileRef &file, Header *header );
+    //! \a newTime gets the timestamp of \a source if only the timestamp changed, the one of the header otherwise.
+    static bool             matchesSource( const Header &header, const ci::fs::path &source, int64_t *newTime );
+    static void             writeSourceTime( const ci::fs::path &cache, int64_t time );
+    static bool             matchesOptimize( const Header &header, bool optimize )    { return ( ( header.mFlags & OPTIMIZED ) != 0 ) == optimize; }
+    static MeshDataRef      parseObj( const ci::fs::path &source, JobSystem *jobs );
+    static MeshDataRef      createView( const MappedFileRef &file, const Header &header );
+};
+
+
+class MeshCacheExc : public std::runtime_error {
+public:
+    MeshCacheExc( const std::string &msg ) : std::runtime_error( msg ) {}
+};
@@ -0,0 +1,115 @@
+#include "MeshData.h"
+
+#include <algorithm>
+
+using namespace ci;
+using namespace std;
+
+
+MeshData::MeshData( uint32_t attribs, size_t numVertices, size_t numIndices )
+: mAttribs( attribs ), mNumVertices( numVertices ), mNumIndices( numIndices )
+{
+    mVertexStorage.resize( numVertices * getVertexSize() );
+    mIndexStorage.resize( numIndices );
+
+    mVertices   = mVertexStorage.data();
+    mIndices    = mIndexStorage.data();
+}
+
+
+MeshData::MeshData( uint32_t attribs, const float *vertices, size_t numVertices, const uint32_t *indices, size_t numIndices, const shared_ptr<void> &owner )
+: mAttribs( attribs ), mNumVertices( numVertices ), mNumIndices( numIndices ), mVertices( vertices ), mIndices( indices ), mOwner( owner )
+{
+}
+
+
+MeshDataRef MeshData::create( uint32_t attribs, const float *vertices, size_t numVertices, const uint32_t *indices, size_t numIndices, const shared_ptr<void> &owner )
+{
+    return MeshDataRef( new MeshData( attribs, vertices, numVertices, indices, numIndices, owner ) );
+}
+
+
+MeshDataRef MeshData::create( const TriMesh &mesh )
+{
+    size_t      numVertices = mesh.getNumVertices();
+    uint32_t    attribs     = 0;
+
+    if ( numVertices > 0 && mesh.getNormals().size() == numVertices )
+        attribs |= NORMAL;
+    if ( numVertices > 0 && mesh.getTexCoords().size() == numVertices )
+        attribs |= TEXCOORD;
+
+    MeshDataRef data    = MeshDataRef( new MeshData( attribs, numVertices, mesh.getNumIndices() ) );
+    float       *dest   = data->getVertexStorage();
+
+    const vector<Vec3f> &positions  = mesh.getVertices();
+    const vector<Vec3f> &normals    = mesh.getNormals();
+    const vector<Vec2f> &texCoords  = mesh.getTexCoords();
+
+    for( size_t k=0; k < numVertices; k++ )
+    {
+        *dest++ = positions[k].x;
+        *dest++ = positions[k].y;
+        *dest++ = positions[k].z;
+
+        if ( attribs & NORMAL )
+        {
+            *dest++ = normals[k].x;
+            *dest++ = normals[k].y;
+            *dest++ = normals[k].z;
+        }
+
+        if ( attribs & TEXCOORD )
+        {
+            *dest++ = texCoords[k].x;
+            *dest++ = texCoords[k].y;
+        }
+    }
+
+    copy( mesh.getIndices().begin(), mesh.getIndices().end(), data->getIndexStorage() );
+
+    return data;
+}
+
+
+AxisAlignedBox3f MeshData::calcBoundingBox() const
+{
+    if ( mNumVertices == 0 )
+        return AxisAlignedBox3f( Vec3f::zero(), Vec3f::zero() );
+
+    Vec3f minP = getPosition( 0 );
+    Vec3f maxP = minP;
+
+    for( size_t k=1; k < mNumVertices; k++ )
+    {
+        Vec3f p = getPosition( k );
+        minP.x = min( minP.x, p.x );    maxP.x = max( maxP.x, p.x );
+        minP.y = min( minP.y, p.y );    maxP.y = max( maxP.y, p.y );
+        minP.z = min( minP.z, p.z );    maxP.z = max( maxP.z, p.z );
+    }
+
+    return AxisAlignedBox3f( minP, maxP );
+}
+
+
+void MeshData::toTriMesh( TriMesh *mesh ) const
+{
+    mesh->clear();
+
+    size_t          size    = getVertexSize();
+    const float     *v      = mVertices;
+
+    for( size_t k=0; k < mNumVertices; k++, v += size )
+    {
+        mesh->appendVertex( Vec3f( v[0], v[1], v[2] ) );
+
+        if ( hasNormals() )
+            mesh->appendNormal( Vec3f( v[3], v[4], v[5] ) );
+
+        if ( hasTexCoords() )
+            mesh->appendTexCoord( Vec2f( v[ getTexCoordOffset() ], v[ getTexCoordOffset() + 1 ] ) );
+    }
+
+    for( size_t k=0; k + 2 < mNumIndices; k += 3 )
+        mesh->appendTriangle( mIndices[k], mIndices[k+1], mIndices[k+2] );
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "cinder/TriMesh.h"
+#include "cinder/AxisAlignedBox.h"
+
+#include <vector>
+#include <memory>
+
+
+typedef std::shared_ptr<class MeshData>     MeshDataRef;
+
+//! Triangle mesh ready for upload: interleaved float vertices (position, then normal and texcoord if present)
+//! and 32 bit indices. The arrays are either owned or a view into memory kept alive by an owner, such as a mapped file.
+class MeshData {
+
+public:
+
+    enum Attrib { NORMAL = 1, TEXCOORD = 2 };
+
+    //! Owned, uninitialised storage.
+    static MeshDataRef  create( uint32_t attribs, size_t numVertices, size_t numIndices )  { return MeshDataRef( new MeshData( attribs, numVertices, numIndices ) ); }
+    //! Interleaves the positions, normals and texcoords of \a mesh, normals and texcoords only if there is one per vertex.
+    static MeshDataRef  create( const ci::TriMesh &mesh );
+    //! View of external arrays, \a owner is kept alive as long as the mesh.
+    static MeshDataRef  create( uint32_t attribs, const float *vertices, size_t numVertices, const uint32_t *indices, size_t numIndices, const std::shared_ptr<void> &owner );
+
+    uint32_t            getAttribs() const              { return mAttribs; }
+    bool                hasNormals() const              { return ( mAttribs & NORMAL ) != 0; }
+    bool                hasTexCoords() const            { return ( mAttribs & TEXCOORD ) != 0; }
+
+    size_t              getNumVertices() const          { return mNumVertices; }
+    size_t              getNumIndices() const           { return mNumIndices; }
+    //! Floats per vertex.
+    size_t              getVertexSize() const           { return getVertexSize( mAttribs ); }
+    static size_t       getVertexSize( uint32_t attribs )   { return 3 + ( attribs & NORMAL ? 3 : 0 ) + ( attribs & TEXCOORD ? 2 : 0 ); }
+    //! Offsets in floats from the start of a vertex.
+    size_t              getNormalOffset() const         { return 3; }
+    size_t              getTexCoordOffset() const       { return hasNormals() ? 6 : 3; }
+
+    const float*        getVertices() const             { return mVertices; }
+    const uint32_t*     getIndices() const              { return mIndices; }
+    //! Writable arrays of owned storage, null for views.
+    float*              getVertexStorage()              { return mVertexStorage.data(); }
+    uint32_t*           getIndexStorage()               { return mIndexStorage.data(); }
+
+    ci::Vec3f           getPosition( size_t vertex ) const  { const float *p = mVertices + vertex * getVertexSize(); return ci::Vec3f( p[0], p[1], p[2] ); }
+    ci::AxisAlignedBox3f    calcBoundingBox() const;
+
+    void                toTriMesh( ci::TriMesh *mesh ) const;
+
+private:
+
+    MeshData( uint32_t attribs, size_t numVertices, size_t numIndices );
+    MeshData( uint32_t attribs, const float *vertices, size_t numVertices, const uint32_t *indices, size_t numIndices, const std::shared_ptr<void> &owner );
+
+    uint32_t                mAttribs;
+    size_t                  mNumVertices;
+    size_t                  mNumIndices;
+    const float             *mVertices;
+    const uint32_t          *mIndices;
+
+    std::vector<float>      mVertexStorage;
+    std::vector<uint32_t>   mIndexStorage;
+    std::shared_ptr<void>   mOwner;
+};
@@ -0,0 +1,119 @@
+#include "MeshLod.h"
+#include "MeshSimplifier.h"
+
+#include "cinder/CinderMath.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace ci;
+using namespace std;
+
+
+MeshLod::Levels MeshLod::buildLevels( const MeshDataRef &data, const vector<float> &ratios )
+{
+    Levels levels( 1 );
+    levels[0].mData = data;
+
+    for( size_t k=0; k < ratios.size(); k++ )
+    {
+        const Level &previous   = levels.back();
+        size_t      target      = (size_t)( data->getNumIndices() / 3 * ratios[k] ) * 3;
+
+        if ( target >= previous.mData->getNumIndices() )
+            continue;
+
+        Level   level;
+        float   error;
+        level.mData     = MeshSimplifier::simplify( *previous.mData, target, &error, &level.mSourceVertices );
+        level.mError    = max( previous.mError, error );
+
+        // seams and borders can stop the simplification early
+        if ( level.mData->getNumIndices() >= previous.mData->getNumIndices() )
+            break;
+
+        // back to the vertices of level 0
+        if ( !previous.mSourceVertices.empty() )
+            for( size_t v=0; v < level.mSourceVertices.size(); v++ )
+                level.mSourceVertices[v] = previous.mSourceVertices[ level.mSourceVertices[v] ];
+
+        levels.push_back( level );
+    }
+
+    return levels;
+}
+
+
+MeshLod::MeshLod( const Levels &levels, const GpuMesh::Format &format )
+: mLevels( levels ), mRadius( 0.0f )
+{
+    for( size_t k=0; k < mLevels.size(); k++ )
+        mMeshes.push_back( GpuMesh::create( mLevels[k].mData, format ) );
+
+    if ( mLevels.empty() || mLevels[0].mData->getNumVertices() == 0 )
+        return;
+
+    // the box centre is close enough for a sphere that only drives the level selection
+    const MeshDataRef &data = mLevels[0].mData;
+    mCenter = data->calcBoundingBox().getCenter();
+
+    for( size_t k=0; k < data->getNumVertices(); k++ )
+        mRadius = max( mRadius, data->getPosition( k ).distance( mCenter ) );
+}
+
+
+bool MeshLod::uploadChunk( size_t maxBytes )
+{
+    for( size_t k=0; k < mMeshes.size() && maxBytes > 0; k++ )
+    {
+        size_t before = mMeshes[k]->getUploadedSize();
+        mMeshes[k]->uploadChunk( maxBytes );
+        maxBytes -= mMeshes[k]->getUploadedSize() - before;
+    }
+
+    return isUploaded();
+}
+
+
+bool MeshLod::isUploaded() const
+{
+    for( size_t k=0; k < mMeshes.size(); k++ )
+        if ( !mMeshes[k]->isUploaded() )
+            return false;
+
+    return true;
+}
+
+
+size_t MeshLod::getSize() const
+{
+    size_t size = 0;
+    for( size_t k=0; k < mMeshes.size(); k++ )
+        size += mMeshes[k]->getSize();
+
+    return size;
+}
+
+
+float MeshLod::calcPixelsPerUnit( const CameraPersp &cam, float viewportHeight, float modelScale ) const
+{
+    // distance to the closest point of the sphere, the full mesh from inside it
+    float distance = cam.getEyePoint().distance( mCenter * modelScale ) - mRadius * modelScale;
+    if ( distance <= 0.0f )
+        return numeric_limits<float>::max();
+
+    return viewportHeight * modelScale / ( 2.0f * distance * tan( toRadians( cam.getFov() ) * 0.5f ) );
+}
+
+
+size_t MeshLod::selectLevel( const CameraPersp &cam, float viewportHeight, float maxErrorPixels, float modelScale ) const
+{
+    float pixelsPerUnit = calcPixelsPerUnit( cam, viewportHeight, modelScale );
+
+    for( size_t k = mLevels.size(); k > 1; k-- )
+        if ( mLevels[k-1].mError * pixelsPerUnit <= maxErrorPixels )
+            return k - 1;
+
+    return 0;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "cinder/Camera.h"
+
+#include "GpuMesh.h"
+
+#include <vector>
+
+
+typedef std::shared_ptr<class MeshLod>      MeshLodRef;
+
+//! A chain of simplified versions of a mesh on the GPU, level 0 is the full mesh.
+//! The levels are built on the CPU by buildLevels(), which can run on any thread, then uploaded like a single GpuMesh.
+//! selectLevel() picks the coarsest level whose simplification error projects to less than a given number of pixels.
+class MeshLod {
+
+public:
+
+    struct Level {
+        Level() : mError( 0.0f ) {}
+
+        MeshDataRef             mData;
+        std::vector<uint32_t>   mSourceVertices;    // index of each vertex in level 0, empty for level 0
+        float                   mError;             // distance to the full mesh, model units
+    };
+
+    typedef std::vector<Level>  Levels;
+
+    //! Level 0 is \a data, then one level per entry of \a ratios, fractions of its triangles in decreasing order.
+    //! Each level simplifies the previous one, levels that can't get any smaller are dropped.
+    static Levels       buildLevels( const MeshDataRef &data, const std::vector<float> &ratios );
+
+    //! Allocates a GpuMesh per level, nothing is uploaded until uploadChunk() or uploadAll().
+    static MeshLodRef   create( const Levels &levels, const GpuMesh::Format &format = GpuMesh::Format() )   { return MeshLodRef( new MeshLod( levels, format ) ); }
+
+    //! Uploads up to \a maxBytes of what is left, level 0 first, returns true once all the levels are on the GPU.
+    bool                uploadChunk( size_t maxBytes );
+    void                uploadAll()                         { uploadChunk( getSize() ); }
+    bool                isUploaded() const;
+    //! Bytes of all the levels.
+    size_t              getSize() const;
+
+    size_t              getNumLevels() const                { return mLevels.size(); }
+    const Level&        getLevel( size_t level ) const      { return mLevels[level]; }
+    const GpuMeshRef&   getMesh( size_t level ) const       { return mMeshes[level]; }
+
+    //! Bounding sphere of level 0 in model space.
+    const ci::Vec3f&    getCenter() const                   { return mCenter; }
+    float               getRadius() const                   { return mRadius; }
+
+    //! Pixels covered by a model unit at the distance of the bounding sphere, seen by \a cam in a viewport \a viewportHeight pixels high.
+    //! \a modelScale is the scale of the model matrix, the model is assumed to be drawn at the origin.
+    float               calcPixelsPerUnit( const ci::CameraPersp &cam, float viewportHeight, float modelScale = 1.0f ) const;
+    //! The coarsest level with an error under \a maxErrorPixels on screen.
+    size_t              selectLevel( const ci::CameraPersp &cam, float viewportHeight, float maxErrorPixels, float modelScale = 1.0f ) const;
+
+private:
+
+    MeshLod( const Levels &levels, const GpuMesh::Format &format );
+
+    Levels                      mLevels;
+    std::vector<GpuMeshRef>     mMeshes;
+    ci::Vec3f                   mCenter;
+    float                       mRadius;
+};
@@ -0,0 +1,303 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+
+namespace {
+
+// Forsyth's scoring: the 3 most recent vertices score the same so the next triangle doesn't just reuse the last edge,
+// then the score decays with the position in the cache. Vertices with few triangles left get a boost, to finish them off.
+const float CACHE_DECAY_POWER   = 1.5f;
+const float LAST_TRI_SCORE      = 0.75f;
+const float VALENCE_BOOST_SCALE = 2.0f;
+const float VALENCE_BOOST_POWER = 0.5f;
+
+const size_t MAX_VALENCE         = 64;
+
+// scores are looked up, built once per reorder
+struct ScoreTable {
+    ScoreTable()
+    {
+        for( size_t k=0; k < MeshOptimizer::CACHE_SIZE; k++ )
+            mCache[k] = k < 3 ? LAST_TRI_SCORE : pow( 1.0f - (float)( k - 3 ) / ( MeshOptimizer::CACHE_SIZE - 3 ), CACHE_DECAY_POWER );
+
+        mValence[0] = 0.0f;
+        for( size_t k=1; k < MAX_VALENCE; k++ )
+            mValence[k] = VALENCE_BOOST_SCALE * pow( (float)k, -VALENCE_BOOST_POWER );
+    }
+
+    float get( int cachePosition, uint32_t remainingTriangles ) const
+    {
+        if ( remainingTriangles == 0 )
+            return -1.0f;
+
+        float valence = remainingTriangles < MAX_VALENCE ? mValence[remainingTriangles] : VALENCE_BOOST_SCALE * pow( (float)remainingTriangles, -VALENCE_BOOST_POWER );
+        return ( cachePosition >= 0 ? mCache[cachePosition] : 0.0f ) + valence;
+    }
+
+    float   mCache[ MeshOptimizer::CACHE_SIZE ];
+    float   mValence[ MAX_VALENCE ];
+};
+
+uint32_t hashVertex( const float *vertex, size_t vertexSize )
+{
+    // FNV-1a on the bits, identical vertices are bitwise identical. Round coordinates leave the low
+    // bits of the floats at 0, the final mix brings the high bits down before the table masks them
+    uint32_t hash = 2166136261u;
+    for( size_t k=0; k < vertexSize; k++ )
+    {
+        uint32_t bits;
+        memcpy( &bits, &vertex[k], sizeof(bits) );
+        hash = ( hash ^ bits ) * 16777619u;
+    }
+
+    hash ^= hash >> 16;
+    hash *= 0x85EBCA6Bu;
+    hash ^= hash >> 13;
+    hash *= 0xC2B2AE35u;
+    return hash ^ ( hash >> 16 );
+}
+
+}
+
+
+size_t MeshOptimizer::weld( const float *vertices, size_t numVertices, size_t vertexSize, uint32_t *remap )
+{
+    size_t capacity = 16;
+    while( capacity < numVertices * 2 )
+        capacity *= 2;
+
+    // open addressing, each slot keeps the first vertex of a kind
+    vector<uint32_t>    table( capacity, 0xFFFFFFFF );
+    size_t              numUnique = 0;
+
+    for( size_t k=0; k < numVertices; k++ )
+    {
+        const float *vertex = vertices + k * vertexSize;
+        size_t      slot    = hashVertex( vertex, vertexSize ) & ( capacity - 1 );
+
+        while( table[slot] != 0xFFFFFFFF && memcmp( vertices + table[slot] * vertexSize, vertex, vertexSize * sizeof(float) ) != 0 )
+            slot = ( slot + 1 ) & ( capacity - 1 );
+
+        if ( table[slot] == 0xFFFFFFFF )
+        {
+            table[slot] = (uint32_t)k;
+            remap[k]    = (uint32_t)numUnique++;
+        }
+        else
+        {
+            remap[k]    = remap[ table[slot] ];
+        }
+    }
+
+    return numUnique;
+}
+
+
+void MeshOptimizer::reorderTriangles( uint32_t *indices, size_t numIndices, size_t numVertices )
+{
+    size_t numTriangles = numIndices / 3;
+    if ( numTriangles < 2 )
+        return;
+
+    // triangles of each vertex, the live ones are kept at the front of each list
+    vector<uint32_t> adjacencyStart( numVertices + 1, 0 );
+    vector<uint32_t> remaining( numVertices, 0 );
+
+    for( size_t k=0; k < numTriangles * 3; k++ )
+        remaining[ indices[k] ]++;
+
+    for( size_t v=0; v < numVertices; v++ )
+        adjacencyStart[v+1] = adjacencyStart[v] + remaining[v];
+
+    vector<uint32_t> adjacency( numTriangles * 3 );
+    {
+        vector<uint32_t> cursor( adjacencyStart.begin(), adjacencyStart.end() - 1 );
+        for( size_t k=0; k < numTriangles * 3; k++ )
+            adjacency[ cursor[ indices[k] ]++ ] = (uint32_t)( k / 3 );
+    }
+
+    ScoreTable          scoreTable;
+    vector<int>         cachePosition( numVertices, -1 );
+    vector<float>       score( numVertices );
+    vector<float>       triangleScore( numTriangles, 0.0f );
+    vector<uint8_t>     emitted( numTriangles, 0 );
+    vector<uint32_t>    result;
+    result.reserve( numTriangles * 3 );
+
+    for( size_t v=0; v < numVertices; v++ )
+        score[v] = scoreTable.get( -1, remaining[v] );
+
+    int     best        = 0;
+    float   bestScore   = -1.0f;
+
+    for( size_t t=0; t < numTriangles; t++ )
+    {
+        triangleScore[t] = score[ indices[t*3] ] + score[ indices[t*3+1] ] + score[ indices[t*3+2] ];
+        if ( triangleScore[t] > bestScore )
+        {
+            bestScore   = triangleScore[t];
+            best        = (int)t;
+        }
+    }
+
+    uint32_t    cache[ CACHE_SIZE + 3 ];
+    size_t      cacheCount  = 0;
+    size_t      cursor      = 0;
+
+    for( size_t n=0; n < numTriangles; n++ )
+    {
+        // nothing in the cache has triangles left, carry on with the first triangle not emitted yet
+        if ( best < 0 )
+        {
+            while( emitted[cursor] )
+                cursor++;
+            best = (int)cursor;
+        }
+
+        const uint32_t *tri = indices + best * 3;
+        emitted[best] = 1;
+        result.insert( result.end(), tri, tri + 3 );
+
+        // the triangle moves to the back of each vertex list, out of the live range
+        for( int k=0; k < 3; k++ )
+        {
+            uint32_t v      = tri[k];
+            uint32_t *begin = &adjacency[ adjacencyStart[v] ];
+            uint32_t *end   = begin + remaining[v];
+            uint32_t *pos   = find( begin, end, (uint32_t)best );
+
+            if ( pos != end )
+            {
+                swap( *pos, *( end - 1 ) );
+                remaining[v]--;
+            }
+        }
+
+        // the triangle vertices go to the front, the rest shifts back
+        uint32_t    newCache[ CACHE_SIZE + 3 ];
+        size_t      newCount = 0;
+
+        for( int k=0; k < 3; k++ )
+            if ( find( newCache, newCache + newCount, tri[k] ) == newCache + newCount )
+                newCache[newCount++] = tri[k];
+
+        for( size_t k=0; k < cacheCount; k++ )
+            if ( cache[k] != tri[0] && cache[k] != tri[1] && cache[k] != tri[2] )
+                newCache[newCount++] = cache[k];
+
+        for( size_t k=0; k < newCount; k++ )
+        {
+            uint32_t v          = newCache[k];
+            cachePosition[v]    = k < CACHE_SIZE ? (int)k : -1;
+            score[v]            = scoreTable.get( cachePosition[v], remaining[v] );
+        }
+
+        // only the triangles around the cache changed score, the best of them goes next
+        best        = -1;
+        bestScore   = -1.0f;
+
+        for( size_t k=0; k < newCount; k++ )
+        {
+            uint32_t v = newCache[k];
+
+            for( uint32_t a = adjacencyStart[v]; a < adjacencyStart[v] + remaining[v]; a++ )
+            {
+                uint32_t t          = adjacency[a];
+                triangleScore[t]    = score[ indices[t*3] ] + score[ indices[t*3+1] ] + score[ indices[t*3+2] ];
+
+                if ( k < CACHE_SIZE && triangleScore[t] > bestScore )
+                {
+                    bestScore   = triangleScore[t];
+                    best        = (int)t;
+                }
+            }
+        }
+
+        cacheCount = newCount < CACHE_SIZE ? newCount : CACHE_SIZE;
+        copy( newCache, newCache + cacheCount, cache );
+    }
+
+    copy( result.begin(), result.end(), indices );
+}
+
+
+void MeshOptimizer::calcFetchRemap( const uint32_t *indices, size_t numIndices, size_t numVertices, uint32_t *remap )
+{
+    fill( remap, remap + numVertices, 0xFFFFFFFF );
+
+    uint32_t next = 0;
+    for( size_t k=0; k < numIndices; k++ )
+        if ( remap[ indices[k] ] == 0xFFFFFFFF )
+            remap[ indices[k] ] = next++;
+
+    for( size_t v=0; v < numVertices; v++ )
+        if ( remap[v] == 0xFFFFFFFF )
+            remap[v] = next++;
+}
+
+
+float MeshOptimizer::calcAcmr( const uint32_t *indices, size_t numIndices, size_t numVertices, size_t cacheSize )
+{
+    if ( numIndices < 3 )
+        return 0.0f;
+
+    // a vertex is still in the FIFO if fewer than cacheSize misses happened since it was loaded
+    vector<size_t>  loadedAt( numVertices, 0 );
+    size_t          misses = 0;
+
+    for( size_t k=0; k < numIndices; k++ )
+    {
+        size_t &loaded = loadedAt[ indices[k] ];
+        if ( loaded == 0 || misses - loaded >= cacheSize )
+            loaded = ++misses;
+    }
+
+    return (float)misses / ( numIndices / 3 );
+}
+
+
+MeshDataRef MeshOptimizer::optimize( const MeshData &data, Stats *stats )
+{
+    size_t          numVertices = data.getNumVertices();
+    size_t          numIndices  = data.getNumIndices();
+    size_t          vertexSize  = data.getVertexSize();
+    const uint32_t  *indices    = data.getIndices();
+
+    vector<uint32_t> weldRemap( numVertices );
+    size_t numUnique = weld( data.getVertices(), numVertices, vertexSize, weldRemap.data() );
+
+    vector<uint32_t> newIndices( numIndices );
+    for( size_t k=0; k < numIndices; k++ )
+        newIndices[k] = weldRemap[ indices[k] ];
+
+    reorderTriangles( newIndices.data(), numIndices, numUnique );
+
+    // the final index of each original vertex, through the weld and the fetch order
+    vector<uint32_t> fetchRemap( numUnique );
+    calcFetchRemap( newIndices.data(), numIndices, numUnique, fetchRemap.data() );
+
+    MeshDataRef result      = MeshData::create( data.getAttribs(), numUnique, numIndices );
+    float       *vertices   = result->getVertexStorage();
+
+    for( size_t v=0; v < numVertices; v++ )
+        memcpy( vertices + fetchRemap[ weldRemap[v] ] * vertexSize, data.getVertices() + v * vertexSize, vertexSize * sizeof(float) );
+
+    uint32_t *dest = result->getIndexStorage();
+    for( size_t k=0; k < numIndices; k++ )
+        dest[k] = fetchRemap[ newIndices[k] ];
+
+    if ( stats )
+    {
+        stats->mVerticesBefore  = (uint32_t)numVertices;
+        stats->mVerticesAfter   = (uint32_t)numUnique;
+        stats->mAcmrBefore      = calcAcmr( indices, numIndices, numVertices );
+        stats->mAcmrAfter       = calcAcmr( dest, numIndices, numUnique );
+    }
+
+    return result;
+}
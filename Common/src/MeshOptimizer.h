@@ -0,0 +1,45 @@
+#pragma once
+
+#include "MeshData.h"
+
+#include <vector>
+#include <cstdint>
+
+
+//! Post-load optimisation of indexed triangle meshes: welds identical vertices, reorders the triangles for the
+//! post-transform vertex cache (Forsyth's linear-speed algorithm) and the vertices in order of first use, for fetch locality.
+//! The stages can also be run on their own, on plain arrays.
+class MeshOptimizer {
+
+public:
+
+    struct Stats {
+        Stats() : mVerticesBefore( 0 ), mVerticesAfter( 0 ), mAcmrBefore( 0.0f ), mAcmrAfter( 0.0f ) {}
+
+        uint32_t    mVerticesBefore;
+        uint32_t    mVerticesAfter;
+        float       mAcmrBefore;        // average cache miss ratio, transformed vertices per triangle
+        float       mAcmrAfter;
+    };
+
+    //! LRU cache modelled by the triangle reordering.
+    static const size_t     CACHE_SIZE  = 32;
+    //! FIFO cache used to measure the ACMR, the usual size on older hardware.
+    static const size_t     FIFO_SIZE   = 16;
+
+    //! Runs all the stages, returns a new owned mesh. Vertices that no triangle uses are kept at the end.
+    static MeshDataRef  optimize( const MeshData &data, Stats *stats = nullptr );
+
+    //! Finds the vertices with bitwise identical attributes, \a vertexSize floats each.
+    //! Fills \a remap with the new index of each vertex, the first of a kind keeps its order, and returns the number of unique vertices.
+    static size_t       weld( const float *vertices, size_t numVertices, size_t vertexSize, uint32_t *remap );
+
+    //! Reorders the triangles in place for vertex cache locality.
+    static void         reorderTriangles( uint32_t *indices, size_t numIndices, size_t numVertices );
+
+    //! Fills \a remap with the index of each vertex in order of first use by \a indices, unused vertices last.
+    static void         calcFetchRemap( const uint32_t *indices, size_t numIndices, size_t numVertices, uint32_t *remap );
+
+    //! Vertices transformed per triangle with a FIFO post-transform cache of \a cacheSize, between 0.5 and 3.
+    static float        calcAcmr( const uint32_t *indices, size_t numIndices, size_t numVertices, size_t cacheSize = FIFO_SIZE );
+};
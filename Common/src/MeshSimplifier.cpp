@@ -0,0 +1,394 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace ci;
+using namespace std;
+
+
+namespace {
+
+// symmetric 4x4 matrix of the squared distance to a set of planes, the area of each plane's triangle as weight
+struct Quadric {
+    Quadric() : mA00( 0 ), mA01( 0 ), mA02( 0 ), mA11( 0 ), mA12( 0 ), mA22( 0 ), mB0( 0 ), mB1( 0 ), mB2( 0 ), mC( 0 ), mWeight( 0 ) {}
+
+    void addPlane( const Vec3f &n, float d, float weight )
+    {
+        mA00 += weight * n.x * n.x;     mA01 += weight * n.x * n.y;     mA02 += weight * n.x * n.z;
+        mA11 += weight * n.y * n.y;     mA12 += weight * n.y * n.z;     mA22 += weight * n.z * n.z;
+        mB0  += weight * n.x * d;       mB1  += weight * n.y * d;       mB2  += weight * n.z * d;
+        mC   += weight * d * d;
+        mWeight += weight;
+    }
+
+    void add( const Quadric &q )
+    {
+        mA00 += q.mA00;     mA01 += q.mA01;     mA02 += q.mA02;
+        mA11 += q.mA11;     mA12 += q.mA12;     mA22 += q.mA22;
+        mB0  += q.mB0;      mB1  += q.mB1;      mB2  += q.mB2;
+        mC   += q.mC;
+        mWeight += q.mWeight;
+    }
+
+    // weighted sum of the squared distances of p to the planes
+    double eval( const Vec3f &p ) const
+    {
+        double x = p.x, y = p.y, z = p.z;
+        double r = mA00 * x * x + mA11 * y * y + mA22 * z * z
+                 + 2.0 * ( mA01 * x * y + mA02 * x * z + mA12 * y * z )
+                 + 2.0 * ( mB0 * x + mB1 * y + mB2 * z ) + mC;
+        return r > 0.0 ? r : 0.0;
+    }
+
+    double  mA00, mA01, mA02, mA11, mA12, mA22;
+    double  mB0, mB1, mB2;
+    double  mC;
+    double  mWeight;
+};
+
+struct Collapse {
+    uint32_t    mFrom, mTo;         // positions
+    double      mCost;
+
+    bool operator<( const Collapse &other ) const
+    {
+        if ( mCost != other.mCost )
+            return mCost < other.mCost;
+        return mFrom != other.mFrom ? mFrom < other.mFrom : mTo < other.mTo;
+    }
+};
+
+// the smallest cosine between a triangle normal before and after a collapse
+const float MIN_NORMAL_COS = 0.2f;
+
+uint64_t edgeKey( uint32_t a, uint32_t b )
+{
+    return a < b ? ( (uint64_t)a << 32 ) | b : ( (uint64_t)b << 32 ) | a;
+}
+
+}
+
+
+MeshDataRef MeshSimplifier::simplify( const MeshData &data, size_t targetIndices, float *error, vector<uint32_t> *sourceVertices )
+{
+    size_t          numVertices = data.getNumVertices();
+    size_t          numIndices  = data.getNumIndices() / 3 * 3;
+    size_t          vertexSize  = data.getVertexSize();
+    const float     *vertices   = data.getVertices();
+
+    // vertices with identical attributes are one vertex, vertices with identical positions one position
+    vector<uint32_t> vertexId( numVertices );
+    size_t numUnique = MeshOptimizer::weld( vertices, numVertices, vertexSize, vertexId.data() );
+
+    vector<uint32_t> firstVertex( numUnique, 0xFFFFFFFF );
+    for( size_t k=0; k < numVertices; k++ )
+        if ( firstVertex[ vertexId[k] ] == 0xFFFFFFFF )
+            firstVertex[ vertexId[k] ] = (uint32_t)k;
+
+    vector<float> packed( numUnique * 3 );
+    for( size_t k=0; k < numUnique; k++ )
+        memcpy( &packed[k*3], vertices + firstVertex[k] * vertexSize, 3 * sizeof(float) );
+
+    vector<uint32_t> positionId( numUnique );
+    size_t numPositions = MeshOptimizer::weld( packed.data(), numUnique, 3, positionId.data() );
+
+    vector<Vec3f> positions( numPositions );
+    for( size_t k=0; k < numUnique; k++ )
+        positions[ positionId[k] ] = Vec3f( packed[k*3], packed[k*3+1], packed[k*3+2] );
+
+    // triangles on unique vertices, without the ones that are already degenerate
+    vector<uint32_t> triangles;
+    triangles.reserve( numIndices );
+
+    for( size_t k=0; k < numIndices; k += 3 )
+    {
+        uint32_t a = vertexId[ data.getIndices()[k] ], b = vertexId[ data.getIndices()[k+1] ], c = vertexId[ data.getIndices()[k+2] ];
+        uint32_t pa = positionId[a], pb = positionId[b], pc = positionId[c];
+
+        if ( pa != pb && pb != pc && pc != pa )
+        {
+            triangles.push_back( a );
+            triangles.push_back( b );
+            triangles.push_back( c );
+        }
+    }
+
+    // plane quadrics, and the border and non manifold edges lock their positions
+    vector<Quadric>     quadrics( numPositions );
+    vector<uint8_t>     locked( numPositions, 0 );
+    vector<uint64_t>    edges;
+    edges.reserve( triangles.size() );
+
+    for( size_t k=0; k < triangles.size(); k += 3 )
+    {
+        uint32_t    p[3]    = { positionId[ triangles[k] ], positionId[ triangles[k+1] ], positionId[ triangles[k+2] ] };
+        Vec3f       n       = ( positions[p[1]] - positions[p[0]] ).cross( positions[p[2]] - positions[p[0]] );
+        float       l       = n.length();
+
+        if ( l > 0.0f )
+        {
+            n /= l;
+            for( int j=0; j < 3; j++ )
+                quadrics[p[j]].addPlane( n, -n.dot( positions[p[0]] ), l * 0.5f );
+        }
+
+        for( int j=0; j < 3; j++ )
+            edges.push_back( edgeKey( p[j], p[(j+1)%3] ) );
+    }
+
+    sort( edges.begin(), edges.end() );
+
+    for( size_t k=0; k < edges.size(); )
+    {
+        size_t end = k + 1;
+        while( end < edges.size() && edges[end] == edges[k] )
+            end++;
+
+        if ( end - k != 2 )
+        {
+            locked[ (uint32_t)( edges[k] >> 32 ) ]          = 1;
+            locked[ (uint32_t)( edges[k] & 0xFFFFFFFF ) ]   = 1;
+        }
+
+        k = end;
+    }
+
+    vector<uint32_t>    collapseTo( numUnique );
+    vector<uint32_t>    adjacencyStart( numPositions + 1 );
+    vector<uint32_t>    adjacency;
+    vector<uint32_t>    wedge( numPositions );
+    vector<uint8_t>     wedges( numPositions );
+    vector<uint8_t>     touched( numPositions );
+    vector<uint32_t>    neighbourMark( numPositions, 0 );
+    uint32_t            markId = 0;
+    vector<Collapse>    collapses;
+    double              maxCost = 0.0;
+
+    targetIndices = targetIndices / 3 * 3;
+
+    while( triangles.size() > targetIndices )
+    {
+        size_t numTriangles = triangles.size() / 3;
+
+        // triangles around each position
+        fill( adjacencyStart.begin(), adjacencyStart.end(), 0 );
+        for( size_t k=0; k < triangles.size(); k++ )
+            adjacencyStart[ positionId[ triangles[k] ] + 1 ]++;
+        for( size_t p=0; p < numPositions; p++ )
+            adjacencyStart[p+1] += adjacencyStart[p];
+
+        adjacency.resize( triangles.size() );
+        {
+            vector<uint32_t> cursor( adjacencyStart.begin(), adjacencyStart.end() - 1 );
+            for( size_t k=0; k < triangles.size(); k++ )
+                adjacency[ cursor[ positionId[ triangles[k] ] ]++ ] = (uint32_t)( k / 3 );
+        }
+
+        // a position used by several vertices is on a seam
+        fill( wedges.begin(), wedges.end(), 0 );
+        for( size_t k=0; k < triangles.size(); k++ )
+        {
+            uint32_t v = triangles[k], p = positionId[v];
+            if ( wedges[p] == 0 )
+            {
+                wedge[p]    = v;
+                wedges[p]   = 1;
+            }
+            else if ( wedge[p] != v )
+            {
+                wedges[p]   = 2;
+            }
+        }
+
+        // the cheapest direction of each edge
+        collapses.clear();
+        for( size_t k=0; k < triangles.size(); k++ )
+        {
+            uint32_t a = positionId[ triangles[k] ];
+            uint32_t b = positionId[ triangles[ k - k % 3 + ( k + 1 ) % 3 ] ];
+
+            // each interior edge is seen twice, once per direction
+            if ( a > b )
+                continue;
+
+            Quadric q = quadrics[a];
+            q.add( quadrics[b] );
+            double  weight = q.mWeight > 0.0 ? q.mWeight : 1.0;
+
+            Collapse c;
+            c.mCost = -1.0;
+
+            if ( !locked[a] && wedges[a] == 1 )
+            {
+                c.mFrom = a;    c.mTo = b;  c.mCost = q.eval( positions[b] ) / weight;
+            }
+
+            if ( !locked[b] && wedges[b] == 1 )
+            {
+                double cost = q.eval( positions[a] ) / weight;
+                if ( c.mCost < 0.0 || cost < c.mCost )
+                {
+                    c.mFrom = b;    c.mTo = a;  c.mCost = cost;
+                }
+            }
+
+            if ( c.mCost >= 0.0 )
+                collapses.push_back( c );
+        }
+
+        sort( collapses.begin(), collapses.end() );
+
+        // independent collapses in order of cost, about 2 triangles each
+        size_t  trianglesToRemove   = numTriangles - targetIndices / 3;
+        size_t  removed             = 0;
+        size_t  applied             = 0;
+
+        fill( touched.begin(), touched.end(), 0 );
+        for( size_t k=0; k < numUnique; k++ )
+            collapseTo[k] = (uint32_t)k;
+
+        for( size_t c=0; c < collapses.size() && removed < trianglesToRemove; c++ )
+        {
+            uint32_t from = collapses[c].mFrom, to = collapses[c].mTo;
+
+            if ( touched[from] || touched[to] )
+                continue;
+
+            // the vertex of \a to on the triangles of the edge, it must be the same on both sides
+            uint32_t    target  = 0xFFFFFFFF;
+            size_t      shared  = 0;
+            bool        valid   = true;
+
+            for( uint32_t a = adjacencyStart[from]; a < adjacencyStart[from+1] && valid; a++ )
+            {
+                const uint32_t  *tri    = &triangles[ adjacency[a] * 3 ];
+                uint32_t        v[3]    = { collapseTo[ tri[0] ], collapseTo[ tri[1] ], collapseTo[ tri[2] ] };
+                uint32_t        p[3]    = { positionId[v[0]], positionId[v[1]], positionId[v[2]] };
+
+                int corner = p[0] == to ? 0 : ( p[1] == to ? 1 : ( p[2] == to ? 2 : -1 ) );
+                if ( corner >= 0 )
+                {
+                    if ( target != 0xFFFFFFFF && target != v[corner] )
+                        valid = false;
+                    target = v[corner];
+                    shared++;
+                    continue;
+                }
+
+                // moving \a from onto \a to must not fold the triangle over
+                Vec3f before    = ( positions[p[1]] - positions[p[0]] ).cross( positions[p[2]] - positions[p[0]] );
+                Vec3f q[3]      = { positions[p[0]], positions[p[1]], positions[p[2]] };
+
+                for( int j=0; j < 3; j++ )
+                    if ( p[j] == from )
+                        q[j] = positions[to];
+
+                Vec3f after = ( q[1] - q[0] ).cross( q[2] - q[0] );
+
+                if ( before.dot( after ) <= MIN_NORMAL_COS * before.length() * after.length() )
+                    valid = false;
+            }
+
+            if ( !valid || shared == 0 )
+                continue;
+
+            // link condition, \a from and \a to only share the neighbours across the edge, or the collapse pinches the surface
+            markId++;
+            for( uint32_t a = adjacencyStart[from]; a < adjacencyStart[from+1]; a++ )
+                for( int j=0; j < 3; j++ )
+                    neighbourMark[ positionId[ triangles[ adjacency[a] * 3 + j ] ] ] = markId;
+
+            size_t common = 0;
+            for( uint32_t a = adjacencyStart[to]; a < adjacencyStart[to+1]; a++ )
+            {
+                for( int j=0; j < 3; j++ )
+                {
+                    uint32_t p = positionId[ triangles[ adjacency[a] * 3 + j ] ];
+                    if ( p != from && p != to && neighbourMark[p] == markId )
+                    {
+                        common++;
+                        neighbourMark[p] = 0;
+                    }
+                }
+            }
+
+            if ( common != shared )
+                continue;
+
+            collapseTo[ wedge[from] ] = target;
+            quadrics[to].add( quadrics[from] );
+
+            // the triangles around \a from changed, their other vertices wait for the next pass
+            for( uint32_t a = adjacencyStart[from]; a < adjacencyStart[from+1]; a++ )
+                for( int j=0; j < 3; j++ )
+                    touched[ positionId[ triangles[ adjacency[a] * 3 + j ] ] ] = 1;
+
+            removed         += shared;
+            maxCost         = max( maxCost, collapses[c].mCost );
+            applied++;
+        }
+
+        if ( applied == 0 )
+            break;
+
+        // apply the pass, the collapsed triangles become degenerate
+        size_t count = 0;
+        for( size_t k=0; k < triangles.size(); k += 3 )
+        {
+            uint32_t a = collapseTo[ triangles[k] ], b = collapseTo[ triangles[k+1] ], c = collapseTo[ triangles[k+2] ];
+            uint32_t pa = positionId[a], pb = positionId[b], pc = positionId[c];
+
+            if ( pa != pb && pb != pc && pc != pa )
+            {
+                triangles[count++] = a;
+                triangles[count++] = b;
+                triangles[count++] = c;
+            }
+        }
+        triangles.resize( count );
+    }
+
+    if ( error )
+        *error = (float)sqrt( maxCost );
+
+    // cache order, then only the vertices still in use in order of first use
+    MeshOptimizer::reorderTriangles( triangles.data(), triangles.size(), numUnique );
+
+    vector<uint32_t> remap( numUnique );
+    MeshOptimizer::calcFetchRemap( triangles.data(), triangles.size(), numUnique, remap.data() );
+
+    vector<uint8_t> used( numUnique, 0 );
+    size_t          numUsed = 0;
+
+    for( size_t k=0; k < triangles.size(); k++ )
+    {
+        numUsed += used[ triangles[k] ] ? 0 : 1;
+        used[ triangles[k] ] = 1;
+    }
+
+    MeshDataRef result  = MeshData::create( data.getAttribs(), numUsed, triangles.size() );
+    float       *dest   = result->getVertexStorage();
+
+    if ( sourceVertices )
+        sourceVertices->resize( numUsed );
+
+    for( size_t v=0; v < numUnique; v++ )
+    {
+        if ( !used[v] )
+            continue;
+
+        memcpy( dest + remap[v] * vertexSize, vertices + firstVertex[v] * vertexSize, vertexSize * sizeof(float) );
+
+        if ( sourceVertices )
+            (*sourceVertices)[ remap[v] ] = firstVertex[v];
+    }
+
+    uint32_t *indices = result->getIndexStorage();
+    for( size_t k=0; k < triangles.size(); k++ )
+        indices[k] = remap[ triangles[k] ];
+
+    return result;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "MeshData.h"
+
+#include <vector>
+#include <cstdint>
+
+
+//! Quadric error simplification (Garland and Heckbert) by half edge collapses: a vertex merges into one of its neighbours,
+//! so the result is a subset of the original vertices and keeps their normals and texcoords untouched.
+//! Border vertices and vertices on an attribute seam never move, collapses that would fold a triangle over are skipped.
+//! Collapses are applied in passes of independent edges in order of error, the result is deterministic.
+class MeshSimplifier {
+
+public:
+
+    //! Collapses edges until at most \a targetIndices indices are left or nothing can collapse any more.
+    //! The triangles of the result are reordered for the vertex cache and the unused vertices dropped.
+    //! \a error gets the largest collapse error, an RMS distance to the original surface in model units,
+    //! \a sourceVertices the index in \a data of each vertex of the result.
+    static MeshDataRef  simplify( const MeshData &data, size_t targetIndices, float *error = nullptr, std::vector<uint32_t> *sourceVertices = nullptr );
+};
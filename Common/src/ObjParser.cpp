@@ -0,0 +1,640 @@
+#include "ObjParser.h"
+#include "MappedFile.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+using namespace ci;
+using namespace std;
+
+
+namespace {
+
+const size_t CHUNK_SIZE     = 1 << 20;      // bytes of text per parse job
+const size_t FILL_GRAIN     = 1 << 16;      // vertices or faces per fill job
+
+// negative indices are resolved against the counts of the chunk, the merge adds the counts of the chunks before it
+enum CornerFlags { REL_V = 1, REL_T = 2, REL_N = 4, HAS_T = 8, HAS_N = 16 };
+
+// attributes of a face, or of any face in a group
+enum FaceFlags { FACE_TEXCOORDS = 1, FACE_NORMALS = 2 };
+
+struct ChunkCorner {
+    int32_t     mV, mT, mN;
+    uint8_t     mFlags;
+};
+
+struct Chunk {
+    const char              *mBegin;
+    const char              *mEnd;
+    vector<Vec3f>           mPositions;
+    vector<Vec3f>           mNormals;
+    vector<Vec2f>           mTexCoords;
+    vector<ChunkCorner>     mCorners;
+    vector<uint32_t>        mFaceEnds;      // local end corner of each face
+    vector<uint8_t>         mFaceFlags;
+    vector<uint32_t>        mGroupStarts;   // local face index of each "g" line
+};
+
+// \n never shows up inside a line
+inline bool isSpace( char c )   { return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f'; }
+inline bool isDigit( char c )   { return c >= '0' && c <= '9'; }
+
+const char* skipSpace( const char *p, const char *end )
+{
+    while( p < end && isSpace( *p ) )
+        ++p;
+    return p;
+}
+
+const char* skipToken( const char *p, const char *end )
+{
+    while( p < end && !isSpace( *p ) )
+        ++p;
+    return p;
+}
+
+// like reading an int from a stream, no digits gives 0
+int32_t parseInt( const char *p, const char *end )
+{
+    bool negative = false;
+    if ( p < end && ( *p == '-' || *p == '+' ) )
+    {
+        negative = *p == '-';
+        ++p;
+    }
+
+    int64_t value = 0;
+    for( ; p < end && isDigit( *p ); ++p )
+        value = min<int64_t>( value * 10 + ( *p - '0' ), 0x7FFFFFFF );
+
+    return (int32_t)( negative ? -value : value );
+}
+
+void parseFloats( const char *p, const char *end, float *dest, size_t count )
+{
+    // a stream stops at the first failure, the remaining values are 0
+    for( size_t k=0; k < count; k++ )
+    {
+        p = skipSpace( p, end );
+
+        const char *next = ObjParser::parseFloat( p, end, &dest[k] );
+        if ( next == p )
+        {
+            fill( dest + k, dest + count, 0.0f );
+            return;
+        }
+
+        p = next;
+    }
+}
+
+void resolve( int32_t index, size_t count, uint8_t relFlag, int32_t *dest, uint8_t *flags )
+{
+    if ( index < 0 )
+    {
+        *dest   = (int32_t)count + index;
+        *flags |= relFlag;
+    }
+    else
+    {
+        *dest   = index - 1;
+    }
+}
+
+void parseFace( Chunk *chunk, const char *p, const char *end, bool includeUVs )
+{
+    uint8_t faceFlags = 0;
+
+    while( true )
+    {
+        p = skipSpace( p, end );
+        if ( p == end )
+            break;
+
+        const char  *tripleEnd  = skipToken( p, end );
+        const char  *slash1     = find( p, tripleEnd, '/' );
+        ChunkCorner corner;
+
+        corner.mT       = -1;
+        corner.mN       = -1;
+        corner.mFlags   = 0;
+
+        resolve( parseInt( p, slash1 ), chunk->mPositions.size(), REL_V, &corner.mV, &corner.mFlags );
+
+        // v/vt, v/vt/vn or v//vn
+        if ( slash1 != tripleEnd )
+        {
+            const char *slash2 = find( slash1 + 1, tripleEnd, '/' );
+
+            if ( slash2 > slash1 + 1 && includeUVs )
+            {
+                resolve( parseInt( slash1 + 1, slash2 ), chunk->mTexCoords.size(), REL_T, &corner.mT, &corner.mFlags );
+                corner.mFlags  |= HAS_T;
+                faceFlags      |= FACE_TEXCOORDS;
+            }
+
+            if ( slash2 != tripleEnd && slash2 + 1 < tripleEnd )
+            {
+                resolve( parseInt( slash2 + 1, tripleEnd ), chunk->mNormals.size(), REL_N, &corner.mN, &corner.mFlags );
+                corner.mFlags  |= HAS_N;
+                faceFlags      |= FACE_NORMALS;
+            }
+        }
+
+        chunk->mCorners.push_back( corner );
+        p = tripleEnd;
+    }
+
+    chunk->mFaceEnds.push_back( (uint32_t)chunk->mCorners.size() );
+    chunk->mFaceFlags.push_back( faceFlags );
+}
+
+void parseLine( Chunk *chunk, const char *p, const char *end, bool includeUVs )
+{
+    p = skipSpace( p, end );
+
+    const char  *tagEnd = skipToken( p, end );
+    size_t      tagSize = tagEnd - p;
+
+    if ( tagSize == 1 && p[0] == 'v' )
+    {
+        Vec3f v;
+        parseFloats( tagEnd, end, &v.x, 3 );
+        chunk->mPositions.push_back( v );
+    }
+    else if ( tagSize == 2 && p[0] == 'v' && p[1] == 't' )
+    {
+        if ( includeUVs )
+        {
+            Vec2f t;
+            parseFloats( tagEnd, end, &t.x, 2 );
+            chunk->mTexCoords.push_back( t );
+        }
+    }
+    else if ( tagSize == 2 && p[0] == 'v' && p[1] == 'n' )
+    {
+        Vec3f n;
+        parseFloats( tagEnd, end, &n.x, 3 );
+        chunk->mNormals.push_back( n.normalized() );
+    }
+    else if ( tagSize == 1 && p[0] == 'f' )
+    {
+        parseFace( chunk, tagEnd, end, includeUVs );
+    }
+    else if ( tagSize == 1 && p[0] == 'g' )
+    {
+        chunk->mGroupStarts.push_back( (uint32_t)chunk->mFaceEnds.size() );
+    }
+}
+
+const char* nextLine( const char *p, const char *end )
+{
+    const char *lineEnd = (const char*)memchr( p, '\n', end - p );
+    return lineEnd ? lineEnd : end;
+}
+
+void parseChunk( Chunk *chunk, bool includeUVs )
+{
+    const char  *p      = chunk->mBegin;
+    const char  *end    = chunk->mEnd;
+    string      joined;
+
+    while( p < end )
+    {
+        const char *lineBegin   = p;
+        const char *lineEnd     = nextLine( p, end );
+        p = lineEnd < end ? lineEnd + 1 : end;
+
+        if ( lineBegin == lineEnd || *lineBegin == '#' )
+            continue;
+
+        // a trailing backslash continues the line, chunks never end on one
+        if ( lineEnd[-1] == '\\' && p < end )
+        {
+            joined.assign( lineBegin, lineEnd );
+
+            while( !joined.empty() && joined[ joined.size() - 1 ] == '\\' && p < end )
+            {
+                const char *nextEnd = nextLine( p, end );
+                joined.erase( joined.size() - 1 );
+                joined.append( p, nextEnd );
+                p = nextEnd < end ? nextEnd + 1 : end;
+            }
+
+            parseLine( chunk, joined.data(), joined.data() + joined.size(), includeUVs );
+            continue;
+        }
+
+        parseLine( chunk, lineBegin, lineEnd, includeUVs );
+    }
+}
+
+void forEachRange( JobSystem *jobs, size_t count, size_t grainSize, const JobSystem::RangeJob &job )
+{
+    if ( jobs )
+    {
+        jobs->parallelFor( count, grainSize, job );
+        return;
+    }
+
+    for( size_t chunk=0; chunk < JobSystem::getNumChunks( count, grainSize ); chunk++ )
+        job( chunk, chunk * grainSize, min( count, ( chunk + 1 ) * grainSize ) );
+}
+
+struct WeldEntry {
+    int32_t     mV, mT, mN;         // mV is -1 for empty slots
+    uint32_t    mVertex;
+};
+
+inline uint32_t hashCorner( int32_t v, int32_t t, int32_t n )
+{
+    uint32_t h = (uint32_t)v * 0x9E3779B1u ^ (uint32_t)t * 0x85EBCA77u ^ (uint32_t)n * 0xC2B2AE3Du;
+    return h ^ ( h >> 15 );
+}
+
+}
+
+
+const char* ObjParser::parseFloat( const char *begin, const char *end, float *result )
+{
+    static const float POW10[] = { 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f };
+
+    const char  *p          = begin;
+    bool        negative    = false;
+    uint64_t    mantissa    = 0;
+    int         digits      = 0;
+    int         exponent    = 0;
+    bool        hasDigits   = false;
+    bool        truncated   = false;
+
+    if ( p < end && ( *p == '-' || *p == '+' ) )
+    {
+        negative = *p == '-';
+        ++p;
+    }
+
+    for( ; p < end && isDigit( *p ); ++p )
+    {
+        hasDigits = true;
+        if ( digits < 19 )
+        {
+            mantissa = mantissa * 10 + ( *p - '0' );
+            digits  += mantissa > 0 ? 1 : 0;
+        }
+        else
+            truncated = true;
+    }
+
+    if ( p < end && *p == '.' )
+    {
+        const char *q = p + 1;
+
+        for( ; q < end && isDigit( *q ); ++q )
+        {
+            hasDigits = true;
+            if ( digits < 19 )
+            {
+                mantissa = mantissa * 10 + ( *q - '0' );
+                digits  += mantissa > 0 ? 1 : 0;
+                exponent--;
+            }
+            else
+                truncated = true;
+        }
+
+        if ( hasDigits )
+            p = q;
+    }
+
+    if ( !hasDigits )
+    {
+        *result = 0.0f;
+        return begin;
+    }
+
+    // the exponent only counts with digits, "1e" is just 1
+    if ( p < end && ( *p == 'e' || *p == 'E' ) )
+    {
+        const char  *q          = p + 1;
+        bool        expNegative = false;
+
+        if ( q < end && ( *q == '-' || *q == '+' ) )
+        {
+            expNegative = *q == '-';
+            ++q;
+        }
+
+        if ( q < end && isDigit( *q ) )
+        {
+            int value = 0;
+            for( ; q < end && isDigit( *q ); ++q )
+                value = min( value * 10 + ( *q - '0' ), 100000 );
+
+            exponent   += expNegative ? -value : value;
+            p           = q;
+        }
+    }
+
+    // both the mantissa and the power of ten are exact floats, a single multiply or divide rounds correctly
+    if ( !truncated && mantissa <= ( 1 << 24 ) && exponent >= -10 && exponent <= 10 )
+    {
+        float value = (float)mantissa;
+        value       = exponent < 0 ? value / POW10[-exponent] : value * POW10[exponent];
+        *result     = negative ? -value : value;
+        return p;
+    }
+
+    string str( begin, p );
+
+#if defined( _MSC_VER ) && _MSC_VER < 1800
+    *result = (float)strtod( str.c_str(), nullptr );
+#else
+    *result = strtof( str.c_str(), nullptr );
+#endif
+
+    return p;
+}
+
+
+ObjParser::ObjParser( const fs::path &path, bool includeUVs, JobSystem *jobs )
+: mJobs( jobs )
+{
+    MappedFileRef   file    = MappedFile::create( path.string() );
+    const char      *data   = (const char*)file->getData();
+    size_t          size    = file->getSize();
+
+    // line aligned chunks, a boundary never follows a line continued with a backslash
+    size_t          numChunks = max<size_t>( 1, JobSystem::getNumChunks( size, CHUNK_SIZE ) );
+    vector<Chunk>   chunks( numChunks );
+    size_t          begin   = 0;
+
+    for( size_t k=0; k < numChunks; k++ )
+    {
+        size_t end = size;
+
+        if ( k + 1 < numChunks )
+        {
+            end = max( begin, ( k + 1 ) * CHUNK_SIZE );
+
+            while( end < size )
+            {
+                const char *lineEnd = (const char*)memchr( data + end, '\n', size - end );
+                if ( !lineEnd )
+                {
+                    end = size;
+                    break;
+                }
+
+                end = lineEnd - data + 1;
+                if ( lineEnd == data || lineEnd[-1] != '\\' )
+                    break;
+            }
+        }
+
+        chunks[k].mBegin    = data + begin;
+        chunks[k].mEnd      = data + end;
+        begin               = end;
+    }
+
+    forEachRange( jobs, numChunks, 1, [&]( size_t chunk, size_t, size_t ) {
+        parseChunk( &chunks[chunk], includeUVs );
+    } );
+
+    // offsets of each chunk in the merged arrays
+    vector<size_t> positionBase( numChunks + 1, 0 ), normalBase( numChunks + 1, 0 ), texCoordBase( numChunks + 1, 0 );
+    vector<size_t> cornerBase( numChunks + 1, 0 ), faceBase( numChunks + 1, 0 );
+
+    for( size_t k=0; k < numChunks; k++ )
+    {
+        positionBase[k+1]   = positionBase[k]   + chunks[k].mPositions.size();
+        normalBase[k+1]     = normalBase[k]     + chunks[k].mNormals.size();
+        texCoordBase[k+1]   = texCoordBase[k]   + chunks[k].mTexCoords.size();
+        cornerBase[k+1]     = cornerBase[k]     + chunks[k].mCorners.size();
+        faceBase[k+1]       = faceBase[k]       + chunks[k].mFaceEnds.size();
+    }
+
+    if ( cornerBase[numChunks] > 0x7FFFFFFF || positionBase[numChunks] > 0x7FFFFFFF )
+        throw ObjParserExc( "too many vertices: " + path.string() );
+
+    mPositions.resize( positionBase[numChunks] );
+    mNormals.resize( normalBase[numChunks] );
+    mTexCoords.resize( texCoordBase[numChunks] );
+    mCorners.resize( cornerBase[numChunks] );
+    mFaceStarts.resize( faceBase[numChunks] + 1 );
+    mFaceStarts.back() = (uint32_t)cornerBase[numChunks];
+
+    vector<uint8_t> invalid( numChunks, 0 );
+
+    forEachRange( jobs, numChunks, 1, [&]( size_t k, size_t, size_t ) {
+        const Chunk &chunk = chunks[k];
+
+        copy( chunk.mPositions.begin(), chunk.mPositions.end(), mPositions.begin() + positionBase[k] );
+        copy( chunk.mNormals.begin(),   chunk.mNormals.end(),   mNormals.begin() + normalBase[k] );
+        copy( chunk.mTexCoords.begin(), chunk.mTexCoords.end(), mTexCoords.begin() + texCoordBase[k] );
+
+        for( size_t f=0; f < chunk.mFaceEnds.size(); f++ )
+            mFaceStarts[ faceBase[k] + f ] = (uint32_t)( cornerBase[k] + ( f > 0 ? chunk.mFaceEnds[f-1] : 0 ) );
+
+        // remap the relative indices and check them all against the merged arrays
+        for( size_t c=0; c < chunk.mCorners.size(); c++ )
+        {
+            const ChunkCorner   &src    = chunk.mCorners[c];
+            Corner              &dest   = mCorners[ cornerBase[k] + c ];
+
+            dest.mV = src.mV + (int32_t)( src.mFlags & REL_V ? positionBase[k] : 0 );
+            dest.mT = src.mFlags & HAS_T ? src.mT + (int32_t)( src.mFlags & REL_T ? texCoordBase[k] : 0 ) : -1;
+            dest.mN = src.mFlags & HAS_N ? src.mN + (int32_t)( src.mFlags & REL_N ? normalBase[k] : 0 ) : -1;
+
+            if ( dest.mV < 0 || dest.mV >= (int32_t)mPositions.size()
+                || ( ( src.mFlags & HAS_T ) && ( dest.mT < 0 || dest.mT >= (int32_t)mTexCoords.size() ) )
+                || ( ( src.mFlags & HAS_N ) && ( dest.mN < 0 || dest.mN >= (int32_t)mNormals.size() ) ) )
+                invalid[k] = 1;
+        }
+    } );
+
+    if ( find( invalid.begin(), invalid.end(), 1 ) != invalid.end() )
+        throw ObjParserExc( "invalid face index: " + path.string() );
+
+    // a "g" line closes the current group if it has any faces, the flags are those of any face in the group
+    Group current;
+    current.mFirstFace  = 0;
+    current.mEndFace    = 0;
+    current.mFlags      = 0;
+
+    for( size_t k=0; k < numChunks; k++ )
+    {
+        const Chunk &chunk  = chunks[k];
+        size_t      g       = 0;
+
+        for( size_t f=0; f <= chunk.mFaceEnds.size(); f++ )
+        {
+            while( g < chunk.mGroupStarts.size() && chunk.mGroupStarts[g] <= f )
+            {
+                size_t face = faceBase[k] + f;
+                if ( face > current.mFirstFace )
+                {
+                    current.mEndFace = face;
+                    mGroups.push_back( current );
+                }
+
+                current.mFirstFace  = face;
+                current.mFlags      = 0;
+                g++;
+            }
+
+            if ( f < chunk.mFaceEnds.size() )
+                current.mFlags |= chunk.mFaceFlags[f];
+        }
+    }
+
+    if ( getNumFaces() > current.mFirstFace )
+    {
+        current.mEndFace = getNumFaces();
+        mGroups.push_back( current );
+    }
+}
+
+
+void ObjParser::load( TriMesh *mesh, bool optimize ) const
+{
+    mesh->clear();
+
+    size_t numFaces     = getNumFaces();
+    size_t numCorners   = mCorners.size();
+
+    // fans, faces with less than 3 corners still add their vertices
+    vector<uint32_t> triangleStarts( numFaces + 1, 0 );
+    for( size_t f=0; f < numFaces; f++ )
+    {
+        uint32_t n = mFaceStarts[f+1] - mFaceStarts[f];
+        triangleStarts[f+1] = triangleStarts[f] + ( n > 2 ? n - 2 : 0 );
+    }
+
+    // optimised, every corner maps to the first corner with the same (position, texcoord, normal) indices, texcoords and normals
+    // taking part only in the groups that have them. The first occurrences become the vertices, in order
+    vector<uint32_t> cornerVertex;
+    vector<uint32_t> vertexCorner;
+
+    if ( optimize )
+    {
+        size_t capacity = 16;
+        while( capacity < numCorners * 2 )
+            capacity *= 2;
+
+        WeldEntry empty;
+        empty.mV = -1;
+        empty.mT = empty.mN = 0;
+        empty.mVertex = 0;
+
+        vector<WeldEntry> table( capacity, empty );
+        cornerVertex.resize( numCorners );
+
+        for( size_t g=0; g < mGroups.size(); g++ )
+        {
+            const Group &group = mGroups[g];
+
+            for( size_t c = mFaceStarts[group.mFirstFace]; c < mFaceStarts[group.mEndFace]; c++ )
+            {
+                int32_t v = mCorners[c].mV;
+                int32_t t = group.mFlags & FACE_TEXCOORDS ? mCorners[c].mT : 0;
+                int32_t n = group.mFlags & FACE_NORMALS ? mCorners[c].mN : 0;
+
+                size_t slot = hashCorner( v, t, n ) & ( capacity - 1 );
+                while( table[slot].mV >= 0 && ( table[slot].mV != v || table[slot].mT != t || table[slot].mN != n ) )
+                    slot = ( slot + 1 ) & ( capacity - 1 );
+
+                if ( table[slot].mV < 0 )
+                {
+                    table[slot].mV      = v;
+                    table[slot].mT      = t;
+                    table[slot].mN      = n;
+                    table[slot].mVertex = (uint32_t)vertexCorner.size();
+                    vertexCorner.push_back( (uint32_t)c );
+                }
+
+                cornerVertex[c] = table[slot].mVertex;
+            }
+        }
+    }
+
+    size_t numVertices = optimize ? vertexCorner.size() : numCorners;
+
+    vector<uint32_t> &indices = mesh->getIndices();
+    indices.resize( triangleStarts[numFaces] * 3 );
+
+    forEachRange( mJobs, numFaces, FILL_GRAIN, [&]( size_t, size_t begin, size_t end ) {
+        for( size_t f=begin; f < end; f++ )
+        {
+            uint32_t    first   = mFaceStarts[f];
+            uint32_t    *dest   = indices.data() + triangleStarts[f] * 3;
+
+            for( uint32_t c = first + 2; c < mFaceStarts[f+1]; c++ )
+            {
+                *dest++ = optimize ? cornerVertex[first] : first;
+                *dest++ = optimize ? cornerVertex[c-1] : c - 1;
+                *dest++ = optimize ? cornerVertex[c] : c;
+            }
+        }
+    } );
+
+    bool uniform = true;
+    for( size_t g=1; g < mGroups.size(); g++ )
+        uniform = uniform && mGroups[g].mFlags == mGroups[0].mFlags;
+
+    // same attributes everywhere, the arrays line up with the vertices and can be filled in parallel
+    if ( uniform )
+    {
+        uint8_t flags = mGroups.empty() ? 0 : mGroups[0].mFlags;
+
+        vector<Vec3f> &positions    = mesh->getVertices();
+        vector<Vec3f> &normals      = mesh->getNormals();
+        vector<Vec2f> &texCoords    = mesh->getTexCoords();
+
+        positions.resize( numVertices );
+        normals.resize( flags & FACE_NORMALS ? numVertices : 0 );
+        texCoords.resize( flags & FACE_TEXCOORDS ? numVertices : 0 );
+
+        forEachRange( mJobs, numVertices, FILL_GRAIN, [&]( size_t, size_t begin, size_t end ) {
+            for( size_t k=begin; k < end; k++ )
+            {
+                const Corner &corner = mCorners[ optimize ? vertexCorner[k] : k ];
+
+                positions[k] = mPositions[corner.mV];
+                if ( flags & FACE_NORMALS )
+                    normals[k] = corner.mN >= 0 ? mNormals[corner.mN] : Vec3f::zero();
+                if ( flags & FACE_TEXCOORDS )
+                    texCoords[k] = corner.mT >= 0 ? mTexCoords[corner.mT] : Vec2f::zero();
+            }
+        } );
+
+        return;
+    }
+
+    // mixed groups append in order, as ObjLoader does
+    size_t numAppended = 0;
+
+    for( size_t g=0; g < mGroups.size(); g++ )
+    {
+        const Group &group = mGroups[g];
+
+        for( size_t c = mFaceStarts[group.mFirstFace]; c < mFaceStarts[group.mEndFace]; c++ )
+        {
+            if ( optimize && cornerVertex[c] != numAppended )
+                continue;
+
+            const Corner &corner = mCorners[c];
+
+            mesh->appendVertex( mPositions[corner.mV] );
+            if ( group.mFlags & FACE_NORMALS )
+                mesh->appendNormal( corner.mN >= 0 ? mNormals[corner.mN] : Vec3f::zero() );
+            if ( group.mFlags & FACE_TEXCOORDS )
+                mesh->appendTexCoord( corner.mT >= 0 ? mTexCoords[corner.mT] : Vec2f::zero() );
+
+            numAppended++;
+        }
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "cinder/TriMesh.h"
+#include "cinder/Filesystem.h"
+
+#include <vector>
+#include <stdexcept>
+
+
+class JobSystem;
+
+typedef std::shared_ptr<class ObjParser>    ObjParserRef;
+
+//! Parallel replacement for ObjLoader. The file is memory-mapped and split into line aligned chunks that are parsed
+//! independently, then merged in chunk order with the relative (negative) indices remapped, so the result never depends
+//! on the number of threads. load() builds the same TriMesh as ObjLoader::load( &mesh ) with the same arguments:
+//! per group normals and texcoords, vertices welded on their (position, texcoord, normal) indices when optimising,
+//! polygons triangulated as fans. Materials are ignored, as ObjLoader does without a material source.
+class ObjParser {
+
+public:
+
+    //! Maps and parses \a path, throws ObjParserExc on invalid indices and MappedFileExc if the file can't be read.
+    //! With \a jobs the chunks are parsed in parallel, \a jobs is also used by load().
+    static ObjParserRef create( const ci::fs::path &path, bool includeUVs = true, JobSystem *jobs = nullptr )
+    {
+        return ObjParserRef( new ObjParser( path, includeUVs, jobs ) );
+    }
+
+    //! Clears \a mesh and fills it with all the groups.
+    void        load( ci::TriMesh *mesh, bool optimize = true ) const;
+
+    size_t      getNumGroups() const            { return mGroups.size(); }
+    size_t      getNumFaces() const             { return mFaceStarts.empty() ? 0 : mFaceStarts.size() - 1; }
+
+    //! Parses a float the way an input stream does, [sign] digits [. digits] [e [sign] digits], and returns the end of the number.
+    //! Returns \a begin and sets \a result to 0 when there are no digits. Short decimals are converted exactly with a single
+    //! float multiply or divide by a power of ten, everything else goes through strtof.
+    static const char*  parseFloat( const char *begin, const char *end, float *result );
+
+private:
+
+    ObjParser( const ci::fs::path &path, bool includeUVs, JobSystem *jobs );
+
+    struct Corner {
+        int32_t     mV, mT, mN;     // 0 based, -1 if missing
+    };
+
+    struct Group {
+        size_t      mFirstFace, mEndFace;
+        uint8_t     mFlags;         // texcoords and normals of any of the faces
+    };
+
+    JobSystem               *mJobs;
+
+    std::vector<ci::Vec3f>  mPositions;
+    std::vector<ci::Vec3f>  mNormals;
+    std::vector<ci::Vec2f>  mTexCoords;
+    std::vector<Corner>     mCorners;
+    std::vector<uint32_t>   mFaceStarts;        // first corner of each face, plus the end
+    std::vector<Group>      mGroups;
+};
+
+
+class ObjParserExc : public std::runtime_error {
+public:
+    ObjParserExc( const std::string &msg ) : std::runtime_error( msg ) {}
+};
@@ -0,0 +1,140 @@
+#include "ParticleKernels.h"
+#include "SimdMath.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+
+using namespace std;
+
+
+void polarToCartesian( const float *angle, const float *radius, float *x, float *y, size_t count )
+{
+    size_t k = 0;
+
+#if SIMD_SSE2
+    for( ; k + 4 <= count; k += 4 )
+    {
+        __m128 s, c;
+        simd::sincos( _mm_loadu_ps( angle + k ), &s, &c );
+
+        __m128 r = _mm_loadu_ps( radius + k );
+        _mm_storeu_ps( x + k, _mm_mul_ps( c, r ) );
+        _mm_storeu_ps( y + k, _mm_mul_ps( s, r ) );
+    }
+#endif
+
+    for( ; k < count; k++ )
+    {
+        float s, c;
+        simd::sincos( angle[k], &s, &c );
+
+        x[k] = c * radius[k];
+        y[k] = s * radius[k];
+    }
+}
+
+
+void PairSweep::sweep( const float *x, const float *y, size_t count, float maxDist, JobSystem *jobs )
+{
+    mPairs.clear();
+    mAlpha.clear();
+
+    // keep the previous order if the count hasn't changed, sorting nearly sorted data is cheap
+    if ( mOrder.size() != count )
+    {
+        mOrder.resize( count );
+        for( size_t k=0; k < count; k++ )
+            mOrder[k] = (uint32_t)k;
+    }
+
+    if ( count < 2 || !( maxDist > 0.0f ) )
+        return;
+
+    sort( mOrder.begin(), mOrder.end(), [x]( uint32_t a, uint32_t b ) { return x[a] < x[b]; } );
+
+    mSortedX.resize( count );
+    mSortedY.resize( count );
+
+    for( size_t k=0; k < count; k++ )
+    {
+        mSortedX[k] = x[ mOrder[k] ];
+        mSortedY[k] = y[ mOrder[k] ];
+    }
+
+    // the chunks only depend on the count, not on the number of threads
+    const size_t pointsPerChunk = 1024;
+
+    mChunks.resize( jobs ? JobSystem::getNumChunks( count, pointsPerChunk ) : 1 );
+
+    if ( jobs )
+    {
+        jobs->parallelFor( count, pointsPerChunk, [&]( size_t chunk, size_t begin, size_t end ) {
+            sweep( begin, end, maxDist, &mChunks[chunk] );
+        } );
+    }
+    else
+    {
+        sweep( 0, count, maxDist, &mChunks[0] );
+    }
+
+    for( size_t k=0; k < mChunks.size(); k++ )
+    {
+        mPairs.insert( mPairs.end(), mChunks[k].mPairs.begin(), mChunks[k].mPairs.end() );
+        mAlpha.insert( mAlpha.end(), mChunks[k].mAlpha.begin(), mChunks[k].mAlpha.end() );
+    }
+}
+
+
+void PairSweep::sweep( size_t begin, size_t end, float maxDist, PairList *out ) const
+{
+    const float *sx         = mSortedX.data();
+    const float *sy         = mSortedY.data();
+    size_t      count       = mSortedX.size();
+    float       maxDistSq   = maxDist * maxDist;
+    float       invMaxDist  = 1.0f / maxDist;
+
+    out->mPairs.clear();
+    out->mAlpha.clear();
+
+    for( size_t i=begin; i < end; i++ )
+    {
+        float   xi  = sx[i];
+        float   yi  = sy[i];
+        size_t  j   = i + 1;
+
+#if SIMD_SSE2
+        __m128  xi4         = _mm_set1_ps( xi );
+        __m128  yi4         = _mm_set1_ps( yi );
+        __m128  maxDistSq4  = _mm_set1_ps( maxDistSq );
+
+        // the block may run past the end of the x range, those points fail the distance test anyway
+        for( ; j + 4 <= count && sx[j] - xi < maxDist; j += 4 )
+        {
+            __m128  dx      = _mm_sub_ps( _mm_loadu_ps( sx + j ), xi4 );
+            __m128  dy      = _mm_sub_ps( _mm_loadu_ps( sy + j ), yi4 );
+            __m128  distSq  = _mm_add_ps( _mm_mul_ps( dx, dx ), _mm_mul_ps( dy, dy ) );
+            int     mask    = _mm_movemask_ps( _mm_cmplt_ps( distSq, maxDistSq4 ) );
+
+            if ( mask == 0 )
+                continue;
+
+            float alpha[4];
+            _mm_storeu_ps( alpha, _mm_sub_ps( _mm_set1_ps( 1.0f ), _mm_mul_ps( _mm_sqrt_ps( distSq ), _mm_set1_ps( invMaxDist ) ) ) );
+
+            for( int n=0; n < 4; n++ )
+                if ( mask & ( 1 << n ) )
+                    out->add( mOrder[i], mOrder[j + n], alpha[n] );
+        }
+#endif
+
+        for( ; j < count && sx[j] - xi < maxDist; j++ )
+        {
+            float dx        = sx[j] - xi;
+            float dy        = sy[j] - yi;
+            float distSq    = dx * dx + dy * dy;
+
+            if ( distSq < maxDistSq )
+                out->add( mOrder[i], mOrder[j], 1.0f - sqrt( distSq ) * invMaxDist );
+        }
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+class JobSystem;
+
+
+//! Writes x = cos( angle ) * radius and y = sin( angle ) * radius for \a count particles stored as arrays.
+void polarToCartesian( const float *angle, const float *radius, float *x, float *y, size_t count );
+
+
+//! Finds every pair of points closer than a distance: the points are sorted along x, then each point is swept
+//! against the following ones, 4 at a time, until they are too far apart along x.
+//! The results are compact arrays, nothing is allocated once the buffers have grown.
+class PairSweep {
+
+public:
+
+    //! \a x and \a y hold \a count points. With \a jobs, ranges of points are swept in parallel and merged in order,
+    //! the pairs come out the same either way.
+    void            sweep( const float *x, const float *y, size_t count, float maxDist, JobSystem *jobs = nullptr );
+
+    //! Number of pairs found by the last sweep.
+    size_t          getNumPairs() const     { return mAlpha.size(); }
+    //! Two indices per pair.
+    const uint32_t* getPairs() const        { return mPairs.data(); }
+    //! 1 - dist / maxDist for each pair.
+    const float*    getAlpha() const        { return mAlpha.data(); }
+
+private:
+
+    struct PairList {
+        void add( uint32_t a, uint32_t b, float alpha ) { mPairs.push_back( a ); mPairs.push_back( b ); mAlpha.push_back( alpha ); }
+
+        std::vector<uint32_t>   mPairs;
+        std::vector<float>      mAlpha;
+    };
+
+    void            sweep( size_t begin, size_t end, float maxDist, PairList *out ) const;
+
+    std::vector<uint32_t>   mOrder;         // kept between sweeps, the points barely move from frame to frame
+    std::vector<float>      mSortedX;
+    std::vector<float>      mSortedY;
+    std::vector<uint32_t>   mPairs;
+    std::vector<float>      mAlpha;
+    std::vector<PairList>   mChunks;
+};
@@ -0,0 +1,197 @@
+#include "PcmFile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+using namespace std;
+
+
+namespace {
+
+uint16_t readU16( const uint8_t *p )  { return (uint16_t)( p[0] | ( p[1] << 8 ) ); }
+uint32_t readU32( const uint8_t *p )  { return (uint32_t)p[0] | ( (uint32_t)p[1] << 8 ) | ( (uint32_t)p[2] << 16 ) | ( (uint32_t)p[3] << 24 ); }
+
+}
+
+
+PcmFile::PcmFile( const string &path, size_t rawSampleRate, size_t rawNumChannels )
+: mSamples( nullptr ), mSampleType( FLOAT32 ), mBytesPerSample( 4 ), mSampleRate( rawSampleRate ), mNumChannels( rawNumChannels ), mNumFrames( 0 )
+{
+    mFile = MappedFile::create( path );
+
+    string ext = path.substr( min( path.size(), path.find_last_of( '.' ) ) );
+    transform( ext.begin(), ext.end(), ext.begin(), ::tolower );
+
+    if ( ext == ".wav" || ext == ".wave" )
+    {
+        parseWav();
+    }
+    else
+    {
+        if ( mNumChannels == 0 )
+            throw MappedFileExc( "invalid number of channels for raw file: " + path );
+
+        mSamples    = mFile->getData();
+        mNumFrames  = mFile->getSize() / ( mBytesPerSample * mNumChannels );
+    }
+}
+
+
+PcmFile::PcmFile( size_t sampleRate, double seconds )
+: mSamples( nullptr ), mSampleType( FLOAT32 ), mBytesPerSample( 4 ), mSampleRate( sampleRate ), mNumChannels( 1 ), mNumFrames( 0 )
+{
+    const double    twoPi       = 6.283185307179586;
+    const double    sweepTime   = 4.0;
+    const double    sweepFrom   = 40.0;
+    const double    sweepTo     = 12000.0;
+    const double    kickTime    = 0.5;
+    double          sweepRatio  = log( sweepTo / sweepFrom );
+    uint32_t        noise       = 22222;
+
+    mNumFrames = (uint64_t)( seconds * sampleRate );
+    mSynthetic.resize( (size_t)mNumFrames );
+
+    for( size_t k=0; k < mSynthetic.size(); k++ )
+    {
+        double t = (double)k / sampleRate;
+
+        // exponential sweep, the phase is the integral of the frequency
+        double sweep    = fmod( t, sweepTime );
+        double phase    = twoPi * sweepFrom * sweepTime / sweepRatio * ( exp( sweepRatio * sweep / sweepTime ) - 1.0 );
+
+        double kick     = fmod( t, kickTime );
+        noise           = noise * 1664525u + 1013904223u;
+
+        mSynthetic[k]   = (float)( 0.3 * sin( phase ) + 0.5 * exp( -kick * 20.0 ) * sin( twoPi * 60.0 * kick ) + 0.05 * ( noise / 4294967296.0 * 2.0 - 1.0 ) );
+    }
+
+    mSamples = reinterpret_cast<const uint8_t*>( mSynthetic.data() );
+}
+
+
+void PcmFile::parseWav()
+{
+    const uint8_t   *data   = mFile->getData();
+    size_t          size    = mFile->getSize();
+
+    if ( size < 12 || memcmp( data, "RIFF", 4 ) != 0 || memcmp( data + 8, "WAVE", 4 ) != 0 )
+        throw MappedFileExc( "not a WAV file: " + mFile->getPath() );
+
+    bool    hasFormat   = false;
+    size_t  pos         = 12;
+
+    // walk the chunks, fmt always comes before data
+    while( pos + 8 <= size )
+    {
+        const uint8_t   *chunk      = data + pos;
+        size_t          chunkSize   = readU32( chunk + 4 );
+        const uint8_t   *body       = chunk + 8;
+
+        if ( memcmp( chunk, "fmt ", 4 ) == 0 && chunkSize >= 16 && pos + 8 + chunkSize <= size )
+        {
+            uint16_t    format          = readU16( body );
+            uint16_t    bitsPerSample   = readU16( body + 14 );
+
+            mNumChannels    = readU16( body + 2 );
+            mSampleRate     = readU32( body + 4 );
+
+            // WAVE_FORMAT_EXTENSIBLE keeps the actual format at the start of the sub-format GUID
+            if ( format == 0xFFFE && chunkSize >= 40 )
+                format = readU16( body + 24 );
+
+            if ( format == 1 && bitsPerSample == 16 )           mSampleType = INT16;
+            else if ( format == 1 && bitsPerSample == 24 )      mSampleType = INT24;
+            else if ( format == 1 && bitsPerSample == 32 )      mSampleType = INT32;
+            else if ( format == 3 && bitsPerSample == 32 )      mSampleType = FLOAT32;
+            else
+                throw MappedFileExc( "unsupported WAV sample format: " + mFile->getPath() );
+
+            mBytesPerSample = bitsPerSample / 8;
+            hasFormat       = true;
+        }
+        else if ( memcmp( chunk, "data", 4 ) == 0 && hasFormat && mNumChannels > 0 )
+        {
+            // some writers leave the data size at 0 or past the end when streaming
+            size_t dataSize = min( chunkSize, size - pos - 8 );
+            if ( chunkSize == 0 )
+                dataSize = size - pos - 8;
+
+            mSamples    = body;
+            mNumFrames  = dataSize / ( mBytesPerSample * mNumChannels );
+            return;
+        }
+
+        // chunks are word aligned
+        pos += 8 + chunkSize + ( chunkSize & 1 );
+    }
+
+    throw MappedFileExc( "WAV file without audio data: " + mFile->getPath() );
+}
+
+
+size_t PcmFile::read( size_t channel, uint64_t frame, float *dest, size_t numFrames ) const
+{
+    if ( frame >= mNumFrames || channel >= mNumChannels )
+        return 0;
+
+    numFrames = (size_t)min<uint64_t>( numFrames, mNumFrames - frame );
+
+    size_t          stride  = mBytesPerSample * mNumChannels;
+    const uint8_t   *src    = mSamples + frame * stride + channel * mBytesPerSample;
+
+    switch( mSampleType )
+    {
+        case INT16:
+            for( size_t k=0; k < numFrames; k++, src += stride )
+                dest[k] = (int16_t)readU16( src ) * ( 1.0f / 32768.0f );
+            break;
+
+        case INT24:
+            for( size_t k=0; k < numFrames; k++, src += stride )
+                dest[k] = ( (int32_t)( ( (uint32_t)src[0] << 8 ) | ( (uint32_t)src[1] << 16 ) | ( (uint32_t)src[2] << 24 ) ) >> 8 ) * ( 1.0f / 8388608.0f );
+            break;
+
+        case INT32:
+            for( size_t k=0; k < numFrames; k++, src += stride )
+                dest[k] = (int32_t)readU32( src ) * ( 1.0f / 2147483648.0f );
+            break;
+
+        case FLOAT32:
+            for( size_t k=0; k < numFrames; k++, src += stride )
+            {
+                uint32_t bits = readU32( src );
+                memcpy( &dest[k], &bits, sizeof(float) );
+            }
+            break;
+    }
+
+    return numFrames;
+}
+
+
+void PcmFile::readLooped( size_t channel, uint64_t frame, float *dest, size_t numFrames ) const
+{
+    if ( mNumFrames == 0 )
+    {
+        fill( dest, dest + numFrames, 0.0f );
+        return;
+    }
+
+    frame %= mNumFrames;
+
+    while( numFrames > 0 )
+    {
+        size_t n    = read( channel, frame, dest, numFrames );
+        dest       += n;
+        numFrames  -= n;
+        frame       = 0;
+
+        // channel out of range
+        if ( n == 0 )
+        {
+            fill( dest, dest + numFrames, 0.0f );
+            return;
+        }
+    }
+}
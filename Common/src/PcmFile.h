@@ -0,0 +1,56 @@
+#pragma once
+
+#include "MappedFile.h"
+
+#include <vector>
+
+
+typedef std::shared_ptr<class PcmFile>  PcmFileRef;
+
+//! PCM audio read straight out of a memory-mapped WAV or raw file, converted to float on the fly.
+//! WAV files can be 16, 24 or 32 bit integer or 32 bit float, raw files are interleaved 32 bit float.
+//! A synthetic signal can stand in for a file when the input has to be the same on every machine.
+class PcmFile {
+
+public:
+
+    //! Opens a WAV file, or a raw file if the extension is neither .wav nor .wave. Throws MappedFileExc on failure.
+    static PcmFileRef create( const std::string &path, size_t rawSampleRate = 44100, size_t rawNumChannels = 1 )
+    {
+        return PcmFileRef( new PcmFile( path, rawSampleRate, rawNumChannels ) );
+    }
+
+    //! \a seconds of a mono test signal generated in memory, always the same: a sweep from 40 Hz to 12 kHz
+    //! every 4 seconds, a low kick every half second and some white noise, so all the bands move.
+    static PcmFileRef createSynthetic( size_t sampleRate = 44100, double seconds = 8.0 )
+    {
+        return PcmFileRef( new PcmFile( sampleRate, seconds ) );
+    }
+
+    size_t      getSampleRate() const   { return mSampleRate; }
+    size_t      getNumChannels() const  { return mNumChannels; }
+    uint64_t    getNumFrames() const    { return mNumFrames; }
+
+    //! Converts \a numFrames of \a channel, starting at \a frame, into \a dest. Returns the number of frames read.
+    size_t      read( size_t channel, uint64_t frame, float *dest, size_t numFrames ) const;
+    //! Always fills \a numFrames, \a frame wraps around the end of the file.
+    void        readLooped( size_t channel, uint64_t frame, float *dest, size_t numFrames ) const;
+
+private:
+
+    PcmFile( const std::string &path, size_t rawSampleRate, size_t rawNumChannels );
+    PcmFile( size_t sampleRate, double seconds );
+
+    void        parseWav();
+
+    enum SampleType { INT16, INT24, INT32, FLOAT32 };
+
+    MappedFileRef       mFile;
+    std::vector<float>  mSynthetic;
+    const uint8_t       *mSamples;
+    SampleType          mSampleType;
+    size_t              mBytesPerSample;
+    size_t              mSampleRate;
+    size_t              mNumChannels;
+    uint64_t            mNumFrames;
+};
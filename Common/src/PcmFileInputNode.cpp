@@ -0,0 +1,37 @@
+#include "PcmFileInputNode.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace ci;
+using namespace std;
+
+
+PcmFileInputNode::PcmFileInputNode( const PcmFileRef &file, bool loop, const Format &format )
+: audio::InputNode( format ), mFile( file ), mLoop( loop ), mReadPos( 0 )
+{
+}
+
+
+void PcmFileInputNode::process( audio::Buffer *buffer )
+{
+    // runs on the audio thread, reads straight out of the mapped file
+    size_t      numFrames   = buffer->getNumFrames();
+    uint64_t    pos         = mReadPos;
+    float       *dest       = buffer->getChannel( 0 );
+
+    if ( mLoop )
+    {
+        mFile->readLooped( 0, pos, dest, numFrames );
+    }
+    else
+    {
+        size_t n = mFile->read( 0, pos, dest, numFrames );
+        fill( dest + n, dest + numFrames, 0.0f );
+    }
+
+    mReadPos = pos + numFrames;
+
+    for( size_t ch=1; ch < buffer->getNumChannels(); ch++ )
+        memcpy( buffer->getChannel( ch ), dest, numFrames * sizeof(float) );
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "cinder/audio/InputNode.h"
+
+#include "PcmFile.h"
+
+#include <atomic>
+
+
+typedef std::shared_ptr<class PcmFileInputNode>   PcmFileInputNodeRef;
+
+//! Plays a PcmFile into the audio graph in real time, a drop-in replacement for the input device node.
+//! Every output channel gets the first channel of the file.
+class PcmFileInputNode : public ci::audio::InputNode {
+
+public:
+
+    PcmFileInputNode( const PcmFileRef &file, bool loop = true, const Format &format = Format() );
+
+    const PcmFileRef&   getFile() const         { return mFile; }
+    uint64_t            getReadPos() const      { return mReadPos; }
+    bool                isFinished() const      { return !mLoop && mReadPos >= mFile->getNumFrames(); }
+
+protected:
+
+    void process( ci::audio::Buffer *buffer ) override;
+
+    PcmFileRef              mFile;
+    bool                    mLoop;
+    std::atomic<uint64_t>   mReadPos;
+};
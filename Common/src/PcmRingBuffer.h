@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+
+//! Single-producer / single-consumer lock-free ring of mono PCM samples.
+//! The producer (the audio thread) never blocks: it keeps writing and the oldest samples are overwritten.
+//! Each sample is stored twice, at i and i + capacity, so any window up to the capacity can be read
+//! by the consumer as one contiguous block, without copying it out of the ring.
+class PcmRingBuffer {
+
+public:
+
+    PcmRingBuffer( size_t capacity = 0 ) : mWriteCount( 0 ) { resize( capacity ); }
+
+    //! Not thread safe, call it before the producer starts.
+    void resize( size_t capacity )
+    {
+        mCapacity = capacity;
+        mData.assign( capacity * 2, 0.0f );
+        mWriteCount.store( 0 );
+    }
+
+    size_t      getCapacity() const { return mCapacity; }
+
+    //! Producer side. Appends \a count samples, overwriting the oldest ones.
+    void write( const float *samples, size_t count )
+    {
+        if ( mCapacity == 0 )
+            return;
+
+        uint64_t writeCount = mWriteCount.load( std::memory_order_relaxed );
+
+        // only the last mCapacity samples would survive anyway
+        if ( count > mCapacity )
+        {
+            writeCount  += count - mCapacity;
+            samples     += count - mCapacity;
+            count        = mCapacity;
+        }
+
+        size_t pos  = (size_t)( writeCount % mCapacity );
+        size_t n    = std::min( count, mCapacity - pos );
+
+        writeMirrored( pos, samples, n );
+        writeMirrored( 0, samples + n, count - n );
+
+        mWriteCount.store( writeCount + count, std::memory_order_release );
+    }
+
+    //! Total number of samples written since the last resize().
+    uint64_t getWriteCount() const { return mWriteCount.load( std::memory_order_acquire ); }
+
+    //! Consumer side. Returns a view of the \a size samples that end at \a endSample (exclusive).
+    //! The view stays valid until the producer writes past endSample - size + capacity.
+    const float* getWindow( uint64_t endSample, size_t size ) const
+    {
+        size = std::min( size, mCapacity );
+        uint64_t start = endSample >= size ? endSample - size : 0;
+        return &mData[ (size_t)( start % mCapacity ) ];
+    }
+
+    //! Consumer side. Returns a view of the most recent \a size samples.
+    const float* getLatestWindow( size_t size ) const { return getWindow( getWriteCount(), size ); }
+
+    //! Consumer side. True if the window starting at \a startSample has not been overwritten yet.
+    bool isAvailable( uint64_t startSample ) const { return getWriteCount() <= startSample + mCapacity; }
+
+private:
+
+    void writeMirrored( size_t pos, const float *samples, size_t count )
+    {
+        if ( count == 0 )
+            return;
+
+        std::memcpy( &mData[pos],               samples, count * sizeof(float) );
+        std::memcpy( &mData[pos + mCapacity],   samples, count * sizeof(float) );
+    }
+
+    std::vector<float>      mData;
+    size_t                  mCapacity;
+    std::atomic<uint64_t>   mWriteCount;
+};
@@ -0,0 +1,23 @@
+#include "PcmTapNode.h"
+
+using namespace ci;
+
+
+PcmTapNode::PcmTapNode( PcmRingBuffer *ringBuffer, const Format &format )
+: audio::NodeAutoPullable( format ), mRingBuffer( ringBuffer ), mTraceBuffer( nullptr ), mLatencyProbe( nullptr )
+{
+}
+
+
+void PcmTapNode::process( audio::Buffer *buffer )
+{
+    // runs on the audio thread, the ring never blocks nor allocates
+    Tracer::Scope trace( mTraceBuffer.load( std::memory_order_relaxed ), "Audio callback" );
+
+    // the tap has no output, the impulse only goes to the ring
+    LatencyProbe *probe = mLatencyProbe.load( std::memory_order_acquire );
+    if ( probe )
+        probe->processInput( buffer->getChannel( 0 ), buffer->getNumFrames(), mRingBuffer->getWriteCount() );
+
+    mRingBuffer->write( buffer->getChannel( 0 ), buffer->getNumFrames() );
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "cinder/audio/Node.h"
+
+#include "PcmRingBuffer.h"
+#include "Tracer.h"
+#include "LatencyProbe.h"
+
+
+typedef std::shared_ptr<class PcmTapNode>   PcmTapNodeRef;
+
+//! Pulls audio like MonitorNode, but instead of keeping its own copy it writes the first channel
+//! straight into a PcmRingBuffer from the audio callback.
+class PcmTapNode : public ci::audio::NodeAutoPullable {
+
+public:
+
+    PcmTapNode( PcmRingBuffer *ringBuffer, const Format &format = Format() );
+
+    //! Records each callback in \a buffer, which then belongs to the audio thread. Null stops recording.
+    void            setTraceBuffer( Tracer::Buffer *buffer )    { mTraceBuffer = buffer; }
+    //! Lets \a probe inject or detect its impulses in the samples written to the ring. Null stops it.
+    void            setLatencyProbe( LatencyProbe *probe )      { mLatencyProbe.store( probe, std::memory_order_release ); }
+
+protected:
+
+    void process( ci::audio::Buffer *buffer ) override;
+
+    PcmRingBuffer                   *mRingBuffer;
+    std::atomic<Tracer::Buffer*>    mTraceBuffer;
+    std::atomic<LatencyProbe*>      mLatencyProbe;
+};
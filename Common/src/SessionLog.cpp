@@ -0,0 +1,328 @@
+#include "SessionLog.h"
+
+#include "cinder/app/App.h"
+#include "cinder/Rand.h"
+
+#include <thread>
+#include <chrono>
+#include <limits>
+#include <cstring>
+#include <ctime>
+
+using namespace ci;
+using namespace ci::app;
+using namespace std;
+
+
+SessionLog::Format& SessionLog::Format::args( const vector<string> &args )
+{
+    for( size_t k=0; k < args.size(); k++ )
+    {
+        if ( args[k] == "--capture" && k + 1 < args.size() )
+            capture( args[++k] );
+
+        else if ( args[k] == "--replay" && k + 1 < args.size() )
+            replay( args[++k], mRealtime );
+
+        else if ( args[k] == "--replay-fast" )
+            mRealtime = false;
+    }
+
+    return *this;
+}
+
+
+SessionLog::SessionLog( const Format &format )
+: mMode( format.mMode ), mRealtime( format.mRealtime ), mPath( format.mPath ), mTimer( true ), mFrame( 0 ), mTime( 0.0 ), mReplayDelay( 0.0 ), mSampleRate( 44100 ),
+  mFinished( false ), mReadPos( 0 )
+{
+    Header header;
+    memset( &header, 0, sizeof(Header) );
+
+    if ( mMode == CAPTURE )
+    {
+        memcpy( header.mMagic, "RWSL", 4 );
+        header.mVersion = VERSION;
+        header.mSeed    = (uint32_t)time( nullptr );
+
+        mOut.open( mPath.c_str(), ios::binary | ios::trunc );
+        mOut.write( (const char*)&header, sizeof(Header) );
+
+        if ( !mOut )
+        {
+            console() << "SessionLog: cannot write \"" << mPath << "\"" << endl;
+            mMode = DISABLED;
+            return;
+        }
+
+        randSeed( header.mSeed );
+        console() << "SessionLog: capturing to " << mPath << endl;
+    }
+
+    else if ( mMode == REPLAY )
+    {
+        try {
+            mFile = MappedFile::create( mPath );
+        }
+        catch( const MappedFileExc &exc ) {
+            console() << "SessionLog: cannot open \"" << mPath << "\": " << exc.what() << endl;
+            mMode = DISABLED;
+            return;
+        }
+
+        if ( mFile->getSize() >= sizeof(Header) )
+            memcpy( &header, mFile->getData(), sizeof(Header) );
+
+        if ( memcmp( header.mMagic, "RWSL", 4 ) != 0 || header.mVersion != VERSION )
+        {
+            console() << "SessionLog: \"" << mPath << "\" isn't a session log" << endl;
+            mFile.reset();
+            mMode = DISABLED;
+            return;
+        }
+
+        mReadPos = sizeof(Header);
+
+        // the records before the first frame describe the audio, the analyser needs them before the replay starts
+        readRecords( false );
+
+        randSeed( header.mSeed );
+        console() << "SessionLog: replaying " << mPath << ( mRealtime ? " in real time" : " as fast as possible" ) << endl;
+    }
+}
+
+
+SessionLog::~SessionLog()
+{
+    if ( mOut.is_open() )
+        mOut.close();
+}
+
+
+void SessionLog::addParam( const string &name, ParamType type, void *value, uint32_t count )
+{
+    Param param;
+    param.mName     = name;
+    param.mType     = type;
+    param.mValue    = value;
+    param.mCount    = count;
+    param.mNamed    = false;
+    param.mLast.assign( count, numeric_limits<double>::quiet_NaN() );
+
+    mParams.push_back( param );
+}
+
+
+double SessionLog::getValue( const Param &param, uint32_t k ) const
+{
+    switch( param.mType )
+    {
+        case FLOAT: return ( (const float*)param.mValue )[k];
+        case INT:   return ( (const int*)param.mValue )[k];
+        default:    return ( (const bool*)param.mValue )[k] ? 1.0 : 0.0;
+    }
+}
+
+
+void SessionLog::setValue( Param &param, uint32_t k, double value )
+{
+    switch( param.mType )
+    {
+        case FLOAT: ( (float*)param.mValue )[k] = (float)value;     break;
+        case INT:   ( (int*)param.mValue )[k]   = (int)value;       break;
+        default:    ( (bool*)param.mValue )[k]  = value != 0.0;     break;
+    }
+}
+
+
+bool SessionLog::beginFrame()
+{
+    if ( mMode == CAPTURE )
+    {
+        mTime = mTimer.getSeconds();
+        captureFrame();
+    }
+    else if ( mMode == REPLAY )
+    {
+        if ( !readRecords( true ) )
+            return false;
+
+        // real time waits until the frame is due. A late frame delays the schedule by its lateness,
+        // so the next frames keep their captured spacing instead of running back to back to catch up
+        double wait = mTime + mReplayDelay - mTimer.getSeconds();
+        if ( mRealtime && wait > 0.0 )
+            this_thread::sleep_for( chrono::microseconds( (int64_t)( wait * 1e6 ) ) );
+        else if ( mRealtime )
+            mReplayDelay -= wait;
+    }
+    else
+    {
+        mTime = mTimer.getSeconds();
+    }
+
+    mFrame++;
+
+    return true;
+}
+
+
+void SessionLog::writeRecord( uint32_t type, const void *data, uint32_t size, const void *extra, uint32_t extraSize )
+{
+    static const char padding[4] = { 0, 0, 0, 0 };
+
+    RecordHeader header;
+    header.mType = type;
+    header.mSize = ( size + extraSize + 3 ) & ~3u;
+
+    mOut.write( (const char*)&header, sizeof(RecordHeader) );
+    mOut.write( (const char*)data, size );
+
+    if ( extra )
+        mOut.write( (const char*)extra, extraSize );
+
+    mOut.write( padding, header.mSize - size - extraSize );
+}
+
+
+void SessionLog::captureFrame()
+{
+    struct { uint64_t mFrame; double mTime; } frame = { mFrame, mTime };
+    writeRecord( FRAME, &frame, sizeof(frame) );
+
+    // only the values that changed since the previous frame, the first frame has them all
+    for( size_t k=0; k < mParams.size(); k++ )
+    {
+        Param   &param      = mParams[k];
+        bool    changed     = false;
+
+        for( uint32_t i=0; i < param.mCount; i++ )
+        {
+            double value = getValue( param, i );
+            if ( value != param.mLast[i] )
+            {
+                param.mLast[i]  = value;
+                changed         = true;
+            }
+        }
+
+        if ( !changed )
+            continue;
+
+        if ( !param.mNamed )
+        {
+            uint32_t name[3] = { (uint32_t)k, (uint32_t)param.mType, param.mCount };
+            writeRecord( PARAM_NAME, name, sizeof(name), param.mName.c_str(), (uint32_t)param.mName.size() );
+            param.mNamed = true;
+        }
+
+        uint32_t id[2] = { (uint32_t)k, param.mCount };
+        writeRecord( PARAM, id, sizeof(id), param.mLast.data(), param.mCount * sizeof(double) );
+    }
+
+    // about once a second, so a crash loses little of the session
+    if ( mFrame % 60 == 59 )
+        mOut.flush();
+}
+
+
+void SessionLog::addPcm( const float *samples, size_t count )
+{
+    if ( mMode == CAPTURE && count > 0 )
+        writeRecord( PCM, samples, (uint32_t)( count * sizeof(float) ) );
+}
+
+
+void SessionLog::setSampleRate( uint32_t rate )
+{
+    if ( mMode != CAPTURE )
+        return;
+
+    mSampleRate = rate;
+    writeRecord( SAMPLE_RATE, &rate, sizeof(rate) );
+}
+
+
+bool SessionLog::readRecords( bool frame )
+{
+    const uint8_t   *data   = mFile->getData();
+    size_t          size    = mFile->getSize();
+    bool            started = false;
+
+    mPcm.clear();
+
+    // reads the next frame and its records up to the following one, or only what comes before the first frame
+    while( mReadPos + sizeof(RecordHeader) <= size )
+    {
+        RecordHeader header;
+        memcpy( &header, data + mReadPos, sizeof(RecordHeader) );
+
+        if ( header.mType == FRAME && ( started || !frame ) )
+            return started;
+
+        const uint8_t *payload = data + mReadPos + sizeof(RecordHeader);
+
+        if ( header.mSize > size - mReadPos - sizeof(RecordHeader) )
+            break;
+
+        mReadPos += sizeof(RecordHeader) + header.mSize;
+
+        if ( header.mType == FRAME && header.mSize >= 16 )
+        {
+            memcpy( &mTime, payload + 8, sizeof(double) );
+            started = true;
+        }
+        else if ( header.mType == SAMPLE_RATE && header.mSize >= 4 )
+        {
+            memcpy( &mSampleRate, payload, sizeof(uint32_t) );
+        }
+        else if ( header.mType == PARAM_NAME && header.mSize >= 12 )
+        {
+            uint32_t name[3];
+            memcpy( name, payload, sizeof(name) );
+
+            // ids are indices of watched values, anything larger is a damaged log
+            if ( name[0] > 0xffff )
+                continue;
+
+            // the name is padded with zeros
+            string  text( (const char*)payload + 12, header.mSize - 12 );
+            text = text.c_str();
+
+            if ( name[0] >= mReplayParams.size() )
+                mReplayParams.resize( name[0] + 1, -1 );
+
+            for( size_t k=0; k < mParams.size(); k++ )
+                if ( mParams[k].mName == text && mParams[k].mType == name[1] && mParams[k].mCount == name[2] )
+                    mReplayParams[name[0]] = (int)k;
+        }
+        else if ( header.mType == PARAM && header.mSize >= 8 )
+        {
+            uint32_t id[2];
+            memcpy( id, payload, sizeof(id) );
+
+            if ( id[0] >= mReplayParams.size() || mReplayParams[id[0]] < 0 || id[1] * sizeof(double) > header.mSize - 8 )
+                continue;
+
+            Param &param = mParams[ mReplayParams[id[0]] ];
+
+            for( uint32_t i=0; i < id[1] && i < param.mCount; i++ )
+            {
+                double value;
+                memcpy( &value, payload + 8 + i * sizeof(double), sizeof(double) );
+                setValue( param, i, value );
+            }
+        }
+        else if ( header.mType == PCM )
+        {
+            // records are 4 byte aligned in a page aligned mapping
+            mPcm.push_back( make_pair( (const float*)payload, header.mSize / sizeof(float) ) );
+        }
+    }
+
+    mReadPos = size;
+
+    if ( !started && frame )
+        mFinished = true;
+
+    return started;
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include "cinder/Timer.h"
+#include "cinder/Color.h"
+
+#include "MappedFile.h"
+
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+
+typedef std::shared_ptr<class SessionLog>   SessionLogRef;
+
+//! Captures what drives an app, the PCM fed to the analysis and the changes of the watched parameters, frame by frame
+//! into a binary log, and replays it so that a glitch seen live can be reproduced and profiled offline.
+//! Replaying feeds frame n the samples captured at frame n and applies the parameters changed at frame n, either at the
+//! captured pace or as fast as possible. The random seed is part of the log, what the app draws from ci::Rand repeats too.
+//! A live threaded analysis picks up results whenever the worker publishes them, its replay analyses every captured
+//! sample in the frame it was captured in, so the results can be a frame ahead of what was seen live.
+//!
+//! The log is a 16 byte header followed by records, each a type and a payload size, all multiples of 4 bytes:
+//! FRAME { frame, seconds }, PARAM_NAME { id, type, components, name }, PARAM { id, components, values }, PCM { samples }.
+//! Samples are stored as they were analysed, 32 bit float, about 10 MB per minute at 44.1 kHz.
+class SessionLog {
+
+public:
+
+    enum Mode { DISABLED, CAPTURE, REPLAY };
+
+    struct Format {
+        Format() : mMode( DISABLED ), mRealtime( true ) {}
+
+        //! Writes the session to \a path.
+        Format& capture( const std::string &path )                          { mMode = CAPTURE; mPath = path; return *this; }
+        //! Replays the session in \a path, at the captured pace or as fast as possible.
+        Format& replay( const std::string &path, bool realtime = true )     { mMode = REPLAY; mPath = path; mRealtime = realtime; return *this; }
+        //! Picks up "--capture <path>", "--replay <path>" and "--replay-fast" from the command line.
+        Format& args( const std::vector<std::string> &args );
+
+        Mode            mMode;
+        std::string     mPath;
+        bool            mRealtime;
+    };
+
+    //! Seeds ci::Rand, with a new seed when capturing and the captured one when replaying, create it before anything is randomised.
+    static SessionLogRef create( const Format &format = Format() )  { return SessionLogRef( new SessionLog( format ) ); }
+
+    ~SessionLog();
+
+    //! Records the changes of \a value, or sets it when replaying. Watch the values before the first frame.
+    void            watch( const std::string &name, float *value )          { addParam( name, FLOAT, value, 1 ); }
+    void            watch( const std::string &name, int *value )            { addParam( name, INT, value, 1 ); }
+    void            watch( const std::string &name, bool *value )           { addParam( name, BOOL, value, 1 ); }
+    void            watch( const std::string &name, ci::Color *value )      { addParam( name, FLOAT, &value->r, 3 ); }
+    void            watch( const std::string &name, ci::ColorA *value )     { addParam( name, FLOAT, &value->r, 4 ); }
+
+    //! Starts a frame, call it first thing in update(). Capturing writes the changed parameters, replaying applies
+    //! the ones of the next captured frame, after waiting for its time in real time mode. Returns false once the replay is over.
+    bool            beginFrame();
+
+    //! Capture side, appends a block of the samples fed to the analysis this frame. Called by AudioAnalyzer.
+    void            addPcm( const float *samples, size_t count );
+    //! Replay side, the blocks of samples of the current frame in the order they were fed, views into the mapped log.
+    size_t          getNumPcm() const               { return mPcm.size(); }
+    const float*    getPcm( size_t n ) const        { return mPcm[n].first; }
+    size_t          getPcmSize( size_t n ) const    { return mPcm[n].second; }
+
+    //! Capture side, stored in the log for the replay.
+    void            setSampleRate( uint32_t rate );
+    uint32_t        getSampleRate() const           { return mSampleRate; }
+
+    Mode            getMode() const                 { return mMode; }
+    bool            isCapturing() const             { return mMode == CAPTURE; }
+    bool            isReplaying() const             { return mMode == REPLAY; }
+    bool            isRealtime() const              { return mRealtime; }
+    //! True once every captured frame has been replayed.
+    bool            isFinished() const              { return mFinished; }
+
+    //! Frames since the start of the session.
+    uint64_t        getFrame() const                { return mFrame; }
+    //! Seconds at the start of the current frame, the captured time when replaying. Use it instead of getElapsedSeconds().
+    double          getTime() const                 { return mTime; }
+
+    static const uint32_t   VERSION = 1;
+
+private:
+
+    SessionLog( const Format &format );
+
+    enum ParamType { FLOAT, INT, BOOL };
+    enum RecordType { FRAME = 1, PARAM_NAME, PARAM, PCM, SAMPLE_RATE };
+
+    struct Header {
+        char        mMagic[4];          // "RWSL"
+        uint32_t    mVersion;
+        uint32_t    mSeed;
+        uint32_t    mReserved;
+    };
+
+    struct RecordHeader {
+        uint32_t    mType;
+        uint32_t    mSize;              // payload bytes, a multiple of 4
+    };
+
+    struct Param {
+        std::string         mName;
+        ParamType           mType;
+        void                *mValue;
+        uint32_t            mCount;
+        std::vector<double> mLast;      // NaN until captured once, so the first frame records every value
+        bool                mNamed;     // PARAM_NAME written
+    };
+
+    void            addParam( const std::string &name, ParamType type, void *value, uint32_t count );
+    double          getValue( const Param &param, uint32_t k ) const;
+    void            setValue( Param &param, uint32_t k, double value );
+
+    void            writeRecord( uint32_t type, const void *data, uint32_t size, const void *extra = nullptr, uint32_t extraSize = 0 );
+    void            captureFrame();
+    bool            readRecords( bool frame );
+
+    Mode                    mMode;
+    bool                    mRealtime;
+    std::string             mPath;
+    ci::Timer               mTimer;
+    uint64_t                mFrame;
+    double                  mTime;
+    double                  mReplayDelay;       // seconds the real time replay has slipped behind the capture
+    uint32_t                mSampleRate;
+    std::vector<Param>      mParams;
+    bool                    mFinished;
+
+    std::ofstream           mOut;               // capture
+
+    MappedFileRef           mFile;              // replay
+    size_t                  mReadPos;
+    std::vector<int>        mReplayParams;      // captured id to index in mParams, -1 if not watched
+    std::vector<std::pair<const float*, size_t> >   mPcm;   // only grows, a frame has one block unless the ring was filled more than once
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+
+// SSE2 is always there on x86_64, and the 32 bit builds target it too. Defining SIMD_SSE2 as 0 forces the scalar paths
+#if !defined( SIMD_SSE2 )
+    #if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+        #define SIMD_SSE2 1
+    #else
+        #define SIMD_SSE2 0
+    #endif
+#endif
+
+#if SIMD_SSE2
+    #include <emmintrin.h>
+#endif
+
+
+//! Small vectorised math helpers shared by the particle and mesh kernels.
+//! The scalar versions run the same steps, so SIMD and scalar builds agree to rounding.
+namespace simd {
+
+// Cephes range reduction and minimax polynomials, accurate to a couple of ulp for |x| < 8192
+const float kFourOverPi     = 1.27323954473516f;
+const float kDP1            = 0.78515625f;
+const float kDP2            = 2.4187564849853515625e-4f;
+const float kDP3            = 3.77489497744594108e-8f;
+const float kSinC0          = -1.9515295891e-4f;
+const float kSinC1          = 8.3321608736e-3f;
+const float kSinC2          = -1.6666654611e-1f;
+const float kCosC0          = 2.443315711809948e-5f;
+const float kCosC1          = -1.388731625493765e-3f;
+const float kCosC2          = 4.166664568298827e-2f;
+
+//! Scalar sine and cosine of \a x.
+inline void sincos( float x, float *s, float *c )
+{
+    float   sign    = x < 0.0f ? -1.0f : 1.0f;
+    float   ax      = std::fabs( x );
+    int32_t j       = ( (int32_t)( ax * kFourOverPi ) + 1 ) & ~1;
+    float   y       = (float)j;
+    float   r       = ( ( ax - y * kDP1 ) - y * kDP2 ) - y * kDP3;
+    float   z       = r * r;
+
+    float   polyS   = ( ( kSinC0 * z + kSinC1 ) * z + kSinC2 ) * z * r + r;
+    float   polyC   = ( ( kCosC0 * z + kCosC1 ) * z + kCosC2 ) * z * z - 0.5f * z + 1.0f;
+
+    // quadrant of x
+    int32_t n       = j >> 1;
+    bool    swap    = ( n & 1 ) != 0;
+
+    *s = ( swap ? polyC : polyS ) * ( ( n & 2 ) ? -sign : sign );
+    *c = ( swap ? polyS : polyC ) * ( ( ( n + 1 ) & 2 ) ? -1.0f : 1.0f );
+}
+
+#if SIMD_SSE2
+
+//! Sine and cosine of 4 floats.
+inline void sincos( __m128 x, __m128 *s, __m128 *c )
+{
+    const __m128    signMask    = _mm_castsi128_ps( _mm_set1_epi32( (int)0x80000000 ) );
+    const __m128i   one         = _mm_set1_epi32( 1 );
+    const __m128i   two         = _mm_set1_epi32( 2 );
+
+    __m128  sign    = _mm_and_ps( x, signMask );
+    __m128  ax      = _mm_andnot_ps( signMask, x );
+    __m128i j       = _mm_and_si128( _mm_add_epi32( _mm_cvttps_epi32( _mm_mul_ps( ax, _mm_set1_ps( kFourOverPi ) ) ), one ), _mm_set1_epi32( ~1 ) );
+    __m128  y       = _mm_cvtepi32_ps( j );
+
+    __m128  r       = _mm_sub_ps( ax, _mm_mul_ps( y, _mm_set1_ps( kDP1 ) ) );
+    r               = _mm_sub_ps( r, _mm_mul_ps( y, _mm_set1_ps( kDP2 ) ) );
+    r               = _mm_sub_ps( r, _mm_mul_ps( y, _mm_set1_ps( kDP3 ) ) );
+    __m128  z       = _mm_mul_ps( r, r );
+
+    __m128  polyS   = _mm_add_ps( _mm_mul_ps( _mm_set1_ps( kSinC0 ), z ), _mm_set1_ps( kSinC1 ) );
+    polyS           = _mm_add_ps( _mm_mul_ps( polyS, z ), _mm_set1_ps( kSinC2 ) );
+    polyS           = _mm_add_ps( _mm_mul_ps( _mm_mul_ps( polyS, z ), r ), r );
+
+    __m128  polyC   = _mm_add_ps( _mm_mul_ps( _mm_set1_ps( kCosC0 ), z ), _mm_set1_ps( kCosC1 ) );
+    polyC           = _mm_add_ps( _mm_mul_ps( polyC, z ), _mm_set1_ps( kCosC2 ) );
+    polyC           = _mm_mul_ps( _mm_mul_ps( polyC, z ), z );
+    polyC           = _mm_add_ps( _mm_sub_ps( polyC, _mm_mul_ps( _mm_set1_ps( 0.5f ), z ) ), _mm_set1_ps( 1.0f ) );
+
+    // quadrant of x: odd quadrants swap the polynomials, the sign comes from bit 1
+    __m128i n       = _mm_srli_epi32( j, 1 );
+    __m128  swap    = _mm_castsi128_ps( _mm_cmpeq_epi32( _mm_and_si128( n, one ), one ) );
+    __m128  signS   = _mm_xor_ps( sign, _mm_castsi128_ps( _mm_slli_epi32( _mm_and_si128( n, two ), 30 ) ) );
+    __m128  signC   = _mm_castsi128_ps( _mm_slli_epi32( _mm_and_si128( _mm_add_epi32( n, one ), two ), 30 ) );
+
+    __m128  sinV    = _mm_or_ps( _mm_and_ps( swap, polyC ), _mm_andnot_ps( swap, polyS ) );
+    __m128  cosV    = _mm_or_ps( _mm_and_ps( swap, polyS ), _mm_andnot_ps( swap, polyC ) );
+
+    *s = _mm_xor_ps( sinV, signS );
+    *c = _mm_xor_ps( cosV, signC );
+}
+
+#endif
+
+} // namespace simd
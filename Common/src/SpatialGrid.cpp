@@ -0,0 +1,179 @@
+#include "SpatialGrid.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+
+SpatialGrid::SpatialGrid()
+: mCellSize( 0.0f ), mMinX( 0.0f ), mMinY( 0.0f ), mCols( 0 ), mRows( 0 )
+{
+}
+
+
+void SpatialGrid::build( const float *xy, size_t stride, size_t count, float cellSize )
+{
+    const uint8_t *src = (const uint8_t*)xy;
+
+    mSortedIdx.resize( count );
+    mSortedXY.resize( count * 2 );
+    mCellOf.resize( count );
+    mCols = mRows = 0;
+
+    if ( count == 0 || !( cellSize > 0.0f ) )
+    {
+        mCellStart.assign( 1, 0 );
+        return;
+    }
+
+    // bounds
+    float maxX, maxY;
+    mMinX = maxX = xy[0];
+    mMinY = maxY = xy[1];
+
+    for( size_t k=1; k < count; k++ )
+    {
+        const float *p = (const float*)( src + k * stride );
+        mMinX = min( mMinX, p[0] );     maxX = max( maxX, p[0] );
+        mMinY = min( mMinY, p[1] );     maxY = max( maxY, p[1] );
+    }
+
+    // a tiny cell size over large bounds would mostly allocate empty cells. The count is per axis, bounds with no area
+    // still get a column or a row per cell. Past the limit the cell size solves ( w / c + 1 ) * ( h / c + 1 ) = maxCells
+    double maxCells = 4.0 * count + 64.0;
+    double w        = (double)maxX - mMinX;
+    double h        = (double)maxY - mMinY;
+
+    if ( ( w / cellSize + 1.0 ) * ( h / cellSize + 1.0 ) > maxCells )
+        cellSize = (float)( ( w + h + sqrt( ( w + h ) * ( w + h ) + 4.0 * ( maxCells - 1.0 ) * w * h ) ) / ( 2.0 * ( maxCells - 1.0 ) ) );
+
+    mCellSize   = cellSize;
+    mCols       = (size_t)( ( maxX - mMinX ) / cellSize ) + 1;
+    mRows       = (size_t)( ( maxY - mMinY ) / cellSize ) + 1;
+
+    // counting sort: histogram, prefix sum, scatter
+    float invCellSize = 1.0f / cellSize;
+
+    mCellStart.assign( mCols * mRows + 1, 0 );
+
+    for( size_t k=0; k < count; k++ )
+    {
+        const float *p  = (const float*)( src + k * stride );
+        size_t      cx  = min( (size_t)( ( p[0] - mMinX ) * invCellSize ), mCols - 1 );
+        size_t      cy  = min( (size_t)( ( p[1] - mMinY ) * invCellSize ), mRows - 1 );
+
+        mCellOf[k] = (uint32_t)( cy * mCols + cx );
+        mCellStart[ mCellOf[k] + 1 ]++;
+    }
+
+    for( size_t k=1; k < mCellStart.size(); k++ )
+        mCellStart[k] += mCellStart[k-1];
+
+    // the cell starts double as write cursors
+    for( size_t k=0; k < count; k++ )
+    {
+        const float *p      = (const float*)( src + k * stride );
+        uint32_t    dest    = mCellStart[ mCellOf[k] ]++;
+
+        mSortedIdx[dest]        = (uint32_t)k;
+        mSortedXY[dest * 2]     = p[0];
+        mSortedXY[dest * 2 + 1] = p[1];
+    }
+
+    // the scatter moved every start to the next cell, shift them back
+    for( size_t k=mCellStart.size() - 1; k > 0; k-- )
+        mCellStart[k] = mCellStart[k-1];
+    mCellStart[0] = 0;
+}
+
+
+void SpatialGrid::findPairs( float maxDist, vector<Pair> *pairs, JobSystem *jobs )
+{
+    if ( mCols == 0 || !( maxDist > 0.0f ) )
+        return;
+
+    float maxDistSq = maxDist * maxDist;
+
+    if ( !jobs )
+    {
+        findPairs( 0, mRows, maxDistSq, pairs );
+        return;
+    }
+
+    // the bands only depend on the grid, not on the number of threads
+    const size_t rowsPerChunk = 4;
+
+    mChunkPairs.resize( JobSystem::getNumChunks( mRows, rowsPerChunk ) );
+
+    jobs->parallelFor( mRows, rowsPerChunk, [&]( size_t chunk, size_t begin, size_t end ) {
+        mChunkPairs[chunk].clear();
+        findPairs( begin, end, maxDistSq, &mChunkPairs[chunk] );
+    } );
+
+    for( size_t k=0; k < mChunkPairs.size(); k++ )
+        pairs->insert( pairs->end(), mChunkPairs[k].begin(), mChunkPairs[k].end() );
+}
+
+
+void SpatialGrid::findPairs( size_t rowBegin, size_t rowEnd, float maxDistSq, vector<Pair> *pairs ) const
+{
+    // each cell is tested against itself and the half of its neighbours that come after it, so every pair is visited once
+    for( size_t cy=rowBegin; cy < rowEnd; cy++ )
+    {
+        for( size_t cx=0; cx < mCols; cx++ )
+        {
+            uint32_t cell = (uint32_t)( cy * mCols + cx );
+
+            if ( mCellStart[cell] == mCellStart[cell+1] )
+                continue;
+
+            findPairs( cell, cell, maxDistSq, pairs );
+
+            if ( cx + 1 < mCols )
+                findPairs( cell, cell + 1, maxDistSq, pairs );
+
+            if ( cy + 1 < mRows )
+            {
+                uint32_t below = cell + (uint32_t)mCols;
+
+                if ( cx > 0 )
+                    findPairs( cell, below - 1, maxDistSq, pairs );
+
+                findPairs( cell, below, maxDistSq, pairs );
+
+                if ( cx + 1 < mCols )
+                    findPairs( cell, below + 1, maxDistSq, pairs );
+            }
+        }
+    }
+}
+
+
+void SpatialGrid::findPairs( uint32_t cellA, uint32_t cellB, float maxDistSq, vector<Pair> *pairs ) const
+{
+    uint32_t endA   = mCellStart[cellA+1];
+    uint32_t endB   = mCellStart[cellB+1];
+
+    for( uint32_t a=mCellStart[cellA]; a < endA; a++ )
+    {
+        float       ax      = mSortedXY[a * 2];
+        float       ay      = mSortedXY[a * 2 + 1];
+        uint32_t    startB  = cellA == cellB ? a + 1 : mCellStart[cellB];
+
+        for( uint32_t b=startB; b < endB; b++ )
+        {
+            float dx        = mSortedXY[b * 2] - ax;
+            float dy        = mSortedXY[b * 2 + 1] - ay;
+            float distSq    = dx * dx + dy * dy;
+
+            if ( distSq < maxDistSq )
+            {
+                uint32_t ia = mSortedIdx[a];
+                uint32_t ib = mSortedIdx[b];
+                pairs->push_back( Pair( min( ia, ib ), max( ia, ib ), distSq ) );
+            }
+        }
+    }
+}
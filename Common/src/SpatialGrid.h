@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+class JobSystem;
+
+
+//! Uniform grid over 2d points, rebuilt from scratch every frame with a counting sort.
+//! Points are read through a pointer and a byte stride, so both arrays of structs and plain xy arrays can be indexed.
+//! Nothing is allocated once the buffers have grown to the largest point count.
+class SpatialGrid {
+
+public:
+
+    struct Pair {
+        Pair() {}
+        Pair( uint32_t a, uint32_t b, float distSq ) : mA( a ), mB( b ), mDistSq( distSq ) {}
+
+        uint32_t    mA;
+        uint32_t    mB;
+        float       mDistSq;
+    };
+
+    SpatialGrid();
+
+    //! Sorts \a count points into cells of \a cellSize. \a xy points to the x of the first point, y must follow x.
+    //! The cell size grows if the bounds would need more than a few cells per point.
+    void    build( const float *xy, size_t stride, size_t count, float cellSize );
+
+    //! Appends every unordered pair closer than \a maxDist to \a pairs, each pair once with mA < mB.
+    //! \a maxDist must not exceed the cell size used by build().
+    //! With \a jobs, bands of rows are searched in parallel and merged in order, the pairs come out the same either way.
+    void    findPairs( float maxDist, std::vector<Pair> *pairs, JobSystem *jobs = nullptr );
+
+    size_t  getNumPoints() const    { return mSortedIdx.size(); }
+    size_t  getNumCells() const     { return mCols * mRows; }
+    float   getCellSize() const     { return mCellSize; }
+
+private:
+
+    void    findPairs( size_t rowBegin, size_t rowEnd, float maxDistSq, std::vector<Pair> *pairs ) const;
+    void    findPairs( uint32_t cellA, uint32_t cellB, float maxDistSq, std::vector<Pair> *pairs ) const;
+
+    float                   mCellSize;
+    float                   mMinX, mMinY;
+    size_t                  mCols, mRows;
+
+    std::vector<uint32_t>   mCellStart;     // first sorted point of each cell, one extra entry at the end
+    std::vector<uint32_t>   mCellOf;        // cell of each input point
+    std::vector<uint32_t>   mSortedIdx;     // input index of each sorted point
+    std::vector<float>      mSortedXY;      // positions in cell order, interleaved
+
+    std::vector<std::vector<Pair> >     mChunkPairs;
+};
@@ -0,0 +1,269 @@
+#include "SpectrumKernel.h"
+#include "SimdMath.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <sstream>
+
+using namespace std;
+
+
+namespace {
+
+    // band edges in Hz, the same as xtract_init_bark()
+    const float kBarkEdges[SpectrumKernel::NUM_BARK_BANDS + 1] = {
+        0, 100, 200, 300, 400, 510, 630, 770, 920, 1080, 1270, 1480, 1720, 2000, 2320, 2700, 3150, 3700, 4400,
+        5300, 6400, 7700, 9500, 12000, 15500, 20500, 27000
+    };
+
+    const double kTwoPi = 6.283185307179586;
+
+}
+
+
+SpectrumKernel::SpectrumKernel()
+{
+}
+
+
+void SpectrumKernel::init( size_t windowSize, float sampleRate )
+{
+    // any other size overruns the bit reversal and twiddle tables
+    if ( windowSize < 8 || ( windowSize & ( windowSize - 1 ) ) )
+    {
+        ostringstream msg;
+        msg << "SpectrumKernel window size must be a power of two of at least 8, not " << windowSize;
+        throw invalid_argument( msg.str() );
+    }
+
+    size_t n    = windowSize;
+    size_t half = n / 2;
+
+    // the tables are computed in double once, the per-window math is all float
+    mWindow.resize( n );
+    for( size_t k=0; k < n; k++ )
+        mWindow[k] = (float)( 0.5 * ( 1.0 - cos( kTwoPi * k / ( n - 1 ) ) ) );
+
+    mWindowed.resize( n );
+    mRe.resize( half );
+    mIm.resize( half );
+    mSpectrum.resize( half );
+    mBands.assign( NUM_BARK_BANDS, 0.0f );
+
+    uint32_t bits = 0;
+    while( ( (size_t)1 << bits ) < half )
+        bits++;
+
+    mBitReverse.resize( half );
+    for( uint32_t k=0; k < half; k++ )
+    {
+        uint32_t r = 0;
+        for( uint32_t b=0; b < bits; b++ )
+            r |= ( ( k >> b ) & 1 ) << ( bits - 1 - b );
+        mBitReverse[k] = r;
+    }
+
+    mTwiddleRe.resize( half );
+    mTwiddleIm.resize( half );
+    for( size_t h=1; h < half; h *= 2 )
+    {
+        for( size_t j=0; j < h; j++ )
+        {
+            mTwiddleRe[h + j] = (float)cos( -kTwoPi * j / ( 2 * h ) );
+            mTwiddleIm[h + j] = (float)sin( -kTwoPi * j / ( 2 * h ) );
+        }
+    }
+
+    mSplitRe.resize( half );
+    mSplitIm.resize( half );
+    for( size_t k=0; k < half; k++ )
+    {
+        mSplitRe[k] = (float)cos( -kTwoPi * k / n );
+        mSplitIm[k] = (float)sin( -kTwoPi * k / n );
+    }
+
+    // bins per band, the bands above Nyquist are empty
+    float nyquist = sampleRate * 0.5f;
+
+    mBandLimits.resize( NUM_BARK_BANDS + 1 );
+    for( size_t k=0; k <= NUM_BARK_BANDS; k++ )
+        mBandLimits[k] = (uint32_t)min<float>( (float)half, kBarkEdges[k] / nyquist * half );
+}
+
+
+void SpectrumKernel::fft()
+{
+    size_t  n   = mRe.size();
+    float   *re = mRe.data();
+    float   *im = mIm.data();
+
+    for( size_t h=1; h < n; h *= 2 )
+    {
+        const float *twRe = &mTwiddleRe[h];
+        const float *twIm = &mTwiddleIm[h];
+
+        for( size_t i=0; i < n; i += 2 * h )
+        {
+            size_t j = 0;
+
+#if SIMD_SSE2
+            // the first two stages have fewer than 4 butterflies per block
+            for( ; j + 4 <= h; j += 4 )
+            {
+                float   *aRe    = re + i + j;
+                float   *aIm    = im + i + j;
+                float   *bRe    = aRe + h;
+                float   *bIm    = aIm + h;
+                __m128  wr      = _mm_loadu_ps( twRe + j );
+                __m128  wi      = _mm_loadu_ps( twIm + j );
+                __m128  xr      = _mm_loadu_ps( bRe );
+                __m128  xi      = _mm_loadu_ps( bIm );
+                __m128  tr      = _mm_sub_ps( _mm_mul_ps( wr, xr ), _mm_mul_ps( wi, xi ) );
+                __m128  ti      = _mm_add_ps( _mm_mul_ps( wr, xi ), _mm_mul_ps( wi, xr ) );
+                __m128  ar      = _mm_loadu_ps( aRe );
+                __m128  ai      = _mm_loadu_ps( aIm );
+
+                _mm_storeu_ps( bRe, _mm_sub_ps( ar, tr ) );
+                _mm_storeu_ps( bIm, _mm_sub_ps( ai, ti ) );
+                _mm_storeu_ps( aRe, _mm_add_ps( ar, tr ) );
+                _mm_storeu_ps( aIm, _mm_add_ps( ai, ti ) );
+            }
+#endif
+
+            for( ; j < h; j++ )
+            {
+                size_t  a   = i + j;
+                size_t  b   = a + h;
+                float   tr  = twRe[j] * re[b] - twIm[j] * im[b];
+                float   ti  = twRe[j] * im[b] + twIm[j] * re[b];
+
+                re[b]  = re[a] - tr;
+                im[b]  = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+}
+
+
+void SpectrumKernel::process( const float *pcm )
+{
+    size_t  n       = mWindow.size();
+    size_t  half    = n / 2;
+    size_t  k       = 0;
+
+#if SIMD_SSE2
+    for( ; k + 4 <= n; k += 4 )
+        _mm_storeu_ps( &mWindowed[k], _mm_mul_ps( _mm_loadu_ps( pcm + k ), _mm_loadu_ps( &mWindow[k] ) ) );
+#endif
+
+    for( ; k < n; k++ )
+        mWindowed[k] = pcm[k] * mWindow[k];
+
+    // even samples are the real parts and odd ones the imaginary parts of the half size input, in bit reversed order
+    for( k=0; k < half; k++ )
+    {
+        uint32_t r  = mBitReverse[k];
+        mRe[k]      = mWindowed[r * 2];
+        mIm[k]      = mWindowed[r * 2 + 1];
+    }
+
+    fft();
+
+    // X[k] = E[k] + W^k O[k], with E and O the spectra of the even and odd samples taken from Z[k] and conj( Z[half - k] )
+    const float *re     = mRe.data();
+    const float *im     = mIm.data();
+    const float scale   = 0.5f / n;
+
+    k = 0;
+
+    // bin 0 pairs with itself, Z[half] is Z[0]
+    {
+        mSpectrum[0] = fabs( re[0] + im[0] ) * 2.0f * scale;
+        k = 1;
+    }
+
+#if SIMD_SSE2
+    const __m128 scale4 = _mm_set1_ps( scale );
+
+    for( ; k + 4 <= half; k += 4 )
+    {
+        // Z[half - k] for the 4 bins, loaded from half - k - 3 and reversed
+        __m128 a    = _mm_loadu_ps( re + k );
+        __m128 b    = _mm_loadu_ps( im + k );
+        __m128 c    = _mm_shuffle_ps( _mm_loadu_ps( re + half - k - 3 ), _mm_loadu_ps( re + half - k - 3 ), _MM_SHUFFLE( 0, 1, 2, 3 ) );
+        __m128 d    = _mm_shuffle_ps( _mm_loadu_ps( im + half - k - 3 ), _mm_loadu_ps( im + half - k - 3 ), _MM_SHUFFLE( 0, 1, 2, 3 ) );
+        __m128 wr   = _mm_loadu_ps( &mSplitRe[k] );
+        __m128 wi   = _mm_loadu_ps( &mSplitIm[k] );
+
+        __m128 eRe  = _mm_add_ps( a, c );
+        __m128 eIm  = _mm_sub_ps( b, d );
+        __m128 oRe  = _mm_add_ps( b, d );
+        __m128 oIm  = _mm_sub_ps( c, a );
+
+        __m128 xRe  = _mm_add_ps( eRe, _mm_sub_ps( _mm_mul_ps( wr, oRe ), _mm_mul_ps( wi, oIm ) ) );
+        __m128 xIm  = _mm_add_ps( eIm, _mm_add_ps( _mm_mul_ps( wr, oIm ), _mm_mul_ps( wi, oRe ) ) );
+
+        _mm_storeu_ps( &mSpectrum[k], _mm_mul_ps( _mm_sqrt_ps( _mm_add_ps( _mm_mul_ps( xRe, xRe ), _mm_mul_ps( xIm, xIm ) ) ), scale4 ) );
+    }
+#endif
+
+    for( ; k < half; k++ )
+    {
+        float a     = re[k];
+        float b     = im[k];
+        float c     = re[half - k];
+        float d     = im[half - k];
+
+        float eRe   = a + c;
+        float eIm   = b - d;
+        float oRe   = b + d;
+        float oIm   = c - a;
+
+        float xRe   = eRe + mSplitRe[k] * oRe - mSplitIm[k] * oIm;
+        float xIm   = eIm + mSplitRe[k] * oIm + mSplitIm[k] * oRe;
+
+        mSpectrum[k] = sqrt( xRe * xRe + xIm * xIm ) * scale;
+    }
+
+    for( size_t band=0; band < NUM_BARK_BANDS; band++ )
+    {
+        float sum = 0.0f;
+        for( uint32_t bin = mBandLimits[band]; bin < mBandLimits[band + 1]; bin++ )
+            sum += mSpectrum[bin];
+
+        mBands[band] = sum;
+    }
+}
+
+
+void SpectrumKernel::shape( const float *raw, size_t count, float gain, float offset, float damping, float *results )
+{
+    // max( v, v + damping * ( previous - v ) ) rises at once and falls by damping
+    size_t k = 0;
+
+#if SIMD_SSE2
+    const __m128 gain4      = _mm_set1_ps( gain );
+    const __m128 offset4    = _mm_set1_ps( offset );
+    const __m128 damping4   = _mm_set1_ps( damping );
+    const __m128 zero       = _mm_setzero_ps();
+    const __m128 one        = _mm_set1_ps( 1.0f );
+
+    for( ; k + 4 <= count; k += 4 )
+    {
+        __m128 v    = _mm_add_ps( offset4, _mm_mul_ps( gain4, _mm_loadu_ps( raw + k ) ) );
+        v           = _mm_min_ps( _mm_max_ps( v, zero ), one );
+        __m128 prev = _mm_loadu_ps( results + k );
+
+        _mm_storeu_ps( results + k, _mm_max_ps( v, _mm_add_ps( v, _mm_mul_ps( damping4, _mm_sub_ps( prev, v ) ) ) ) );
+    }
+#endif
+
+    for( ; k < count; k++ )
+    {
+        float v     = min( max( offset + gain * raw[k], 0.0f ), 1.0f );
+        results[k]  = max( v, v + damping * ( results[k] - v ) );
+    }
+}
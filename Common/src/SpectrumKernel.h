@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+
+//! Single precision Hann window, FFT, magnitude spectrum and Bark bands of a PCM window, the float path of the
+//! XTRACT_SPECTRUM and XTRACT_BARK_COEFFICIENTS features. The real FFT runs as a complex FFT of half the size on split
+//! real and imaginary arrays, the butterflies and the spectrum are computed 4 bins at a time with SSE2.
+//! Magnitudes are |X[k]| / N for the bins 0 to N/2 - 1 and each band sums the bins between the Bark edges, like LibXtract.
+//! Everything is allocated by init(), process() only writes to the buffers and the results are views into them.
+class SpectrumKernel {
+
+public:
+
+    SpectrumKernel();
+
+    //! \a windowSize is a power of two, at least 8, throws std::invalid_argument otherwise.
+    void            init( size_t windowSize, float sampleRate );
+
+    //! Windows getWindowSize() samples of \a pcm and computes the spectrum and the bands.
+    void            process( const float *pcm );
+
+    size_t          getWindowSize() const           { return mWindow.size(); }
+
+    //! getWindowSize() / 2 magnitudes, valid until the next process().
+    const float*    getSpectrum() const             { return mSpectrum.data(); }
+    size_t          getSpectrumSize() const         { return mSpectrum.size(); }
+
+    //! NUM_BARK_BANDS sums of magnitudes, valid until the next process().
+    const float*    getBands() const                { return mBands.data(); }
+    size_t          getNumBands() const             { return mBands.size(); }
+
+    //! What the ciXtract features do with their raw values: offset + gain * raw clamped to [0, 1], then \a results
+    //! rises to it at once and falls towards it by \a damping per call. \a results holds the previous values.
+    static void     shape( const float *raw, size_t count, float gain, float offset, float damping, float *results );
+
+    static const size_t NUM_BARK_BANDS = 26;
+
+private:
+
+    void            fft();
+
+    std::vector<float>      mWindow;
+    std::vector<float>      mWindowed;
+    std::vector<uint32_t>   mBitReverse;        // of the half size complex FFT
+    std::vector<float>      mRe;
+    std::vector<float>      mIm;
+    std::vector<float>      mTwiddleRe;         // exp( -2 pi i j / len ) for each stage, stage len / 2 starts at len / 2
+    std::vector<float>      mTwiddleIm;
+    std::vector<float>      mSplitRe;           // exp( -2 pi i k / N ), splits the half size FFT into the real one
+    std::vector<float>      mSplitIm;
+    std::vector<float>      mSpectrum;
+    std::vector<uint32_t>   mBandLimits;        // NUM_BARK_BANDS + 1 bins
+    std::vector<float>      mBands;
+};
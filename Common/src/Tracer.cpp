@@ -0,0 +1,158 @@
+#include "Tracer.h"
+
+#include <fstream>
+
+using namespace ci;
+using namespace std;
+
+
+Tracer::Format& Tracer::Format::args( const vector<string> &args )
+{
+    for( size_t k=0; k < args.size(); k++ )
+    {
+        if ( args[k] == "--trace" && k + 1 < args.size() )
+        {
+            mPath   = args[++k];
+            mStart  = true;
+        }
+    }
+
+    return *this;
+}
+
+
+Tracer::Buffer::Buffer( Tracer *tracer, const string &name, uint32_t id, size_t capacity )
+: mTracer( tracer ), mName( name ), mId( id ), mEvents( capacity ), mCount( 0 ), mSession( 0 ), mDropped( 0 )
+{
+}
+
+
+void Tracer::Buffer::add( const char *name, double start, double end )
+{
+    // the first event of a new recording drops the previous one, only this thread ever resets the buffer
+    uint32_t session = mTracer->mSession.load( memory_order_acquire );
+
+    if ( mSession.load( memory_order_relaxed ) != session )
+    {
+        mCount.store( 0, memory_order_relaxed );
+        mDropped.store( 0, memory_order_relaxed );
+        mSession.store( session, memory_order_release );
+    }
+
+    size_t count = mCount.load( memory_order_relaxed );
+
+    if ( count == mEvents.size() )
+    {
+        mDropped.fetch_add( 1, memory_order_relaxed );
+        return;
+    }
+
+    Event &event    = mEvents[count];
+    event.mName     = name;
+    event.mStart    = start;
+    event.mDuration = end - start;
+
+    mCount.store( count + 1, memory_order_release );
+}
+
+
+Tracer::Tracer( const Format &format )
+: mFormat( format ), mClock( true ), mRecording( false ), mSession( 0 )
+{
+    mMainBuffer = createBuffer( "Main" );
+
+    if ( mFormat.mStart )
+        start();
+}
+
+
+Tracer::~Tracer()
+{
+    setRecording( false );
+}
+
+
+Tracer::Buffer* Tracer::createBuffer( const string &name )
+{
+    lock_guard<mutex> lock( mBuffersMutex );
+
+    mBuffers.push_back( shared_ptr<Buffer>( new Buffer( this, name, (uint32_t)mBuffers.size() + 1, mFormat.mCapacity ) ) );
+
+    return mBuffers.back().get();
+}
+
+
+void Tracer::start()
+{
+    mSession.fetch_add( 1, memory_order_release );
+    mRecording.store( true, memory_order_relaxed );
+}
+
+
+void Tracer::stop()
+{
+    mRecording.store( false, memory_order_relaxed );
+}
+
+
+void Tracer::setRecording( bool record )
+{
+    if ( record == isRecording() )
+        return;
+
+    if ( record )
+    {
+        start();
+    }
+    else
+    {
+        stop();
+        write( mFormat.mPath );
+    }
+}
+
+
+bool Tracer::write( const fs::path &path )
+{
+    ofstream file( path.string().c_str(), ios::trunc );
+    if ( !file.is_open() )
+        return false;
+
+    file.setf( ios::fixed );
+    file.precision( 3 );
+
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+    lock_guard<mutex>   lock( mBuffersMutex );
+    uint32_t            session = mSession.load( memory_order_acquire );
+    bool                first   = true;
+
+    for( size_t k=0; k < mBuffers.size(); k++ )
+    {
+        const Buffer &buffer = *mBuffers[k];
+
+        file << ( first ? "" : ",\n" ) << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer.mId << ",\"args\":{\"name\":\"" << buffer.mName << "\"}}";
+        first = false;
+
+        // buffers that haven't recorded anything since the last start still hold the previous recording
+        if ( buffer.mSession.load( memory_order_acquire ) != session )
+            continue;
+
+        size_t count = buffer.mCount.load( memory_order_acquire );
+
+        for( size_t i=0; i < count; i++ )
+        {
+            const Event &event = buffer.mEvents[i];
+            file << ",\n{\"name\":\"" << event.mName << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer.mId
+                 << ",\"ts\":" << event.mStart * 1000000.0 << ",\"dur\":" << event.mDuration * 1000000.0 << "}";
+        }
+
+        uint32_t dropped = buffer.mDropped.load( memory_order_relaxed );
+        if ( dropped > 0 )
+            file << ",\n{\"name\":\"dropped events\",\"ph\":\"C\",\"pid\":1,\"tid\":" << buffer.mId << ",\"ts\":0,\"args\":{\"" << buffer.mName << "\":" << dropped << "}}";
+    }
+
+    file << "\n]}\n";
+
+    return file.good();
+}
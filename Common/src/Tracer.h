@@ -0,0 +1,129 @@
+#pragma once
+
+#include "cinder/Timer.h"
+#include "cinder/Filesystem.h"
+#include "cinder/Utilities.h"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+
+typedef std::shared_ptr<class Tracer>   TracerRef;
+
+//! Records timed scopes from several threads and writes them as Chrome trace events, to open in chrome://tracing or Perfetto.
+//! Each thread writes to its own Buffer without locks, the buffers are only read by write() once the recording is stopped.
+//! Recording can be started and stopped at any time, a Scope costs a relaxed atomic load while nothing is recorded.
+class Tracer {
+
+public:
+
+    struct Format {
+        Format() : mCapacity( 65536 ), mPath( ci::getDocumentsDirectory() / "trace.json" ), mStart( false ) {}
+
+        //! Events per thread and recording, the ones over it are dropped.
+        Format& capacity( size_t events )               { mCapacity = events; return *this; }
+        //! File written when the recording stops.
+        Format& path( const ci::fs::path &path )        { mPath = path; return *this; }
+        //! Records from the start.
+        Format& start( bool start = true )              { mStart = start; return *this; }
+        //! Picks up "--trace <path>" from the command line, which records from the start.
+        Format& args( const std::vector<std::string> &args );
+
+        size_t          mCapacity;
+        ci::fs::path    mPath;
+        bool            mStart;
+    };
+
+    struct Event {
+        const char  *mName;                 // must outlive the tracer, usually a literal
+        double      mStart;
+        double      mDuration;
+    };
+
+    //! The events of a single thread.
+    class Buffer {
+    public:
+        //! Only to be called by the thread the buffer belongs to.
+        void                add( const char *name, double start, double end );
+
+        bool                isRecording() const     { return mTracer->isRecording(); }
+        double              now() const             { return mTracer->now(); }
+        const std::string&  getName() const         { return mName; }
+
+    private:
+        friend class Tracer;
+
+        Buffer( Tracer *tracer, const std::string &name, uint32_t id, size_t capacity );
+
+        Tracer                  *mTracer;
+        std::string             mName;
+        uint32_t                mId;
+        std::vector<Event>      mEvents;
+        std::atomic<size_t>     mCount;         // published with release, write() reads up to it
+        std::atomic<uint32_t>   mSession;       // recording the events belong to
+        std::atomic<uint32_t>   mDropped;
+    };
+
+    //! Records a scope in \a buffer, does nothing with a null buffer or while nothing is recorded.
+    class Scope {
+    public:
+        Scope( Buffer *buffer, const char *name ) : mBuffer( buffer && buffer->isRecording() ? buffer : nullptr ), mName( name ), mStart( 0.0 )
+        {
+            if ( mBuffer )
+                mStart = mBuffer->now();
+        }
+
+        ~Scope()
+        {
+            if ( mBuffer )
+                mBuffer->add( mName, mStart, mBuffer->now() );
+        }
+
+    private:
+        Scope( const Scope& );
+        Scope& operator=( const Scope& );
+
+        Buffer          *mBuffer;
+        const char      *mName;
+        double          mStart;
+    };
+
+    static TracerRef create( const Format &format = Format() )  { return TracerRef( new Tracer( format ) ); }
+
+    //! Writes the recording if it's still running.
+    ~Tracer();
+
+    //! Buffer of the thread that created the tracer.
+    Buffer*             getMainBuffer()                 { return mMainBuffer; }
+    //! A new buffer for another thread, shown as \a name in the trace. Thread safe, the buffer lives as long as the tracer.
+    Buffer*             createBuffer( const std::string &name );
+
+    //! Drops the previous recording and starts a new one.
+    void                start();
+    void                stop();
+    bool                isRecording() const             { return mRecording.load( std::memory_order_relaxed ); }
+    //! Starts or stops the recording, stopping writes it to the Format path. Meant to follow a toggle every frame.
+    void                setRecording( bool record );
+
+    //! Writes the last recording as a Chrome trace, returns false if the file can't be written.
+    bool                write( const ci::fs::path &path );
+    const ci::fs::path& getPath() const                 { return mFormat.mPath; }
+
+    //! Seconds since the tracer was created, thread safe.
+    double              now() const                     { return mClock.getSeconds(); }
+
+private:
+
+    Tracer( const Format &format );
+
+    Format                                  mFormat;
+    ci::Timer                               mClock;
+    std::mutex                              mBuffersMutex;
+    std::vector<std::shared_ptr<Buffer> >   mBuffers;
+    Buffer                                  *mMainBuffer;
+    std::atomic<bool>                       mRecording;
+    std::atomic<uint32_t>                   mSession;
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+
+
+//! Lock-free hand-off of the latest value from one producer thread to one consumer thread.
+//! The producer fills getBack() and publish()es it, the consumer calls update() and reads getFront().
+//! Neither side ever waits, and publishing and updating only swap buffer indices.
+template<typename T>
+class TripleBuffer {
+
+public:
+
+    TripleBuffer() : mBack( 0 ), mMiddle( 1 ), mFront( 2 ) {}
+
+    //! Producer side.
+    T&          getBack()           { return mBuffers[mBack]; }
+
+    //! Producer side. Hands the back buffer over, the consumer will pick it up on its next update().
+    void        publish()           { mBack = mMiddle.exchange( mBack | DIRTY_BIT, std::memory_order_acq_rel ) & INDEX_MASK; }
+
+    //! Consumer side. Swaps in the most recently published buffer, returns false if there is nothing new.
+    bool update()
+    {
+        if ( ( mMiddle.load( std::memory_order_relaxed ) & DIRTY_BIT ) == 0 )
+            return false;
+
+        mFront = mMiddle.exchange( mFront, std::memory_order_acq_rel ) & INDEX_MASK;
+        return true;
+    }
+
+    //! Consumer side.
+    const T&    getFront() const    { return mBuffers[mFront]; }
+
+    //! Direct access to all three buffers, only safe before the producer starts.
+    T&          getBuffer( int n )  { return mBuffers[n]; }
+
+private:
+
+    enum { INDEX_MASK = 0x3, DIRTY_BIT = 0x4 };
+
+    T                   mBuffers[3];
+    int                 mBack;
+    std::atomic<int>    mMiddle;
+    int                 mFront;
+};
@@ -0,0 +1,128 @@
+#include "VertexPacking.h"
+
+#include <cmath>
+#include <cstring>
+
+using namespace ci;
+
+
+int16_t VertexPacking::packSnorm16( float value )
+{
+    value = value < -1.0f ? -1.0f : ( value > 1.0f ? 1.0f : value );
+    return (int16_t)floor( value * 32767.0f + 0.5f );
+}
+
+
+uint16_t VertexPacking::packHalf( float value )
+{
+    uint32_t bits;
+    memcpy( &bits, &value, sizeof(bits) );
+
+    uint16_t sign   = (uint16_t)( ( bits >> 16 ) & 0x8000 );
+    uint32_t abs    = bits & 0x7FFFFFFF;
+
+    // infinity and NaN, NaN stays quiet
+    if ( abs >= 0x7F800000 )
+        return sign | 0x7C00 | ( abs > 0x7F800000 ? 0x0200 : 0 );
+
+    // 65520 and above round to infinity
+    if ( abs >= 0x477FF000 )
+        return sign | 0x7C00;
+
+    uint32_t half, rem, halfway;
+
+    if ( abs < 0x38800000 )
+    {
+        // below 2^-14 the half is denormal, the mantissa with its implicit 1 shifts right
+        uint32_t shift = 126 - ( abs >> 23 );
+        if ( shift > 24 )
+            return sign;
+
+        uint32_t mantissa = ( abs & 0x007FFFFF ) | 0x00800000;
+        half    = mantissa >> shift;
+        rem     = mantissa & ( ( 1u << shift ) - 1 );
+        halfway = 1u << ( shift - 1 );
+    }
+    else
+    {
+        // rebias the exponent, 127 -> 15, and drop 13 bits of mantissa
+        half    = ( abs - 0x38000000 ) >> 13;
+        rem     = abs & 0x1FFF;
+        halfway = 0x1000;
+    }
+
+    // a carry out of the mantissa correctly bumps the exponent
+    if ( rem > halfway || ( rem == halfway && ( half & 1 ) ) )
+        half++;
+
+    return sign | (uint16_t)half;
+}
+
+
+float VertexPacking::unpackHalf( uint16_t value )
+{
+    uint32_t sign       = (uint32_t)( value & 0x8000 ) << 16;
+    uint32_t exponent   = ( value >> 10 ) & 0x1F;
+    uint32_t mantissa   = value & 0x03FF;
+    uint32_t bits;
+
+    if ( exponent == 0x1F )
+    {
+        bits = sign | 0x7F800000 | ( mantissa << 13 );
+    }
+    else if ( exponent == 0 )
+    {
+        // zero and denormals, exact in float
+        float result = mantissa * ( 1.0f / 16777216.0f );
+        return sign ? -result : result;
+    }
+    else
+    {
+        bits = sign | ( ( exponent + 112 ) << 23 ) | ( mantissa << 13 );
+    }
+
+    float result;
+    memcpy( &result, &bits, sizeof(result) );
+    return result;
+}
+
+
+void VertexPacking::packOctahedral( const Vec3f &n, int16_t result[2] )
+{
+    float l1 = fabs( n.x ) + fabs( n.y ) + fabs( n.z );
+    if ( l1 <= 0.0f )
+    {
+        result[0] = result[1] = 0;
+        return;
+    }
+
+    float u = n.x / l1;
+    float v = n.y / l1;
+
+    if ( n.z < 0.0f )
+    {
+        float foldU = ( 1.0f - fabs( v ) ) * ( u >= 0.0f ? 1.0f : -1.0f );
+        float foldV = ( 1.0f - fabs( u ) ) * ( v >= 0.0f ? 1.0f : -1.0f );
+        u = foldU;
+        v = foldV;
+    }
+
+    result[0] = packSnorm16( u );
+    result[1] = packSnorm16( v );
+}
+
+
+Vec3f VertexPacking::unpackOctahedral( const int16_t packed[2] )
+{
+    float u = unpackSnorm16( packed[0] );
+    float v = unpackSnorm16( packed[1] );
+    Vec3f n( u, v, 1.0f - fabs( u ) - fabs( v ) );
+
+    if ( n.z < 0.0f )
+    {
+        n.x = ( 1.0f - fabs( v ) ) * ( u >= 0.0f ? 1.0f : -1.0f );
+        n.y = ( 1.0f - fabs( u ) ) * ( v >= 0.0f ? 1.0f : -1.0f );
+    }
+
+    return n.normalized();
+}
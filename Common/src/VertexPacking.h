@@ -0,0 +1,27 @@
+#pragma once
+
+#include "cinder/Vector.h"
+
+#include <cstdint>
+
+
+//! Conversions used by the compact vertex layout of GpuMesh: signed 16 bit fixed point, half floats and octahedral normals.
+//! Fixed point values are kept unnormalised, 32767 is 1, the shader scales them so the result doesn't depend on the
+//! GL version's snorm convention.
+class VertexPacking {
+
+public:
+
+    //! Rounds \a value clamped to [-1, 1] to [-32767, 32767].
+    static int16_t      packSnorm16( float value );
+    static float        unpackSnorm16( int16_t value )      { return value / 32767.0f; }
+
+    //! IEEE 754 half, rounded to nearest even, overflows to infinity.
+    static uint16_t     packHalf( float value );
+    static float        unpackHalf( uint16_t value );
+
+    //! Projects the unit vector \a n on the octahedron |x|+|y|+|z| = 1 and unfolds the lower half over the upper one,
+    //! two values spread evenly over the sphere, \a result gets them as snorm16.
+    static void         packOctahedral( const ci::Vec3f &n, int16_t result[2] );
+    static ci::Vec3f    unpackOctahedral( const int16_t packed[2] );
+};
@@ -4,10 +4,15 @@
 #include "cinder/Rand.h"
 #include <math.h>
 
-#include "cinder/audio/Context.h"
-#include "cinder/audio/MonitorNode.h"
-
-#include "ciXtract.h"
+#include "AudioAnalyzer.h"
+#include "ParticleKernels.h"
+#include "FrameProfiler.h"
+#include "Tracer.h"
+#include "Benchmark.h"
+#include "SessionLog.h"
+#include "LatencyProbe.h"
+#include "BatchRenderer.h"
+#include "JobSystem.h"
 
 
 using namespace ci;
@@ -19,37 +24,43 @@ class SoundCirclesApp : public AppNative {
     
 public:
     
-    struct Particle
+    // one array per attribute, the kernels stream through angle/radius and x/y
+    struct Particles
     {
-        float   angle;
-        float   vel;
-        float   size;
-        float   radius;
-        float   initRadius;
-        ColorA  col;
+        void    resize( size_t n );
+        size_t  count() const { return angle.size(); }
+        
+        vector<float>   angle;
+        vector<float>   vel;
+        vector<float>   size;
+        vector<float>   radius;
+        vector<float>   initRadius;
+        vector<ColorA>  col;
+        vector<float>   x;
+        vector<float>   y;
     };
     
     void prepareSettings( Settings *settings );
 	void setup();
 	void update();
 	void draw();
-    void initAudio();
+    void endFrame();
     void updateParticles();
     void drawParticles();
     
+    // Audio
+    AudioAnalyzerRef            mAudio;
+    
     // Xtract
-    ciXtractRef                 mXtract;
-    ciXtractFeatureRef          mBark;
     float                       mBarkGain;
     float                       mBarkOffset;
     float                       mBarkDamping;
     
-    // Audio
-	audio::InputDeviceNodeRef	mInputDeviceNode;
-	audio::MonitorNodeRef       mMonitorNode;
-    audio::Buffer               mPcmBuffer;
-    
-    vector<Particle>            mParticles;
+    Particles                   mParticles;
+    PairSweep                   mPairSweep;
+    BatchRendererRef            mBatch;
+    JobSystemRef                mJobs;
+    bool                        mMultithreaded;
     float                       mMinDist;
     float                       mRadius;
     float                       mSpeed;
@@ -57,6 +68,19 @@ public:
     
     params::InterfaceGlRef      mParams;
     float                       mFps;
+    int                         mDrawCallsSaved;
+    
+    FrameProfilerRef            mProfiler;
+    size_t                      mParticlesStage;
+    size_t                      mDrawParticlesStage;
+    size_t                      mDraw2dStage;
+    size_t                      mParamsStage;
+    TracerRef                   mTracer;
+    bool                        mTracing;
+    BenchmarkRef                mBenchmark;
+    SessionLogRef               mSession;
+    LatencyProbeRef             mLatency;
+    bool                        mLatencyEnabled;
 };
 
 
@@ -75,9 +99,37 @@ void SoundCirclesApp::setup()
     mRadius         = 100.0f;
     mSpeed          = 1.0f;
     mParticlesN     = 50;
+    mDrawCallsSaved = 0;
+    mBatch          = BatchRenderer::create();
+    mJobs           = JobSystem::create();
+    mMultithreaded  = true;
+    
+    // "--benchmark <frames>" feeds the audio offline and runs a fixed number of frames as fast as possible, then writes a report and quits
+    mBenchmark      = Benchmark::create( "SoundCircles", Benchmark::Format().args( getArgs() ) );
     
-    mParams = params::InterfaceGl::create( "params", Vec2i( 200, 250 ) );
+    // "--capture <path>" logs the audio and the parameter changes of every frame, "--replay <path>" plays a log back frame by frame,
+    // at the captured pace or as fast as possible with "--replay-fast". The session seeds Rand, it's created before anything random
+    mSession        = SessionLog::create( SessionLog::Format().args( getArgs() ) );
+    
+    if ( mBenchmark->isEnabled() || ( mSession->isReplaying() && !mSession->isRealtime() ) )
+    {
+        disableFrameRate();
+        gl::disableVerticalSync();
+    }
+    
+    mBenchmark->param( "Particles N",   &mParticlesN );
+    mBenchmark->param( "Min dist.",     &mMinDist );
+    mBenchmark->param( "Radius",        &mRadius );
+    mBenchmark->param( "Speed",         &mSpeed );
+    mBenchmark->param( "Multithreaded", &mMultithreaded );
+    mBenchmark->setItemName( "particles" );
+    
+    // per-stage timings, "--profile-csv <path>" writes every frame, allocations in allocation free stages fail a benchmark
+    mProfiler       = FrameProfiler::create( mBenchmark->getProfilerFormat().args( getArgs() ) );
+    
+    mParams = params::InterfaceGl::create( "params", Vec2i( 240, 420 ) );
     mParams->addParam( "FPS",  &mFps );
+    mParams->addParam( "Draw calls saved",  &mDrawCallsSaved, "", true );
     mParams->addSeparator();
     mParams->addParam( "Bark gain",     &mBarkGain,     "min=0.1 max=500.0 step=0.01" );
     mParams->addParam( "Bark offset",   &mBarkOffset,   "min=-1.0 max=1.0 step=0.01" );
@@ -86,51 +138,114 @@ void SoundCirclesApp::setup()
     mParams->addParam( "Min dist.",     &mMinDist,      "min=0.0 max=1000.0 step=1.0" );
     mParams->addParam( "Radius",        &mRadius,       "min=0.0 max=1000.0 step=1.0" );
     mParams->addParam( "Speed",         &mSpeed,        "min=0.0 max=10.0 step=0.1" );
-    mParams->addParam( "Particles N",   &mParticlesN,   "min=0 max=" + to_string(mParticlesN*2) );
+    mParams->addParam( "Particles N",   &mParticlesN,   "min=0 max=50000 step=50" );
+    mParams->addParam( "Multithreaded", &mMultithreaded );
     
-    // initialise Xtract
-    mXtract = ciXtract::create();
+    // initialise audio and Xtract
+    AudioAnalyzer::Format audioFormat = AudioAnalyzer::Format().threaded().hopSize( CIXTRACT_PCM_SIZE / 4 ).session( mSession ).args( getArgs() );
+    if ( mBenchmark->isEnabled() )
+        audioFormat.offline();
     
-    // enable features
-    mXtract->enableFeature( XTRACT_BARK_COEFFICIENTS );
-    mXtract->enableFeature( XTRACT_SPECTRUM );
-    
-    // get feature references
-    mBark       = mXtract->getFeature( XTRACT_BARK_COEFFICIENTS );
+    mAudio = AudioAnalyzer::create( audioFormat );
     
-    initAudio();
-    
-    for( int k=0; k < mParticlesN*2; k++ )
+    // enable features
+    mAudio->enableFeature( XTRACT_BARK_COEFFICIENTS );
+    mAudio->enableFeature( XTRACT_SPECTRUM );
+    
+    mAudio->setProfiler( mProfiler );
+    mParticlesStage     = mProfiler->addStage( "Particle update" );
+    mDrawParticlesStage = mProfiler->addStage( "Particle draw" );
+    mDraw2dStage        = mProfiler->addStage( "PCM and data draw" );
+    mParamsStage        = mProfiler->addStage( "Params draw" );
+    mProfiler->addParams( mParams );
+    
+    // a Chrome trace of the main, audio and analysis threads is written when "Record trace" is unticked, "--trace <path>" records from the start
+    mTracer     = Tracer::create( Tracer::Format().path( getDocumentsDirectory() / "SoundCircles-trace.json" ).args( getArgs() ) );
+    mTracing    = mTracer->isRecording();
+    mAudio->setTracer( mTracer );
+    mParams->addParam( "Record trace", &mTracing, "group='Profiler'" );
+    
+    // "--latency <impulses>" injects impulses into the analysed input, reports how long they take to reach the screen and quits.
+    // "Latency probe" measures them while the app runs
+    mLatency        = LatencyProbe::create( LatencyProbe::Format().report( getDocumentsDirectory() / "SoundCircles-latency.txt" ).args( getArgs() ) );
+    mLatencyEnabled = mLatency->isEnabled();
+    mAudio->setLatencyProbe( mLatency );
+    mParams->addParam( "Latency probe", &mLatencyEnabled, "group='Latency'" );
+    mLatency->addParams( mParams );
+    
+    // the values changed by hand during a show
+    mSession->watch( "Bark gain",     &mBarkGain );
+    mSession->watch( "Bark offset",   &mBarkOffset );
+    mSession->watch( "Bark damping",  &mBarkDamping );
+    mSession->watch( "Min dist.",     &mMinDist );
+    mSession->watch( "Radius",        &mRadius );
+    mSession->watch( "Speed",         &mSpeed );
+    mSession->watch( "Particles N",   &mParticlesN );
+    mSession->watch( "Multithreaded", &mMultithreaded );
+    
+    mParticles.resize( mParticlesN * 2 );
+    polarToCartesian( mParticles.angle.data(), mParticles.radius.data(), mParticles.x.data(), mParticles.y.data(), mParticles.count() );
+}
+
+
+void SoundCirclesApp::Particles::resize( size_t n )
+{
+    size_t k = count();
+    
+    angle.resize( n );
+    vel.resize( n );
+    size.resize( n );
+    radius.resize( n );
+    initRadius.resize( n );
+    col.resize( n );
+    x.resize( n );
+    y.resize( n );
+    
+    for( ; k < n; k++ )
     {
-        Particle p;
-        p.angle         = randFloat( toRadians(360.0f) );
-        p.vel           = randFloat( -0.01f, 0.01f );
-        p.size          = 5.0f;
-        p.initRadius    = 100.0f;
-        p.radius        = p.initRadius;
-        p.col           = Color::white();
-        
-        mParticles.push_back( p );
+        angle[k]        = randFloat( toRadians(360.0f) );
+        vel[k]          = randFloat( -0.01f, 0.01f );
+        size[k]         = 5.0f;
+        initRadius[k]   = 100.0f;
+        radius[k]       = initRadius[k];
+        col[k]          = Color::white();
     }
 }
 
 
 void SoundCirclesApp::update()
 {
+    // the previous frame has been swapped by now
+    mLatency->mark( LatencyProbe::SWAP );
+    
+    // a replayed frame sets the parameters it was captured with, before anything reads them
+    if ( !mSession->beginFrame() )
+    {
+        quit();
+        return;
+    }
+    
+    mProfiler->beginFrame();
+    mTracer->setRecording( mTracing );
+    mLatency->setEnabled( mLatencyEnabled );
+    
+    Tracer::Scope trace( mTracer->getMainBuffer(), "update" );
+    
     // update params
-    mBark->setGain( mBarkGain );
-    mBark->setOffset( mBarkOffset );
-    mBark->setDamping( mBarkDamping );
+    mAudio->setFeatureParams( XTRACT_BARK_COEFFICIENTS, mBarkGain, mBarkOffset, mBarkDamping );
     
-    if ( !mMonitorNode )
+    if ( !mAudio->isRunning() )
         return;
     
-    mPcmBuffer = mMonitorNode->getBuffer();                     // get PCM buffer
+    mAudio->update();                                           // swap in the Xtract results of the hops since the last frame
     
-    if ( !mPcmBuffer.isEmpty() )
-        mXtract->update( mPcmBuffer.getData() );                // update Xtract
+    mBenchmark->addItems( (double)mParticlesN );
     
+    mProfiler->begin( mParticlesStage );
     updateParticles();
+    mProfiler->end( mParticlesStage );
+    
+    mLatency->mark( LatencyProbe::UPLOAD );                     // the particles follow the results
     
     mFps = getAverageFps();
 }
@@ -138,57 +253,84 @@ void SoundCirclesApp::update()
 
 void SoundCirclesApp::draw()
 {
+    Tracer::Scope trace( mTracer->getMainBuffer(), "draw" );
+    
+    // only the CPU side of the frame is measured
+    if ( mBenchmark->isNullRenderer() )
+    {
+        endFrame();
+        return;
+    }
+    
 	gl::clear( Color::gray( 0.1f ) );
     gl::enableAlphaBlending();
     
-    ciXtract::drawPcm( Rectf( 0, 0, getWindowWidth(), 60 ), mPcmBuffer.getData(), mPcmBuffer.getSize() / mPcmBuffer.getNumChannels() );
+    mProfiler->begin( mDraw2dStage );
+    mAudio->drawPcm( Rectf( 0, 0, getWindowWidth(), 60 ) );
     
-    ciXtract::drawData( mBark, Rectf( 15, 60, 140, 100 ) );
+    mAudio->drawData( XTRACT_BARK_COEFFICIENTS, Rectf( 15, 60, 140, 100 ), AudioAnalyzer::MAX );
+    mProfiler->end( mDraw2dStage );
     
+    mProfiler->begin( mDrawParticlesStage );
     drawParticles();
+    mProfiler->end( mDrawParticlesStage );
     
+    mProfiler->begin( mParamsStage );
     mParams->draw();
+    mProfiler->end( mParamsStage );
+    
+    endFrame();
 }
 
 
-void SoundCirclesApp::initAudio()
+void SoundCirclesApp::endFrame()
 {
-    auto ctx = audio::Context::master();
-    
-    vector<audio::DeviceRef> devices = audio::Device::getInputDevices();
-    console() << "List audio devices:" << endl;
-    for( auto k=0; k < devices.size(); k++ )
-        console() << devices[k]->getName() << endl;
-    
-    // find and initialise a device by name
-    audio::DeviceRef dev    = audio::Device::findDeviceByName( "Soundflower (2ch)" );
-    mInputDeviceNode        = ctx->createInputDeviceNode( dev );
-    
-    // initialise default input device
-    //    mInputDeviceNode = ctx->createInputDeviceNode();
-    
-    // initialise MonitorNode to get the PCM data
-	auto monitorFormat = audio::MonitorNode::Format().windowSize( CIXTRACT_PCM_SIZE );
-	mMonitorNode = ctx->makeNode( new audio::MonitorNode( monitorFormat ) );
-    
-    // pipe the input device into the MonitorNode
-	mInputDeviceNode >> mMonitorNode;
+    mLatency->mark( LatencyProbe::DRAW );
+    mProfiler->endFrame();
     
-	// InputDeviceNode (and all InputNode subclasses) need to be enabled()'s to process audio. So does the Context:
-	mInputDeviceNode->enable();
-	ctx->enable();
+    if ( mBenchmark->addFrame( *mProfiler ) || mLatency->isFinished() )
+        quit();
 }
 
 
 void SoundCirclesApp::updateParticles()
 {
-    shared_ptr<double>  data    = mBark->getResults();
+    FeatureView         data    = mAudio->getResults( XTRACT_BARK_COEFFICIENTS, AudioAnalyzer::MAX );
     
-    for( size_t k=0; k < mParticlesN; k++ )
-    {
-        mParticles[k].angle += mParticles[k].vel * mSpeed;
-        mParticles[k].radius = mParticles[k].initRadius + ( mRadius * data.get()[ k % mBark->getResultsN() ] );
-    }
+    if ( data.empty() )
+        return;
+    
+    // particles are only ever added, the slider just picks how many are active
+    if ( mParticlesN > (int)mParticles.count() )
+        mParticles.resize( mParticlesN );
+    
+    const float twoPi   = 2.0f * (float)M_PI;
+    JobSystem   *jobs   = mMultithreaded ? mJobs.get() : nullptr;
+    
+    // chunks are a multiple of 4, the SIMD blocks line up the same as in a single pass
+    auto update = [&]( size_t, size_t begin, size_t end ) {
+        for( size_t k=begin; k < end; k++ )
+        {
+            float angle = mParticles.angle[k] + mParticles.vel[k] * mSpeed;
+            
+            // keep the angle small, the sincos range reduction loses precision on large values
+            if ( angle > twoPi )        angle -= twoPi;
+            else if ( angle < 0.0f )    angle += twoPi;
+            
+            mParticles.angle[k]     = angle;
+            mParticles.radius[k]    = mParticles.initRadius[k] + ( mRadius * data[ k % data.size() ] );
+        }
+        
+        // positions are computed once per frame
+        polarToCartesian( mParticles.angle.data() + begin, mParticles.radius.data() + begin, mParticles.x.data() + begin, mParticles.y.data() + begin, end - begin );
+    };
+    
+    if ( jobs )
+        jobs->parallelFor( mParticlesN, 4096, update );
+    else
+        update( 0, 0, mParticlesN );
+    
+    mPairSweep.sweep( mParticles.x.data(), mParticles.y.data(), mParticlesN, mMinDist, jobs );
 }
 
 
@@ -198,34 +340,32 @@ void SoundCirclesApp::drawParticles()
     
     gl::translate( getWindowCenter() );
     
-    Vec2f   posA, posB;
-    float   dist;
-    ColorA  col = ColorA::white();
+    const float     *x      = mParticles.x.data();
+    const float     *y      = mParticles.y.data();
+    const uint32_t  *pairs  = mPairSweep.getPairs();
+    const float     *alpha  = mPairSweep.getAlpha();
+    ColorA          col     = ColorA::white();
+    int             n       = min( mParticlesN, (int)mParticles.count() );
     
-    for( size_t k=0; k < mParticlesN; k++ )
+    for( int k=0; k < n; k++ )
+        mBatch->addStrokedCircle( Vec2f( x[k], y[k] ), mParticles.size[k], mParticles.col[k] );
+    
+    // each pair is drawn once
+    for( size_t k=0; k < mPairSweep.getNumPairs(); k++ )
     {
-        gl::color( mParticles[k].col );
-        posA = Vec2f( cos( mParticles[k].angle ), sin( mParticles[k].angle ) ) * mParticles[k].radius;
-        gl::drawStrokedCircle( posA, mParticles[k].size );
-
-        for( size_t i=0; i < mParticlesN; i++ )
-        {
-            if ( k == i )
-                continue;
-            
-            posB = Vec2f( cos( mParticles[i].angle ), sin( mParticles[i].angle ) ) * mParticles[i].radius;
-            dist = posA.distance( posB );
-            
-            if ( dist < mMinDist )
-            {
-                col.a = 1.0f - dist / mMinDist;
-                
-                gl::color( col );
-                gl::drawLine( posA, posB );
-            }
-        }
+        uint32_t a = pairs[k*2];
+        uint32_t b = pairs[k*2+1];
+        
+        col.a = alpha[k];
+        
+        mBatch->addLine( Vec2f( x[a], y[a] ), Vec2f( x[b], y[b] ), col );
     }
     
+    // one draw call for the lines and one for the circles
+    mBatch->draw();
+    
+    mDrawCallsSaved = mBatch->getDrawCallsSaved();
+    
     gl::popMatrices();
 }
 
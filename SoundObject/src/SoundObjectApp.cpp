@@ -2,14 +2,20 @@
 #include "cinder/gl/gl.h"
 #include "cinder/params/Params.h"
 
-#include "cinder/gl/Vbo.h"
-#include "cinder/ObjLoader.h"
 #include "cinder/MayaCamUI.h"
 
-#include "cinder/audio/Context.h"
-#include "cinder/audio/MonitorNode.h"
+#include "AudioAnalyzer.h"
+#include "DisplacementKernel.h"
+#include "FrameProfiler.h"
+#include "Tracer.h"
+#include "Benchmark.h"
+#include "SessionLog.h"
+#include "LatencyProbe.h"
+#include "JobSystem.h"
+#include "MeshCache.h"
+#include "MeshLod.h"
 
-#include "ciXtract.h"
+#include <algorithm>
 
 
 using namespace ci;
@@ -27,31 +33,53 @@ public:
 	void mouseDrag( MouseEvent event );
 	void update();
 	void draw();
-    void initAudio();
+    void endFrame();
     void processData();
+    void createMesh();
+    
+    // Audio
+    AudioAnalyzerRef            mAudio;
     
     // Xtract
-    ciXtractRef                 mXtract;
-    ciXtractFeatureRef          mBark;
     vector<double>              mBarkData;
     float                       mBarkGain;
     float                       mBarkOffset;
     float                       mBarkDamping;
     
-    // Audio
-	audio::InputDeviceNodeRef	mInputDeviceNode;
-	audio::MonitorNodeRef       mMonitorNode;
-    audio::Buffer               mPcmBuffer;
-    
     // Mesh
-    TriMesh                     mTriMesh;
-	gl::VboMeshRef              mVbo;
+    MeshLod::Levels             mMeshLevels;            // simplified once, the GPU side is recreated when the layout changes
+    MeshLodRef                  mMesh;                  // static normals and indices, dynamic positions or displacements
+    int                         mLodLevel;              // level drawn this frame, the only one displaced
+    int                         mLodOverride;           // -1 picks the level from the screen size
+    float                       mLodMaxError;           // pixels
+    int                         mLodTriangles;
+    bool                        mCompactVertices;
+    bool                        mMeshCompactRequested;  // the mesh layout follows mCompactVertices on the next update
+    float                       mMeshKb;
+    float                       mFrameUploadKb;
     ColorA                      mMeshCol;
     float                       mDistorsion;
+    vector<DisplacementKernel>  mDisplacement;          // one per level
+    JobSystemRef                mJobs;
+    bool                        mMultithreaded;
+    bool                        mOptimizeMesh;          // welded and reordered for the vertex cache
     
     params::InterfaceGlRef      mParams;
 	MayaCamUI                   mMayaCam;
     float                       mFps;
+    
+    // Profiler
+    FrameProfilerRef            mProfiler;
+    size_t                      mVertexStage;
+    size_t                      mDraw3dStage;
+    size_t                      mDraw2dStage;
+    size_t                      mParamsStage;
+    TracerRef                   mTracer;
+    bool                        mTracing;
+    BenchmarkRef                mBenchmark;
+    SessionLogRef               mSession;
+    LatencyProbeRef             mLatency;
+    bool                        mLatencyEnabled;
 };
 
 
@@ -67,7 +95,23 @@ void SoundObjectApp::setup()
     mBarkOffset     = 0.0f;
     mBarkDamping    = 0.98f;
     
-    mParams = params::InterfaceGl::create( "params", Vec2i( 200, 250 ) );
+    // "--benchmark <frames>" feeds the audio offline and runs a fixed number of frames as fast as possible, then writes a report and quits
+    mBenchmark      = Benchmark::create( "SoundObject", Benchmark::Format().args( getArgs() ) );
+    
+    // "--capture <path>" logs the audio and the parameter changes of every frame, "--replay <path>" plays a log back frame by frame,
+    // at the captured pace or as fast as possible with "--replay-fast". The session seeds Rand, it's created before anything random
+    mSession        = SessionLog::create( SessionLog::Format().args( getArgs() ) );
+    
+    if ( mBenchmark->isEnabled() || ( mSession->isReplaying() && !mSession->isRealtime() ) )
+    {
+        disableFrameRate();
+        gl::disableVerticalSync();
+    }
+    
+    // per-stage timings, "--profile-csv <path>" writes every frame, allocations in allocation free stages fail a benchmark
+    mProfiler       = FrameProfiler::create( mBenchmark->getProfilerFormat().args( getArgs() ) );
+    
+    mParams = params::InterfaceGl::create( "params", Vec2i( 240, 420 ) );
     mParams->addParam( "FPS",  &mFps );
     mParams->addSeparator();
     mParams->addParam( "Bark gain",     &mBarkGain,     "min=0.1 max=500.0 step=0.01" );
@@ -76,33 +120,132 @@ void SoundObjectApp::setup()
     mParams->addSeparator();
     mParams->addParam( "Mesh color", &mMeshCol );
     mParams->addParam( "Distortion", &mDistorsion, "min=0.0 max=100.0 step=0.1" );
-    
-    // load mesh
-	ObjLoader loader( loadAsset( "head-low.obj" ) );
-	loader.load( &mTriMesh );
-	gl::VboMesh::Layout layout;
-	layout.setStaticIndices();
-	layout.setDynamicPositions();
-    mVbo = gl::VboMesh::create( mTriMesh, layout );
+    mParams->addParam( "Multithreaded", &mMultithreaded );
+    mParams->addParam( "Compact vertices", &mCompactVertices );
+    mParams->addParam( "Mesh KB",           &mMeshKb,           "", true );
+    mParams->addParam( "Frame upload KB",   &mFrameUploadKb,    "", true );
+    mParams->addSeparator();
+    mParams->addParam( "LOD max error px",  &mLodMaxError,      "min=0.1 max=20.0 step=0.1" );
+    mParams->addParam( "LOD override",      &mLodOverride,      "min=-1 max=3 step=1" );
+    mParams->addParam( "LOD level",         &mLodLevel,         "", true );
+    mParams->addParam( "LOD triangles",     &mLodTriangles,     "", true );
+    
+    mJobs               = JobSystem::create();
+    mMultithreaded      = true;
+    mCompactVertices    = true;
+    mLodLevel           = 0;
+    mLodOverride        = -1;
+    mLodMaxError        = 1.0f;
+    mLodTriangles       = 0;
+    
+    mBenchmark->setParam( "Mesh", "head-low.obj" );
+    mBenchmark->param( "Multithreaded",     &mMultithreaded );
+    mBenchmark->param( "Compact vertices",  &mCompactVertices );
+    mBenchmark->param( "LOD override",      &mLodOverride );
+    mBenchmark->param( "LOD max error px",  &mLodMaxError );
+    mBenchmark->setItemName( "vertices" );
+    
+    // "--optimize-mesh" welds the mesh and reorders it for the vertex cache. The vertex order changes, and with it
+    // which Bark band each vertex follows, so it's off by default
+    mOptimizeMesh = find( getArgs().begin(), getArgs().end(), "--optimize-mesh" ) != getArgs().end();
+    mBenchmark->param( "Optimise mesh", &mOptimizeMesh );
+    
+    // load mesh, from the binary cache unless head-low.obj changed
+    MeshOptimizer::Stats    meshStats;
+    MeshDataRef             meshData = MeshCache::loadObj( getAssetPath( "head-low.obj" ), true, mJobs.get(), mOptimizeMesh, &meshStats );
+    if ( mOptimizeMesh )
+        console() << "head-low.obj: " << meshStats.mVerticesBefore << " -> " << meshStats.mVerticesAfter << " vertices, ACMR "
+                  << meshStats.mAcmrBefore << " -> " << meshStats.mAcmrAfter << endl;
+    
+    // quadric simplification to 50, 25 and 10% of the triangles
+    vector<float> lodRatios;
+    lodRatios.push_back( 0.5f );
+    lodRatios.push_back( 0.25f );
+    lodRatios.push_back( 0.1f );
+    mMeshLevels = MeshLod::buildLevels( meshData, lodRatios );
+    
+    for( size_t k=0; k < mMeshLevels.size(); k++ )
+        console() << "LOD " << k << ": " << mMeshLevels[k].mData->getNumIndices() / 3 << " triangles, error " << mMeshLevels[k].mError << endl;
+    
+    createMesh();
     
     mMeshCol    = ColorA::white();
     mDistorsion = 3.0f;
+    mBenchmark->param( "Distortion", &mDistorsion );
     
     // initialise camera
 	CameraPersp initialCam;
 	initialCam.setPerspective( 45.0f, getWindowAspectRatio(), 0.1, 10000 );
 	mMayaCam.setCurrentCam( initialCam );
     
-    // initialise Xtract
-    mXtract = ciXtract::create();
+    // initialise audio and Xtract
+    AudioAnalyzer::Format audioFormat = AudioAnalyzer::Format().threaded().hopSize( CIXTRACT_PCM_SIZE / 4 ).session( mSession ).args( getArgs() );
+    if ( mBenchmark->isEnabled() )
+        audioFormat.offline();
+    
+    mAudio = AudioAnalyzer::create( audioFormat );
     
     // enable features
-    mXtract->enableFeature( XTRACT_BARK_COEFFICIENTS );
+    mAudio->enableFeature( XTRACT_BARK_COEFFICIENTS );
+    
+    mAudio->setProfiler( mProfiler );
+    mVertexStage    = mProfiler->addStage( "Vertex update" );
+    mDraw3dStage    = mProfiler->addStage( "3D draw" );
+    mDraw2dStage    = mProfiler->addStage( "PCM and data draw" );
+    mParamsStage    = mProfiler->addStage( "Params draw" );
+    mProfiler->addParams( mParams );
+    
+    // a Chrome trace of the main, audio and analysis threads is written when "Record trace" is unticked, "--trace <path>" records from the start
+    mTracer     = Tracer::create( Tracer::Format().path( getDocumentsDirectory() / "SoundObject-trace.json" ).args( getArgs() ) );
+    mTracing    = mTracer->isRecording();
+    mAudio->setTracer( mTracer );
+    mParams->addParam( "Record trace", &mTracing, "group='Profiler'" );
+    
+    // "--latency <impulses>" injects impulses into the analysed input, reports how long they take to reach the screen and quits.
+    // "Latency probe" measures them while the app runs
+    mLatency        = LatencyProbe::create( LatencyProbe::Format().report( getDocumentsDirectory() / "SoundObject-latency.txt" ).args( getArgs() ) );
+    mLatencyEnabled = mLatency->isEnabled();
+    mAudio->setLatencyProbe( mLatency );
+    mParams->addParam( "Latency probe", &mLatencyEnabled, "group='Latency'" );
+    mLatency->addParams( mParams );
+    
+    // the values changed by hand during a show
+    mSession->watch( "Bark gain",         &mBarkGain );
+    mSession->watch( "Bark offset",       &mBarkOffset );
+    mSession->watch( "Bark damping",      &mBarkDamping );
+    mSession->watch( "Mesh color",        &mMeshCol );
+    mSession->watch( "Distortion",        &mDistorsion );
+    mSession->watch( "Multithreaded",     &mMultithreaded );
+    mSession->watch( "Compact vertices",  &mCompactVertices );
+    mSession->watch( "LOD max error px",  &mLodMaxError );
+    mSession->watch( "LOD override",      &mLodOverride );
+}
+
+
+void SoundObjectApp::createMesh()
+{
+    mMeshCompactRequested = mCompactVertices;
+    
+    mMesh = MeshLod::create( mMeshLevels, GpuMesh::Format().dynamicPositions().compact( mCompactVertices ) );
+    mMesh->uploadAll();
+    
+    mMeshKb = mMesh->getSize() / 1024.0f;
     
-    // get feature references
-    mBark       = mXtract->getFeature( XTRACT_BARK_COEFFICIENTS );
+    // compact meshes are displaced on the GPU and only need the offsets, otherwise base positions and directions are computed once.
+    // The levels follow the bands of the vertices they come from. The band count is only known once the audio runs
+    size_t numBands = mDisplacement.empty() ? 0 : mDisplacement[0].getNumBands();
+    mDisplacement.resize( mMesh->getNumLevels() );
     
-    initAudio();
+    for( size_t k=0; k < mMesh->getNumLevels(); k++ )
+    {
+        const MeshDataRef   &data   = mMesh->getLevel( k ).mData;
+        const uint32_t      *ids    = k > 0 ? mMesh->getLevel( k ).mSourceVertices.data() : nullptr;
+        
+        if ( mMesh->getMesh( k )->isCompact() )
+            mDisplacement[k].init( data->getNumVertices(), numBands, ids );
+        else
+            mDisplacement[k].init( data->getVertices(), data->getNumVertices(), numBands, data->getVertexSize(), ids );
+    }
 }
 
 
@@ -122,87 +265,130 @@ void SoundObjectApp::mouseDrag( MouseEvent event )
 
 void SoundObjectApp::update()
 {
-    // update params
-    mBark->setGain( mBarkGain );
-    mBark->setOffset( mBarkOffset );
-    mBark->setDamping( mBarkDamping );
+    // the previous frame has been swapped by now
+    mLatency->mark( LatencyProbe::SWAP );
     
-    if ( !mMonitorNode )
+    // a replayed frame sets the parameters it was captured with, before anything reads them
+    if ( !mSession->beginFrame() )
+    {
+        quit();
         return;
+    }
     
-    mPcmBuffer = mMonitorNode->getBuffer();                     // get PCM buffer
+    mProfiler->beginFrame();
+    mTracer->setRecording( mTracing );
+    mLatency->setEnabled( mLatencyEnabled );
     
-    if ( !mPcmBuffer.isEmpty() )
-        mXtract->update( mPcmBuffer.getData() );                // update Xtract
+    Tracer::Scope trace( mTracer->getMainBuffer(), "update" );
+    
+    // update params
+    mAudio->setFeatureParams( XTRACT_BARK_COEFFICIENTS, mBarkGain, mBarkOffset, mBarkDamping );
+    
+    if ( mCompactVertices != mMeshCompactRequested )
+        createMesh();
+    
+    // the level is picked before displacing, levels that aren't drawn cost nothing
+    int numLevels   = (int)mMesh->getNumLevels();
+    mLodLevel       = mLodOverride >= 0 ? min( mLodOverride, numLevels - 1 ) : (int)mMesh->selectLevel( mMayaCam.getCamera(), (float)getWindowHeight(), mLodMaxError );
+    
+    GpuMeshRef          mesh            = mMesh->getMesh( mLodLevel );
+    DisplacementKernel  &displacement   = mDisplacement[mLodLevel];
+    mLodTriangles   = (int)mesh->getNumIndices() / 3;
+    mFrameUploadKb  = mesh->getDynamicSize() / 1024.0f;
+    
+    if ( !mAudio->isRunning() )
+        return;
+    
+    mAudio->update();                                           // swap in the Xtract results of the hops since the last frame
     
     // update Vbo
-    std::shared_ptr<double> data        = mBark->getResults();
-    int                     dataSize    = mBark->getResultsN();
+    FeatureView             data        = mAudio->getResults( XTRACT_BARK_COEFFICIENTS, AudioAnalyzer::MAX );
     
-    vector<Vec3f> verts = mTriMesh.getVertices();
-    gl::VboMesh::VertexIter iter = mVbo->mapVertexBuffer();
+    if ( data.empty() || displacement.getNumVertices() == 0 )
+        return;
+    
+    if ( displacement.getNumBands() != data.size() )
+        displacement.setNumBands( data.size() );
+    
+    mBenchmark->addItems( (double)displacement.getNumVertices() );
     
-    for( int k=0; k < mVbo->getNumVertices(); k++ )     // for( int k=0; k < dataSize; k++ )
+    // the kernel writes straight into the mapped buffer, compact meshes only take the offset along the direction
+    FrameProfiler::Scope    scope( mProfiler.get(), mVertexStage );
+    JobSystem               *jobs = mMultithreaded ? mJobs.get() : nullptr;
+    
+    if ( mesh->isCompact() )
+    {
+        float *displacements = mesh->mapDisplacements();
+        
+        if ( displacements )
+            displacement.calcOffsets( data.data(), mDistorsion, displacements, jobs );
+        
+        mesh->unmapDisplacements();
+    }
+    else
     {
-        // iter.setPosition( verts[k] + mDistorsion * verts[k].normalized() * ( 1.0f + data.get()[k%dataSize] ) );
-        iter.setPosition( verts[k] + mDistorsion * verts[k].normalized() * data.get()[k%dataSize] );
-        ++iter;
+        uint8_t *positions = mesh->mapPositions();
+        
+        if ( positions )
+            displacement.displace( data.data(), mDistorsion, positions, mesh->getPositionStride(), jobs );
+        
+        mesh->unmapPositions();
     }
     
+    mLatency->mark( LatencyProbe::UPLOAD );                     // the vertices follow the results
+    
     mFps = getAverageFps();
 }
 
 
 void SoundObjectApp::draw()
 {
+    Tracer::Scope trace( mTracer->getMainBuffer(), "draw" );
+    
+    // only the CPU side of the frame is measured
+    if ( mBenchmark->isNullRenderer() )
+    {
+        endFrame();
+        return;
+    }
+    
 	gl::clear( Color::gray( 0.1f ) );
     gl::enableAlphaBlending();
     
     // render 3D scene
+    mProfiler->begin( mDraw3dStage );
 	gl::setMatrices( mMayaCam.getCamera() );
     gl::enableWireframe();
     gl::color( mMeshCol );
-    gl::draw( mVbo );
+    mMesh->getMesh( mLodLevel )->draw();
     gl::disableWireframe();
 	gl::setMatricesWindow( getWindowSize() );
+    mProfiler->end( mDraw3dStage );
     
     gl::color( Color::white() );
     
     // render 2D
-    ciXtract::drawPcm( Rectf( 0, 0, getWindowWidth(), 60 ), mPcmBuffer.getData(), mPcmBuffer.getSize() / mPcmBuffer.getNumChannels() );
+    mProfiler->begin( mDraw2dStage );
+    mAudio->drawPcm( Rectf( 0, 0, getWindowWidth(), 60 ) );
     
-    ciXtract::drawData( mBark, Rectf( 15, 60, 140, 100 ) );
+    mAudio->drawData( XTRACT_BARK_COEFFICIENTS, Rectf( 15, 60, 140, 100 ), AudioAnalyzer::MAX );
+    mProfiler->end( mDraw2dStage );
     
+    mProfiler->begin( mParamsStage );
     mParams->draw();
+    mProfiler->end( mParamsStage );
+    
+    endFrame();
 }
 
 
-void SoundObjectApp::initAudio()
+void SoundObjectApp::endFrame()
 {
-    auto ctx = audio::Context::master();
-    
-    vector<audio::DeviceRef> devices = audio::Device::getInputDevices();
-    console() << "List audio devices:" << endl;
-    for( auto k=0; k < devices.size(); k++ )
-        console() << devices[k]->getName() << endl;
-    
-    // find and initialise a device by name
-    audio::DeviceRef dev    = audio::Device::findDeviceByName( "Soundflower (2ch)" );
-    mInputDeviceNode        = ctx->createInputDeviceNode( dev );
-    
-    // initialise default input device
-    //    mInputDeviceNode = ctx->createInputDeviceNode();
-    
-    // initialise MonitorNode to get the PCM data
-	auto monitorFormat = audio::MonitorNode::Format().windowSize( CIXTRACT_PCM_SIZE );
-	mMonitorNode = ctx->makeNode( new audio::MonitorNode( monitorFormat ) );
-    
-    // pipe the input device into the MonitorNode
-	mInputDeviceNode >> mMonitorNode;
+    mLatency->mark( LatencyProbe::DRAW );
+    mProfiler->endFrame();
     
-	// InputDeviceNode (and all InputNode subclasses) need to be enabled()'s to process audio. So does the Context:
-	mInputDeviceNode->enable();
-	ctx->enable();
+    if ( mBenchmark->addFrame( *mProfiler ) || mLatency->isFinished() )
+        quit();
 }
 
 
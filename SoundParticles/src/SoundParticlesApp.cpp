@@ -3,10 +3,15 @@
 #include "cinder/params/Params.h"
 #include "cinder/Rand.h"
 
-#include "cinder/audio/Context.h"
-#include "cinder/audio/MonitorNode.h"
-
-#include "ciXtract.h"
+#include "AudioAnalyzer.h"
+#include "SpatialGrid.h"
+#include "FrameProfiler.h"
+#include "Tracer.h"
+#include "Benchmark.h"
+#include "SessionLog.h"
+#include "LatencyProbe.h"
+#include "BatchRenderer.h"
+#include "JobSystem.h"
 
 
 using namespace ci;
@@ -30,27 +35,43 @@ public:
 	void setup();
 	void update();
 	void draw();
-    void initAudio();
+    void endFrame();
+    void initParticles();
     void updateParticles();
     void drawParticles();
     
+    // Audio
+    AudioAnalyzerRef            mAudio;
+    
     // Xtract
-    ciXtractRef                 mXtract;
-    ciXtractFeatureRef          mBark;
     float                       mBarkGain;
     float                       mBarkOffset;
     float                       mBarkDamping;
     
-    // Audio
-	audio::InputDeviceNodeRef	mInputDeviceNode;
-	audio::MonitorNodeRef       mMonitorNode;
-    audio::Buffer               mPcmBuffer;
-    
     vector<Particle>            mParticles;
+    int                         mNumParticles;
     float                       mMinDist;
+    SpatialGrid                 mGrid;
+    vector<SpatialGrid::Pair>   mPairs;
+    BatchRendererRef            mBatch;
+    JobSystemRef                mJobs;
+    bool                        mMultithreaded;
     
     params::InterfaceGlRef      mParams;
     float                       mFps;
+    int                         mDrawCallsSaved;
+    
+    FrameProfilerRef            mProfiler;
+    size_t                      mParticlesStage;
+    size_t                      mDrawParticlesStage;
+    size_t                      mDraw2dStage;
+    size_t                      mParamsStage;
+    TracerRef                   mTracer;
+    bool                        mTracing;
+    BenchmarkRef                mBenchmark;
+    SessionLogRef               mSession;
+    LatencyProbeRef             mLatency;
+    bool                        mLatencyEnabled;
 };
 
 
@@ -66,29 +87,96 @@ void SoundParticlesApp::setup()
     mBarkOffset     = 0.0f;
     mBarkDamping    = 0.95f;
     mMinDist        = 100.0f;
+    mNumParticles   = 100;
+    mDrawCallsSaved = 0;
+    mBatch          = BatchRenderer::create();
+    mJobs           = JobSystem::create();
+    mMultithreaded  = true;
+    
+    // "--benchmark <frames>" feeds the audio offline and runs a fixed number of frames as fast as possible, then writes a report and quits
+    mBenchmark      = Benchmark::create( "SoundParticles", Benchmark::Format().args( getArgs() ) );
     
-    mParams = params::InterfaceGl::create( "params", Vec2i( 200, 250 ) );
+    // "--capture <path>" logs the audio and the parameter changes of every frame, "--replay <path>" plays a log back frame by frame,
+    // at the captured pace or as fast as possible with "--replay-fast". The session seeds Rand, it's created before anything random
+    mSession        = SessionLog::create( SessionLog::Format().args( getArgs() ) );
+    
+    if ( mBenchmark->isEnabled() || ( mSession->isReplaying() && !mSession->isRealtime() ) )
+    {
+        disableFrameRate();
+        gl::disableVerticalSync();
+    }
+    
+    mBenchmark->param( "Particles",     &mNumParticles );
+    mBenchmark->param( "Min dist.",     &mMinDist );
+    mBenchmark->param( "Multithreaded", &mMultithreaded );
+    mBenchmark->setItemName( "particles" );
+    
+    // per-stage timings, "--profile-csv <path>" writes every frame, allocations in allocation free stages fail a benchmark
+    mProfiler       = FrameProfiler::create( mBenchmark->getProfilerFormat().args( getArgs() ) );
+    
+    mParams = params::InterfaceGl::create( "params", Vec2i( 240, 420 ) );
     mParams->addParam( "FPS",  &mFps );
+    mParams->addParam( "Draw calls saved",  &mDrawCallsSaved, "", true );
     mParams->addSeparator();
     mParams->addParam( "Bark gain",     &mBarkGain,     "min=0.1 max=500.0 step=0.01" );
     mParams->addParam( "Bark offset",   &mBarkOffset,   "min=-1.0 max=1.0 step=0.01" );
     mParams->addParam( "Bark damping",  &mBarkDamping,  "min=0.7 max=0.99 step=0.01" );
     mParams->addSeparator();
     mParams->addParam( "Min dist.",     &mMinDist,      "min=0.0 max=1000.0 step=1.0" );
+    mParams->addParam( "Particles",     &mNumParticles, "min=0 max=200000 step=100" );
+    mParams->addParam( "Multithreaded", &mMultithreaded );
     
-    // initialise Xtract
-    mXtract = ciXtract::create();
+    // initialise audio and Xtract
+    AudioAnalyzer::Format audioFormat = AudioAnalyzer::Format().threaded().hopSize( CIXTRACT_PCM_SIZE / 4 ).session( mSession ).args( getArgs() );
+    if ( mBenchmark->isEnabled() )
+        audioFormat.offline();
+    
+    mAudio = AudioAnalyzer::create( audioFormat );
     
     // enable features
-    mXtract->enableFeature( XTRACT_BARK_COEFFICIENTS );
-    mXtract->enableFeature( XTRACT_SPECTRUM );
+    mAudio->enableFeature( XTRACT_BARK_COEFFICIENTS );
+    mAudio->enableFeature( XTRACT_SPECTRUM );
+    
+    mAudio->setProfiler( mProfiler );
+    mParticlesStage     = mProfiler->addStage( "Particle update" );
+    mDrawParticlesStage = mProfiler->addStage( "Particle draw" );
+    mDraw2dStage        = mProfiler->addStage( "PCM and data draw" );
+    mParamsStage        = mProfiler->addStage( "Params draw" );
+    mProfiler->addParams( mParams );
     
-    // get feature references
-    mBark       = mXtract->getFeature( XTRACT_BARK_COEFFICIENTS );
+    // a Chrome trace of the main, audio and analysis threads is written when "Record trace" is unticked, "--trace <path>" records from the start
+    mTracer     = Tracer::create( Tracer::Format().path( getDocumentsDirectory() / "SoundParticles-trace.json" ).args( getArgs() ) );
+    mTracing    = mTracer->isRecording();
+    mAudio->setTracer( mTracer );
+    mParams->addParam( "Record trace", &mTracing, "group='Profiler'" );
     
-    initAudio();
+    // "--latency <impulses>" injects impulses into the analysed input, reports how long they take to reach the screen and quits.
+    // "Latency probe" measures them while the app runs
+    mLatency        = LatencyProbe::create( LatencyProbe::Format().report( getDocumentsDirectory() / "SoundParticles-latency.txt" ).args( getArgs() ) );
+    mLatencyEnabled = mLatency->isEnabled();
+    mAudio->setLatencyProbe( mLatency );
+    mParams->addParam( "Latency probe", &mLatencyEnabled, "group='Latency'" );
+    mLatency->addParams( mParams );
     
-    for( int k=0; k < 100; k++ )
+    // the values changed by hand during a show
+    mSession->watch( "Bark gain",     &mBarkGain );
+    mSession->watch( "Bark offset",   &mBarkOffset );
+    mSession->watch( "Bark damping",  &mBarkDamping );
+    mSession->watch( "Min dist.",     &mMinDist );
+    mSession->watch( "Particles",     &mNumParticles );
+    mSession->watch( "Multithreaded", &mMultithreaded );
+    
+    initParticles();
+}
+
+
+void SoundParticlesApp::initParticles()
+{
+    // keep the existing particles, only add or remove the difference
+    if ( (int)mParticles.size() > mNumParticles )
+        mParticles.resize( mNumParticles );
+    
+    while( (int)mParticles.size() < mNumParticles )
     {
         Particle p;
         p.pos   = Vec2f( randInt( getWindowWidth() ), randInt( getWindowHeight() ) );
@@ -103,20 +191,40 @@ void SoundParticlesApp::setup()
 
 void SoundParticlesApp::update()
 {
+    // the previous frame has been swapped by now
+    mLatency->mark( LatencyProbe::SWAP );
+    
+    // a replayed frame sets the parameters it was captured with, before anything reads them
+    if ( !mSession->beginFrame() )
+    {
+        quit();
+        return;
+    }
+    
+    mProfiler->beginFrame();
+    mTracer->setRecording( mTracing );
+    mLatency->setEnabled( mLatencyEnabled );
+    
+    Tracer::Scope trace( mTracer->getMainBuffer(), "update" );
+    
     // update params
-    mBark->setGain( mBarkGain );
-    mBark->setOffset( mBarkOffset );
-    mBark->setDamping( mBarkDamping );
+    mAudio->setFeatureParams( XTRACT_BARK_COEFFICIENTS, mBarkGain, mBarkOffset, mBarkDamping );
     
-    if ( !mMonitorNode )
+    if ( !mAudio->isRunning() )
         return;
     
-    mPcmBuffer = mMonitorNode->getBuffer();                     // get PCM buffer
+    mAudio->update();                                           // swap in the Xtract results of the hops since the last frame
+    
+    if ( (int)mParticles.size() != mNumParticles )
+        initParticles();
     
-    if ( !mPcmBuffer.isEmpty() )
-        mXtract->update( mPcmBuffer.getData() );                // update Xtract
+    mBenchmark->addItems( (double)mParticles.size() );
     
+    mProfiler->begin( mParticlesStage );
     updateParticles();
+    mProfiler->end( mParticlesStage );
+    
+    mLatency->mark( LatencyProbe::UPLOAD );                     // the particles follow the results
     
     mFps = getAverageFps();
 }
@@ -124,87 +232,112 @@ void SoundParticlesApp::update()
 
 void SoundParticlesApp::draw()
 {
+    Tracer::Scope trace( mTracer->getMainBuffer(), "draw" );
+    
+    // only the CPU side of the frame is measured
+    if ( mBenchmark->isNullRenderer() )
+    {
+        endFrame();
+        return;
+    }
+    
 	gl::clear( Color::gray( 0.1f ) );
     gl::enableAlphaBlending();
     
-    ciXtract::drawPcm( Rectf( 0, 0, getWindowWidth(), 60 ), mPcmBuffer.getData(), mPcmBuffer.getSize() / mPcmBuffer.getNumChannels() );
+    mProfiler->begin( mDraw2dStage );
+    mAudio->drawPcm( Rectf( 0, 0, getWindowWidth(), 60 ) );
     
-    ciXtract::drawData( mBark, Rectf( 15, 60, 140, 100 ) );
+    mAudio->drawData( XTRACT_BARK_COEFFICIENTS, Rectf( 15, 60, 140, 100 ), AudioAnalyzer::MAX );
+    mProfiler->end( mDraw2dStage );
     
+    mProfiler->begin( mDrawParticlesStage );
     drawParticles();
+    mProfiler->end( mDrawParticlesStage );
     
+    mProfiler->begin( mParamsStage );
     mParams->draw();
+    mProfiler->end( mParamsStage );
+    
+    endFrame();
 }
 
 
-void SoundParticlesApp::initAudio()
+void SoundParticlesApp::endFrame()
 {
-    auto ctx = audio::Context::master();
-    
-    vector<audio::DeviceRef> devices = audio::Device::getInputDevices();
-    console() << "List audio devices:" << endl;
-    for( auto k=0; k < devices.size(); k++ )
-        console() << devices[k]->getName() << endl;
-    
-    // find and initialise a device by name
-    audio::DeviceRef dev    = audio::Device::findDeviceByName( "Soundflower (2ch)" );
-    mInputDeviceNode        = ctx->createInputDeviceNode( dev );
+    mLatency->mark( LatencyProbe::DRAW );
+    mProfiler->endFrame();
     
-    // initialise default input device
-    //    mInputDeviceNode = ctx->createInputDeviceNode();
-    
-    // initialise MonitorNode to get the PCM data
-	auto monitorFormat = audio::MonitorNode::Format().windowSize( CIXTRACT_PCM_SIZE );
-	mMonitorNode = ctx->makeNode( new audio::MonitorNode( monitorFormat ) );
-    
-    // pipe the input device into the MonitorNode
-	mInputDeviceNode >> mMonitorNode;
-    
-	// InputDeviceNode (and all InputNode subclasses) need to be enabled()'s to process audio. So does the Context:
-	mInputDeviceNode->enable();
-	ctx->enable();
+    if ( mBenchmark->addFrame( *mProfiler ) || mLatency->isFinished() )
+        quit();
 }
 
 
 void SoundParticlesApp::updateParticles()
 {
-    for( size_t k=0; k < mParticles.size(); k++ )
-    {
-        
-        mParticles[k].pos += mParticles[k].vel;
-        
-        if ( mParticles[k].pos.x < 0 && mParticles[k].vel.x < 0 )                  mParticles[k].pos.x = getWindowWidth() + mParticles[k].size;
-        if ( mParticles[k].pos.x > getWindowWidth() && mParticles[k].vel.x > 0 )   mParticles[k].pos.x = - mParticles[k].size;
-    }
+    float   width   = (float)getWindowWidth();
+    auto    update  = [this, width]( size_t, size_t begin, size_t end ) {
+        for( size_t k=begin; k < end; k++ )
+        {
+            Particle &p = mParticles[k];
+            
+            p.pos += p.vel;
+            
+            if ( p.pos.x < 0 && p.vel.x < 0 )           p.pos.x = width + p.size;
+            if ( p.pos.x > width && p.vel.x > 0 )       p.pos.x = - p.size;
+        }
+    };
+    
+    if ( mMultithreaded )
+        mJobs->parallelFor( mParticles.size(), 4096, update );
+    else
+        update( 0, 0, mParticles.size() );
 }
 
 
 void SoundParticlesApp::drawParticles()
 {
-    float               dist;
-    int                 idx;
-    shared_ptr<double>  data    = mBark->getResults();
-    ColorA              col     = ColorA::white();
+    FeatureView         data    = mAudio->getResults( XTRACT_BARK_COEFFICIENTS, AudioAnalyzer::MAX );
+    JobSystem           *jobs   = mMultithreaded ? mJobs.get() : nullptr;
+    
+    if ( data.empty() )
+        return;
     
     for( size_t k=0; k < mParticles.size(); k++ )
-    {
-        gl::color( mParticles[k].col );
-        gl::drawStrokedCircle( mParticles[k].pos, mParticles[k].size );
+        mBatch->addStrokedCircle( mParticles[k].pos, mParticles[k].size, mParticles[k].col );
+    
+    if ( mParticles.empty() )
+        return;
+    
+    // only the particles in the neighbouring cells are compared, each pair once
+    mGrid.build( &mParticles[0].pos.x, sizeof(Particle), mParticles.size(), mMinDist );
+    
+    mPairs.clear();
+    mGrid.findPairs( mMinDist, &mPairs, jobs );
+    
+    // each pair writes its own line, the order doesn't depend on the threads
+    size_t firstLine    = mBatch->allocateLines( mPairs.size() );
+    auto   addLines     = [&]( size_t, size_t begin, size_t end ) {
+        ColorA col = ColorA::white();
         
-        for( size_t i=0; i < mParticles.size(); i++ )
+        for( size_t k=begin; k < end; k++ )
         {
-            dist    = mParticles[k].pos.distance( mParticles[i].pos );
+            const SpatialGrid::Pair &pair = mPairs[k];
             
-            if ( k != i && dist < mMinDist )
-            {
-                idx     = ( k + i ) % mBark->getResultsN();
-                col.a   = data.get()[idx];
-                
-                gl::color( col );
-                gl::drawLine( mParticles[k].pos, mParticles[i].pos );
-            }
+            col.a = data[ ( pair.mA + pair.mB ) % data.size() ];
+            
+            mBatch->setLine( firstLine + k, mParticles[pair.mA].pos, mParticles[pair.mB].pos, col );
         }
-    }
+    };
+    
+    if ( jobs )
+        jobs->parallelFor( mPairs.size(), 8192, addLines );
+    else
+        addLines( 0, 0, mPairs.size() );
+    
+    // one draw call for the lines and one for the circles
+    mBatch->draw();
+    
+    mDrawCallsSaved = mBatch->getDrawCallsSaved();
 }
 
 
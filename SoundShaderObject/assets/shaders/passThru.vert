@@ -11,6 +11,11 @@ uniform float			spreadOffset;
 uniform float			time;
 uniform vec4            tintColor;
 
+uniform sampler2D		historyTex;             // one row per frame, historyHead is the latest
+uniform int				historyHead;
+uniform vec2			historySize;
+uniform float			historyDelay;           // frames, the delay grows along the texture v
+
 
 void main()
 {
@@ -19,6 +24,13 @@ void main()
 	texPos.x		= float( mod( binN, int(texWidth) ) + 0.5 ) / texWidth;
 	texPos.y		= float( binN / int(texWidth) + 0.5 ) / texHeight;
     vec4 col        = texture2D( dataTex, texPos );
+    
+    if ( historyDelay > 0.0 )
+    {
+        float age   = floor( historyDelay * gl_MultiTexCoord0.y );
+        col         = texture2D( historyTex, vec2( ( float( binN ) + 0.5 ) / historySize.x, ( float( historyHead ) - age + 0.5 ) / historySize.y ) );
+    }
+    
 	gl_FrontColor   = tintColor * col;
     gl_FrontColor.a = col.r;
     gl_Position     = ftransform();
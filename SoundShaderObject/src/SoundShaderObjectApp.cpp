@@ -3,14 +3,21 @@
 #include "cinder/params/Params.h"
 #include "cinder/gl/GlslProg.h"
 #include "cinder/gl/Texture.h"
-#include "cinder/gl/Vbo.h"
-#include "cinder/ObjLoader.h"
 #include "cinder/MayaCamUI.h"
 
-#include "cinder/audio/Context.h"
-#include "cinder/audio/MonitorNode.h"
+#include "AudioAnalyzer.h"
+#include "FeatureTexture.h"
+#include "FeatureHistory.h"
+#include "FrameProfiler.h"
+#include "Tracer.h"
+#include "Benchmark.h"
+#include "SessionLog.h"
+#include "LatencyProbe.h"
+#include "AsyncMeshLoader.h"
+#include "MeshCache.h"
+#include "JobSystem.h"
 
-#include "ciXtract.h"
+#include <algorithm>
 
 using namespace ci;
 using namespace ci::app;
@@ -24,7 +31,7 @@ public:
 	void setup();
 	void update();
 	void draw();
-    void initAudio();
+    void endFrame();
     
     void keyDown( KeyEvent event );
     void mouseDown( MouseEvent event );
@@ -35,31 +42,48 @@ public:
     void loadShader();
     void loadObject( fs::path filepath );
     
+    // Audio
+    AudioAnalyzerRef            mAudio;
+    
     // Xtract
-    ciXtractRef                 mXtract;
-    ciXtractFeatureRef          mBark;
     float                       mBarkGain;
     float                       mBarkOffset;
     float                       mBarkDamping;
     
-    // Audio
-	audio::InputDeviceNodeRef	mInputDeviceNode;
-	audio::MonitorNodeRef       mMonitorNode;
-    audio::Buffer               mPcmBuffer;
-    
     
     ColorA                      mObjColor;
     gl::GlslProgRef             mShader;
     MayaCamUI                   mMayaCam;
     bool                        mRenderWireframe;
     
-    gl::VboMesh                 mVbo;
+    JobSystemRef                mJobs;                  // parses the OBJ files
+    bool                        mOptimizeMesh;          // welded and reordered for the vertex cache
+    AsyncMeshLoaderRef          mMeshLoader;            // parses on a worker thread, the current mesh stays on screen until the new one is uploaded
+    float                       mMeshLoadTime;
+    float                       mMeshUploadTime;
+    float                       mLodMaxError;           // pixels, the level is picked from the screen size
+    int                         mLodLevel;
+    int                         mLodTriangles;
     
-	Surface32f                  mFeatureSurf;			// data is stored in Surface
-	gl::Texture                 mFeatureTex;			// use a Texture to pass the data to the shader
+    FeatureTextureRef           mFeatureTex;            // persistent float texture to pass the data to the shader
+    FeatureHistoryRef           mFeatureHistory;        // the last frames, one row each
+    float                       mHistoryDelay;
     
     params::InterfaceGlRef      mParams;
     float                       mFps;
+    
+    FrameProfilerRef            mProfiler;
+    size_t                      mMeshStage;
+    size_t                      mTextureStage;
+    size_t                      mDraw3dStage;
+    size_t                      mDraw2dStage;
+    size_t                      mParamsStage;
+    TracerRef                   mTracer;
+    bool                        mTracing;
+    BenchmarkRef                mBenchmark;
+    SessionLogRef               mSession;
+    LatencyProbeRef             mLatency;
+    bool                        mLatencyEnabled;
 };
 
 
@@ -76,8 +100,34 @@ void SoundShaderObjectApp::setup()
     mBarkDamping        = 0.95f;
     mObjColor           = ColorA( 0.0f, 1.0f, 1.0f, 1.0f );
     mRenderWireframe    = true;
+    mHistoryDelay       = 0.0f;
+    mMeshLoadTime       = 0.0f;
+    mMeshUploadTime     = 0.0f;
+    mLodMaxError        = 1.0f;
+    mLodLevel           = 0;
+    mLodTriangles       = 0;
+    
+    // "--benchmark <frames>" feeds the audio offline and runs a fixed number of frames as fast as possible, then writes a report and quits
+    mBenchmark          = Benchmark::create( "SoundShaderObject", Benchmark::Format().args( getArgs() ) );
+    
+    // "--capture <path>" logs the audio and the parameter changes of every frame, "--replay <path>" plays a log back frame by frame,
+    // at the captured pace or as fast as possible with "--replay-fast". The session seeds Rand, it's created before anything random
+    mSession        = SessionLog::create( SessionLog::Format().args( getArgs() ) );
+    
+    if ( mBenchmark->isEnabled() || ( mSession->isReplaying() && !mSession->isRealtime() ) )
+    {
+        disableFrameRate();
+        gl::disableVerticalSync();
+    }
+    
+    mBenchmark->param( "Wireframe",         &mRenderWireframe );
+    mBenchmark->param( "LOD max error px",  &mLodMaxError );
+    mBenchmark->setItemName( "triangles" );
+    
+    // per-stage timings, "--profile-csv <path>" writes every frame, allocations in allocation free stages fail a benchmark
+    mProfiler           = FrameProfiler::create( mBenchmark->getProfilerFormat().args( getArgs() ) );
     
-    mParams = params::InterfaceGl::create( "params", Vec2i( 200, 250 ) );
+    mParams = params::InterfaceGl::create( "params", Vec2i( 240, 420 ) );
     mParams->addParam( "FPS",  &mFps );
     mParams->addSeparator();
     mParams->addParam( "Bark gain",     &mBarkGain,     "min=0.1 max=500.0 step=0.01" );
@@ -86,17 +136,80 @@ void SoundShaderObjectApp::setup()
     mParams->addSeparator();
     mParams->addParam( "Obj color",     &mObjColor );
     mParams->addParam( "Wireframe",     &mRenderWireframe );
+    mParams->addParam( "History delay", &mHistoryDelay,  "min=0.0 max=63.0 step=1.0" );
+    mParams->addSeparator();
+    mParams->addParam( "Mesh load ms",   &mMeshLoadTime,     "", true );
+    mParams->addParam( "Mesh upload ms", &mMeshUploadTime,   "", true );
+    mParams->addParam( "LOD max error px", &mLodMaxError,    "min=0.1 max=20.0 step=0.1" );
+    mParams->addParam( "LOD level",      &mLodLevel,         "", true );
+    mParams->addParam( "LOD triangles",  &mLodTriangles,     "", true );
     
-    // initialise Xtract
-    mXtract = ciXtract::create();
-    
-    // enable features
-    mXtract->enableFeature( XTRACT_BARK_COEFFICIENTS );
+    // initialise audio and Xtract
+    AudioAnalyzer::Format audioFormat = AudioAnalyzer::Format().threaded().hopSize( CIXTRACT_PCM_SIZE / 4 ).session( mSession ).args( getArgs() );
+    if ( mBenchmark->isEnabled() )
+        audioFormat.offline();
     
-    // get feature references
-    mBark               = mXtract->getFeature( XTRACT_BARK_COEFFICIENTS );
+    mAudio = AudioAnalyzer::create( audioFormat );
     
-    loadObject( getAssetPath( "cube.obj" ) );
+    // enable features
+    mAudio->enableFeature( XTRACT_BARK_COEFFICIENTS );
+    
+    mAudio->setProfiler( mProfiler );
+    mMeshStage      = mProfiler->addStage( "Mesh upload" );
+    mTextureStage   = mProfiler->addStage( "Texture upload", true );
+    mDraw3dStage    = mProfiler->addStage( "3D draw" );
+    mDraw2dStage    = mProfiler->addStage( "PCM and data draw" );
+    mParamsStage    = mProfiler->addStage( "Params draw" );
+    mProfiler->addParams( mParams );
+    
+    // a Chrome trace of the main, audio and analysis threads is written when "Record trace" is unticked, "--trace <path>" records from the start
+    mTracer     = Tracer::create( Tracer::Format().path( getDocumentsDirectory() / "SoundShaderObject-trace.json" ).args( getArgs() ) );
+    mTracing    = mTracer->isRecording();
+    mAudio->setTracer( mTracer );
+    mParams->addParam( "Record trace", &mTracing, "group='Profiler'" );
+    
+    // "--latency <impulses>" injects impulses into the analysed input, reports how long they take to reach the screen and quits.
+    // "Latency probe" measures them while the app runs
+    mLatency        = LatencyProbe::create( LatencyProbe::Format().report( getDocumentsDirectory() / "SoundShaderObject-latency.txt" ).args( getArgs() ) );
+    mLatencyEnabled = mLatency->isEnabled();
+    mAudio->setLatencyProbe( mLatency );
+    mParams->addParam( "Latency probe", &mLatencyEnabled, "group='Latency'" );
+    mLatency->addParams( mParams );
+    
+    // the values changed by hand during a show
+    mSession->watch( "Bark gain",         &mBarkGain );
+    mSession->watch( "Bark offset",       &mBarkOffset );
+    mSession->watch( "Bark damping",      &mBarkDamping );
+    mSession->watch( "Obj color",         &mObjColor );
+    mSession->watch( "Wireframe",         &mRenderWireframe );
+    mSession->watch( "History delay",     &mHistoryDelay );
+    mSession->watch( "LOD max error px",  &mLodMaxError );
+    
+    // OBJ files are parsed on all cores and cached in binary next to the source, later loads only map the cache.
+    // The worker then simplifies them to 50, 25 and 10% of the triangles. "--optimize-mesh" also welds them and reorders
+    // them for the vertex cache, which changes which Bark band each vertex follows, so it's off by default
+    vector<float> lodRatios;
+    lodRatios.push_back( 0.5f );
+    lodRatios.push_back( 0.25f );
+    lodRatios.push_back( 0.1f );
+    
+    mOptimizeMesh = find( getArgs().begin(), getArgs().end(), "--optimize-mesh" ) != getArgs().end();
+    mBenchmark->param( "Optimise mesh", &mOptimizeMesh );
+    
+    mJobs           = JobSystem::create();
+    JobSystem *jobs = mJobs.get();
+    bool optimize   = mOptimizeMesh;
+    mMeshLoader     = AsyncMeshLoader::create( AsyncMeshLoader::Format().lodRatios( lodRatios ).loadFn( [jobs, optimize]( const fs::path &path ) {
+        MeshOptimizer::Stats    stats;
+        MeshDataRef             data = MeshCache::loadObj( path, true, jobs, optimize, &stats );
+        if ( optimize )
+            console() << path.filename().string() << ": " << stats.mVerticesBefore << " -> " << stats.mVerticesAfter << " vertices, ACMR "
+                      << stats.mAcmrBefore << " -> " << stats.mAcmrAfter << endl;
+        return data;
+    } ) );
+    string mesh = "cube.obj";
+    mBenchmark->param( "Mesh", &mesh );
+    loadObject( getAssetPath( mesh ) );
     
     loadShader();
     
@@ -104,37 +217,56 @@ void SoundShaderObjectApp::setup()
 	initialCam.setPerspective( 45.0f, getWindowAspectRatio(), 0.1, 1000 );
 	mMayaCam.setCurrentCam( initialCam );
     
-	mFeatureSurf    = Surface32f( 32, 32, false );	// we can store up to 1024 values(32x32)
-	mFeatureTex     = gl::Texture( 32, 32 );
-    
-    initAudio();
+    mFeatureTex     = FeatureTexture::create( FeatureTexture::Format().size( 32, 32 ).pbos( 2 ) );     // we can store up to 1024 values(32x32)
+    mFeatureHistory = FeatureHistory::create( FeatureHistory::Format().values( 32 ).frames( 64 ).pbos( 2 ) );
 }
 
 
 void SoundShaderObjectApp::update()
 {
-    // update params
-    mBark->setGain( mBarkGain );
-    mBark->setOffset( mBarkOffset );
-    mBark->setDamping( mBarkDamping );
+    // the previous frame has been swapped by now
+    mLatency->mark( LatencyProbe::SWAP );
     
-    if ( !mMonitorNode )
+    // a replayed frame sets the parameters it was captured with, before anything reads them
+    if ( !mSession->beginFrame() )
+    {
+        quit();
         return;
+    }
     
-    mPcmBuffer = mMonitorNode->getBuffer();                     // get PCM buffer
+    mProfiler->beginFrame();
+    mTracer->setRecording( mTracing );
+    mLatency->setEnabled( mLatencyEnabled );
     
-    if ( !mPcmBuffer.isEmpty() )
-        mXtract->update( mPcmBuffer.getData() );                // update Xtract
+    Tracer::Scope trace( mTracer->getMainBuffer(), "update" );
     
-    // update Surface
-    int x, y;
-    for( int k=0; k < mBark->getResultsN(); k++ )
+    // upload the next chunk of a mesh being loaded
+    mProfiler->begin( mMeshStage );
+    if ( mMeshLoader->update() )
     {
-        x = k % mFeatureSurf.getWidth();
-        y = k / mFeatureSurf.getWidth();
-        mFeatureSurf.setPixel( Vec2i(x, y), Color::gray( mBark->getDataValue(k) ) );
+        mMeshLoadTime   = mMeshLoader->getTimings().mLoad * 1000.0;
+        mMeshUploadTime = mMeshLoader->getTimings().mUpload * 1000.0;
     }
-    mFeatureTex = gl::Texture( mFeatureSurf );
+    mProfiler->end( mMeshStage );
+    
+    // update params
+    mAudio->setFeatureParams( XTRACT_BARK_COEFFICIENTS, mBarkGain, mBarkOffset, mBarkDamping );
+    
+    if ( !mAudio->isRunning() )
+        return;
+    
+    mAudio->update();                                           // swap in the Xtract results of the hops since the last frame
+    
+    // update texture, only the texels in use are uploaded
+    FrameProfiler::Scope    scope( mProfiler.get(), mTextureStage );
+    FeatureView             data = mAudio->getResults( XTRACT_BARK_COEFFICIENTS, AudioAnalyzer::MAX );
+    mFeatureTex->update( data.data(), data.size() );
+    
+    // one row per frame, the shaders can look back up to 64 frames
+    if ( !data.empty() )
+        mFeatureHistory->push( data.data(), data.size() );
+    
+    mLatency->mark( LatencyProbe::UPLOAD );                     // the textures hold the results
 
     mFps = getAverageFps();
 }
@@ -142,27 +274,41 @@ void SoundShaderObjectApp::update()
 
 void SoundShaderObjectApp::draw()
 {
+    Tracer::Scope trace( mTracer->getMainBuffer(), "draw" );
+    
+    // only the CPU side of the frame is measured
+    if ( mBenchmark->isNullRenderer() )
+    {
+        endFrame();
+        return;
+    }
+    
 	gl::clear( Color( 0, 0, 0 ) );
     gl::enableAlphaBlending();
     gl::enableDepthRead();
     gl::enableDepthWrite();
     
+    mProfiler->begin( mDraw3dStage );
     gl::pushMatrices();
     
 	gl::setMatrices( mMayaCam.getCamera() );
 	
-	if ( mBark && mFeatureTex )
+	if ( mFeatureTex )
 	{
 		mShader->bind();
-		mFeatureTex.enableAndBind();
+		mFeatureTex->bind();
 		mShader->uniform( "dataTex",		0 );
-		mShader->uniform( "texWidth",		(float)mFeatureTex.getWidth() );
-		mShader->uniform( "texHeight",		(float)mFeatureTex.getHeight() );
-		mShader->uniform( "soundDataSize",  (float)mBark->getResultsN() );
+		mShader->uniform( "texWidth",		(float)mFeatureTex->getWidth() );
+		mShader->uniform( "texHeight",		(float)mFeatureTex->getHeight() );
+		mShader->uniform( "soundDataSize",  (float)mAudio->getResults( XTRACT_BARK_COEFFICIENTS, AudioAnalyzer::MAX ).size() );
 		mShader->uniform( "spread",         1.0f );
 		mShader->uniform( "spreadOffset",   0.0f );
-        mShader->uniform( "time",           (float)getElapsedSeconds() );
+        mShader->uniform( "time",           (float)mSession->getTime() );
 		mShader->uniform( "tintColor",      mObjColor );
+        
+        mFeatureHistory->bind( 1 );
+        mFeatureHistory->setUniforms( mShader, 1 );
+        mShader->uniform( "historyDelay",   mHistoryDelay );
 	}
     
     if ( mRenderWireframe )
@@ -170,14 +316,25 @@ void SoundShaderObjectApp::draw()
     
 	gl::color( Color(1.0f, 0.0f, 0.0f ) );
     
-	if ( mVbo )
-	    gl::draw( mVbo );
+    // the shader displaces the vertices, only the level drawn pays for it
+	if ( mMeshLoader->getMesh() )
+    {
+        const MeshLodRef &lod = mMeshLoader->getMesh();
+        mLodLevel       = (int)lod->selectLevel( mMayaCam.getCamera(), (float)getWindowHeight(), mLodMaxError );
+        mLodTriangles   = (int)lod->getMesh( mLodLevel )->getNumIndices() / 3;
+	    lod->getMesh( mLodLevel )->draw();
+        
+        // like the frames, the work isn't measured while a mesh is loading
+        if ( !mMeshLoader->isLoading() )
+            mBenchmark->addItems( mLodTriangles );
+    }
     
     if ( mRenderWireframe )
         gl::disableWireframe();
     
 	mShader->unbind();
-	mFeatureTex.unbind();
+	mFeatureTex->unbind();
+    mFeatureHistory->unbind( 1 );
     
 	gl::color( Color::white() );
     //	gl::drawCoordinateFrame();
@@ -186,45 +343,34 @@ void SoundShaderObjectApp::draw()
     
     gl::disableDepthRead();
     gl::disableDepthWrite();
+    mProfiler->end( mDraw3dStage );
     
+    mProfiler->begin( mDraw2dStage );
 	gl::setMatricesWindow( getWindowSize() );
 	
-	gl::draw( mFeatureSurf );
+	gl::draw( mFeatureTex->getTexture() );
     
-    ciXtract::drawPcm( Rectf( 0, 0, getWindowWidth(), 60 ), mPcmBuffer.getData(), mPcmBuffer.getSize() / mPcmBuffer.getNumChannels() );
+    mAudio->drawPcm( Rectf( 0, 0, getWindowWidth(), 60 ) );
     
-    ciXtract::drawData( mBark, Rectf( 15, 60, 140, 100 ) );
+    mAudio->drawData( XTRACT_BARK_COEFFICIENTS, Rectf( 15, 60, 140, 100 ), AudioAnalyzer::MAX );
+    mProfiler->end( mDraw2dStage );
     
+    mProfiler->begin( mParamsStage );
     mParams->draw();
+    mProfiler->end( mParamsStage );
+    
+    endFrame();
 }
 
 
-void SoundShaderObjectApp::initAudio()
+void SoundShaderObjectApp::endFrame()
 {
-    auto ctx = audio::Context::master();
-    
-    vector<audio::DeviceRef> devices = audio::Device::getInputDevices();
-    console() << "List audio devices:" << endl;
-    for( auto k=0; k < devices.size(); k++ )
-        console() << devices[k]->getName() << endl;
-    
-    // find and initialise a device by name
-    audio::DeviceRef dev    = audio::Device::findDeviceByName( "Soundflower (2ch)" );
-    mInputDeviceNode        = ctx->createInputDeviceNode( dev );
-    
-    // initialise default input device
-    //    mInputDeviceNode = ctx->createInputDeviceNode();
-    
-    // initialise MonitorNode to get the PCM data
-	auto monitorFormat = audio::MonitorNode::Format().windowSize( CIXTRACT_PCM_SIZE );
-	mMonitorNode = ctx->makeNode( new audio::MonitorNode( monitorFormat ) );
+    mLatency->mark( LatencyProbe::DRAW );
+    mProfiler->endFrame();
     
-    // pipe the input device into the MonitorNode
-	mInputDeviceNode >> mMonitorNode;
-    
-	// InputDeviceNode (and all InputNode subclasses) need to be enabled()'s to process audio. So does the Context:
-	mInputDeviceNode->enable();
-	ctx->enable();
+    // frames aren't measured while a mesh is loading
+    if ( ( !mMeshLoader->isLoading() && mBenchmark->addFrame( *mProfiler ) ) || mLatency->isFinished() )
+        quit();
 }
 
 
@@ -294,16 +440,8 @@ void SoundShaderObjectApp::loadShader()
 
 void SoundShaderObjectApp::loadObject( fs::path filepath )
 {
-    try {
-		ObjLoader loader( DataSourcePath::create( filepath.string() ) );
-		TriMesh mesh;
-		loader.load( &mesh );
-		mVbo = gl::VboMesh( mesh );
-	}
-	catch( ... ) {
-		console() << "cannot load file: " << filepath.generic_string() << endl;
-		return;
-	}
+    // returns straight away, errors are logged by the loader
+    mMeshLoader->load( filepath );
 }
 
 
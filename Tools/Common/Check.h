@@ -0,0 +1,39 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <cstddef>
+#include <cstdlib>
+
+
+//! Counters of the check programs under Tools, each is a single translation unit that includes this once.
+//! check() records a result and prints the failures, checkSummary() prints the totals and returns the exit code of main().
+struct CheckCounts {
+    size_t  mChecks;
+    size_t  mFailures;
+};
+
+inline CheckCounts& checkCounts()
+{
+    static CheckCounts counts = { 0, 0 };
+    return counts;
+}
+
+//! \a fixture names the input, \a what the property that should hold.
+inline void check( bool ok, const std::string &fixture, const std::string &what )
+{
+    checkCounts().mChecks++;
+
+    if ( ok )
+        return;
+
+    checkCounts().mFailures++;
+    std::cout << "FAIL " << fixture << ": " << what << std::endl;
+}
+
+inline int checkSummary( const std::string &program )
+{
+    std::cout << program << ": " << checkCounts().mChecks << " checks, " << checkCounts().mFailures << " failed" << std::endl;
+
+    return checkCounts().mFailures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,520 @@
+// Microbenchmarks of the per-frame kernels of the sound apps, each over a range of problem sizes to show how it scales.
+// Every kernel is timed next to the code it replaced or a plain reference, in ns per call and per item.
+//
+//  KernelBench [--kernel <name>]... [--sizes <n,n,...>] [--min-time <ms>] [--csv <path>]
+//
+// Kernels: neighbours, polar, displacement, feature-packing, pcm-decimation, spectrum. All of them by default.
+// --sizes replaces the default sizes of every kernel run, --min-time is the time each measure runs for (20 ms).
+// The spectrum kernel skips the sizes that aren't a power of two of at least 8.
+// Builds like ObjParserBench, from the repository root on OS X, with the sources of the ciXtract block (XTRACT_PATH below):
+//
+//  XTRACT_PATH=$CINDER_PATH/blocks/ciXtract/src
+//  clang++ -std=c++11 -stdlib=libc++ -O2 -I$CINDER_PATH/include -I$CINDER_PATH/boost -I$XTRACT_PATH -I$XTRACT_PATH/LibXtract
+//      -I$XTRACT_PATH/LibXtract/xtract -ICommon/src -x c++ Tools/KernelBench/src/KernelBench.cpp Common/src/SpatialGrid.cpp
+//      Common/src/ParticleKernels.cpp Common/src/DisplacementKernel.cpp Common/src/JobSystem.cpp Common/src/SpectrumKernel.cpp
+//      $XTRACT_PATH/ciXtract.cpp
+//      -x c $XTRACT_PATH/LibXtract/src/*.c $XTRACT_PATH/LibXtract/src/dywapitchtrack/*.c -x none
+//      $CINDER_PATH/lib/libcinder.a -framework Cocoa -framework OpenGL -framework QuickTime -framework CoreVideo
+//      -framework AppKit -framework Accelerate -framework AudioToolbox -framework AudioUnit -framework CoreAudio
+//      -o KernelBench
+
+#include "cinder/Timer.h"
+#include "cinder/Surface.h"
+#include "cinder/Vector.h"
+#include "cinder/CinderMath.h"
+
+#include "ciXtract.h"
+#include "xtract/libxtract.h"
+
+#include "SpatialGrid.h"
+#include "ParticleKernels.h"
+#include "DisplacementKernel.h"
+#include "SpectrumKernel.h"
+#include "JobSystem.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+using namespace ci;
+using namespace std;
+
+
+struct Result {
+    string  mKernel;
+    string  mVariant;
+    size_t  mSize;
+    double  mNsPerCall;     // median of the runs
+    double  mNsPerItem;
+};
+
+
+struct Bench {
+    Bench() : mMinSeconds( 0.02 ), mJobs( JobSystem::create() ) {}
+
+    double              mMinSeconds;
+    vector<size_t>      mSizes;         // replaces the default sizes when set
+    JobSystemRef        mJobs;
+    vector<Result>      mResults;
+    volatile float      mSink;          // keeps the results alive
+
+    const vector<size_t>& sizes( const vector<size_t> &defaults ) const     { return mSizes.empty() ? defaults : mSizes; }
+
+    // calls fn until the batch takes a few ms, then times 7 batches and keeps the median
+    template<typename Fn>
+    void run( const string &kernel, const string &variant, size_t size, Fn fn )
+    {
+        size_t calls = 1;
+        for(;;)
+        {
+            Timer timer( true );
+            for( size_t k=0; k < calls; k++ )
+                fn();
+            if ( timer.getSeconds() >= mMinSeconds / 7.0 || calls >= ( 1 << 24 ) )
+                break;
+            calls *= 2;
+        }
+
+        vector<double> runs;
+        for( int r=0; r < 7; r++ )
+        {
+            Timer timer( true );
+            for( size_t k=0; k < calls; k++ )
+                fn();
+            runs.push_back( timer.getSeconds() * 1e9 / calls );
+        }
+
+        nth_element( runs.begin(), runs.begin() + 3, runs.end() );
+
+        Result result;
+        result.mKernel      = kernel;
+        result.mVariant     = variant;
+        result.mSize        = size;
+        result.mNsPerCall   = runs[3];
+        result.mNsPerItem   = runs[3] / max<size_t>( size, 1 );
+        mResults.push_back( result );
+
+        printf( "  %-16s %9zu  %14.0f ns  %10.3f ns / item\n", variant.c_str(), size, result.mNsPerCall, result.mNsPerItem );
+    }
+};
+
+
+// deterministic random numbers, the inputs are the same on every run
+struct Lcg {
+    Lcg( uint32_t seed = 1 ) : mState( seed ) {}
+
+    float next()    { mState = mState * 1664525u + 1013904223u; return ( mState >> 8 ) / 16777216.0f; }
+
+    uint32_t mState;
+};
+
+
+// particle pairs closer than a distance: the grid and the sweep used by the apps, and the all-pairs loop they replaced.
+// The points keep the same density at every size, about 8 neighbours each
+void benchNeighbours( Bench &bench )
+{
+    const float maxDist = 20.0f;
+
+    size_t defaults[] = { 1000, 4000, 16000, 64000, 256000 };
+    vector<size_t> sizes = bench.sizes( vector<size_t>( defaults, defaults + 5 ) );
+
+    cout << "neighbours" << endl;
+
+    for( size_t s=0; s < sizes.size(); s++ )
+    {
+        size_t  n       = sizes[s];
+        float   side    = sqrt( n * (float)M_PI * maxDist * maxDist / 8.0f );
+        Lcg     rnd;
+
+        vector<float> xy( n * 2 ), x( n ), y( n );
+        for( size_t k=0; k < n; k++ )
+        {
+            x[k] = xy[k * 2]        = rnd.next() * side;
+            y[k] = xy[k * 2 + 1]    = rnd.next() * side;
+        }
+
+        SpatialGrid                 grid;
+        vector<SpatialGrid::Pair>   pairs;
+        PairSweep                   sweep;
+
+        bench.run( "neighbours", "grid", n, [&]() {
+            pairs.clear();
+            grid.build( xy.data(), sizeof(float) * 2, n, maxDist );
+            grid.findPairs( maxDist, &pairs );
+        } );
+
+        bench.run( "neighbours", "grid-jobs", n, [&]() {
+            pairs.clear();
+            grid.build( xy.data(), sizeof(float) * 2, n, maxDist );
+            grid.findPairs( maxDist, &pairs, bench.mJobs.get() );
+        } );
+
+        bench.run( "neighbours", "sweep", n, [&]() {
+            sweep.sweep( x.data(), y.data(), n, maxDist );
+        } );
+
+        bench.run( "neighbours", "sweep-jobs", n, [&]() {
+            sweep.sweep( x.data(), y.data(), n, maxDist, bench.mJobs.get() );
+        } );
+
+        // every particle against every other one, as drawParticles() first did, only for the small sizes
+        if ( n <= 16000 )
+        {
+            bench.run( "neighbours", "all-pairs", n, [&]() {
+                size_t found = 0;
+                for( size_t a=0; a < n; a++ )
+                    for( size_t b=0; b < n; b++ )
+                        if ( a != b && Vec2f( x[a], y[a] ).distance( Vec2f( x[b], y[b] ) ) < maxDist )
+                            found++;
+                bench.mSink = (float)found;
+            } );
+        }
+    }
+}
+
+
+// polar to cartesian positions of the circles: the array kernel and the per-particle struct it replaced
+void benchPolar( Bench &bench )
+{
+    struct Particle {
+        float   angle;
+        float   radius;
+        Vec2f   pos;
+        ColorA  col;
+    };
+
+    size_t defaults[] = { 1000, 10000, 100000, 1000000 };
+    vector<size_t> sizes = bench.sizes( vector<size_t>( defaults, defaults + 4 ) );
+
+    cout << "polar" << endl;
+
+    for( size_t s=0; s < sizes.size(); s++ )
+    {
+        size_t  n = sizes[s];
+        Lcg     rnd;
+
+        vector<float>       angle( n ), radius( n ), x( n ), y( n );
+        vector<Particle>    particles( n );
+
+        for( size_t k=0; k < n; k++ )
+        {
+            angle[k]    = particles[k].angle    = rnd.next() * 2.0f * (float)M_PI;
+            radius[k]   = particles[k].radius   = rnd.next() * 500.0f;
+        }
+
+        bench.run( "polar", "arrays", n, [&]() {
+            polarToCartesian( angle.data(), radius.data(), x.data(), y.data(), n );
+            bench.mSink = x[n / 2];
+        } );
+
+        bench.run( "polar", "structs", n, [&]() {
+            for( size_t k=0; k < n; k++ )
+                particles[k].pos = Vec2f( cos( particles[k].angle ), sin( particles[k].angle ) ) * particles[k].radius;
+            bench.mSink = particles[n / 2].pos.x;
+        } );
+    }
+}
+
+
+// displacement of the mesh by the Bark bands, into an interleaved buffer as mapped from a Vbo, or offsets only
+void benchDisplacement( Bench &bench )
+{
+    const size_t    numBands    = XTRACT_BARK_BANDS;
+    const size_t    stride      = 32;       // position, normal and texcoord
+
+    size_t defaults[] = { 1000, 10000, 100000, 1000000 };
+    vector<size_t> sizes = bench.sizes( vector<size_t>( defaults, defaults + 4 ) );
+
+    cout << "displacement" << endl;
+
+    vector<float> bands( numBands );
+    Lcg rnd;
+    for( size_t k=0; k < numBands; k++ )
+        bands[k] = rnd.next();
+
+    for( size_t s=0; s < sizes.size(); s++ )
+    {
+        size_t n = sizes[s];
+
+        vector<float> positions( n * 3 );
+        for( size_t k=0; k < positions.size(); k++ )
+            positions[k] = rnd.next() * 2.0f - 1.0f;
+
+        DisplacementKernel  kernel, offsets;
+        vector<uint8_t>     buffer( n * stride );
+        vector<float>       dest( n );
+
+        kernel.init( positions.data(), n, numBands );
+        offsets.init( n, numBands );
+
+        bench.run( "displacement", "positions", n, [&]() {
+            kernel.displace( bands.data(), 3.0f, buffer.data(), stride );
+        } );
+
+        bench.run( "displacement", "positions-jobs", n, [&]() {
+            kernel.displace( bands.data(), 3.0f, buffer.data(), stride, bench.mJobs.get() );
+        } );
+
+        bench.run( "displacement", "offsets", n, [&]() {
+            offsets.calcOffsets( bands.data(), 3.0f, dest.data() );
+        } );
+
+        bench.run( "displacement", "offsets-jobs", n, [&]() {
+            offsets.calcOffsets( bands.data(), 3.0f, dest.data(), bench.mJobs.get() );
+        } );
+    }
+}
+
+
+// feature values laid out for the shaders: one texel per value row by row, padded, as FeatureHistory::push() does,
+// and the Surface32f filled pixel by pixel it replaced
+void benchFeaturePacking( Bench &bench )
+{
+    size_t defaults[] = { 26, 256, 1024, 4096, 16384 };
+    vector<size_t> sizes = bench.sizes( vector<size_t>( defaults, defaults + 5 ) );
+
+    cout << "feature-packing" << endl;
+
+    for( size_t s=0; s < sizes.size(); s++ )
+    {
+        size_t  n       = sizes[s];
+        int32_t width   = 1;
+        while( (size_t)width * width < n )
+            width *= 2;
+
+        Lcg             rnd;
+        vector<float>   values( n );
+        vector<float>   texels( width * width );
+        Surface32f      surface( width, width, false );
+
+        for( size_t k=0; k < n; k++ )
+            values[k] = rnd.next();
+
+        bench.run( "feature-packing", "rows", n, [&]() {
+            copy( values.begin(), values.end(), texels.begin() );
+            fill( texels.begin() + n, texels.end(), 0.0f );
+            bench.mSink = texels[n / 2];
+        } );
+
+        bench.run( "feature-packing", "surface", n, [&]() {
+            for( size_t k=0; k < n; k++ )
+                surface.setPixel( Vec2i( (int)( k % width ), (int)( k / width ) ), Color::gray( values[k] ) );
+        } );
+    }
+}
+
+
+// the PCM window reduced to what a waveform of 1200 pixels can show: min and max per column,
+// next to one vertex per sample as a line strip through every sample needs
+void benchPcmDecimation( Bench &bench )
+{
+    const size_t columns = 1200;
+
+    size_t defaults[] = { 512, 1024, 4096, 16384, 65536 };
+    vector<size_t> sizes = bench.sizes( vector<size_t>( defaults, defaults + 5 ) );
+
+    cout << "pcm-decimation" << endl;
+
+    for( size_t s=0; s < sizes.size(); s++ )
+    {
+        size_t  n = sizes[s];
+        Lcg     rnd;
+
+        vector<float> pcm( n ), minMax( columns * 2 );
+        vector<Vec2f> strip( n );
+
+        for( size_t k=0; k < n; k++ )
+            pcm[k] = rnd.next() * 2.0f - 1.0f;
+
+        bench.run( "pcm-decimation", "min-max", n, [&]() {
+            for( size_t c=0; c < columns; c++ )
+            {
+                size_t begin    = c * n / columns;
+                size_t end      = max( begin + 1, ( c + 1 ) * n / columns );
+                float  lo       = pcm[begin];
+                float  hi       = pcm[begin];
+
+                for( size_t k = begin + 1; k < end && k < n; k++ )
+                {
+                    lo = min( lo, pcm[k] );
+                    hi = max( hi, pcm[k] );
+                }
+
+                minMax[c * 2]       = lo;
+                minMax[c * 2 + 1]   = hi;
+            }
+            bench.mSink = minMax[columns];
+        } );
+
+        bench.run( "pcm-decimation", "line-strip", n, [&]() {
+            float step = (float)columns / n;
+            for( size_t k=0; k < n; k++ )
+                strip[k] = Vec2f( k * step, 30.0f + pcm[k] * 30.0f );
+            bench.mSink = strip[n / 2].y;
+        } );
+    }
+}
+
+
+// LibXtract at several window sizes: window, magnitude spectrum and Bark bands, next to the same in float by the SpectrumKernel
+// the apps use, then ciXtract::update() as the apps called it
+void benchSpectrum( Bench &bench )
+{
+    const double sampleRate = 44100.0;
+
+    size_t defaults[] = { 512, 1024, 2048, 4096, 8192 };
+    vector<size_t> sizes = bench.sizes( vector<size_t>( defaults, defaults + 5 ) );
+
+    cout << "spectrum" << endl;
+
+    for( size_t s=0; s < sizes.size(); s++ )
+    {
+        // both FFTs only take powers of two, SpectrumKernel from 8 up
+        if ( sizes[s] < 8 || ( sizes[s] & ( sizes[s] - 1 ) ) )
+        {
+            printf( "  skipped %zu, not a power of two of at least 8\n", sizes[s] );
+            continue;
+        }
+
+        int     n       = (int)sizes[s];
+        int     half    = n / 2;
+        Lcg     rnd;
+
+        vector<double> pcm( n ), windowed( n ), spectrum( n ), bark( XTRACT_BARK_BANDS );
+        vector<int>    bandLimits( XTRACT_BARK_BANDS );
+
+        for( int k=0; k < n; k++ )
+            pcm[k] = rnd.next() * 2.0 - 1.0;
+
+        double  *window         = xtract_init_window( n, XTRACT_HANN );
+        double  spectrumArgs[4] = { sampleRate / n, XTRACT_MAGNITUDE_SPECTRUM, 0.0, 0.0 };
+
+        xtract_init_fft( n, XTRACT_SPECTRUM );
+        xtract_init_bark( half, sampleRate / 2.0, bandLimits.data() );
+
+        bench.run( "spectrum", "window", n, [&]() {
+            xtract_windowed( pcm.data(), n, window, windowed.data() );
+        } );
+
+        bench.run( "spectrum", "spectrum", n, [&]() {
+            xtract_spectrum( windowed.data(), n, spectrumArgs, spectrum.data() );
+        } );
+
+        bench.run( "spectrum", "bark", n, [&]() {
+            xtract_bark_coefficients( spectrum.data(), half, bandLimits.data(), bark.data() );
+        } );
+
+        xtract_free_window( window );
+        xtract_free_fft();
+
+        SpectrumKernel  kernel;
+        vector<float>   pcmFloat( pcm.begin(), pcm.end() );
+
+        kernel.init( n, (float)sampleRate );
+
+        bench.run( "spectrum", "kernel-float", n, [&]() {
+            kernel.process( pcmFloat.data() );
+        } );
+    }
+
+    // ciXtract analyses a fixed window, the size doesn't follow --sizes
+    ciXtractRef     xtract = ciXtract::create();
+    vector<float>   pcm( CIXTRACT_PCM_SIZE );
+    Lcg             rnd;
+
+    for( size_t k=0; k < pcm.size(); k++ )
+        pcm[k] = rnd.next() * 2.0f - 1.0f;
+
+    xtract->enableFeature( XTRACT_BARK_COEFFICIENTS );
+
+    bench.run( "spectrum", "ciXtract-bark", CIXTRACT_PCM_SIZE, [&]() {
+        xtract->update( pcm.data() );
+    } );
+}
+
+
+void writeCsv( const Bench &bench, const string &path )
+{
+    ofstream out( path.c_str() );
+
+    out << "kernel,variant,size,ns_per_call,ns_per_item\n";
+
+    for( size_t k=0; k < bench.mResults.size(); k++ )
+    {
+        const Result &r = bench.mResults[k];
+        out << r.mKernel << ',' << r.mVariant << ',' << r.mSize << ',' << r.mNsPerCall << ',' << r.mNsPerItem << '\n';
+    }
+}
+
+
+int main( int argc, char *argv[] )
+{
+    Bench           bench;
+    vector<string>  kernels;
+    string          csv;
+
+    for( int k=1; k < argc; k++ )
+    {
+        string arg = argv[k];
+
+        if ( arg == "--kernel" && k + 1 < argc )
+            kernels.push_back( argv[++k] );
+        else if ( arg == "--min-time" && k + 1 < argc )
+            bench.mMinSeconds = max( 1, atoi( argv[++k] ) ) / 1000.0;
+        else if ( arg == "--csv" && k + 1 < argc )
+            csv = argv[++k];
+        else if ( arg == "--sizes" && k + 1 < argc )
+        {
+            stringstream    list( argv[++k] );
+            string          size;
+            while( getline( list, size, ',' ) )
+                if ( atol( size.c_str() ) > 0 )
+                    bench.mSizes.push_back( (size_t)atol( size.c_str() ) );
+        }
+        else
+        {
+            cerr << "unknown argument " << arg << endl;
+            return 1;
+        }
+    }
+
+    struct Kernel {
+        const char  *mName;
+        void        (*mFn)( Bench& );
+    };
+
+    Kernel all[] = {
+        { "neighbours",         benchNeighbours },
+        { "polar",              benchPolar },
+        { "displacement",       benchDisplacement },
+        { "feature-packing",    benchFeaturePacking },
+        { "pcm-decimation",     benchPcmDecimation },
+        { "spectrum",           benchSpectrum }
+    };
+
+    bool found = kernels.empty();
+
+    for( size_t k=0; k < sizeof(all) / sizeof(all[0]); k++ )
+    {
+        if ( !kernels.empty() && find( kernels.begin(), kernels.end(), all[k].mName ) == kernels.end() )
+            continue;
+
+        all[k].mFn( bench );
+        found = true;
+    }
+
+    if ( !found )
+    {
+        cerr << "no such kernel" << endl;
+        return 1;
+    }
+
+    if ( !csv.empty() )
+        writeCsv( bench, csv );
+
+    return 0;
+}
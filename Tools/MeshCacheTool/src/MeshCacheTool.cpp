@@ -0,0 +1,104 @@
+// Command line converter, writes the binary cache next to each OBJ: "head-low.obj" -> "head-low.obj.mesh".
+//
+//  MeshCacheTool [--force] [--optimize] <file.obj | directory>...
+//
+// Directories are scanned for .obj files, caches that are still valid are skipped unless --force is given.
+// --optimize runs MeshOptimizer before writing, and prints the vertex cache miss ratio before and after. It's off by default
+// like in the apps, a cache must be built the same way as the app that loads it, with --optimize for "--optimize-mesh".
+// Builds against Cinder without an app, e.g. from the repository root on OS X (a single command):
+//
+//  clang++ -std=c++11 -stdlib=libc++ -I$CINDER_PATH/include -I$CINDER_PATH/boost -ICommon/src
+//      Tools/MeshCacheTool/src/MeshCacheTool.cpp Common/src/MeshCache.cpp Common/src/MeshData.cpp Common/src/ObjParser.cpp
+//      Common/src/JobSystem.cpp Common/src/MappedFile.cpp Common/src/MeshOptimizer.cpp
+//      $CINDER_PATH/lib/libcinder.a -framework Cocoa -framework OpenGL -framework QuickTime -framework CoreVideo
+//      -framework AppKit -framework Accelerate -framework AudioToolbox -framework AudioUnit -framework CoreAudio
+//      -o MeshCacheTool
+//
+//  MeshCacheTool SoundObject/assets SoundShaderObject/assets
+
+#include "cinder/Timer.h"
+
+#include "MeshCache.h"
+#include "JobSystem.h"
+
+#include <iostream>
+#include <vector>
+
+using namespace ci;
+using namespace std;
+
+
+bool convert( const fs::path &source, bool force, bool optimize, JobSystem *jobs )
+{
+    fs::path cache = MeshCache::getCachePath( source );
+
+    if ( !force && MeshCache::isValid( source, cache, optimize ) )
+    {
+        cout << source.string() << ": up to date" << endl;
+        return true;
+    }
+
+    try {
+        Timer                   timer( true );
+        MeshOptimizer::Stats    stats;
+        MeshDataRef             data = MeshCache::build( source, cache, jobs, optimize, &stats );
+
+        cout << source.string() << ": " << data->getNumVertices() << " vertices, " << data->getNumIndices() / 3 << " triangles, "
+             << fs::file_size( cache ) << " bytes, " << timer.getSeconds() * 1000.0 << " ms" << endl;
+
+        if ( optimize )
+            cout << "  " << stats.mVerticesBefore << " vertices before welding, ACMR " << stats.mAcmrBefore << " -> " << stats.mAcmrAfter << endl;
+    }
+    catch( const std::exception &exc ) {
+        cerr << source.string() << ": " << exc.what() << endl;
+        return false;
+    }
+
+    return true;
+}
+
+
+int main( int argc, char *argv[] )
+{
+    bool                force       = false;
+    bool                optimize    = false;
+    vector<fs::path>    sources;
+
+    for( int k=1; k < argc; k++ )
+    {
+        string arg = argv[k];
+
+        if ( arg == "--force" )
+        {
+            force = true;
+        }
+        else if ( arg == "--optimize" )
+        {
+            optimize = true;
+        }
+        else if ( fs::is_directory( arg ) )
+        {
+            for( fs::directory_iterator it( arg ), end; it != end; ++it )
+                if ( it->path().extension() == ".obj" )
+                    sources.push_back( it->path() );
+        }
+        else
+        {
+            sources.push_back( arg );
+        }
+    }
+
+    if ( sources.empty() )
+    {
+        cerr << "usage: MeshCacheTool [--force] [--optimize] <file.obj | directory>..." << endl;
+        return 1;
+    }
+
+    JobSystemRef    jobs    = JobSystem::create();
+    bool            ok      = true;
+
+    for( size_t k=0; k < sources.size(); k++ )
+        ok = convert( sources[k], force, optimize, jobs.get() ) && ok;
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,258 @@
+// Checks MeshOptimizer on small meshes with known results and on a shuffled unwelded grid: the weld remap, the fetch
+// remap, the ACMR, and that welding, reordering and optimize() keep the same set of triangles. Exits with a failure if any check fails.
+//
+//  MeshOptimizerCheck
+//
+// Builds like ObjParserBench, from the repository root on OS X (a single command):
+//
+//  clang++ -std=c++11 -stdlib=libc++ -O2 -I$CINDER_PATH/include -I$CINDER_PATH/boost -ICommon/src -ITools/Common
+//      Tools/MeshOptimizerCheck/src/MeshOptimizerCheck.cpp Common/src/MeshOptimizer.cpp Common/src/MeshData.cpp
+//      $CINDER_PATH/lib/libcinder.a -framework Cocoa -framework OpenGL -framework QuickTime -framework CoreVideo
+//      -framework AppKit -framework Accelerate -framework AudioToolbox -framework AudioUnit -framework CoreAudio
+//      -o MeshOptimizerCheck
+
+#include "Check.h"
+
+#include "MeshData.h"
+#include "MeshOptimizer.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+
+using namespace std;
+
+
+namespace {
+
+    typedef vector<float> Vertex;
+
+    struct Triangle {
+        Vertex  mCorners[3];
+
+        bool operator<( const Triangle &other ) const
+        {
+            return lexicographical_compare( mCorners, mCorners + 3, other.mCorners, other.mCorners + 3 );
+        }
+
+        bool operator==( const Triangle &other ) const
+        {
+            return equal( mCorners, mCorners + 3, other.mCorners );
+        }
+    };
+
+    // the triangles by the attributes of their corners, each rotated to start at its smallest corner so the winding is
+    // kept but not the first corner, then sorted. Two meshes with the same triangles give the same list
+    vector<Triangle> triangleSet( const float *vertices, size_t vertexSize, const uint32_t *indices, size_t numIndices )
+    {
+        vector<Triangle> triangles( numIndices / 3 );
+
+        for( size_t t=0; t < triangles.size(); t++ )
+        {
+            Vertex corners[3];
+            for( size_t c=0; c < 3; c++ )
+            {
+                const float *v = vertices + indices[t * 3 + c] * vertexSize;
+                corners[c].assign( v, v + vertexSize );
+            }
+
+            size_t first = min_element( corners, corners + 3 ) - corners;
+            for( size_t c=0; c < 3; c++ )
+                triangles[t].mCorners[c] = corners[( first + c ) % 3];
+        }
+
+        sort( triangles.begin(), triangles.end() );
+        return triangles;
+    }
+
+    vector<Triangle> triangleSet( const MeshData &data )
+    {
+        return triangleSet( data.getVertices(), data.getVertexSize(), data.getIndices(), data.getNumIndices() );
+    }
+
+    bool isPermutation( const vector<uint32_t> &remap, size_t count )
+    {
+        vector<uint32_t> sorted( remap );
+        sort( sorted.begin(), sorted.end() );
+
+        for( size_t k=0; k < sorted.size(); k++ )
+            if ( sorted[k] != k )
+                return false;
+
+        return sorted.size() == count;
+    }
+
+    // a grid of quads with positions, normals and texcoords, every triangle has its own vertices like an unwelded OBJ,
+    // and the triangles are shuffled with a fixed seed so the cache order is poor
+    MeshDataRef unweldedGrid( size_t size )
+    {
+        MeshDataRef data        = MeshData::create( MeshData::NORMAL | MeshData::TEXCOORD, size * size * 6, size * size * 6 );
+        float       *vertices   = data->getVertexStorage();
+        uint32_t    *indices    = data->getIndexStorage();
+        size_t      vertexSize  = data->getVertexSize();
+
+        vector<size_t> cells( size * size * 2 );
+        for( size_t k=0; k < cells.size(); k++ )
+            cells[k] = k;
+
+        uint32_t seed = 12345;
+        for( size_t k=cells.size() - 1; k > 0; k-- )
+        {
+            seed = seed * 1664525u + 1013904223u;
+            swap( cells[k], cells[ ( seed >> 8 ) % ( k + 1 ) ] );
+        }
+
+        const size_t corners[2][3][2] = { { { 0, 0 }, { 1, 0 }, { 1, 1 } }, { { 0, 0 }, { 1, 1 }, { 0, 1 } } };
+
+        for( size_t t=0; t < cells.size(); t++ )
+        {
+            size_t cell = cells[t] / 2;
+            size_t half = cells[t] % 2;
+
+            for( size_t c=0; c < 3; c++ )
+            {
+                size_t  x   = cell % size + corners[half][c][0];
+                size_t  y   = cell / size + corners[half][c][1];
+                float   *v  = vertices + ( t * 3 + c ) * vertexSize;
+
+                v[0] = x * 0.5f;    v[1] = y * 0.5f;    v[2] = ( ( x * 7 + y * 3 ) % 5 ) * 0.25f;
+                v[3] = 0.0f;        v[4] = 0.0f;        v[5] = 1.0f;
+                v[6] = (float)x / size;                 v[7] = (float)y / size;
+
+                indices[t * 3 + c] = (uint32_t)( t * 3 + c );
+            }
+        }
+
+        return data;
+    }
+
+}
+
+
+void checkWeld()
+{
+    // 2 floats per vertex, -0 and 0 differ in their bits and are not welded
+    const float vertices[] = { 0, 0,  1, 0,  0, 0,  1, 1,  1, 0,  -0.0f, 0,  1, 1 };
+
+    const uint32_t expected[] = { 0, 1, 0, 2, 1, 3, 2 };
+
+    vector<uint32_t>    remap( 7 );
+    size_t              numUnique = MeshOptimizer::weld( vertices, 7, 2, remap.data() );
+
+    check( numUnique == 4, "weld", "4 unique vertices" );
+    check( equal( remap.begin(), remap.end(), expected ), "weld", "first of a kind keeps its order" );
+
+    MeshDataRef grid = unweldedGrid( 8 );
+    remap.resize( grid->getNumVertices() );
+
+    check( MeshOptimizer::weld( grid->getVertices(), grid->getNumVertices(), grid->getVertexSize(), remap.data() ) == 9 * 9, "weld", "one vertex per grid point" );
+}
+
+
+void checkFetchRemap()
+{
+    const uint32_t indices[]    = { 3, 1, 4, 4, 1, 0 };
+    const uint32_t expected[]   = { 3, 1, 4, 0, 2, 5 };
+
+    vector<uint32_t> remap( 6 );
+    MeshOptimizer::calcFetchRemap( indices, 6, 6, remap.data() );
+
+    // 2 and 5 are not used and come after the used vertices, in their order
+    check( equal( remap.begin(), remap.end(), expected ), "fetch", "order of first use, unused vertices last" );
+    check( isPermutation( remap, 6 ), "fetch", "permutation" );
+}
+
+
+void checkAcmr()
+{
+    const uint32_t triangle[]   = { 0, 1, 2 };
+    const uint32_t strip[]      = { 0, 1, 2, 2, 1, 3, 2, 3, 4, 4, 3, 5 };
+
+    check( MeshOptimizer::calcAcmr( triangle, 3, 3 ) == 3.0f, "acmr", "3 for a single triangle" );
+    check( MeshOptimizer::calcAcmr( strip, 12, 6 ) == 1.5f, "acmr", "1.5 for a strip of 4" );
+    check( MeshOptimizer::calcAcmr( strip, 12, 6, 1 ) == 2.5f, "acmr", "2.5 for a strip of 4 with a cache of 1" );
+}
+
+
+void checkReorder()
+{
+    MeshDataRef grid        = unweldedGrid( 32 );
+    size_t      numVertices = grid->getNumVertices();
+    size_t      numIndices  = grid->getNumIndices();
+    size_t      vertexSize  = grid->getVertexSize();
+
+    vector<Triangle> before = triangleSet( *grid );
+
+    // weld and reorder by hand, on the original vertices through the weld remap
+    vector<uint32_t>    remap( numVertices );
+    size_t              numUnique = MeshOptimizer::weld( grid->getVertices(), numVertices, vertexSize, remap.data() );
+
+    vector<float> welded( numUnique * vertexSize );
+    for( size_t v=0; v < numVertices; v++ )
+        memcpy( &welded[ remap[v] * vertexSize ], grid->getVertices() + v * vertexSize, vertexSize * sizeof(float) );
+
+    vector<uint32_t> indices( numIndices );
+    for( size_t k=0; k < numIndices; k++ )
+        indices[k] = remap[ grid->getIndices()[k] ];
+
+    check( triangleSet( welded.data(), vertexSize, indices.data(), numIndices ) == before, "reorder", "same triangles after welding" );
+
+    float acmrWelded = MeshOptimizer::calcAcmr( indices.data(), numIndices, numUnique );
+    MeshOptimizer::reorderTriangles( indices.data(), numIndices, numUnique );
+
+    check( triangleSet( welded.data(), vertexSize, indices.data(), numIndices ) == before, "reorder", "same triangles after reordering" );
+    check( MeshOptimizer::calcAcmr( indices.data(), numIndices, numUnique ) < acmrWelded, "reorder", "lower ACMR" );
+
+    // the whole pipeline
+    MeshOptimizer::Stats    stats;
+    MeshDataRef             optimized = MeshOptimizer::optimize( *grid, &stats );
+
+    check( triangleSet( *optimized ) == before, "optimize", "same triangles" );
+    check( optimized->getNumVertices() == numUnique && optimized->getNumIndices() == numIndices, "optimize", "welded vertex count" );
+    check( stats.mVerticesBefore == numVertices && stats.mVerticesAfter == numUnique, "optimize", "stats vertex counts" );
+    check( stats.mAcmrAfter < stats.mAcmrBefore && stats.mAcmrAfter < 1.0f, "optimize", "ACMR under 1" );
+
+    // the vertices are in order of first use, so the fetch remap of the result is the identity
+    remap.resize( numUnique );
+    MeshOptimizer::calcFetchRemap( optimized->getIndices(), numIndices, numUnique, remap.data() );
+
+    bool identity = true;
+    for( size_t v=0; v < numUnique; v++ )
+        identity &= remap[v] == v;
+
+    check( identity, "optimize", "vertices in order of first use" );
+}
+
+
+void checkUnused()
+{
+    // a vertex that no triangle uses is kept, at the end
+    MeshDataRef data = MeshData::create( 0, 5, 3 );
+
+    const float     vertices[]  = { 9, 9, 9,  0, 0, 0,  1, 0, 0,  0, 1, 0,  1, 0, 0 };
+    const uint32_t  indices[]   = { 1, 2, 3 };
+
+    memcpy( data->getVertexStorage(), vertices, sizeof(vertices) );
+    memcpy( data->getIndexStorage(), indices, sizeof(indices) );
+
+    MeshDataRef optimized = MeshOptimizer::optimize( *data );
+
+    check( optimized->getNumVertices() == 4, "unused", "duplicate welded, unused vertex kept" );
+    check( triangleSet( *optimized ) == triangleSet( *data ), "unused", "same triangle" );
+    check( optimized->getNumVertices() == 4 && optimized->getVertices()[9] == 9.0f, "unused", "unused vertex last" );
+}
+
+
+int main()
+{
+    checkWeld();
+    checkFetchRemap();
+    checkAcmr();
+    checkReorder();
+    checkUnused();
+
+    return checkSummary( "MeshOptimizerCheck" );
+}
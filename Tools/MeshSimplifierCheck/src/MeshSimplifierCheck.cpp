@@ -0,0 +1,229 @@
+// Checks MeshSimplifier on grids with a border and a texcoord seam: the index count goes down, the border and seam
+// vertices are all kept, the outline and the area of a flat grid don't change, no triangle folds over, the vertices
+// are copies of their source vertices, and the result is deterministic. Exits with a failure if any check fails.
+//
+//  MeshSimplifierCheck
+//
+// Builds like ObjParserBench, from the repository root on OS X (a single command):
+//
+//  clang++ -std=c++11 -stdlib=libc++ -O2 -I$CINDER_PATH/include -I$CINDER_PATH/boost -ICommon/src -ITools/Common
+//      Tools/MeshSimplifierCheck/src/MeshSimplifierCheck.cpp Common/src/MeshSimplifier.cpp Common/src/MeshOptimizer.cpp
+//      Common/src/MeshData.cpp $CINDER_PATH/lib/libcinder.a -framework Cocoa -framework OpenGL -framework QuickTime
+//      -framework CoreVideo -framework AppKit -framework Accelerate -framework AudioToolbox -framework AudioUnit
+//      -framework CoreAudio -o MeshSimplifierCheck
+
+#include "cinder/Vector.h"
+
+#include "Check.h"
+
+#include "MeshData.h"
+#include "MeshSimplifier.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+
+using namespace ci;
+using namespace std;
+
+
+namespace {
+
+    // a welded grid of size x size quads, 0.5 apart, with a wave in z unless \a flat. The column at size / 2 is a
+    // texcoord seam: the quads on its right use their own copies of its vertices, with u starting again from 0
+    MeshDataRef seamGrid( size_t size, bool flat )
+    {
+        size_t      seam        = size / 2;
+        size_t      numVertices = ( size + 1 ) * ( size + 2 );
+        MeshDataRef data        = MeshData::create( MeshData::NORMAL | MeshData::TEXCOORD, numVertices, size * size * 6 );
+        float       *vertices   = data->getVertexStorage();
+        uint32_t    *indices    = data->getIndexStorage();
+        size_t      vertexSize  = data->getVertexSize();
+
+        // size + 2 columns per row, the seam column twice
+        for( size_t y=0; y <= size; y++ )
+        {
+            for( size_t column=0; column <= size + 1; column++ )
+            {
+                size_t  x   = column <= seam ? column : column - 1;
+                float   *v  = vertices + ( y * ( size + 2 ) + column ) * vertexSize;
+
+                v[0] = x * 0.5f;
+                v[1] = y * 0.5f;
+                v[2] = flat ? 0.0f : 0.25f * sin( x * 0.4f ) * cos( y * 0.3f );
+                v[3] = 0.0f;    v[4] = 0.0f;    v[5] = 1.0f;
+                v[6] = column <= seam ? (float)x / seam : (float)( x - seam ) / ( size - seam );
+                v[7] = (float)y / size;
+            }
+        }
+
+        for( size_t y=0; y < size; y++ )
+        {
+            for( size_t x=0; x < size; x++ )
+            {
+                size_t      column  = x < seam ? x : x + 1;
+                uint32_t    a       = (uint32_t)( y * ( size + 2 ) + column );
+                uint32_t    b       = a + (uint32_t)( size + 2 );
+                uint32_t    quad[6] = { a, a + 1, b + 1, a, b + 1, b };
+
+                memcpy( indices + ( y * size + x ) * 6, quad, sizeof(quad) );
+            }
+        }
+
+        return data;
+    }
+
+    bool hasPosition( const MeshData &data, const Vec3f &position )
+    {
+        for( size_t v=0; v < data.getNumVertices(); v++ )
+            if ( data.getPosition( v ) == position )
+                return true;
+
+        return false;
+    }
+
+    bool hasVertex( const MeshData &data, const float *vertex )
+    {
+        for( size_t v=0; v < data.getNumVertices(); v++ )
+            if ( memcmp( data.getVertices() + v * data.getVertexSize(), vertex, data.getVertexSize() * sizeof(float) ) == 0 )
+                return true;
+
+        return false;
+    }
+
+    Vec3f triangleNormal( const MeshData &data, size_t triangle )
+    {
+        const uint32_t *tri = data.getIndices() + triangle * 3;
+        Vec3f a = data.getPosition( tri[0] ), b = data.getPosition( tri[1] ), c = data.getPosition( tri[2] );
+
+        return ( b - a ).cross( c - a );
+    }
+
+    // total length of the edges used by a single triangle, on positions so the seam doesn't count
+    float outlineLength( const MeshData &data )
+    {
+        // an edge is the 6 coordinates of its ends, smallest end first
+        map<vector<float>, int> edges;
+
+        for( size_t k=0; k < data.getNumIndices(); k++ )
+        {
+            Vec3f a = data.getPosition( data.getIndices()[k] );
+            Vec3f b = data.getPosition( data.getIndices()[ k - k % 3 + ( k + 1 ) % 3 ] );
+
+            if ( lexicographical_compare( &b.x, &b.x + 3, &a.x, &a.x + 3 ) )
+                swap( a, b );
+
+            float key[6] = { a.x, a.y, a.z, b.x, b.y, b.z };
+            edges[ vector<float>( key, key + 6 ) ]++;
+        }
+
+        float length = 0.0f;
+        for( auto it = edges.begin(); it != edges.end(); ++it )
+            if ( it->second == 1 )
+                length += ( Vec3f( it->first[3], it->first[4], it->first[5] ) - Vec3f( it->first[0], it->first[1], it->first[2] ) ).length();
+
+        return length;
+    }
+
+}
+
+
+void checkWavy()
+{
+    const size_t size = 32;
+
+    MeshDataRef         grid = seamGrid( size, false );
+    float               error;
+    vector<uint32_t>    sources;
+    MeshDataRef         result = MeshSimplifier::simplify( *grid, grid->getNumIndices() / 4, &error, &sources );
+
+    check( result->getNumIndices() < grid->getNumIndices() / 2, "wavy", "fewer than half the indices" );
+    check( error > 0.0f && error < 0.25f, "wavy", "error between 0 and the wave amplitude" );
+
+    // every vertex of the result is its source vertex, untouched
+    bool copies = sources.size() == result->getNumVertices();
+    for( size_t v=0; copies && v < sources.size(); v++ )
+        copies = sources[v] < grid->getNumVertices() && memcmp( result->getVertices() + v * result->getVertexSize(),
+            grid->getVertices() + sources[v] * grid->getVertexSize(), grid->getVertexSize() * sizeof(float) ) == 0;
+
+    check( copies, "wavy", "vertices are copies of their source vertices" );
+
+    // the border positions and the seam vertices, both copies, never move
+    bool border = true, seam = true;
+    for( size_t y=0; y <= size; y++ )
+    {
+        for( size_t column=0; column <= size + 1; column++ )
+        {
+            const float *v = grid->getVertices() + ( y * ( size + 2 ) + column ) * grid->getVertexSize();
+
+            if ( y == 0 || y == size || column == 0 || column == size + 1 )
+                border &= hasPosition( *result, Vec3f( v[0], v[1], v[2] ) );
+            if ( column == size / 2 || column == size / 2 + 1 )
+                seam &= hasVertex( *result, v );
+        }
+    }
+
+    check( border, "wavy", "border vertices kept" );
+    check( seam, "wavy", "seam vertices kept on both sides" );
+    check( fabs( outlineLength( *result ) - outlineLength( *grid ) ) < 1e-3f, "wavy", "same outline" );
+
+    // same input, same output
+    float               again;
+    vector<uint32_t>    sourcesAgain;
+    MeshDataRef         second = MeshSimplifier::simplify( *grid, grid->getNumIndices() / 4, &again, &sourcesAgain );
+
+    check( again == error && sourcesAgain == sources && second->getNumIndices() == result->getNumIndices()
+        && memcmp( second->getIndices(), result->getIndices(), result->getNumIndices() * sizeof(uint32_t) ) == 0, "wavy", "deterministic" );
+}
+
+
+void checkFlat()
+{
+    const size_t size = 16;
+
+    MeshDataRef grid    = seamGrid( size, true );
+    float       error;
+    MeshDataRef result  = MeshSimplifier::simplify( *grid, 0, &error );
+
+    // only the border and the seam are left, collapses on a plane cost nothing
+    check( result->getNumIndices() < grid->getNumIndices() / 4, "flat", "simplified down to the border and the seam" );
+    check( error == 0.0f, "flat", "no error" );
+
+    float   area    = 0.0f;
+    bool    facing  = true;
+    for( size_t t=0; t < result->getNumIndices() / 3; t++ )
+    {
+        Vec3f n = triangleNormal( *result, t );
+        area   += n.length() * 0.5f;
+        facing &= n.z > 0.0f;
+    }
+
+    check( facing, "flat", "no triangle folds over" );
+    check( fabs( area - size * size * 0.25f ) < 1e-3f, "flat", "same area" );
+    check( fabs( outlineLength( *result ) - outlineLength( *grid ) ) < 1e-3f, "flat", "same outline" );
+}
+
+
+void checkTarget()
+{
+    // a target above the index count changes nothing but the order
+    MeshDataRef grid    = seamGrid( 8, false );
+    MeshDataRef result  = MeshSimplifier::simplify( *grid, grid->getNumIndices() );
+
+    check( result->getNumIndices() == grid->getNumIndices() && result->getNumVertices() == grid->getNumVertices(), "target", "nothing to collapse" );
+}
+
+
+int main()
+{
+    checkWavy();
+    checkFlat();
+    checkTarget();
+
+    return checkSummary( "MeshSimplifierCheck" );
+}
@@ -0,0 +1,176 @@
+// Compares ObjParser with ObjLoader: load time and identical TriMesh output, optimised and not.
+//
+//  ObjParserBench [--synthetic <vertices>] [--runs <n>] [file.obj]...
+//
+// Without files it runs on the bundled assets and a synthetic sphere of 2M vertices, written to the temp directory.
+// Builds like MeshCacheTool, from the repository root on OS X (a single command):
+//
+//  clang++ -std=c++11 -stdlib=libc++ -O2 -I$CINDER_PATH/include -I$CINDER_PATH/boost -ICommon/src
+//      Tools/ObjParserBench/src/ObjParserBench.cpp Common/src/ObjParser.cpp Common/src/JobSystem.cpp Common/src/MappedFile.cpp
+//      $CINDER_PATH/lib/libcinder.a -framework Cocoa -framework OpenGL -framework QuickTime -framework CoreVideo
+//      -framework AppKit -framework Accelerate -framework AudioToolbox -framework AudioUnit -framework CoreAudio
+//      -o ObjParserBench
+
+#include "cinder/ObjLoader.h"
+#include "cinder/Timer.h"
+#include "cinder/CinderMath.h"
+
+#include "ObjParser.h"
+#include "JobSystem.h"
+
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+using namespace ci;
+using namespace std;
+
+
+// UV sphere with normals and texcoords, about numVertices positions
+fs::path writeSphere( size_t numVertices )
+{
+    size_t      rings   = max<size_t>( 2, (size_t)sqrt( numVertices / 2.0 ) );
+    size_t      sectors = max<size_t>( 3, numVertices / rings );
+    fs::path    path    = fs::temp_directory_path() / "ObjParserBench-sphere.obj";
+    ofstream    out( path.string().c_str() );
+    char        line[128];
+
+    for( size_t r=0; r <= rings; r++ )
+    {
+        for( size_t s=0; s <= sectors; s++ )
+        {
+            float theta = (float)r / rings * (float)M_PI;
+            float phi   = (float)s / sectors * 2.0f * (float)M_PI;
+            Vec3f n( sin( theta ) * cos( phi ), cos( theta ), sin( theta ) * sin( phi ) );
+
+            snprintf( line, sizeof(line), "v %.6f %.6f %.6f\nvn %.6f %.6f %.6f\nvt %.6f %.6f\n", n.x * 10.0f, n.y * 10.0f, n.z * 10.0f, n.x, n.y, n.z, (float)s / sectors, (float)r / rings );
+            out << line;
+        }
+    }
+
+    for( size_t r=0; r < rings; r++ )
+    {
+        for( size_t s=0; s < sectors; s++ )
+        {
+            size_t a = r * ( sectors + 1 ) + s + 1;
+            size_t b = a + sectors + 1;
+            out << "f " << a << "/" << a << "/" << a << " " << b << "/" << b << "/" << b << " " << b + 1 << "/" << b + 1 << "/" << b + 1 << " " << a + 1 << "/" << a + 1 << "/" << a + 1 << "\n";
+        }
+    }
+
+    return path;
+}
+
+
+template<typename T>
+bool sameArray( const vector<T> &a, const vector<T> &b )
+{
+    return a.size() == b.size() && ( a.empty() || memcmp( a.data(), b.data(), a.size() * sizeof(T) ) == 0 );
+}
+
+
+bool sameMesh( const TriMesh &a, const TriMesh &b )
+{
+    return sameArray( a.getVertices(), b.getVertices() ) && sameArray( a.getNormals(), b.getNormals() )
+        && sameArray( a.getTexCoords(), b.getTexCoords() ) && sameArray( a.getIndices(), b.getIndices() );
+}
+
+
+// best of the runs, in ms
+template<typename Fn>
+double bestOf( int runs, Fn fn )
+{
+    double best = 1e30;
+    for( int k=0; k < runs; k++ )
+    {
+        Timer timer( true );
+        fn();
+        best = min( best, timer.getSeconds() * 1000.0 );
+    }
+    return best;
+}
+
+
+bool bench( const fs::path &path, int runs, JobSystem *jobs )
+{
+    bool identical = true;
+
+    cout << path.filename().string() << " (" << fs::file_size( path ) / 1024 << " KB)" << endl;
+
+    for( int optimize=1; optimize >= 0; optimize-- )
+    {
+        TriMesh loaderMesh, serialMesh, parallelMesh;
+
+        double loaderMs = bestOf( runs, [&]() {
+            ObjLoader loader( DataSourcePath::create( path ) );
+            loader.load( &loaderMesh, boost::logic::indeterminate, boost::logic::indeterminate, optimize != 0 );
+        } );
+
+        double serialMs = bestOf( runs, [&]() {
+            ObjParser::create( path )->load( &serialMesh, optimize != 0 );
+        } );
+
+        double parallelMs = bestOf( runs, [&]() {
+            ObjParser::create( path, true, jobs )->load( &parallelMesh, optimize != 0 );
+        } );
+
+        bool same = sameMesh( loaderMesh, serialMesh ) && sameMesh( loaderMesh, parallelMesh );
+        identical = identical && same;
+
+        printf( "  %-12s %9zu vertices  ObjLoader %9.2f ms  ObjParser %9.2f ms (x%.1f)  %zu threads %9.2f ms (x%.1f)  %s\n",
+                optimize ? "optimised" : "unoptimised", loaderMesh.getNumVertices(), loaderMs, serialMs, loaderMs / serialMs,
+                jobs->getNumWorkers() + 1, parallelMs, loaderMs / parallelMs, same ? "identical" : "DIFFERENT" );
+    }
+
+    return identical;
+}
+
+
+int main( int argc, char *argv[] )
+{
+    size_t              synthetic   = 2000000;
+    int                 runs        = 3;
+    vector<fs::path>    files;
+
+    for( int k=1; k < argc; k++ )
+    {
+        string arg = argv[k];
+
+        if ( arg == "--synthetic" && k + 1 < argc )
+            synthetic = (size_t)atol( argv[++k] );
+        else if ( arg == "--runs" && k + 1 < argc )
+            runs = max( 1, atoi( argv[++k] ) );
+        else
+            files.push_back( arg );
+    }
+
+    if ( files.empty() )
+    {
+        files.push_back( "SoundObject/assets/head-low.obj" );
+        files.push_back( "SoundShaderObject/assets/cube.obj" );
+        files.push_back( "SoundShaderObject/assets/shape01.obj" );
+        files.push_back( "SoundShaderObject/assets/shape01b.obj" );
+    }
+
+    if ( synthetic > 0 )
+        files.push_back( writeSphere( synthetic ) );
+
+    JobSystemRef    jobs    = JobSystem::create();
+    bool            ok      = true;
+
+    for( size_t k=0; k < files.size(); k++ )
+    {
+        try {
+            ok = bench( files[k], runs, jobs.get() ) && ok;
+        }
+        catch( const std::exception &exc ) {
+            cerr << files[k].string() << ": " << exc.what() << endl;
+            ok = false;
+        }
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,248 @@
+// Checks ObjParser against small OBJ fixtures with known results: positions, texcoords, normals and indices,
+// welded and not, plus a file of several chunks parsed with and without jobs. Exits with a failure if any check fails.
+//
+//  ObjParserCheck
+//
+// The fixtures are written to the temp directory. Builds like ObjParserBench, from the repository root on OS X (a single command):
+//
+//  clang++ -std=c++11 -stdlib=libc++ -O2 -I$CINDER_PATH/include -I$CINDER_PATH/boost -ICommon/src -ITools/Common
+//      Tools/ObjParserCheck/src/ObjParserCheck.cpp Common/src/ObjParser.cpp Common/src/JobSystem.cpp Common/src/MappedFile.cpp
+//      $CINDER_PATH/lib/libcinder.a -framework Cocoa -framework OpenGL -framework QuickTime -framework CoreVideo
+//      -framework AppKit -framework Accelerate -framework AudioToolbox -framework AudioUnit -framework CoreAudio
+//      -o ObjParserCheck
+
+#include "cinder/TriMesh.h"
+#include "cinder/Filesystem.h"
+
+#include "Check.h"
+
+#include "ObjParser.h"
+#include "JobSystem.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+
+using namespace ci;
+using namespace std;
+
+
+namespace {
+
+    fs::path writeFixture( const string &name, const string &text )
+    {
+        fs::path path = fs::temp_directory_path() / ( "ObjParserCheck-" + name + ".obj" );
+        ofstream out( path.string().c_str(), ios::binary | ios::trunc );
+        out << text;
+
+        return path;
+    }
+
+    TriMesh parse( const fs::path &path, bool optimize, JobSystem *jobs = nullptr )
+    {
+        TriMesh mesh;
+        ObjParser::create( path, true, jobs )->load( &mesh, optimize );
+
+        return mesh;
+    }
+
+    template<typename T>
+    bool sameArray( const vector<T> &a, const vector<T> &b )
+    {
+        return a.size() == b.size() && ( a.empty() || memcmp( a.data(), b.data(), a.size() * sizeof(T) ) == 0 );
+    }
+
+    bool sameMesh( const TriMesh &a, const TriMesh &b )
+    {
+        return sameArray( a.getVertices(), b.getVertices() ) && sameArray( a.getNormals(), b.getNormals() )
+            && sameArray( a.getTexCoords(), b.getTexCoords() ) && sameArray( a.getIndices(), b.getIndices() );
+    }
+
+    bool hasIndices( const TriMesh &mesh, const uint32_t *indices, size_t count )
+    {
+        return mesh.getIndices().size() == count && memcmp( mesh.getIndices().data(), indices, count * sizeof(uint32_t) ) == 0;
+    }
+
+}
+
+
+void checkTriangle()
+{
+    fs::path    path    = writeFixture( "triangle", "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n" );
+    TriMesh     mesh    = parse( path, true );
+
+    const uint32_t indices[] = { 0, 1, 2 };
+
+    check( mesh.getNumVertices() == 3, "triangle", "3 vertices" );
+    check( hasIndices( mesh, indices, 3 ), "triangle", "indices 0 1 2" );
+    check( mesh.getVertices()[1] == Vec3f( 1, 0, 0 ), "triangle", "second position" );
+    check( mesh.getNormals().empty() && mesh.getTexCoords().empty(), "triangle", "no normals or texcoords" );
+}
+
+
+void checkQuads()
+{
+    // two quads sharing an edge, split as fans. Each corner keeps its own texcoord and the shared normal,
+    // welding merges the corners of the shared edge, without it every face has its own corners
+    fs::path path = writeFixture( "quads",
+        "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nv 2 0 0\nv 2 1 0\n"
+        "vt 0 0\nvt 0.5 0\nvt 0.5 1\nvt 0 1\nvt 1 0\nvt 1 1\n"
+        "vn 0 0 1\n"
+        "f 1/1/1 2/2/1 3/3/1 4/4/1\n"
+        "f 2/2/1 5/5/1 6/6/1 3/3/1\n" );
+
+    TriMesh welded  = parse( path, true );
+    TriMesh flat    = parse( path, false );
+
+    const uint32_t weldedIndices[]  = { 0, 1, 2, 0, 2, 3, 1, 4, 5, 1, 5, 2 };
+    const uint32_t flatIndices[]    = { 0, 1, 2, 0, 2, 3, 4, 5, 6, 4, 6, 7 };
+
+    check( welded.getNumVertices() == 6, "quads", "6 welded vertices" );
+    check( hasIndices( welded, weldedIndices, 12 ), "quads", "fan indices, welded" );
+    check( welded.getTexCoords().size() == 6 && welded.getTexCoords()[5] == Vec2f( 1, 1 ), "quads", "texcoords" );
+    check( welded.getNormals().size() == 6 && welded.getNormals()[3] == Vec3f( 0, 0, 1 ), "quads", "normals" );
+
+    check( flat.getNumVertices() == 8, "quads", "8 vertices without welding" );
+    check( hasIndices( flat, flatIndices, 12 ), "quads", "fan indices, not welded" );
+    check( flat.getNumVertices() == 8 && flat.getVertices()[4] == Vec3f( 1, 0, 0 ) && flat.getVertices()[7] == Vec3f( 1, 1, 0 ), "quads", "corners of the second face" );
+}
+
+
+void checkNegativeIndices()
+{
+    // relative indices count back from the last vertex defined so far
+    fs::path positive = writeFixture( "positive", "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nf 1 2 3\nf 1 3 4\n" );
+    fs::path negative = writeFixture( "negative", "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nf -4 -3 -2\nf -4 -2 -1\n" );
+
+    check( sameMesh( parse( positive, true ), parse( negative, true ) ), "negative", "same mesh as absolute indices" );
+    check( sameMesh( parse( positive, false ), parse( negative, false ) ), "negative", "same mesh as absolute indices, not welded" );
+}
+
+
+void checkFormatting()
+{
+    // comment lines, blank lines, CRLF, tabs, a continued line, exponents and signs.
+    // A comment at the end of a face line isn't supported, as in ObjLoader
+    fs::path path = writeFixture( "formatting",
+        "# header comment\r\n"
+        "\r\n"
+        "v\t1.5 -2.25e1 +3\r\n"
+        "v 1e-2 \\\n 0.125 -0\r\n"
+        "v .5 4E2 -7.\r\n"
+        "# comment between lines\r\n"
+        "f 1 2 3\r\n" );
+
+    TriMesh mesh = parse( path, true );
+
+    check( mesh.getNumVertices() == 3, "formatting", "3 vertices" );
+
+    if ( mesh.getNumVertices() == 3 )
+    {
+        check( mesh.getVertices()[0] == Vec3f( 1.5f, -22.5f, 3.0f ), "formatting", "tab separated exponent and plus sign" );
+        check( mesh.getVertices()[1] == Vec3f( 0.01f, 0.125f, 0.0f ), "formatting", "continued line" );
+        check( mesh.getVertices()[2] == Vec3f( 0.5f, 400.0f, -7.0f ), "formatting", "leading and trailing dots" );
+    }
+}
+
+
+void checkGroups()
+{
+    // welding is across the whole mesh like ObjLoader, a position shared by two groups is one vertex
+    fs::path path = writeFixture( "groups",
+        "v 0 0 0\nv 1 0 0\nv 0 1 0\nv 1 1 0\n"
+        "g first\nf 1 2 3\n"
+        "g second\nf 2 4 3\n" );
+
+    ObjParserRef    parser = ObjParser::create( path );
+    TriMesh         welded;
+    parser->load( &welded );
+
+    TriMesh flat = parse( path, false );
+
+    const uint32_t weldedIndices[]  = { 0, 1, 2, 1, 3, 2 };
+    const uint32_t flatIndices[]    = { 0, 1, 2, 3, 4, 5 };
+
+    check( parser->getNumGroups() == 2 && parser->getNumFaces() == 2, "groups", "2 groups of 1 face" );
+    check( welded.getNumVertices() == 4 && hasIndices( welded, weldedIndices, 6 ), "groups", "vertices welded across groups" );
+    check( flat.getNumVertices() == 6 && hasIndices( flat, flatIndices, 6 ), "groups", "vertices per face without welding" );
+}
+
+
+void checkInvalidIndex()
+{
+    fs::path    path    = writeFixture( "invalid", "v 0 0 0\nv 1 0 0\nf 1 2 3\n" );
+    bool        thrown  = false;
+
+    try {
+        parse( path, true );
+    }
+    catch( const ObjParserExc & ) {
+        thrown = true;
+    }
+
+    check( thrown, "invalid", "an index past the last vertex throws ObjParserExc" );
+}
+
+
+void checkChunks()
+{
+    // a grid large enough to be split in several chunks, with relative indices that cross the chunk boundaries
+    const size_t size = 400;
+
+    ostringstream text;
+
+    for( size_t y=0; y <= size; y++ )
+        for( size_t x=0; x <= size; x++ )
+            text << "v " << x * 0.25 << " " << y * 0.25 << " " << ( ( x * 7 + y * 3 ) % 11 ) * 0.125 << "\nvt " << x / (float)size << " " << y / (float)size << "\n";
+
+    text << "vn 0 0 1\n";
+
+    for( size_t y=0; y < size; y++ )
+    {
+        if ( y % 100 == 0 )
+            text << "g rows" << y << "\n";
+
+        for( size_t x=0; x < size; x++ )
+        {
+            size_t a = y * ( size + 1 ) + x + 1;
+            size_t b = a + size + 1;
+            text << "f " << a << "/" << a << "/1 " << a + 1 << "/" << a + 1 << "/1 " << b + 1 << "/" << b + 1 << "/-1 " << b << "/" << b << "/-1\n";
+        }
+    }
+
+    fs::path        path    = writeFixture( "chunks", text.str() );
+    JobSystemRef    jobs    = JobSystem::create( 3 );
+
+    check( fs::file_size( path ) > ( 2 << 20 ), "chunks", "the fixture spans several chunks" );
+
+    for( int optimize=0; optimize < 2; optimize++ )
+    {
+        TriMesh serial      = parse( path, optimize != 0 );
+        TriMesh parallel    = parse( path, optimize != 0, jobs.get() );
+
+        check( serial.getNumIndices() == size * size * 6, "chunks", "2 triangles per grid cell" );
+        check( sameMesh( serial, parallel ), "chunks", optimize ? "same welded mesh with and without jobs" : "same mesh with and without jobs" );
+    }
+
+    // one vertex per grid point once welded, 4 per cell without
+    check( parse( path, true ).getNumVertices() == ( size + 1 ) * ( size + 1 ), "chunks", "one welded vertex per grid point" );
+    check( parse( path, false ).getNumVertices() == size * size * 4, "chunks", "4 vertices per cell without welding" );
+}
+
+
+int main()
+{
+    checkTriangle();
+    checkQuads();
+    checkNegativeIndices();
+    checkFormatting();
+    checkGroups();
+    checkInvalidIndex();
+    checkChunks();
+
+    return checkSummary( "ObjParserCheck" );
+}
@@ -0,0 +1,234 @@
+// Checks SpectrumKernel against a double precision Hann windowed DFT for every window size from 8 to 4096: the
+// magnitudes, the Bark bands and the peak of a tone, then shape() against its scalar formula. Exits with a failure if any check fails.
+// Build it twice to cover both paths of the kernel, the second time with the SSE2 code compiled out:
+//
+//  SpectrumCheck
+//
+// From the repository root, it only needs the kernel:
+//
+//  clang++ -std=c++11 -O2 -ICommon/src -ITools/Common Tools/SpectrumCheck/src/SpectrumCheck.cpp Common/src/SpectrumKernel.cpp -o SpectrumCheck
+//  clang++ -std=c++11 -O2 -DSIMD_SSE2=0 -ICommon/src -ITools/Common Tools/SpectrumCheck/src/SpectrumCheck.cpp Common/src/SpectrumKernel.cpp -o SpectrumCheckScalar
+
+#include "Check.h"
+
+#include "SpectrumKernel.h"
+#include "SimdMath.h"
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+
+using namespace std;
+
+
+namespace {
+
+    const double kTwoPi = 6.283185307179586;
+
+    // the edges of xtract_init_bark(), in Hz
+    const float kBarkEdges[SpectrumKernel::NUM_BARK_BANDS + 1] = {
+        0, 100, 200, 300, 400, 510, 630, 770, 920, 1080, 1270, 1480, 1720, 2000, 2320, 2700, 3150, 3700, 4400,
+        5300, 6400, 7700, 9500, 12000, 15500, 20500, 27000
+    };
+
+    uint32_t sSeed = 1;
+
+    float random( float low, float high )
+    {
+        sSeed = sSeed * 1664525u + 1013904223u;
+        return low + ( high - low ) * ( sSeed >> 8 ) / 16777216.0f;
+    }
+
+    // |X[k]| / N of the Hann windowed input for k below N / 2, the direct sum in double
+    vector<double> referenceSpectrum( const vector<float> &pcm )
+    {
+        size_t          n = pcm.size();
+        vector<double>  windowed( n );
+        vector<double>  spectrum( n / 2 );
+
+        for( size_t k=0; k < n; k++ )
+            windowed[k] = pcm[k] * 0.5 * ( 1.0 - cos( kTwoPi * k / ( n - 1 ) ) );
+
+        for( size_t bin=0; bin < n / 2; bin++ )
+        {
+            double re = 0.0, im = 0.0;
+            for( size_t k=0; k < n; k++ )
+            {
+                // the angle modulo 2 pi, exact in integers
+                double angle = kTwoPi * ( ( bin * k ) % n ) / n;
+                re += windowed[k] * cos( angle );
+                im -= windowed[k] * sin( angle );
+            }
+
+            spectrum[bin] = sqrt( re * re + im * im ) / n;
+        }
+
+        return spectrum;
+    }
+
+    string sizeName( size_t n )
+    {
+        ostringstream name;
+        name << "n=" << n;
+        return name.str();
+    }
+
+}
+
+
+void checkSpectrum( size_t n, float sampleRate )
+{
+    // noise with two tones, one of them on a bin
+    vector<float> pcm( n );
+    for( size_t k=0; k < n; k++ )
+        pcm[k] = random( -0.25f, 0.25f ) + 0.5f * (float)sin( kTwoPi * k * ( n / 8 ) / n ) + 0.25f * (float)cos( kTwoPi * k * 3.3 / n );
+
+    SpectrumKernel kernel;
+    kernel.init( n, sampleRate );
+    kernel.process( pcm.data() );
+
+    vector<double>  reference   = referenceSpectrum( pcm );
+    double          peak        = *max_element( reference.begin(), reference.end() );
+    double          maxError    = 0.0;
+
+    for( size_t bin=0; bin < n / 2; bin++ )
+        maxError = max( maxError, fabs( kernel.getSpectrum()[bin] - reference[bin] ) );
+
+    string name = sizeName( n );
+
+    check( kernel.getSpectrumSize() == n / 2 && kernel.getNumBands() == SpectrumKernel::NUM_BARK_BANDS, name, "sizes" );
+    check( maxError <= 1e-5 * peak, name, "magnitudes within 1e-5 of the peak" );
+
+    size_t peakBin = max_element( kernel.getSpectrum(), kernel.getSpectrum() + n / 2 ) - kernel.getSpectrum();
+    check( peakBin == n / 8, name, "peak on the tone bin" );
+
+    // each band sums the bins from its lower edge up to the next one, like LibXtract, the edges in float like its tables
+    float   nyquist     = sampleRate * 0.5f;
+    float   half        = (float)( n / 2 );
+    double  bandError   = 0.0;
+    double  total       = 0.0;
+
+    for( size_t band=0; band < SpectrumKernel::NUM_BARK_BANDS; band++ )
+    {
+        size_t  low     = (size_t)min( half, kBarkEdges[band] / nyquist * half );
+        size_t  high    = (size_t)min( half, kBarkEdges[band + 1] / nyquist * half );
+        double  sum     = 0.0;
+
+        for( size_t bin=low; bin < high; bin++ )
+            sum += reference[bin];
+
+        bandError   = max( bandError, fabs( kernel.getBands()[band] - sum ) );
+        total      += sum;
+    }
+
+    check( bandError <= 1e-5 * max( total, peak ), name, "bands within 1e-5 of the reference sums" );
+}
+
+
+void checkSilence()
+{
+    vector<float> pcm( 512, 0.0f );
+
+    SpectrumKernel kernel;
+    kernel.init( 512, 44100.0f );
+    kernel.process( pcm.data() );
+
+    bool zero = true;
+    for( size_t bin=0; bin < kernel.getSpectrumSize(); bin++ )
+        zero &= kernel.getSpectrum()[bin] == 0.0f;
+    for( size_t band=0; band < kernel.getNumBands(); band++ )
+        zero &= kernel.getBands()[band] == 0.0f;
+
+    check( zero, "silence", "zero spectrum and bands" );
+
+    // process() reuses its buffers, a second window doesn't keep anything of the first
+    for( size_t k=0; k < 512; k++ )
+        pcm[k] = random( -1.0f, 1.0f );
+
+    kernel.process( pcm.data() );
+    fill( pcm.begin(), pcm.end(), 0.0f );
+    kernel.process( pcm.data() );
+
+    check( *max_element( kernel.getSpectrum(), kernel.getSpectrum() + kernel.getSpectrumSize() ) == 0.0f, "silence", "nothing left of the previous window" );
+}
+
+
+void checkInvalidSizes()
+{
+    const size_t sizes[] = { 0, 1, 4, 12, 1000, 4097 };
+
+    for( size_t k=0; k < sizeof(sizes) / sizeof(sizes[0]); k++ )
+    {
+        SpectrumKernel  kernel;
+        bool            thrown = false;
+
+        try {
+            kernel.init( sizes[k], 44100.0f );
+        }
+        catch( const invalid_argument & ) {
+            thrown = true;
+        }
+
+        check( thrown, sizeName( sizes[k] ), "init() throws for a size that isn't a power of two of at least 8" );
+    }
+}
+
+
+void checkShape()
+{
+    // an odd count runs both the 4 wide loop and the tail
+    const size_t count = 37;
+
+    vector<float> raw( count ), results( count ), expected( count );
+    for( size_t k=0; k < count; k++ )
+    {
+        raw[k]      = random( -0.5f, 2.0f );
+        results[k]  = expected[k] = random( 0.0f, 1.0f );
+    }
+
+    for( int pass=0; pass < 3; pass++ )
+    {
+        const float gain = 1.5f, offset = -0.1f, damping = 0.9f;
+
+        for( size_t k=0; k < count; k++ )
+        {
+            float v     = min( max( offset + gain * raw[k], 0.0f ), 1.0f );
+            expected[k] = max( v, v + damping * ( expected[k] - v ) );
+        }
+
+        SpectrumKernel::shape( raw.data(), count, gain, offset, damping, results.data() );
+
+        // the falling values of the next pass
+        for( size_t k=0; k < count; k++ )
+            raw[k] *= 0.5f;
+    }
+
+    float maxError = 0.0f;
+    for( size_t k=0; k < count; k++ )
+        maxError = max( maxError, fabs( results[k] - expected[k] ) );
+
+    check( maxError <= 1e-6f, "shape", "same as the scalar formula" );
+}
+
+
+int main()
+{
+    cout << "SpectrumCheck: " << ( SIMD_SSE2 ? "SSE2" : "scalar" ) << " path" << endl;
+
+    for( size_t n=8; n <= 4096; n *= 2 )
+    {
+        checkSpectrum( n, 44100.0f );
+        checkSpectrum( n, 48000.0f );
+    }
+
+    checkSilence();
+    checkInvalidSizes();
+    checkShape();
+
+    return checkSummary( "SpectrumCheck" );
+}
@@ -0,0 +1,180 @@
+// Checks the conversions of VertexPacking: snorm16 rounding and clamping, half floats against every half value and
+// a nearest-value reference, and the round trip error of octahedral normals over the sphere. Exits with a failure if any check fails.
+//
+//  VertexPackingCheck
+//
+// Builds like ObjParserBench, from the repository root on OS X (a single command):
+//
+//  clang++ -std=c++11 -stdlib=libc++ -O2 -I$CINDER_PATH/include -I$CINDER_PATH/boost -ICommon/src -ITools/Common
+//      Tools/VertexPackingCheck/src/VertexPackingCheck.cpp Common/src/VertexPacking.cpp -o VertexPackingCheck
+
+#include "cinder/Vector.h"
+
+#include "Check.h"
+
+#include "VertexPacking.h"
+
+#include <iostream>
+#include <string>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+
+using namespace ci;
+using namespace std;
+
+
+namespace {
+
+    float fromBits( uint32_t bits )
+    {
+        float value;
+        memcpy( &value, &bits, sizeof(value) );
+        return value;
+    }
+
+    bool isNan( float value )
+    {
+        return value != value;
+    }
+
+}
+
+
+void checkSnorm16()
+{
+    check( VertexPacking::packSnorm16( 1.0f ) == 32767 && VertexPacking::packSnorm16( -1.0f ) == -32767, "snorm16", "1 and -1" );
+    check( VertexPacking::packSnorm16( 2.0f ) == 32767 && VertexPacking::packSnorm16( -2.0f ) == -32767, "snorm16", "clamped to [-1, 1]" );
+    check( VertexPacking::packSnorm16( 0.0f ) == 0 && VertexPacking::packSnorm16( -0.0f ) == 0, "snorm16", "0 and -0" );
+    check( VertexPacking::packSnorm16( 0.5f ) == 16384 && VertexPacking::packSnorm16( -0.5f ) == -16383, "snorm16", "halfway rounds up" );
+
+    // every value comes back within half a step
+    float maxError = 0.0f;
+    for( int k=-100000; k <= 100000; k++ )
+    {
+        float value = k / 100000.0f;
+        maxError = max( maxError, fabs( VertexPacking::unpackSnorm16( VertexPacking::packSnorm16( value ) ) - value ) );
+    }
+
+    check( maxError <= 0.5f / 32767.0f + 1e-7f, "snorm16", "round trip within half a step" );
+
+    bool exact = true;
+    for( int k=-32767; k <= 32767; k++ )
+        exact &= VertexPacking::packSnorm16( VertexPacking::unpackSnorm16( (int16_t)k ) ) == k;
+
+    check( exact, "snorm16", "every value packs back to itself" );
+}
+
+
+void checkHalfValues()
+{
+    check( VertexPacking::packHalf( 1.0f ) == 0x3C00 && VertexPacking::packHalf( -2.0f ) == 0xC000, "half", "1 and -2" );
+    check( VertexPacking::packHalf( 0.0f ) == 0x0000 && VertexPacking::packHalf( -0.0f ) == 0x8000, "half", "signed zeros" );
+    check( VertexPacking::packHalf( 65504.0f ) == 0x7BFF && VertexPacking::packHalf( 65519.0f ) == 0x7BFF, "half", "largest half" );
+    check( VertexPacking::packHalf( 65520.0f ) == 0x7C00 && VertexPacking::packHalf( -1e10f ) == 0xFC00, "half", "overflow to infinity" );
+    check( VertexPacking::packHalf( ldexp( 1.0f, -24 ) ) == 0x0001 && VertexPacking::packHalf( ldexp( 1.0f, -14 ) ) == 0x0400, "half", "smallest denormal and normal" );
+    check( VertexPacking::packHalf( ldexp( 1.0f, -25 ) ) == 0x0000 && VertexPacking::packHalf( ldexp( 3.0f, -25 ) ) == 0x0002, "half", "denormal ties to even" );
+    check( VertexPacking::packHalf( 1.0f + ldexp( 1.0f, -11 ) ) == 0x3C00 && VertexPacking::packHalf( 1.0f + ldexp( 3.0f, -11 ) ) == 0x3C02, "half", "normal ties to even" );
+    check( VertexPacking::packHalf( 1.0f + ldexp( 1.0f, -11 ) + ldexp( 1.0f, -20 ) ) == 0x3C01, "half", "above the tie rounds up" );
+    check( VertexPacking::packHalf( 2047.5f ) == 0x6800, "half", "rounding carries into the exponent" );
+
+    uint16_t nan = VertexPacking::packHalf( fromBits( 0x7FC00000 ) );
+    check( ( nan & 0x7C00 ) == 0x7C00 && ( nan & 0x03FF ) != 0, "half", "NaN stays NaN" );
+    check( ( VertexPacking::packHalf( fromBits( 0x7F800001 ) ) & 0x03FF ) != 0, "half", "signalling NaN doesn't become infinity" );
+}
+
+
+void checkHalfRoundTrip()
+{
+    // every half that isn't NaN unpacks and packs back to itself
+    bool exact = true;
+    for( uint32_t h=0; h < 0x10000; h++ )
+    {
+        float value = VertexPacking::unpackHalf( (uint16_t)h );
+
+        if ( isNan( value ) )
+            exact &= ( h & 0x7C00 ) == 0x7C00 && ( h & 0x03FF ) != 0;
+        else
+            exact &= VertexPacking::packHalf( value ) == h;
+    }
+
+    check( exact, "half", "every half packs back to itself" );
+
+    // floats through the finite range pack to the nearest half, ties to the even one
+    bool nearest = true;
+    for( uint32_t bits=0; bits < 0x477FF000; bits += 997 )
+    {
+        float       value   = fromBits( bits );
+        uint16_t    h       = VertexPacking::packHalf( value );
+        double      error   = fabs( (double)VertexPacking::unpackHalf( h ) - value );
+
+        if ( h > 0 )
+            nearest &= error <= fabs( (double)VertexPacking::unpackHalf( h - 1 ) - value );
+
+        double above = fabs( (double)VertexPacking::unpackHalf( h + 1 ) - value );
+        nearest &= error < above || ( error == above && ( h & 1 ) == 0 );
+    }
+
+    check( nearest, "half", "nearest half" );
+}
+
+
+void checkOctahedral()
+{
+    const Vec3f axes[] = { Vec3f( 1, 0, 0 ), Vec3f( -1, 0, 0 ), Vec3f( 0, 1, 0 ), Vec3f( 0, -1, 0 ), Vec3f( 0, 0, 1 ), Vec3f( 0, 0, -1 ) };
+
+    bool exactAxes = true;
+    for( size_t k=0; k < 6; k++ )
+    {
+        int16_t packed[2];
+        VertexPacking::packOctahedral( axes[k], packed );
+        exactAxes &= VertexPacking::unpackOctahedral( packed ) == axes[k];
+    }
+
+    check( exactAxes, "octahedral", "axes are exact" );
+
+    // a Fibonacci spiral covers the sphere evenly, both hemispheres and the fold at z = 0
+    const size_t    count       = 100000;
+    const float     goldenAngle = 2.39996323f;
+    double          maxAngle    = 0.0;
+    float           maxLength   = 0.0f;
+
+    for( size_t k=0; k < count; k++ )
+    {
+        float z = 1.0f - 2.0f * ( k + 0.5f ) / count;
+        float r = sqrt( 1.0f - z * z );
+        Vec3f n( r * cos( goldenAngle * k ), r * sin( goldenAngle * k ), z );
+
+        int16_t packed[2];
+        VertexPacking::packOctahedral( n, packed );
+        Vec3f unpacked = VertexPacking::unpackOctahedral( packed );
+
+        // in double, a float dot product this close to 1 only has a few bits left
+        double dx = (double)n.y * unpacked.z - (double)n.z * unpacked.y;
+        double dy = (double)n.z * unpacked.x - (double)n.x * unpacked.z;
+        double dz = (double)n.x * unpacked.y - (double)n.y * unpacked.x;
+        double d  = (double)n.x * unpacked.x + (double)n.y * unpacked.y + (double)n.z * unpacked.z;
+
+        maxAngle    = max( maxAngle, atan2( sqrt( dx * dx + dy * dy + dz * dz ), d ) );
+        maxLength   = max( maxLength, fabs( unpacked.length() - 1.0f ) );
+    }
+
+    // half a step of 1 / 32767 on the octahedron is under 0.004 degree on the sphere, the bound leaves some margin
+    check( maxAngle <= 0.01 * 3.14159265 / 180.0, "octahedral", "round trip within 0.01 degree" );
+    check( maxLength <= 1e-6f, "octahedral", "unit length" );
+
+    int16_t zero[2] = { 1, 1 };
+    VertexPacking::packOctahedral( Vec3f( 0, 0, 0 ), zero );
+    check( zero[0] == 0 && zero[1] == 0, "octahedral", "zero vector packs to 0" );
+}
+
+
+int main()
+{
+    checkSnorm16();
+    checkHalfValues();
+    checkHalfRoundTrip();
+    checkOctahedral();
+
+    return checkSummary( "VertexPackingCheck" );
+}